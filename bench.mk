@@ -0,0 +1,44 @@
+# Native benchmarks of the conversion engine. These don't need Node.js or N-API.
+UNAME := $(shell uname -s)
+BENCH_OBJS := build/bench/Backend.o build/bench/PortableBackend.o build/bench/Codec.o build/bench/ascii.o build/bench/ChunkedCoders.o build/bench/unicode.o build/bench/MultiByteTables.o build/bench/representable.o build/bench/detect.o build/bench/pool.o
+BENCHES := build/bench/encode build/bench/unicode build/bench/suite
+
+ifeq ($(UNAME),Darwin)
+CXXFLAGS := -flto -O2 -Wall -std=c++17 $(CXXFLAGS)
+LDFLAGS := $(CXXFLAGS) -framework CoreFoundation -liconv $(LDFLAGS)
+BENCH_OBJS += build/bench/CFBackend.o build/bench/IconvCoders.o
+else
+CXXFLAGS := -flto -O2 -Wall -std=c++17 $(CXXFLAGS)
+LDFLAGS := $(CXXFLAGS) $(LDFLAGS)
+endif
+
+.PHONY: all run encode unicode suite
+.SECONDARY:
+all: $(BENCHES)
+
+run: $(BENCHES)
+	@for bench in $(BENCHES); do $$bench || exit 1; done
+
+encode: build/bench/encode
+	build/bench/encode
+
+unicode: build/bench/unicode
+	build/bench/unicode
+
+# Writes JSON results to standard output. Pass options with SUITE_ARGS, such as SUITE_ARGS=--max-size=256M.
+suite: build/bench/suite
+	build/bench/suite $(SUITE_ARGS)
+
+# The suite measures the CJK encodings too, so it needs their tables.
+build/bench/suite: | lib/cjk-tables.bin
+
+build/bench/%: bench/%.cc $(BENCH_OBJS)
+	$(CXX) $(LDFLAGS) -o $@ $^
+
+build/bench/%.o: src/%.cc
+	@mkdir -p build/bench
+	$(CXX) $(CXXFLAGS) -c -o $@ $^
+
+lib/cjk-tables.bin: tools/generate-cjk-tables.py tools/cjk-tables.sha256
+	@mkdir -p lib
+	python3 $< $@
@@ -0,0 +1,140 @@
+// Measures the Node.js API (decode, encode, transcode, and encodeSmallest) for several kinds of text, in each family of encodings, at sizes from 16 bytes up. This includes the cost of crossing N-API, copying strings in and out of JavaScript, and allocating Buffers, which the native benchmarks leave out. The results are written as JSON, so that runs of different versions can be compared.
+//
+// Build the module first (npm run prepare), then run with: npm run bench:api
+//
+// Options:
+//   --max-size=N   Largest input, in bytes of UTF-16. Defaults to 16M. Inputs go up to 256M, but those need several GiB of memory.
+//   --min-time=N   Milliseconds to spend on each measurement. Defaults to 100.
+//   --filter=S     Only run measurements whose operation, corpus, or encoding name contains S.
+
+import { encodeSmallest, StringEncoding, transcode } from "..";
+
+interface Options {
+	maxSize: number;
+	minTime: number;
+	filter: string;
+}
+
+function parseSize(text: string): number {
+	const match = /^(\d+)([kmg]?)$/i.exec(text);
+	if (!match)
+		throw new RangeError(`Not a size: ${text}`);
+	return Number(match[1]) * 1024 ** " kmg".indexOf(match[2].toLowerCase() || " ");
+}
+
+function parseOptions(args: string[]): Options {
+	const options: Options = { maxSize: 16 * 1024 * 1024, minTime: 100, filter: "" };
+
+	for (const arg of args) {
+		const [name, value] = arg.split(/=(.*)/);
+
+		switch (name) {
+			case "--max-size": options.maxSize = parseSize(value); break;
+			case "--min-time": options.minTime = Number(value); break;
+			case "--filter": options.filter = value; break;
+			default: throw new RangeError(`Unrecognized option: ${arg}`);
+		}
+	}
+
+	return options;
+}
+
+/** Peak resident set size of this process so far, in bytes. Older versions of Node.js can only tell the current size. */
+function peakRSS(): number {
+	const { resourceUsage } = process as { resourceUsage?: () => { maxRSS: number } };
+	return resourceUsage ? resourceUsage().maxRSS * 1024 : process.memoryUsage().rss;
+}
+
+/** Repeats the `unit` until the text is `size` bytes of UTF-16, without splitting a surrogate pair. */
+function makeText(unit: string, size: number): string {
+	const length = Math.max(1, Math.floor(size / 2));
+	let text = unit.repeat(Math.ceil(length / unit.length)).slice(0, length);
+
+	if (/[\ud800-\udbff]$/.test(text))
+		text = text.slice(0, -1) + " ";
+
+	return text;
+}
+
+const options = parseOptions(process.argv.slice(2));
+const results: object[] = [];
+
+function run(operation: string, corpus: string, family: string, encoding: string, sizeClass: number, inputBytes: number, fn: () => unknown): void {
+	if (options.filter && ![operation, corpus, encoding].some(s => s.includes(options.filter)))
+		return;
+
+	let iterations = 0;
+	const start = process.hrtime();
+	let elapsed: number;
+
+	do {
+		fn();
+		iterations++;
+		const [seconds, nanoseconds] = process.hrtime(start);
+		elapsed = seconds + nanoseconds / 1e9;
+	} while (elapsed * 1000 < options.minTime);
+
+	results.push({
+		operation,
+		corpus,
+		family,
+		encoding,
+		sizeClass,
+		inputBytes,
+		iterations,
+		nsPerCall: elapsed * 1e9 / iterations,
+		mibPerSecond: inputBytes * iterations / elapsed / (1024 * 1024),
+		peakRSS: peakRSS()
+	});
+}
+
+const corpora: [string, string][] = [
+	["ASCII", "The quick brown fox jumps over the lazy dog. "],
+	["Latin", "Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter. "],
+	["Japanese", "日本語の文章には、ひらがなとカタカナと漢字が混ざっています。"],
+	["Chinese", "這是一段繁體中文的文字，用來測試轉換的速度。"],
+	["Korean", "한국어 문장입니다. 변환 속도를 측정합니다. "],
+	["emoji", "👍🎉 ok 😀🚀 "]
+];
+
+const targets: [string, StringEncoding][] = ([
+	["Unicode", "UTF-8"],
+	["Unicode", "UTF-16LE"],
+	["Unicode", "UTF-32LE"],
+	["single-byte", "ISO-8859-1"],
+	["single-byte", "windows-1252"],
+	["single-byte", "macintosh"],
+	["CJK", "Shift_JIS"],
+	["CJK", "EUC-KR"],
+	["CJK", "Big5"],
+	["CJK", "GB18030"]
+] as [string, string][]).map(([family, name]): [string, StringEncoding] => [family, StringEncoding.byIANACharSetName(name)]);
+
+const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+
+for (const [corpus, unit] of corpora) {
+	for (let size = 16; size <= options.maxSize && size <= 256 * 1024 * 1024; size *= 16) {
+		const text = makeText(unit, size);
+		const textBytes = text.length * 2;
+
+		run("encodeSmallest", corpus, "", "", size, textBytes, () => encodeSmallest(text));
+
+		for (const [family, encoding] of targets) {
+			const name = encoding.ianaCharSetName;
+
+			// Only measure encodings that can represent the corpus, since the others would just fail at the first character that they can't.
+			if (!encoding.canEncode(text))
+				continue;
+
+			const encoded = encoding.encode(text);
+
+			run("encode", corpus, family, name, size, textBytes, () => encoding.encode(text));
+			run("decode", corpus, family, name, size, encoded.length, () => encoding.decode(encoded));
+
+			if (!encoding.equals(utf8))
+				run("transcodeToUTF8", corpus, family, name, size, encoded.length, () => transcode(encoded, encoding, utf8));
+		}
+	}
+}
+
+process.stdout.write(JSON.stringify({ benchmark: "api", node: process.version, minTimeMs: options.minTime, results }, null, "\t") + "\n");
@@ -0,0 +1,86 @@
+// Compares the old way of encoding (measure the output with one conversion pass, then convert again into a buffer of that size) with Backend::encodeAll, which converts only once.
+//
+// Build and run with: make -f bench.mk encode
+
+#include "../src/Backend.hh"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Sample {
+		const char *description;
+		std::u16string unit;
+	};
+
+	struct Target {
+		const char *name;
+		EncodingId encoding;
+	};
+
+	/** The encode engine as it was before `encodeAll`: a measuring pass followed by a writing pass. */
+	size_t encodeTwoPass(const Backend &backend, EncodingId encoding, std::u16string_view text) {
+		auto const measured = backend.encode(encoding, text, '?', nullptr, 0);
+		std::vector<uint8_t> buf(measured.written);
+		return backend.encode(encoding, text, '?', buf.data(), buf.size()).written;
+	}
+
+	size_t encodeOnePass(const Backend &backend, EncodingId encoding, std::u16string_view text) {
+		return backend.encodeAll(encoding, text, '?')->size();
+	}
+
+	/** Runs `fn` repeatedly for about a quarter of a second, and returns the throughput in MiB of input per second. */
+	template <typename Fn>
+	double throughput(std::u16string_view text, Fn fn) {
+		using clock = std::chrono::steady_clock;
+		volatile size_t sink = 0;
+		size_t iterations = 0;
+		const auto start = clock::now();
+		clock::duration elapsed;
+
+		do {
+			sink = sink + fn(text);
+			iterations++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(250));
+
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		return double(text.size() * sizeof(char16_t)) * double(iterations) / seconds / (1024 * 1024);
+	}
+}
+
+int main() {
+	const Backend &backend = Backend::Default();
+
+	const Sample samples[] = {
+		{ "ASCII", u"The quick brown fox jumps over the lazy dog. " },
+		{ "Latin-1", u"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter. " },
+		{ "mixed", u"Grüße, 世界! Καλημέρα κόσμε. 👍 " }
+	};
+
+	const Target targets[] = {
+		{ "UTF-8", 0x08000100 },
+		{ "ISO-8859-1", 0x0201 },
+		{ "UTF-16LE", 0x14000100 }
+	};
+
+	std::printf("%-8s %-11s %10s %14s %14s %8s\n", "text", "encoding", "chars", "2-pass MiB/s", "1-pass MiB/s", "speedup");
+
+	for (const auto &sample : samples) {
+		for (size_t size = 1024; size <= 16 * 1024 * 1024; size *= 8) {
+			std::u16string text;
+			while (text.size() < size)
+				text += sample.unit;
+
+			for (const auto &target : targets) {
+				const double before = throughput(text, [&] (auto t) { return encodeTwoPass(backend, target.encoding, t); });
+				const double after = throughput(text, [&] (auto t) { return encodeOnePass(backend, target.encoding, t); });
+
+				std::printf("%-8s %-11s %10zu %14.1f %14.1f %7.2fx\n", sample.description, target.name, text.size(), before, after, after / before);
+			}
+		}
+	}
+
+	return 0;
+}
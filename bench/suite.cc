@@ -0,0 +1,317 @@
+// Measures each stage of the conversion engine (decode, encode, transcode, and encoding with the smallest encoding) for several kinds of text, in each family of encodings, at sizes from 16 bytes up. The results are written as JSON, so that runs of different versions can be compared.
+//
+// Build and run with: make -f bench.mk suite
+//
+// Options:
+//   --max-size=N   Largest input, in bytes of UTF-16. Defaults to 16M. Inputs go up to 256M, but those need several GiB of memory.
+//   --min-time=N   Milliseconds to spend on each measurement. Defaults to 100.
+//   --filter=S     Only run measurements whose operation, corpus, or encoding name contains S.
+//   --tables=PATH  The CJK table file. Defaults to lib/cjk-tables.bin.
+
+#include "../src/Backend.hh"
+#include "../src/MultiByteTables.hh"
+#include "../src/unicode.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+namespace {
+	std::atomic<size_t> allocationCount(0), allocatedBytes(0);
+
+	inline void countAllocation(size_t size) noexcept {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+}
+
+// Count allocations made by the engine, so that each measurement can report how many it takes. With glibc, malloc itself can be replaced, which catches `EncodedBytes` and `operator new` alike. Elsewhere, only `operator new` is counted.
+#ifdef __GLIBC__
+extern "C" {
+	void *__libc_malloc(size_t);
+	void *__libc_calloc(size_t, size_t);
+	void *__libc_realloc(void *, size_t);
+	void __libc_free(void *);
+
+	void *malloc(size_t size) {
+		countAllocation(size);
+		return __libc_malloc(size);
+	}
+
+	void *calloc(size_t count, size_t size) {
+		countAllocation(count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void *realloc(void *p, size_t size) {
+		countAllocation(size);
+		return __libc_realloc(p, size);
+	}
+
+	void free(void *p) {
+		__libc_free(p);
+	}
+}
+#else
+void *operator new(size_t size) {
+	countAllocation(size);
+
+	if (void *const p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+#endif
+
+namespace {
+	struct Corpus {
+		const char *name;
+		std::u16string unit;
+	};
+
+	struct Target {
+		const char *family;
+		const char *name;
+		EncodingId encoding;
+	};
+
+	struct Options {
+		size_t maxSize = 16 * 1024 * 1024;
+		std::chrono::milliseconds minTime { 100 };
+		std::string filter;
+		std::string tables = "lib/cjk-tables.bin";
+	};
+
+	struct Measurement {
+		size_t iterations;
+		double seconds;
+		size_t allocations;
+		size_t allocatedBytes;
+	};
+
+	size_t parseSize(const char *text) {
+		char *end;
+		size_t size = std::strtoull(text, &end, 10);
+
+		switch (*end) {
+			case 'G': case 'g': size *= 1024;
+			// fall through
+			case 'M': case 'm': size *= 1024;
+			// fall through
+			case 'K': case 'k': size *= 1024;
+		}
+
+		return size;
+	}
+
+	Options parseOptions(int argc, char **argv) {
+		Options options;
+
+		for (int i = 1; i < argc; i++) {
+			const char *const arg = argv[i];
+
+			if (std::strncmp(arg, "--max-size=", 11) == 0)
+				options.maxSize = parseSize(arg + 11);
+			else if (std::strncmp(arg, "--min-time=", 11) == 0)
+				options.minTime = std::chrono::milliseconds(std::atol(arg + 11));
+			else if (std::strncmp(arg, "--filter=", 9) == 0)
+				options.filter = arg + 9;
+			else if (std::strncmp(arg, "--tables=", 9) == 0)
+				options.tables = arg + 9;
+			else {
+				std::fprintf(stderr, "Unrecognized option: %s\n", arg);
+				std::exit(2);
+			}
+		}
+
+		return options;
+	}
+
+	/** Peak resident set size of this process so far, in bytes. */
+	size_t peakRSS() {
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return size_t(usage.ru_maxrss);
+#else
+		return size_t(usage.ru_maxrss) * 1024;
+#endif
+	}
+
+	/** Runs `fn` repeatedly for at least `minTime`, and at least once. */
+	template <typename Fn>
+	Measurement measure(std::chrono::milliseconds minTime, Fn fn) {
+		using clock = std::chrono::steady_clock;
+		volatile size_t sink = 0;
+		size_t iterations = 0;
+		const size_t allocationsBefore = allocationCount.load(), bytesBefore = allocatedBytes.load();
+		const auto start = clock::now();
+		clock::duration elapsed;
+
+		do {
+			sink = sink + fn();
+			iterations++;
+			elapsed = clock::now() - start;
+		} while (elapsed < minTime);
+
+		return {
+			iterations,
+			std::chrono::duration<double>(elapsed).count(),
+			allocationCount.load() - allocationsBefore,
+			allocatedBytes.load() - bytesBefore
+		};
+	}
+
+	/** Repeats the `unit` until the text is `size` bytes of UTF-16, without splitting a surrogate pair. */
+	std::u16string makeText(const std::u16string &unit, size_t size) {
+		const size_t length = size / 2 == 0 ? 1 : size / 2;
+		std::u16string text;
+		text.reserve(length + unit.size());
+
+		while (text.size() < length)
+			text += unit;
+
+		text.resize(length);
+		if (text.back() >= 0xd800 && text.back() <= 0xdbff)
+			text.back() = u' ';
+
+		return text;
+	}
+
+	/** The conversion that the `transcode` function does: directly between Unicode encodings, and by way of UTF-16 otherwise. */
+	size_t transcode(const Backend &backend, EncodingId from, EncodingId to, const EncodedBytes &bytes) {
+		if (isUnicodeEncoding(from) && isUnicodeEncoding(to))
+			return transcodeUnicode(from, to, bytes.data(), bytes.size(), 0).bytes.size();
+
+		auto const decoded = backend.decode(from, bytes.data(), bytes.size());
+		return backend.encodeAll(to, *decoded, 0)->size();
+	}
+
+	class Report {
+		const Options &_options;
+		bool _first = true;
+
+		public:
+		Report(const Options &options) : _options(options) {
+			std::printf("{\n\t\"benchmark\": \"native\",\n\t\"minTimeMs\": %lld,\n\t\"results\": [", static_cast<long long>(options.minTime.count()));
+		}
+
+		~Report() {
+			std::printf("\n\t]\n}\n");
+		}
+
+		bool wants(const char *operation, const char *corpus, const char *encoding) const {
+			const auto &filter = _options.filter;
+			return filter.empty() || std::strstr(operation, filter.c_str()) || std::strstr(corpus, filter.c_str()) || std::strstr(encoding, filter.c_str());
+		}
+
+		template <typename Fn>
+		void run(const char *operation, const char *corpus, const char *family, const char *encoding, size_t sizeClass, size_t inputBytes, Fn fn) {
+			if (!wants(operation, corpus, encoding))
+				return;
+
+			const auto m = measure(_options.minTime, fn);
+			const double calls = double(m.iterations);
+
+			std::printf(
+				"%s\n\t\t{ \"operation\": \"%s\", \"corpus\": \"%s\", \"family\": \"%s\", \"encoding\": \"%s\", \"sizeClass\": %zu, \"inputBytes\": %zu, \"iterations\": %zu, \"nsPerCall\": %.1f, \"mibPerSecond\": %.2f, \"allocationsPerCall\": %.2f, \"allocatedBytesPerCall\": %.0f, \"peakRSS\": %zu }",
+				_first ? "" : ",",
+				operation, corpus, family, encoding, sizeClass, inputBytes, m.iterations,
+				m.seconds * 1e9 / calls,
+				double(inputBytes) * calls / m.seconds / (1024 * 1024),
+				double(m.allocations) / calls,
+				double(m.allocatedBytes) / calls,
+				peakRSS()
+			);
+			std::fflush(stdout);
+			_first = false;
+		}
+	};
+}
+
+int main(int argc, char **argv) {
+	const Options options = parseOptions(argc, argv);
+	MultiByteTables::setFilePath(options.tables);
+
+	const Backend &backend = Backend::Default();
+
+	const Corpus corpora[] = {
+		{ "ASCII", u"The quick brown fox jumps over the lazy dog. " },
+		{ "Latin", u"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter. " },
+		{ "Japanese", u"日本語の文章には、ひらがなとカタカナと漢字が混ざっています。" },
+		{ "Chinese", u"這是一段繁體中文的文字，用來測試轉換的速度。" },
+		{ "Korean", u"한국어 문장입니다. 변환 속도를 측정합니다. " },
+		{ "emoji", u"👍🎉 ok 😀🚀 " }
+	};
+
+	const std::pair<const char *, const char *> targetNames[] = {
+		{ "Unicode", "UTF-8" },
+		{ "Unicode", "UTF-16LE" },
+		{ "Unicode", "UTF-32LE" },
+		{ "single-byte", "ISO-8859-1" },
+		{ "single-byte", "windows-1252" },
+		{ "single-byte", "macintosh" },
+		{ "CJK", "Shift_JIS" },
+		{ "CJK", "EUC-KR" },
+		{ "CJK", "Big5" },
+		{ "CJK", "GB18030" }
+	};
+
+	std::vector<Target> targets;
+	for (const auto &name : targetNames) {
+		const EncodingId encoding = backend.encodingForIANACharSetName(name.second);
+
+		if (encoding == kEncodingInvalidId || !backend.isEncodingAvailable(encoding))
+			std::fprintf(stderr, "Skipping %s, which is not available.\n", name.second);
+		else
+			targets.push_back({ name.first, name.second, encoding });
+	}
+
+	Report report(options);
+
+	for (const auto &corpus : corpora) {
+		for (size_t size = 16; size <= options.maxSize && size <= size_t(256) * 1024 * 1024; size *= 16) {
+			const std::u16string text = makeText(corpus.unit, size);
+			const size_t textBytes = text.size() * sizeof(char16_t);
+
+			report.run("encodeSmallest", corpus.name, "", "", size, textBytes, [&] {
+				return backend.encodeAll(backend.smallestEncoding(text).encoding, text, 0)->size();
+			});
+
+			for (const auto &target : targets) {
+				// Only measure encodings that can represent the corpus, since the others would just fail at the first character that they can't.
+				auto encoded = backend.encodeAll(target.encoding, text, 0);
+				if (!encoded)
+					continue;
+
+				report.run("encode", corpus.name, target.family, target.name, size, textBytes, [&] {
+					return backend.encodeAll(target.encoding, text, 0)->size();
+				});
+
+				report.run("decode", corpus.name, target.family, target.name, size, encoded->size(), [&] {
+					return backend.decode(target.encoding, encoded->data(), encoded->size())->size();
+				});
+
+				if (target.encoding != kEncodingUTF8) {
+					report.run("transcodeToUTF8", corpus.name, target.family, target.name, size, encoded->size(), [&] {
+						return transcode(backend, target.encoding, kEncodingUTF8, *encoded);
+					});
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+// Compares converting between Unicode encoding forms by way of UTF-16 (Backend::decode followed by Backend::encodeAll) with transcodeUnicode, which converts directly.
+//
+// Build and run with: make -f bench.mk unicode
+
+#include "../src/Backend.hh"
+#include "../src/unicode.hh"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+	struct Sample {
+		const char *description;
+		std::u16string unit;
+	};
+
+	struct Form {
+		const char *name;
+		EncodingId encoding;
+	};
+
+	size_t transcodeViaUTF16(const Backend &backend, EncodingId from, EncodingId to, const std::string &bytes) {
+		auto const decoded = backend.decode(from, reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size());
+		return backend.encodeAll(to, *decoded, '?')->size();
+	}
+
+	size_t transcodeDirectly(EncodingId from, EncodingId to, const std::string &bytes) {
+		return transcodeUnicode(from, to, reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), '?').bytes.size();
+	}
+
+	/** Runs `fn` repeatedly for about a quarter of a second, and returns the throughput in MiB of input per second. */
+	template <typename Fn>
+	double throughput(const std::string &bytes, Fn fn) {
+		using clock = std::chrono::steady_clock;
+		volatile size_t sink = 0;
+		size_t iterations = 0;
+		const auto start = clock::now();
+		clock::duration elapsed;
+
+		do {
+			sink = sink + fn(bytes);
+			iterations++;
+			elapsed = clock::now() - start;
+		} while (elapsed < std::chrono::milliseconds(250));
+
+		const double seconds = std::chrono::duration<double>(elapsed).count();
+		return double(bytes.size()) * double(iterations) / seconds / (1024 * 1024);
+	}
+}
+
+int main() {
+	const Backend &backend = Backend::Default();
+
+	const Sample samples[] = {
+		{ "ASCII", u"The quick brown fox jumps over the lazy dog. " },
+		{ "Latin-1", u"Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter. " },
+		{ "mixed", u"Grüße, 世界! Καλημέρα κόσμε. 👍 " }
+	};
+
+	const Form forms[] = {
+		{ "UTF-8", kEncodingUTF8 },
+		{ "UTF-16LE", kEncodingUTF16LE },
+		{ "UTF-16BE", kEncodingUTF16BE },
+		{ "UTF-32LE", kEncodingUTF32LE }
+	};
+
+	std::printf("%-8s %-9s %-9s %10s %14s %14s %8s\n", "text", "from", "to", "bytes", "UTF-16 MiB/s", "direct MiB/s", "speedup");
+
+	for (const auto &sample : samples) {
+		for (size_t size = 1024; size <= 4 * 1024 * 1024; size *= 64) {
+			std::u16string text;
+			while (text.size() < size)
+				text += sample.unit;
+
+			for (const auto &from : forms) {
+				auto const encoded = backend.encodeAll(from.encoding, text, '?');
+				const std::string bytes(reinterpret_cast<const char *>(encoded->data()), encoded->size());
+
+				for (const auto &to : forms) {
+					if (from.encoding == to.encoding)
+						continue;
+
+					const double before = throughput(bytes, [&] (auto &b) { return transcodeViaUTF16(backend, from.encoding, to.encoding, b); });
+					const double after = throughput(bytes, [&] (auto &b) { return transcodeDirectly(from.encoding, to.encoding, b); });
+
+					std::printf("%-8s %-9s %-9s %10zu %14.1f %14.1f %7.2fx\n", sample.description, from.name, to.name, bytes.size(), before, after, after / before);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
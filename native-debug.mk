@@ -1,10 +1,27 @@
+UNAME := $(shell uname -s)
+OBJS := build/iccf.o build/string-utils.o build/StringEncoding.o build/transcode.o build/Backend.o build/PortableBackend.o build/Codec.o build/ascii.o build/ConversionWorker.o build/ChunkedCoders.o build/incremental.o build/unicode.o build/MultiByteTables.o build/representable.o build/detect.o build/stats.o build/pool.o build/parallel.o build/file.o
+
+ifeq ($(UNAME),Darwin)
 CXXFLAGS := -mmacosx-version-min=10.10 -arch x86_64 -arch arm64 -Inode_modules/node-addon-api -I/usr/local/include/node -fno-rtti -fvisibility=hidden -Wall -std=c++17 -DBUILDING_NODE_EXTENSION -g $(CXXFLAGS)
-LDFLAGS := $(CXXFLAGS) -bundle -undefined dynamic_lookup -framework CoreFoundation $(LDFLAGS)
+LDFLAGS := $(CXXFLAGS) -bundle -undefined dynamic_lookup -framework CoreFoundation -liconv $(LDFLAGS)
+OBJS += build/CFBackend.o build/IconvCoders.o
+else
+NODE_INCLUDE ?= $(dir $(shell which node))../include/node
+CXXFLAGS := -fPIC -Inode_modules/node-addon-api -I$(NODE_INCLUDE) -fno-rtti -fvisibility=hidden -Wall -std=c++17 -DBUILDING_NODE_EXTENSION -g $(CXXFLAGS)
+LDFLAGS := $(CXXFLAGS) -shared -ldl $(LDFLAGS)
+endif
+
+.PHONY: all
+all: lib/native.node lib/cjk-tables.bin
 
-lib/native.node: build/iccf.o build/string-utils.o build/StringEncoding.o build/transcode.o
+lib/native.node: $(OBJS)
 	@mkdir -p lib
 	$(CXX) $(LDFLAGS) -o $@ $^
 
 build/%.o: src/%.cc
 	@mkdir -p build
 	$(CXX) $(CXXFLAGS) -c -o $@ $^
+
+lib/cjk-tables.bin: tools/generate-cjk-tables.py tools/cjk-tables.sha256
+	@mkdir -p lib
+	python3 $< $@
@@ -6,8 +6,17 @@ type StringEncoding = import("./index").StringEncoding;
 
 /** Signals that the given text cannot be fully encoded in the chosen {@link StringEncoding}. */
 export class NotRepresentableError extends Error {
-	private constructor(text: unknown, encoding: StringEncoding) {
-		super(`Not fully representable in ${encoding}:\n${inspect(typeof text === "string" ? cliTruncate(text, 65) : text)}`);
+	/**
+	 * Where the first character that cannot be represented is, if known.
+	 *
+	 * @remarks
+	 * If the text was a string, this is an index in UTF-16 code units, like `String.prototype.indexOf` returns. If the text was a buffer (as with {@link transcode}), this is the offset of the character's first byte.
+	 */
+	readonly offset?: number;
+
+	private constructor(text: unknown, encoding: StringEncoding, offset?: number) {
+		super(`Not fully representable in ${encoding}${offset === undefined ? "" : ` (at offset ${offset})`}:\n${inspect(typeof text === "string" ? cliTruncate(text, 65) : text)}`);
+		this.offset = offset;
 	}
 }
 NotRepresentableError.prototype.name = NotRepresentableError.name;
@@ -19,8 +28,12 @@ NotRepresentableError.prototype.name = NotRepresentableError.name;
  * Not all {@link StringEncoding}s can throw this error. Most single-byte encodings and some multi-byte encodings have a valid mapping for every possible sequence of bytes. However, some encodings (such as ASCII and UTF-8) don't consider all byte sequences valid; such encodings will throw this error if the input contains any invalid byte sequences.
  */
 export class InvalidEncodedTextError extends Error {
-	private constructor(text: unknown, encoding: StringEncoding) {
-		super(`Input is not valid ${encoding}:\n${inspect(text)}`);
+	/** The offset of the first byte of the first invalid (or cut-off) character in the text, if known. */
+	readonly offset?: number;
+
+	private constructor(text: unknown, encoding: StringEncoding, offset?: number) {
+		super(`Input is not valid ${encoding}${offset === undefined ? "" : ` (at offset ${offset})`}:\n${inspect(text)}`);
+		this.offset = offset;
 	}
 }
 InvalidEncodedTextError.prototype.name = InvalidEncodedTextError.name;
@@ -42,3 +55,19 @@ export class UnrecognizedEncodingError extends Error {
 	}
 }
 UnrecognizedEncodingError.prototype.name = UnrecognizedEncodingError.name;
+
+/**
+ * Signals that an asynchronous operation was cancelled with an `AbortSignal`.
+ *
+ * @remarks
+ * Like the errors thrown by Node.js's own cancellable operations, this error's `name` is `"AbortError"` and its `code` is `"ABORT_ERR"`.
+ */
+export class AbortError extends Error {
+	/** Always `"ABORT_ERR"`. */
+	readonly code: "ABORT_ERR" = "ABORT_ERR";
+
+	private constructor() {
+		super("The operation was aborted");
+	}
+}
+AbortError.prototype.name = AbortError.name;
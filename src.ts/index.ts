@@ -1,7 +1,8 @@
-import { BufferLike, DecodeOptions, EncodeOptions, StringEncoding } from "./native";
+import { AsyncOptions, BufferLike, DecodeOptions, EncodeOptions, StringEncoding } from "./native";
 
 export * from "./errors";
 export * from "./native";
+export * from "./streams";
 
 /**
  * Convenience alias for {@link StringEncoding.decode}.
@@ -33,3 +34,31 @@ export function encode(text: string, encoding: string | StringEncoding, options?
 		encoding = StringEncoding.byIANACharSetName(encoding);
 	return encoding.encode(text, options);
 }
+
+/**
+ * Convenience alias for {@link StringEncoding.decodeAsync}.
+ *
+ * @param text - The encoded text.
+ * @param encoding - The encoding of the `text`. May be an IANA character set name or a {@link StringEncoding}.
+ * @param options - Options for decoding and cancellation.
+ * @returns A promise for the decoded text, as a string.
+ */
+export async function decodeAsync(text: BufferLike, encoding: string | StringEncoding, options?: DecodeOptions & AsyncOptions): Promise<string> {
+	if (typeof encoding === "string")
+		encoding = StringEncoding.byIANACharSetName(encoding);
+	return encoding.decodeAsync(text, options);
+}
+
+/**
+ * Convenience alias for {@link StringEncoding.encodeAsync}.
+ *
+ * @param text - The text to encode.
+ * @param encoding - The encoding to use. May be an IANA character set name or a {@link StringEncoding}.
+ * @param options - Options for encoding and cancellation.
+ * @returns A promise for the encoded text, in a `Buffer`.
+ */
+export async function encodeAsync(text: string, encoding: string | StringEncoding, options?: EncodeOptions & AsyncOptions): Promise<Buffer> {
+	if (typeof encoding === "string")
+		encoding = StringEncoding.byIANACharSetName(encoding);
+	return encoding.encodeAsync(text, options);
+}
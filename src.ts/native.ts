@@ -1,3 +1,4 @@
+import * as path from "path";
 import { inspect } from "util";
 import * as errors from "./errors";
 
@@ -5,6 +6,7 @@ module.exports = require("./native.node")({
 	newFormattedTypeError(expected: unknown, actual: unknown) {
 		return new TypeError(`Expected ${expected}; got ${inspect(actual)}`);
 	},
+	multiByteTablePath: path.join(__dirname, "cjk-tables.bin"),
 	...errors
 });
 
@@ -90,6 +92,51 @@ export declare class StringEncoding {
 	 */
 	decode(text: BufferLike, options?: DecodeOptions): string;
 
+	/**
+	 * Decodes the given text on a background thread.
+	 *
+	 * @remarks
+	 * This works like {@link StringEncoding.decode}, but doesn't block the event loop while decoding. The `text` is copied before this method returns, so it's safe to modify it afterward.
+	 *
+	 * The returned promise rejects with {@link InvalidEncodedTextError} if the `text` is not valid in this encoding, or with {@link AbortError} if `options.signal` is aborted first.
+	 *
+	 * @param text - The encoded text.
+	 * @param options - Options for decoding.
+	 * @returns A promise for the decoded text, as a string.
+	 */
+	decodeAsync(text: BufferLike, options?: DecodeOptions & AsyncOptions): Promise<string>;
+
+	/**
+	 * Decodes the given text, reporting invalid text without throwing an error.
+	 *
+	 * @remarks
+	 * This works like {@link StringEncoding.decode}, but where that would throw {@link InvalidEncodedTextError}, this returns a {@link ConversionFailure} instead. That is much cheaper than constructing, throwing, and catching an error, which makes a difference when invalid input is routine.
+	 *
+	 * @param text - The encoded text.
+	 * @param options - Options for decoding.
+	 * @returns The decoded text, as a string, or a {@link ConversionFailure} saying where the text stops being valid.
+	 */
+	tryDecode(text: BufferLike, options?: DecodeOptions): string | ConversionFailure;
+
+	/**
+	 * Checks whether the given text is valid in this encoding, without decoding it.
+	 *
+	 * @remarks
+	 * This is much faster than calling {@link StringEncoding.decode} and catching the error, because it only scans the bytes, without building a string. Text that ends partway through a character is not valid.
+	 *
+	 * @param text - The encoded text.
+	 * @returns Whether {@link StringEncoding.decode} would succeed.
+	 */
+	isValid(text: BufferLike): boolean;
+
+	/**
+	 * Finds where the given text stops being valid in this encoding, without decoding it.
+	 *
+	 * @param text - The encoded text.
+	 * @returns The offset of the first byte of the first invalid or incomplete character, or the length of the `text` if it's all valid.
+	 */
+	validLength(text: BufferLike): number;
+
 	/**
 	 * Returns whether the given {@link StringEncoding} represents the same encoding as this one.
 	 *
@@ -110,6 +157,48 @@ export declare class StringEncoding {
 	 */
 	encode(text: string, options?: EncodeOptions): Buffer;
 
+	/**
+	 * Encodes the given text on a background thread.
+	 *
+	 * @remarks
+	 * This works like {@link StringEncoding.encode}, but doesn't block the event loop while encoding.
+	 *
+	 * The returned promise rejects with {@link NotRepresentableError} if the `text` cannot be fully represented in this encoding and `options` does not contain a `lossByte`, or with {@link AbortError} if `options.signal` is aborted first.
+	 *
+	 * @param text - The text to encode.
+	 * @param options - Options for encoding.
+	 * @returns A promise for the encoded text, in a `Buffer`.
+	 */
+	encodeAsync(text: string, options?: EncodeOptions & AsyncOptions): Promise<Buffer>;
+
+	/**
+	 * Encodes the given text, reporting unrepresentable characters without throwing an error.
+	 *
+	 * @remarks
+	 * This works like {@link StringEncoding.encode}, but where that would throw {@link NotRepresentableError}, this returns a {@link ConversionFailure} instead. See {@link StringEncoding.tryDecode}.
+	 *
+	 * @param text - The text to encode.
+	 * @param options - Options for encoding.
+	 * @returns The encoded text, in a `Buffer`, or a {@link ConversionFailure} saying where the first unrepresentable character is.
+	 */
+	tryEncode(text: string, options?: EncodeOptions): Buffer | ConversionFailure;
+
+	/**
+	 * Checks whether the given text can be fully represented in this encoding, without encoding it.
+	 *
+	 * @param text - The text to check.
+	 * @returns Whether {@link StringEncoding.encode} would succeed without a `lossByte`.
+	 */
+	canEncode(text: string): boolean;
+
+	/**
+	 * Finds the first character of the given text that can't be represented in this encoding, without encoding it.
+	 *
+	 * @param text - The text to check.
+	 * @returns The index (in UTF-16 code units, like `String.prototype.indexOf`) of the first unrepresentable character, or the length of the `text` if there isn't one.
+	 */
+	encodableLength(text: string): number;
+
 	/**
 	 * Looks up a {@link StringEncoding} by its {@link https://developer.apple.com/documentation/corefoundation/cfstringencoding?language=objc | numeric identifier}.
 	 *
@@ -156,6 +245,16 @@ export declare class StringEncoding {
 	 */
 	static byNSStringEncoding(nsStringEncoding: number): StringEncoding;
 
+	/**
+	 * Every {@link StringEncoding} that is supported.
+	 *
+	 * @remarks
+	 * On macOS, this uses the Core Foundation function {@link https://developer.apple.com/documentation/corefoundation/1542384-cfstringgetlistofavailableencodi?language=objc | CFStringGetListOfAvailableEncodings}, and the order is the one it gives. Elsewhere, this library's own encodings are listed, with single-byte encodings first.
+	 *
+	 * @returns A new array each time. The encodings in it are the same objects that the other lookup methods return.
+	 */
+	static all(): StringEncoding[];
+
 	/**
 	 * The default {@link StringEncoding} used by the operating system when it creates strings.
 	 *
@@ -165,6 +264,92 @@ export declare class StringEncoding {
 	static readonly system: StringEncoding;
 }
 
+/**
+ * Decodes text that arrives in pieces, such as from a stream.
+ *
+ * @remarks
+ * Bytes at the end of a piece that don't make up a whole character are held until the next piece arrives. A byte order mark is recognized only at the very beginning of the text.
+ *
+ * After {@link Decoder.end} is called, or after any method throws, the decoder cannot be used any more.
+ */
+export declare class Decoder {
+	/**
+	 * Creates a new {@link Decoder}.
+	 *
+	 * @param encoding - The encoding of the text, as a {@link StringEncoding} or an IANA character set name.
+	 * @param options - Options for decoding.
+	 */
+	constructor(encoding: StringEncoding | string, options?: DecodeOptions);
+
+	/** The encoding of the text. */
+	readonly encoding: StringEncoding;
+
+	/**
+	 * Decodes the next piece of text.
+	 *
+	 * @remarks
+	 * Throws {@link InvalidEncodedTextError} if the `chunk` is not valid in this encoding.
+	 *
+	 * @param chunk - The next piece of encoded text.
+	 * @returns As much of the text as could be decoded so far.
+	 */
+	write(chunk: BufferLike): string;
+
+	/**
+	 * Decodes the last piece of text.
+	 *
+	 * @remarks
+	 * Throws {@link InvalidEncodedTextError} if the `chunk` is not valid in this encoding, or if the text ends partway through a character.
+	 *
+	 * @param chunk - The last piece of encoded text, if there is one.
+	 * @returns The rest of the decoded text.
+	 */
+	end(chunk?: BufferLike): string;
+}
+
+/**
+ * Encodes text that arrives in pieces, such as from a stream.
+ *
+ * @remarks
+ * A surrogate pair may be split between two pieces. Any byte order mark is written only at the very beginning, and any shift state (as in ISO-2022-JP) is carried over from one piece to the next, and reset at the end.
+ *
+ * After {@link Encoder.end} is called, or after any method throws, the encoder cannot be used any more.
+ */
+export declare class Encoder {
+	/**
+	 * Creates a new {@link Encoder}.
+	 *
+	 * @param encoding - The encoding to use, as a {@link StringEncoding} or an IANA character set name.
+	 * @param options - Options for encoding.
+	 */
+	constructor(encoding: StringEncoding | string, options?: EncodeOptions);
+
+	/** The encoding being used. */
+	readonly encoding: StringEncoding;
+
+	/**
+	 * Encodes the next piece of text.
+	 *
+	 * @remarks
+	 * Throws {@link NotRepresentableError} if the `chunk` cannot be fully represented in this encoding, and the options given to the constructor do not contain a `lossByte`.
+	 *
+	 * @param chunk - The next piece of text.
+	 * @returns As much of the text as could be encoded so far.
+	 */
+	write(chunk: string): Buffer;
+
+	/**
+	 * Encodes the last piece of text.
+	 *
+	 * @remarks
+	 * Throws {@link NotRepresentableError} under the same conditions as {@link Encoder.write}.
+	 *
+	 * @param chunk - The last piece of text, if there is one.
+	 * @returns The rest of the encoded text.
+	 */
+	end(chunk?: string): Buffer;
+}
+
 /** An object containing some encoded text in a `Buffer`, along with the encoding used. */
 export interface TextAndEncoding {
 	/** The encoding of the `text`. */
@@ -173,8 +358,72 @@ export interface TextAndEncoding {
 	text: Buffer;
 }
 
+/** An encoding that can represent some text, and how long the text is in it. See {@link representableEncodings}. */
+export interface RepresentableEncoding {
+	/** The encoding. */
+	encoding: StringEncoding;
+	/** How many bytes the text takes up in this encoding, including any byte order mark. */
+	length: number;
+}
+
 /**
- * Encodes the given text, using the smallest representation supported by Core Foundation.
+ * Finds the encodings that can represent all of the given text, and how many bytes it takes up in each.
+ *
+ * @remarks
+ * The candidates are the encodings that this package has its own conversion tables for (see the README), which are the ones the portable backend supports. On macOS, Core Foundation supports many more encodings than these, but they are rarely the smallest.
+ *
+ * This examines the text once for all of the single-byte and Unicode encodings together, so it is much faster than trying to encode the text in each one. Use this to choose an encoding by your own rules. Except on macOS, `encodeSmallest` simply takes the first.
+ *
+ * @param text - The text to examine.
+ * @returns The encodings, from smallest to largest. Encodings of the same size are in a fixed order, with single-byte encodings first.
+ */
+export declare function representableEncodings(text: string): RepresentableEncoding[];
+
+/** An encoding that some bytes might be in, and how likely that is. See {@link detectEncoding}. */
+export interface DetectedEncoding {
+	/** The encoding. */
+	encoding: StringEncoding;
+	/** From 0 (certainly not) to 1 (certainly). This is a heuristic score, not a true probability, but it is comparable between encodings and between calls. */
+	confidence: number;
+}
+
+/** Options for {@link detectEncoding}. */
+export interface DetectEncodingOptions {
+	/**
+	 * The encodings to consider, as {@link StringEncoding}s or IANA character set names.
+	 *
+	 * By default, these are the encodings that this package has its own conversion tables for (see the README).
+	 */
+	candidates?: (StringEncoding | string)[];
+
+	/**
+	 * How many bytes, from the beginning of the input, to examine. Defaults to 65536. Use `Infinity` to examine all of it.
+	 *
+	 * A character that is cut off at the end of the sample doesn't count against an encoding.
+	 */
+	sampleBytes?: number;
+}
+
+/**
+ * Guesses the encoding of some bytes of unknown origin.
+ *
+ * @remarks
+ * A byte order mark settles the question. Otherwise, each candidate encoding that the input is valid in is scored by how plausible the decoded text is: common letters of some script score well, while control characters, box drawing, and words with capital letters in the middle (the hallmark of text decoded in the wrong encoding) score badly. Valid UTF-8 with many non-ASCII characters is almost certainly UTF-8.
+ *
+ * The single-byte encodings are all scored together from one pass over the input, so this is much faster than decoding the input in each of them. Still, it only looks at a prefix of the input, as set by the `sampleBytes` option.
+ *
+ * Short inputs give little to go on, and some encodings differ only in characters that the input doesn't use (like ISO Latin 1 and Windows Latin 1, for most text), so always be prepared for the best guess to be wrong.
+ *
+ * @param text - The encoded text.
+ * @returns The candidates that the input is valid in, most likely first. Empty if there are none.
+ */
+export declare function detectEncoding(text: BufferLike, options?: DetectEncodingOptions): DetectedEncoding[];
+
+/**
+ * Encodes the given text, using the smallest representation among its {@link representableEncodings}.
+ *
+ * @remarks
+ * On macOS, the encoding is chosen by Core Foundation's `CFStringGetSmallestEncoding` instead, which only considers the system encoding and UTF-16.
  *
  * @param text - The text to encode.
  * @param options - Options for encoding.
@@ -183,7 +432,10 @@ export interface TextAndEncoding {
 export declare function encodeSmallest(text: string, options?: SelectAndEncodeOptions & { isEncodingOk?: never }): TextAndEncoding;
 
 /**
- * Encodes the given text, using the smallest representation supported by Core Foundation.
+ * Encodes the given text, using the smallest representation among its {@link representableEncodings}.
+ *
+ * @remarks
+ * On macOS, the encoding is chosen by Core Foundation's `CFStringGetSmallestEncoding` instead, which only considers the system encoding and UTF-16.
  *
  * @param text - The text to encode.
  * @param options - Options for encoding, possibly including an {@link SelectAndEncodeOptions.isEncodingOk | options.isEncodingOk} method.
@@ -195,7 +447,7 @@ export declare function encodeSmallest(text: string, options: SelectAndEncodeOpt
  * Converts encoded text from one encoding to another.
  *
  * @remarks
- * This is faster than decoding to a JavaScript string and then encoding the string.
+ * This is faster than decoding to a JavaScript string and then encoding the string. Between UTF-8, UTF-16, and UTF-32, text is converted directly, without an intermediate copy in any other form.
  *
  * Throws {@link InvalidEncodedTextError} if the `text` is not valid in `fromEncoding`.
  *
@@ -210,9 +462,177 @@ export declare function encodeSmallest(text: string, options: SelectAndEncodeOpt
 export declare function transcode(text: BufferLike, fromEncoding: StringEncoding | string, toEncoding: StringEncoding | string, options?: DecodeOptions & EncodeOptions): Buffer;
 
 /**
- * Converts encoded text from its current encoding to the smallest representation supported by Core Foundation.
+ * Converts encoded text from one encoding to another, on a background thread.
+ *
+ * @remarks
+ * This works like {@link transcode}, but doesn't block the event loop while converting. The `text` is copied before this function returns, so it's safe to modify it afterward.
+ *
+ * The returned promise rejects with {@link InvalidEncodedTextError} or {@link NotRepresentableError} under the same conditions that {@link transcode} would throw them, or with {@link AbortError} if `options.signal` is aborted first.
+ *
+ * @param text - The encoded text to transcode.
+ * @param fromEncoding - The encoding of the `text`, as a {@link StringEncoding} or an IANA character set name.
+ * @param toEncoding - The desired encoding, as a {@link StringEncoding} or an IANA character set name.
+ * @param options - Options for decoding, encoding, and cancellation.
+ * @returns A promise for the `text`, encoded in `toEncoding` instead of `fromEncoding`.
+ */
+export declare function transcodeAsync(text: BufferLike, fromEncoding: StringEncoding | string, toEncoding: StringEncoding | string, options?: DecodeOptions & EncodeOptions & AsyncOptions): Promise<Buffer>;
+
+/**
+ * Converts the contents of a file from one encoding to another, writing the result to another file, on a background thread.
+ *
+ * @remarks
+ * Neither file is read into memory all at once. The input file is mapped into memory and converted a piece at a time, and the output is written in large blocks as it's produced, so memory use stays about the same however large the files are.
+ *
+ * The returned promise rejects with {@link InvalidEncodedTextError} or {@link NotRepresentableError} if the file can't be converted, with `text` set to `inPath`. Where the input can be cut into pieces at character boundaries (in the same encodings that {@link setParallelTranscodeOptions} describes), the error's `offset` is where the first problem in the file is; otherwise, it's not known. Failures to read or write the files reject with an error like those of the `fs` module, with `code`, `syscall`, and `path` properties. The promise rejects with {@link AbortError} if `options.signal` is aborted first.
+ *
+ * The output file is created if it doesn't exist, and replaced if it does. If the conversion fails or is aborted, the output file is removed. It must not be the same file as the input.
+ *
+ * The `fatal: false` option is not supported, and throws a `RangeError`.
+ *
+ * @param inPath - The path of the file to convert.
+ * @param outPath - The path of the file to write the converted text to.
+ * @param fromEncoding - The encoding of the input file, as a {@link StringEncoding} or an IANA character set name.
+ * @param toEncoding - The desired encoding, as a {@link StringEncoding} or an IANA character set name.
+ * @param options - Options for encoding and cancellation.
+ * @returns A promise for the number of bytes written.
+ */
+export declare function transcodeFile(inPath: string, outPath: string, fromEncoding: StringEncoding | string, toEncoding: StringEncoding | string, options?: DecodeOptions & EncodeOptions & AsyncOptions): Promise<number>;
+
+/**
+ * What {@link StringEncoding.tryDecode} and {@link StringEncoding.tryEncode} return when the text can't be converted.
+ *
+ * @remarks
+ * This is a plain object. Unlike {@link InvalidEncodedTextError} and {@link NotRepresentableError}, it has no stack trace or message, and doesn't keep a reference to the text.
+ */
+export interface ConversionFailure {
+	/** `"invalid"` if the encoded text is not valid in the encoding, or `"unrepresentable"` if the text has a character that the encoding can't represent. */
+	reason: "invalid" | "unrepresentable";
+
+	/** Where the problem is: the byte offset of the first invalid (or cut-off) character, or the index in UTF-16 code units of the first unrepresentable one. These are the same as the `offset` of the corresponding error. */
+	offset: number;
+}
+
+/** Result of {@link encodeInto} and {@link transcodeInto}. */
+export interface ReadAndWritten {
+	/** How much of the input was converted: UTF-16 code units for {@link encodeInto}, or bytes for {@link transcodeInto}. If this is less than the length of the input, then the target was full. */
+	read: number;
+
+	/** How many bytes were written to the target. */
+	written: number;
+}
+
+/**
+ * Encodes the given text into an existing buffer, like `TextEncoder.encodeInto`.
+ *
+ * @remarks
+ * If the `target` fills up, encoding stops after the last character that fits completely. To encode the rest, call this again with the rest of the `text` (from index `read`).
+ *
+ * Encodings that begin with a byte order mark (UTF-16 and UTF-32 without an explicit byte order) write one on every call. When encoding in several calls, use an explicit byte order instead, like `UTF-16LE`. Likewise, stateful encodings like ISO-2022-JP should not be encoded in several calls this way; use {@link Encoder} for those.
+ *
+ * Throws {@link NotRepresentableError} if the `text` cannot be fully represented in the encoding, and `options` does not contain a `lossByte`.
+ *
+ * @param text - The text to encode.
+ * @param encoding - The encoding to use, as a {@link StringEncoding} or an IANA character set name.
+ * @param target - Where to write the encoded text.
+ * @param offset - Index in `target` to start writing at. Defaults to 0.
+ * @param options - Options for encoding.
+ */
+export declare function encodeInto(text: string, encoding: StringEncoding | string, target: BufferLike, offset?: number, options?: EncodeOptions): ReadAndWritten;
+
+/**
+ * Converts encoded text from one encoding to another, writing the result into an existing buffer.
+ *
+ * @remarks
+ * This works like {@link encodeInto}, with the same caveats. `read` is the number of bytes of `text` that were converted, and always ends on a character boundary, so the rest of `text` can be passed to the next call. In stateful encodings like ISO-2022-JP, though, the next call starts over in the initial shift state.
+ *
+ * Throws {@link InvalidEncodedTextError} if the `text` is not valid in `fromEncoding`.
+ *
+ * Throws {@link NotRepresentableError} if the `text` cannot be fully represented in `toEncoding`, and `options` does not contain a `lossByte`.
+ *
+ * @param text - The encoded text to transcode.
+ * @param fromEncoding - The encoding of the `text`, as a {@link StringEncoding} or an IANA character set name.
+ * @param toEncoding - The desired encoding, as a {@link StringEncoding} or an IANA character set name.
+ * @param target - Where to write the transcoded text.
+ * @param offset - Index in `target` to start writing at. Defaults to 0.
+ * @param options - Options for both decoding and encoding.
+ */
+export declare function transcodeInto(text: BufferLike, fromEncoding: StringEncoding | string, toEncoding: StringEncoding | string, target: BufferLike, offset?: number, options?: DecodeOptions & EncodeOptions): ReadAndWritten;
+
+/**
+ * Many pieces of encoded text, for the batch functions {@link decodeMany} and {@link transcodeMany}.
+ *
+ * @remarks
+ * This is either an array of buffers, or one buffer containing all of the pieces back to back. In the latter case, `offsets` holds the index in `buffer` where each piece begins, followed by the index where the last one ends, so there is one more offset than there are pieces.
+ */
+export type BatchInput = BufferLike[] | {
+	buffer: BufferLike;
+	offsets: Uint32Array | number[];
+};
+
+/** Result of {@link decodeMany}. */
+export interface DecodeManyResult {
+	/** The decoded texts, in the same order as the input. Texts that could not be decoded are `null`. */
+	strings: Array<string | null>;
+
+	/** Indices of the texts that could not be decoded, in ascending order. */
+	errors: number[];
+}
+
+/** Result of {@link encodeMany} and {@link transcodeMany}. */
+export interface EncodeManyResult {
+	/** All of the encoded texts, back to back. */
+	buffer: Buffer;
+
+	/** The index in `buffer` where each text begins, followed by the index where the last one ends. Text number `i` is `buffer.subarray(offsets[i], offsets[i + 1])`. */
+	offsets: Uint32Array;
+
+	/** Indices of the texts that could not be converted, in ascending order. These texts are empty in the `buffer`. */
+	errors: number[];
+}
+
+/**
+ * Decodes many pieces of text at once.
  *
  * @remarks
+ * This is much faster than calling {@link StringEncoding.decode} for each piece when the pieces are small, because it crosses into native code only once. Pieces that are not valid in the given encoding don't cause an exception. Instead, they are listed in the result's `errors`.
+ *
+ * @param texts - The encoded texts.
+ * @param encoding - The encoding of the texts, as a {@link StringEncoding} or an IANA character set name.
+ * @param options - Options for decoding.
+ */
+export declare function decodeMany(texts: BatchInput, encoding: StringEncoding | string, options?: DecodeOptions): DecodeManyResult;
+
+/**
+ * Encodes many strings at once, into a single buffer.
+ *
+ * @remarks
+ * Like {@link decodeMany}, this crosses into native code only once. Strings that cannot be fully represented in the given encoding (and `options` does not contain a `lossByte`) don't cause an exception. Instead, they are listed in the result's `errors`.
+ *
+ * @param texts - The texts to encode.
+ * @param encoding - The encoding to use, as a {@link StringEncoding} or an IANA character set name.
+ * @param options - Options for encoding.
+ */
+export declare function encodeMany(texts: string[], encoding: StringEncoding | string, options?: EncodeOptions): EncodeManyResult;
+
+/**
+ * Converts many pieces of encoded text from one encoding to another at once, into a single buffer.
+ *
+ * @remarks
+ * Like {@link decodeMany}, this crosses into native code only once. Pieces that are not valid in `fromEncoding`, or cannot be fully represented in `toEncoding`, don't cause an exception. Instead, they are listed in the result's `errors`.
+ *
+ * @param texts - The encoded texts to transcode.
+ * @param fromEncoding - The encoding of the texts, as a {@link StringEncoding} or an IANA character set name.
+ * @param toEncoding - The desired encoding, as a {@link StringEncoding} or an IANA character set name.
+ * @param options - Options for both decoding and encoding.
+ */
+export declare function transcodeMany(texts: BatchInput, fromEncoding: StringEncoding | string, toEncoding: StringEncoding | string, options?: DecodeOptions & EncodeOptions): EncodeManyResult;
+
+/**
+ * Converts encoded text from its current encoding to the smallest representation among its {@link representableEncodings}.
+ *
+ * @remarks
+ * On macOS, the encoding is chosen by Core Foundation's `CFStringGetSmallestEncoding` instead, which only considers the system encoding and UTF-16.
+ *
  * Throws {@link InvalidEncodedTextError} if the `text` is not valid in `fromEncoding`.
  *
  * @param text - The text to encode.
@@ -223,9 +643,11 @@ export declare function transcode(text: BufferLike, fromEncoding: StringEncoding
 export declare function transcodeSmallest(text: BufferLike, fromEncoding: StringEncoding | string, options?: DecodeOptions & SelectAndEncodeOptions & { isEncodingOk?: never }): TextAndEncoding;
 
 /**
- * Converts encoded text from its current encoding to the smallest representation supported by Core Foundation.
+ * Converts encoded text from its current encoding to the smallest representation among its {@link representableEncodings}.
  *
  * @remarks
+ * On macOS, the encoding is chosen by Core Foundation's `CFStringGetSmallestEncoding` instead, which only considers the system encoding and UTF-16.
+ *
  * Throws {@link InvalidEncodedTextError} if the `text` is not valid in `fromEncoding`.
  *
  * @param text - The text to encode.
@@ -235,6 +657,154 @@ export declare function transcodeSmallest(text: BufferLike, fromEncoding: String
  */
 export declare function transcodeSmallest(text: BufferLike, fromEncoding: StringEncoding | string, options: DecodeOptions & SelectAndEncodeOptions): TextAndEncoding | null;
 
+/**
+ * Sets how long decoded text must be before it's kept outside of the JavaScript heap.
+ *
+ * @remarks
+ * In versions of Node.js that support external strings, a decoded string that is at least this many UTF-16 code units long uses the decoder's output where it is, rather than copying it into the JavaScript heap. This reduces peak memory use when decoding large texts. Older versions of Node.js always copy.
+ *
+ * The default is 262144 (256Ki) code units. Use `Infinity` to never make external strings.
+ *
+ * @param length - The new threshold, in UTF-16 code units.
+ */
+export declare function setExternalStringThreshold(length: number): void;
+
+/**
+ * Turns collection of {@link Stats | statistics} on or off.
+ *
+ * @remarks
+ * Statistics are off by default. While they're off, collecting them costs next to nothing. Turning them off keeps the counts collected so far; use {@link resetStats} to clear them.
+ */
+export declare function setStatsEnabled(enabled: boolean): void;
+
+/** Gets the {@link Stats | statistics} collected so far, from all threads. */
+export declare function getStats(): Stats;
+
+/** Sets all {@link Stats | statistics} back to zero, along with the counts in {@link PoolStats}. */
+export declare function resetStats(): void;
+
+/**
+ * Changes how much memory is kept for reuse by the pool that conversions allocate their temporary buffers from.
+ *
+ * @remarks
+ * Temporary buffers of up to 64 KiB, such as decoded text on its way into a JavaScript string, come from a pool. When one is freed, the thread that freed it keeps it for its next conversion, instead of returning it to the system allocator. This saves time and fragmentation when many small conversions are done. These limits say how much each thread may keep. Limits that are left out stay as they are.
+ *
+ * Lowering the limits takes effect on each thread the next time it frees a buffer. Set `threadBytes` to 0 to turn pooling off.
+ */
+export declare function setPoolLimits(limits: Partial<PoolLimits>): void;
+
+/** Gets statistics about the pool that conversions allocate their temporary buffers from, from all threads. Unlike {@link getStats}, these are always collected. */
+export declare function getPoolStats(): PoolStats;
+
+/** Limits on how much memory each thread keeps in the pool, for {@link setPoolLimits}. */
+export interface PoolLimits {
+	/** Most bytes of free buffers that each thread keeps. The default is 1048576 (1 MiB). */
+	threadBytes: number;
+
+	/** Most free buffers of each size that each thread keeps. The default is 64. */
+	classBlocks: number;
+}
+
+/** Statistics about the memory pool, from {@link getPoolStats}. */
+export interface PoolStats {
+	/** How many buffers were allocated. */
+	allocations: number;
+
+	/** How many of the allocations reused a buffer kept in the pool, rather than asking the system allocator. */
+	reused: number;
+
+	/** How many of the allocations were too big to pool, at over 64 KiB. */
+	oversize: number;
+
+	/** How many freed buffers were returned to the system allocator instead of being kept, because the pool was at its {@link PoolLimits | limits}. */
+	released: number;
+
+	/** How many free buffers the pool is keeping now, in all threads. Not reset by {@link resetStats}. */
+	cachedBlocks: number;
+
+	/** How many bytes of memory the free buffers take up. Not reset by {@link resetStats}. */
+	cachedBytes: number;
+
+	/** The current limits. */
+	limits: PoolLimits;
+}
+
+/**
+ * Changes when {@link transcode} and {@link transcodeAsync} split large inputs among several threads.
+ *
+ * @remarks
+ * An input at least `threshold` bytes long is cut into chunks at character boundaries, and the chunks are converted at the same time on up to `threads` threads, including the calling one. The result, and any error, is exactly the same as if the whole input had been converted on one thread.
+ *
+ * This is only done between encodings where character boundaries can be found without decoding from the beginning: the Unicode encodings, single-byte encodings, and EUC encodings. Encoding to UTF-16 or UTF-32 without an explicit byte order, and decoding with `fatal: false`, are always done on one thread. Options that are left out stay as they are.
+ */
+export declare function setParallelTranscodeOptions(options: Partial<ParallelTranscodeOptions>): void;
+
+/** Options for {@link setParallelTranscodeOptions}. */
+export interface ParallelTranscodeOptions {
+	/** How many bytes long an input must be to be split among threads. The default is 33554432 (32 MiB). */
+	threshold: number;
+
+	/** Most threads to use for one conversion, counting the calling thread. The default, 0, means one for each processor. 1 means never split. */
+	threads: number;
+}
+
+/**
+ * Statistics about the conversions this module has performed, from {@link getStats}.
+ *
+ * @remarks
+ * These are only collected while enabled with {@link setStatsEnabled}.
+ */
+export interface Stats {
+	/** Whether statistics are currently being collected. */
+	enabled: boolean;
+
+	/** Counts for each operation and encoding that has been used. */
+	operations: OperationStats[];
+
+	/**
+	 * How often each shortcut was taken, when there was a chance to take it. The hit rate of each is `taken / (taken + missed)`.
+	 *
+	 * @remarks
+	 * `ascii` is all-ASCII text that was copied instead of converted. `contiguousText` is decoded text that could be copied into a JavaScript string in one piece (on macOS, this is when Core Foundation gives direct access to a string's characters). `externalString` is decoded text that was long enough to become an external string, and didn't need to be copied into the JavaScript heap at all.
+	 */
+	fastPaths: Record<"ascii" | "contiguousText" | "externalString", { taken: number; missed: number }>;
+
+	/** How many times text was copied between JavaScript and native memory. */
+	copies: number;
+
+	/** How many bytes were copied between JavaScript and native memory, in total. */
+	copiedBytes: number;
+}
+
+/** Statistics about one operation on one encoding, in {@link Stats}. */
+export interface OperationStats {
+	/**
+	 * The operation.
+	 *
+	 * @remarks
+	 * This includes the asynchronous, `try`, `Into`, and batch forms of each operation, such as {@link StringEncoding.decodeAsync} and {@link decodeMany}, but not {@link Decoder} and {@link Encoder}. Each batch counts as one call.
+	 */
+	operation: "decode" | "encode" | "transcode";
+
+	/** The encoding. For `transcode`, this is the encoding of the input. */
+	encoding: StringEncoding;
+
+	/** How many calls there were. */
+	calls: number;
+
+	/** How many of the calls failed, such as because of invalid input. */
+	errors: number;
+
+	/** How many bytes of input were given, in total. Text in JavaScript strings counts as UTF-16: two bytes per code unit. */
+	bytesIn: number;
+
+	/** How many bytes of output were produced by the calls that succeeded, counted as `bytesIn` is. */
+	bytesOut: number;
+
+	/** How long the calls took. Element `i` counts the calls that took at least 2<sup>i</sup> nanoseconds, but less than 2<sup>i+1</sup>. The last element also counts any that took longer. Asynchronous calls are timed from when they start until their promise settles. */
+	latency: number[];
+}
+
 /**
  * Tests whether an encoding exists and is supported.
  *
@@ -246,9 +816,34 @@ export declare function encodingExists(encoding: string): boolean;
  * Options for decoding.
  *
  * @remarks
- * This interface is an empty placeholder, as there are currently no pertinent decoding options supported by Core Foundation.
+ * {@link transcodeInto} and {@link Decoder} only support the default, fatal mode, and throw `RangeError` if `fatal` is `false`.
  */
 export interface DecodeOptions {
+	/**
+	 * Whether invalid input is an error.
+	 *
+	 * @remarks
+	 * If this is `true` (the default), then invalid input causes {@link InvalidEncodedTextError} to be thrown.
+	 *
+	 * If this is `false`, then each malformed sequence in the input is decoded as {@link DecodeOptions.replacement} instead, and decoding always succeeds. For UTF-8, a malformed sequence is the longest prefix of a valid one, as in the WHATWG Encoding Standard.
+	 */
+	fatal?: boolean;
+
+	/**
+	 * The character to decode malformed sequences as, when `fatal` is `false`.
+	 *
+	 * @remarks
+	 * This may be a string of one character, or the code point of one. It must not be a surrogate. The default is U+FFFD REPLACEMENT CHARACTER.
+	 */
+	replacement?: string | number;
+
+	/**
+	 * If present, then the `count` property of this object is set to the number of malformed sequences that were replaced.
+	 *
+	 * @remarks
+	 * This is set to 0 if there were none, or if `fatal` is `true`.
+	 */
+	replacements?: { count: number };
 }
 
 /** Options for encoding. */
@@ -270,10 +865,33 @@ export interface SelectAndEncodeOptions extends EncodeOptions {
 	 * Decides whether to encode with the given {@link StringEncoding}.
 	 *
 	 * @remarks
-	 * This method is called by `encodeSmallest` and `transcodeSmallest` to let the application decide whether to proceed with Core Foundation's chosen smallest encoding, before actually performing the work of encoding the text.
+	 * This method is called by `encodeSmallest` and `transcodeSmallest` to let the application decide whether to proceed with the chosen smallest encoding, before actually performing the work of encoding the text.
 	 *
 	 * @param encoding - The selected {@link StringEncoding}.
 	 * @returns `true` if the text should be encoded; `false` to abort encoding. If this method returns `false`, then the calling function (`encodeSmallest` or `transcodeSmallest`) will return `null` instead of the encoded text.
 	 */
 	isEncodingOk?(encoding: StringEncoding): boolean;
 }
+
+/**
+ * The parts of `AbortSignal` that this library uses.
+ *
+ * @remarks
+ * This is satisfied by the `AbortSignal` built into Node.js 15 and later, and by most polyfills for older versions.
+ */
+export interface AbortSignalLike {
+	readonly aborted: boolean;
+	addEventListener(type: "abort", listener: () => void): void;
+	removeEventListener(type: "abort", listener: () => void): void;
+}
+
+/** Options for asynchronous operations, like {@link StringEncoding.decodeAsync}. */
+export interface AsyncOptions {
+	/**
+	 * Cancels the operation when aborted.
+	 *
+	 * @remarks
+	 * When this signal is aborted, the returned promise rejects with {@link AbortError}. If the conversion hasn't started yet, it's skipped. If it's already running, it stops as soon as it safely can.
+	 */
+	signal?: AbortSignalLike;
+}
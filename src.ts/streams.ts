@@ -0,0 +1,128 @@
+import { Transform, TransformCallback, TransformOptions } from "stream";
+import { StringDecoder } from "string_decoder";
+import { DecodeOptions, Decoder, EncodeOptions, Encoder, StringEncoding } from "./native";
+
+/**
+ * A `Transform` stream that decodes bytes into strings.
+ *
+ * @remarks
+ * Characters that are split between two chunks are decoded correctly. The readable side produces strings.
+ *
+ * Emits {@link InvalidEncodedTextError} as an error if the text is not valid in the given encoding, including if it ends partway through a character.
+ */
+export class DecoderStream extends Transform {
+	private readonly _decoder: Decoder;
+
+	/**
+	 * @param encoding - The encoding of the incoming bytes, as a {@link StringEncoding} or an IANA character set name.
+	 * @param options - Options for decoding, and for the underlying `Transform` stream.
+	 */
+	constructor(encoding: StringEncoding | string, options?: DecodeOptions & TransformOptions) {
+		super({
+			...options,
+			decodeStrings: true,
+			encoding: "utf8"
+		});
+
+		this._decoder = new Decoder(encoding, options);
+	}
+
+	/** The encoding of the incoming bytes. */
+	get encoding(): StringEncoding {
+		return this._decoder.encoding;
+	}
+
+	_transform(chunk: Buffer, _encoding: string, callback: TransformCallback): void {
+		let text: string;
+
+		try {
+			text = this._decoder.write(chunk);
+		}
+		catch (e) {
+			callback(e);
+			return;
+		}
+
+		if (text)
+			this.push(text, "utf8");
+		callback();
+	}
+
+	_flush(callback: TransformCallback): void {
+		let text: string;
+
+		try {
+			text = this._decoder.end();
+		}
+		catch (e) {
+			callback(e);
+			return;
+		}
+
+		if (text)
+			this.push(text, "utf8");
+		callback();
+	}
+}
+
+/**
+ * A `Transform` stream that encodes strings into bytes.
+ *
+ * @remarks
+ * Strings written to this stream are encoded as they are. `Buffer`s written to it are taken to be UTF-8, and characters that are split between two `Buffer`s are handled correctly.
+ *
+ * Emits {@link NotRepresentableError} as an error if the text cannot be fully represented in the given encoding, and `options` does not contain a `lossByte`.
+ */
+export class EncoderStream extends Transform {
+	private readonly _encoder: Encoder;
+	private readonly _utf8 = new StringDecoder("utf8");
+
+	/**
+	 * @param encoding - The encoding to use, as a {@link StringEncoding} or an IANA character set name.
+	 * @param options - Options for encoding, and for the underlying `Transform` stream.
+	 */
+	constructor(encoding: StringEncoding | string, options?: EncodeOptions & TransformOptions) {
+		super({
+			...options,
+			decodeStrings: false
+		});
+
+		this._encoder = new Encoder(encoding, options);
+	}
+
+	/** The encoding being used. */
+	get encoding(): StringEncoding {
+		return this._encoder.encoding;
+	}
+
+	_transform(chunk: string | Buffer, _encoding: string, callback: TransformCallback): void {
+		try {
+			const text = typeof chunk === "string" ? chunk : this._utf8.write(chunk);
+			const bytes = this._encoder.write(text);
+
+			if (bytes.length)
+				this.push(bytes);
+		}
+		catch (e) {
+			callback(e);
+			return;
+		}
+
+		callback();
+	}
+
+	_flush(callback: TransformCallback): void {
+		try {
+			const bytes = this._encoder.end(this._utf8.end());
+
+			if (bytes.length)
+				this.push(bytes);
+		}
+		catch (e) {
+			callback(e);
+			return;
+		}
+
+		callback();
+	}
+}
@@ -0,0 +1,412 @@
+#include "Backend.hh"
+#include "PortableBackend.hh"
+#include "ChunkedCoders.hh"
+#include "GrowableBuffer.hh"
+#include "ascii.hh"
+#include <algorithm>
+#include <new>
+
+#if defined(__APPLE__) && !defined(ICCF_PORTABLE_BACKEND)
+#include "CFBackend.hh"
+#endif
+
+const Backend &Backend::Default() {
+#if defined(__APPLE__) && !defined(ICCF_PORTABLE_BACKEND)
+	static const CFBackend backend;
+#else
+	static const PortableBackend backend;
+#endif
+	return backend;
+}
+
+namespace {
+	/** Output buffers up to this size are allocated for the worst case up front, rather than guessing a smaller size and growing. */
+	constexpr size_t kWorstCaseLimit = 64 * 1024;
+
+	/** `encodeAllFromUTF8` widens this many bytes of UTF-8 at a time, at most. */
+	constexpr size_t kUTF8PieceLength = 16 * 1024;
+
+	/** Replaces the contents of `out` with the given UTF-8 text, which must be valid, and must not end partway through a character. */
+	void widenUTF8(const uint8_t *in, size_t length, PooledU16String &out) {
+		// The UTF-16 form is never longer than the UTF-8 form, in code units.
+		out.resize(length);
+		char16_t *const start = &out[0], *o = start;
+
+		for (size_t i = 0; i < length;) {
+			const size_t run = asciiPrefixLength(in + i, length - i);
+			latin1ToUTF16(in + i, run, o);
+			i += run;
+			o += run;
+
+			if (i >= length)
+				break;
+
+			const uint8_t lead = in[i];
+			char32_t c;
+
+			if (lead < 0xe0) {
+				c = (char32_t(lead & 0x1f) << 6) | (in[i + 1] & 0x3f);
+				i += 2;
+			}
+			else if (lead < 0xf0) {
+				c = (char32_t(lead & 0x0f) << 12) | (char32_t(in[i + 1] & 0x3f) << 6) | (in[i + 2] & 0x3f);
+				i += 3;
+			}
+			else {
+				c = (char32_t(lead & 0x07) << 18) | (char32_t(in[i + 1] & 0x3f) << 12) | (char32_t(in[i + 2] & 0x3f) << 6) | (in[i + 3] & 0x3f);
+				i += 4;
+			}
+
+			if (c < 0x10000)
+				*o++ = static_cast<char16_t>(c);
+			else {
+				*o++ = static_cast<char16_t>(0xd7c0 + (c >> 10));
+				*o++ = static_cast<char16_t>(0xdc00 | (c & 0x3ff));
+			}
+		}
+
+		out.resize(static_cast<size_t>(o - start));
+	}
+}
+
+bool Backend::isNameLookupCheap() const {
+	return false;
+}
+
+bool Backend::isEncodingResumable(EncodingId encoding) const {
+	return isASCIICompatible(encoding);
+}
+
+bool Backend::usesPortableTables(EncodingId) const {
+	return false;
+}
+
+std::optional<EncodedBytes> Backend::encodeAll(EncodingId encoding, std::u16string_view text, uint8_t lossByte, size_t *unrepresentableAt) const {
+	const size_t worstCase = maxEncodedLength(encoding, text.size());
+
+	// Encodings that can't be resumed partway through the text always get a worst-case buffer, and start over if that somehow wasn't enough.
+	const bool resumable = isEncodingResumable(encoding);
+
+	// For big texts in encodings like UTF-8, the worst case is usually a gross overestimate, so start with a guess and grow from there.
+	GrowableBuffer buf(
+		resumable && worstCase > kWorstCaseLimit
+		? std::min(worstCase, text.size() + text.size() / 4)
+		: worstCase
+	);
+
+	size_t read = 0, written = 0;
+
+	for (;;) {
+		auto const result = encode(encoding, text.substr(read), lossByte, buf.data() + written, buf.capacity() - written);
+
+		if (result.status == EncodeResult::Status::ok)
+			return buf.finish(written + result.written);
+		else if (result.status == EncodeResult::Status::unrepresentable) {
+			if (unrepresentableAt != nullptr)
+				*unrepresentableAt = read + result.read;
+			return std::nullopt;
+		}
+
+		size_t newCapacity;
+
+		if (resumable) {
+			read += result.read;
+			written += result.written;
+			newCapacity = std::min(buf.capacity() * 2, written + maxEncodedLength(encoding, text.size() - read));
+		}
+		else {
+			read = written = 0;
+			newCapacity = buf.capacity() * 2;
+		}
+
+		// Make sure there's progress, even if `maxEncodedLength` is wrong.
+		if (newCapacity <= buf.capacity())
+			newCapacity = buf.capacity() * 2 + 16;
+
+		buf.resize(newCapacity);
+	}
+}
+
+std::optional<EncodedBytes> Backend::encodeAll(EncodingId encoding, std::u16string_view text, uint8_t lossByte, size_t expectedLength, size_t *unrepresentableAt) const {
+	GrowableBuffer buf(expectedLength);
+	auto const result = encode(encoding, text, lossByte, buf.data(), buf.capacity());
+
+	if (result.status == EncodeResult::Status::ok)
+		return buf.finish(result.written);
+	else if (result.status == EncodeResult::Status::unrepresentable) {
+		if (unrepresentableAt != nullptr)
+			*unrepresentableAt = result.read;
+		return std::nullopt;
+	}
+	else
+		return encodeAll(encoding, text, lossByte, unrepresentableAt);
+}
+
+std::optional<EncodedBytes> Backend::encodeAllFromUTF8(EncodingId encoding, const uint8_t *utf8, size_t length, size_t utf16Length, uint8_t lossByte, size_t *unrepresentableAt) const {
+	const size_t worstCase = maxEncodedLength(encoding, utf16Length);
+	GrowableBuffer buf(worstCase > kWorstCaseLimit ? std::min(worstCase, utf16Length + utf16Length / 4) : worstCase);
+	PooledU16String piece;
+	size_t consumed = 0, unitsBefore = 0, written = 0;
+
+	while (consumed < length) {
+		// Don't split a character between pieces.
+		size_t end = std::min(length, consumed + kUTF8PieceLength);
+		while (end < length && (utf8[end] & 0xc0) == 0x80)
+			end--;
+
+		widenUTF8(utf8 + consumed, end - consumed, piece);
+
+		for (size_t read = 0;;) {
+			auto const result = encode(encoding, std::u16string_view(piece).substr(read), lossByte, buf.data() + written, buf.capacity() - written);
+
+			if (result.status == EncodeResult::Status::unrepresentable) {
+				if (unrepresentableAt != nullptr)
+					*unrepresentableAt = unitsBefore + read + result.read;
+				return std::nullopt;
+			}
+
+			read += result.read;
+			written += result.written;
+
+			if (result.status == EncodeResult::Status::ok)
+				break;
+
+			size_t newCapacity = std::min(buf.capacity() * 2, written + maxEncodedLength(encoding, utf16Length - unitsBefore - read));
+
+			// Make sure there's progress, even if `maxEncodedLength` is wrong.
+			if (newCapacity <= buf.capacity())
+				newCapacity = buf.capacity() * 2 + 16;
+
+			buf.resize(newCapacity);
+		}
+
+		unitsBefore += piece.size();
+		consumed = end;
+	}
+
+	return buf.finish(written);
+}
+
+size_t Backend::encodableLength(EncodingId encoding, std::u16string_view text) const {
+	auto const result = encode(encoding, text, 0, nullptr, 0);
+	return result.status == EncodeResult::Status::ok ? text.size() : result.read;
+}
+
+size_t Backend::inputLength(EncodingId unmarkedEncoding, size_t bomLength, std::u16string_view decodedPrefix) const {
+	return bomLength + encode(unmarkedEncoding, decodedPrefix, 0, nullptr, 0).written;
+}
+
+size_t Backend::unrepresentableOffset(EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) const {
+	size_t bomLength;
+	const auto unmarkedFrom = skipByteOrderMark(from, bytes, length, bomLength);
+	const auto decoded = decode(from, bytes, length);
+
+	if (!decoded)
+		return 0;
+
+	const std::u16string_view text = *decoded;
+	return inputLength(unmarkedFrom, bomLength, text.substr(0, encodableLength(to, text)));
+}
+
+size_t Backend::validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	// The longest character in any supported encoding is this many bytes.
+	constexpr size_t kMaxCharacterLength = 4;
+
+	auto const decodes = [&] (size_t prefix) {
+		return decode(encoding, bytes, prefix).has_value();
+	};
+
+	if (decodes(length))
+		return length;
+
+	// Narrow down where the bytes stop being valid. A prefix that ends partway through a character doesn't decode even though a longer one might, so try a few lengths each time, not just the midpoint.
+	size_t valid = 0, invalid = length;
+
+	while (invalid - valid > 1) {
+		const size_t mid = valid + (invalid - valid) / 2;
+		bool found = false;
+
+		for (size_t prefix = mid; prefix < invalid && prefix < mid + kMaxCharacterLength; prefix++) {
+			if (decodes(prefix)) {
+				valid = prefix;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+			invalid = mid;
+	}
+
+	return valid;
+}
+
+namespace {
+	/** How many bytes `Backend::decodeLossy` tries to decode at once, at first and at most. It starts small again after each invalid sequence, so that corrupt text doesn't mean decoding big pieces over and over. */
+	constexpr size_t kMinLossyWindow = 64, kMaxLossyWindow = 64 * 1024;
+}
+
+DecodedText Backend::decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements) const {
+	// The longest character in any supported encoding is this many bytes.
+	constexpr size_t kMaxCharacterLength = 4;
+
+	size_t replaced = 0;
+
+	if (auto decoded = decode(encoding, bytes, length)) {
+		if (replacements != nullptr)
+			*replacements = 0;
+		return std::move(*decoded);
+	}
+
+	// The byte order mark only counts at the very beginning, so the rest is decoded in the byte order it chose, and an invalid code unit is skipped as a whole.
+	size_t bomLength;
+	const EncodingId unmarked = skipByteOrderMark(encoding, bytes, length, bomLength);
+	const size_t unitLength =
+		unmarked == kEncodingUTF16BE || unmarked == kEncodingUTF16LE ? 2
+		: unmarked == kEncodingUTF32BE || unmarked == kEncodingUTF32LE ? 4
+		: 1;
+
+	PooledU16String out;
+	size_t window = kMinLossyWindow;
+
+	const auto append = [&] (const uint8_t *piece, size_t pieceLength) {
+		if (auto decoded = decode(unmarked, piece, pieceLength)) {
+			out.append(std::u16string_view(*decoded));
+			return true;
+		}
+		return false;
+	};
+
+	for (size_t i = bomLength; i < length;) {
+		const size_t available = std::min(window, length - i);
+		const bool last = available == length - i;
+
+		if (append(bytes + i, available)) {
+			i += available;
+			window = std::min(window * 2, kMaxLossyWindow);
+			continue;
+		}
+
+		size_t valid = validLength(unmarked, bytes + i, available);
+
+		if (valid != 0 && append(bytes + i, valid))
+			i += valid;
+		else
+			valid = 0;
+
+		// A character cut off by the end of the window may turn out fine once the rest of it is seen, so look again from there. The window is never shorter than a character unless it's the last, so this always makes progress.
+		if (!last && available - valid < kMaxCharacterLength)
+			continue;
+
+		if (replacement >= 0x10000) {
+			out.push_back(static_cast<char16_t>(0xd800 + ((replacement - 0x10000) >> 10)));
+			out.push_back(static_cast<char16_t>(0xdc00 + ((replacement - 0x10000) & 0x3ff)));
+		}
+		else
+			out.push_back(static_cast<char16_t>(replacement));
+
+		replaced++;
+		i += std::min(unitLength, length - i);
+		window = kMinLossyWindow;
+	}
+
+	if (replacements != nullptr)
+		*replacements = replaced;
+
+	return DecodedText(std::move(out));
+}
+
+namespace {
+	inline bool startsWith(const uint8_t *bytes, size_t length, std::initializer_list<uint8_t> prefix) noexcept {
+		return length >= prefix.size() && std::equal(prefix.begin(), prefix.end(), bytes);
+	}
+}
+
+EncodingId Backend::skipByteOrderMark(EncodingId encoding, const uint8_t *bytes, size_t length, size_t &bomLength) noexcept {
+	bomLength = 0;
+
+	switch (encoding) {
+		case kEncodingUTF8:
+			if (startsWith(bytes, length, { 0xef, 0xbb, 0xbf }))
+				bomLength = 3;
+			return encoding;
+
+		case kEncodingUTF16:
+			if (startsWith(bytes, length, { 0xff, 0xfe })) {
+				bomLength = 2;
+				return kEncodingUTF16LE;
+			}
+			else {
+				if (startsWith(bytes, length, { 0xfe, 0xff }))
+					bomLength = 2;
+				return kEncodingUTF16BE;
+			}
+
+		case kEncodingUTF32:
+			if (startsWith(bytes, length, { 0xff, 0xfe, 0, 0 })) {
+				bomLength = 4;
+				return kEncodingUTF32LE;
+			}
+			else {
+				if (startsWith(bytes, length, { 0, 0, 0xfe, 0xff }))
+					bomLength = 4;
+				return kEncodingUTF32BE;
+			}
+
+		default:
+			return encoding;
+	}
+}
+
+size_t Backend::incompleteTailLength(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	switch (encoding) {
+		case kEncodingUTF8:
+			// Look back, past any continuation bytes, for the lead byte of a sequence that isn't finished yet.
+			for (size_t i = 1; i <= std::min<size_t>(3, length); i++) {
+				const uint8_t b = bytes[length - i];
+
+				if ((b & 0xc0) == 0x80)
+					continue;
+
+				const size_t sequenceLength = b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : b >= 0xc0 ? 2 : 1;
+				return sequenceLength > i ? i : 0;
+			}
+			return 0;
+
+		case kEncodingUTF16:
+		case kEncodingUTF16BE:
+		case kEncodingUTF16LE: {
+			const size_t odd = length % 2;
+
+			if (length - odd >= 2) {
+				const uint8_t *last = bytes + length - odd - 2;
+				const char16_t unit = encoding == kEncodingUTF16LE ? last[0] | (last[1] << 8) : (last[0] << 8) | last[1];
+
+				if (unit >= 0xd800 && unit <= 0xdbff)
+					return odd + 2;
+			}
+
+			return odd;
+		}
+
+		case kEncodingUTF32:
+		case kEncodingUTF32BE:
+		case kEncodingUTF32LE:
+			return length % 4;
+
+		default:
+			return maxEncodedLength(encoding, 1) == 1 ? 0 : kUnknownTailLength;
+	}
+}
+
+std::unique_ptr<IncrementalDecoder> Backend::newDecoder(EncodingId encoding) const {
+	return std::make_unique<ChunkedDecoder>(*this, encoding);
+}
+
+std::unique_ptr<IncrementalEncoder> Backend::newEncoder(EncodingId encoding, uint8_t lossByte) const {
+	return std::make_unique<ChunkedEncoder>(*this, encoding, lossByte);
+}
+
+std::vector<EncodingId> Backend::tableMismatches() const {
+	return {};
+}
@@ -0,0 +1,473 @@
+#pragma once
+
+#include "pool.hh"
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Numeric identifier of a character encoding.
+ *
+ * These are the values of Core Foundation's `CFStringEncoding` constants, on every platform, so that `StringEncoding.cfStringEncoding` means the same thing regardless of which backend is doing the work.
+ */
+typedef uint32_t EncodingId;
+
+static constexpr EncodingId kEncodingInvalidId = 0xffffffffU;
+
+/** The Unicode encodings, which get special treatment in a few places. */
+static constexpr EncodingId kEncodingUTF8 = 0x08000100;
+static constexpr EncodingId kEncodingUTF16 = 0x00000100;
+static constexpr EncodingId kEncodingUTF16BE = 0x10000100;
+static constexpr EncodingId kEncodingUTF16LE = 0x14000100;
+static constexpr EncodingId kEncodingUTF32 = 0x0c000100;
+static constexpr EncodingId kEncodingUTF32BE = 0x18000100;
+static constexpr EncodingId kEncodingUTF32LE = 0x1c000100;
+
+/** Returned by `Backend::windowsCodepage` for encodings that have no corresponding Windows codepage. */
+static constexpr uint32_t kNoWindowsCodepage = UINT32_MAX;
+
+/** UTF-16 text in memory from `Pool`. Decoded text and temporary copies of text are kept in these, since they're usually freed soon after they're made. */
+typedef std::basic_string<char16_t, std::char_traits<char16_t>, Pool::Allocator<char16_t>> PooledU16String;
+
+/**
+ * Text produced by a `Backend`'s decoder, as UTF-16 code units in native byte order.
+ *
+ * The characters either live in this object's own storage, are borrowed from some backend-specific object (such as a `CFString`) that is kept alive by `owner`, or are held by a `Source` that can only copy them out piece by piece.
+ *
+ * Text held by a `Source` is copied into contiguous storage the first time `data` (or the conversion to `std::u16string_view`) is used. Callers that can work piece by piece should check `isContiguous` and use `read` instead, to avoid that copy.
+ */
+class DecodedText {
+	public:
+	/** Text that a backend can copy out in pieces, but that isn't stored contiguously anywhere that can be borrowed. */
+	class Source {
+		public:
+		virtual ~Source() {}
+		virtual size_t size() const noexcept = 0;
+
+		/** Copies the code units in the range [`start`, `start + length`) to `out`. */
+		virtual void read(size_t start, size_t length, char16_t *out) const noexcept = 0;
+	};
+
+	private:
+	mutable PooledU16String _storage;
+	mutable std::shared_ptr<const Source> _source;
+	std::shared_ptr<const void> _owner;
+	const char16_t *_borrowed = nullptr;
+	size_t _borrowedLength = 0;
+
+	void materialize() const {
+		PooledU16String storage(_source->size(), u'\0');
+		_source->read(0, storage.size(), &storage[0]);
+		_storage = std::move(storage);
+		_source.reset();
+	}
+
+	public:
+	inline DecodedText() noexcept {}
+
+	inline DecodedText(PooledU16String &&storage) noexcept
+	: _storage(std::move(storage))
+	{}
+
+	inline DecodedText(const char16_t *chars, size_t length, std::shared_ptr<const void> owner) noexcept
+	: _owner(std::move(owner))
+	, _borrowed(chars)
+	, _borrowedLength(length)
+	{}
+
+	inline DecodedText(std::shared_ptr<const Source> source) noexcept
+	: _source(std::move(source))
+	{}
+
+	/** Whether `data` can be used without first copying the whole text. */
+	inline bool isContiguous() const noexcept {
+		return !_source;
+	}
+
+	inline const char16_t *data() const {
+		if (_source)
+			materialize();
+		return _owner ? _borrowed : _storage.data();
+	}
+
+	inline size_t size() const noexcept {
+		return _source ? _source->size() : _owner ? _borrowedLength : _storage.size();
+	}
+
+	/** Copies the code units in the range [`start`, `start + length`) to `out`. */
+	inline void read(size_t start, size_t length, char16_t *out) const {
+		if (_source)
+			_source->read(start, length, out);
+		else
+			std::char_traits<char16_t>::copy(out, data() + start, length);
+	}
+
+	inline operator std::u16string_view() const {
+		return { data(), size() };
+	}
+};
+
+/**
+ * Bytes produced by `Backend::encodeAll`.
+ *
+ * The memory is allocated with `std::malloc`, so that ownership of it can be handed over to something else (such as a `Buffer`) with `release`.
+ */
+class EncodedBytes {
+	uint8_t *_data = nullptr;
+	size_t _length = 0;
+
+	public:
+	inline EncodedBytes() noexcept {}
+
+	/** Takes ownership of `data`, which must have been allocated with `std::malloc`. */
+	inline EncodedBytes(uint8_t *data, size_t length) noexcept
+	: _data(data)
+	, _length(length)
+	{}
+
+	inline EncodedBytes(EncodedBytes &&other) noexcept
+	: _data(other._data)
+	, _length(other._length)
+	{
+		other._data = nullptr;
+		other._length = 0;
+	}
+
+	inline EncodedBytes &operator=(EncodedBytes &&other) noexcept {
+		std::swap(_data, other._data);
+		std::swap(_length, other._length);
+		return *this;
+	}
+
+	EncodedBytes(const EncodedBytes &) = delete;
+	EncodedBytes &operator=(const EncodedBytes &) = delete;
+
+	inline ~EncodedBytes() {
+		std::free(_data);
+	}
+
+	/** Makes a copy of the given bytes. */
+	static inline EncodedBytes copy(const uint8_t *data, size_t length) {
+		auto const copy = static_cast<uint8_t *>(std::malloc(length == 0 ? 1 : length));
+		if (copy == nullptr)
+			throw std::bad_alloc();
+		std::char_traits<char>::copy(reinterpret_cast<char *>(copy), reinterpret_cast<const char *>(data), length);
+		return EncodedBytes(copy, length);
+	}
+
+	inline const uint8_t *data() const noexcept {
+		return _data;
+	}
+
+	inline size_t size() const noexcept {
+		return _length;
+	}
+
+	/** Gives up ownership of the bytes. The caller becomes responsible for freeing them. */
+	inline uint8_t *release() noexcept {
+		auto const data = _data;
+		_data = nullptr;
+		_length = 0;
+		return data;
+	}
+};
+
+/** Outcome of a call to `Backend::encode`. */
+struct EncodeResult {
+	enum class Status {
+		/** All of the text was encoded. */
+		ok,
+
+		/** Encoding stopped because the next character would not fit in the output buffer. */
+		outputFull,
+
+		/** Encoding stopped at a character that is not representable in the encoding, and no loss byte was given. */
+		unrepresentable
+	};
+
+	Status status;
+
+	/** Number of UTF-16 code units consumed. This never ends in the middle of a surrogate pair. */
+	size_t read;
+
+	/** Number of bytes produced (or, when measuring, that would be produced). */
+	size_t written;
+};
+
+/** An encoding that can represent some text, and how many bytes the text takes up in it. See `Backend::representableEncodings`. */
+struct RepresentableEncoding {
+	EncodingId encoding;
+	size_t length;
+};
+
+/** An encoding that some bytes might be in, and how likely that is. See `Backend::detectEncoding`. */
+struct DetectedEncoding {
+	EncodingId encoding;
+
+	/** From 0 (certainly not) to 1 (certainly). */
+	double confidence;
+};
+
+/**
+ * Decodes text that arrives in pieces, such as from a stream. Obtained from `Backend::newDecoder`.
+ *
+ * Bytes at the end of a piece that don't make up a whole character are held until the next piece arrives, as is any shift state. Like `Backend`, this is safe to use without a JavaScript environment, but an instance must not be used by more than one thread at a time.
+ */
+class IncrementalDecoder {
+	public:
+	virtual ~IncrementalDecoder() {}
+
+	/**
+	 * Decodes the next piece of text, and appends it to `out`.
+	 *
+	 * @param end - Whether this is the last piece. If it is, then the text must not end partway through a character.
+	 * @returns False if the text is not valid. After that, the decoder should not be used any more.
+	 */
+	virtual bool write(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) = 0;
+
+	/** The number of bytes at the end of the text written so far that haven't been decoded yet, because they don't make up a whole character. */
+	virtual size_t pendingLength() const noexcept = 0;
+};
+
+/**
+ * Encodes text that arrives in pieces. Obtained from `Backend::newEncoder`.
+ *
+ * A high surrogate at the end of a piece is held until the next piece arrives, in case the next piece begins with the matching low surrogate. Any byte order mark is written only at the very beginning, and any shift state is carried over from one piece to the next and reset at the end.
+ */
+class IncrementalEncoder {
+	public:
+	virtual ~IncrementalEncoder() {}
+
+	/**
+	 * Encodes the next piece of text.
+	 *
+	 * @param end - Whether this is the last piece.
+	 * @returns The encoded bytes, or `std::nullopt` if some character is not representable and there is no loss byte. After that, the encoder should not be used any more.
+	 */
+	virtual std::optional<EncodedBytes> write(std::u16string_view text, bool end) = 0;
+};
+
+/**
+ * The engine that does the actual character set conversion, and knows which encodings exist.
+ *
+ * All methods are safe to call without a JavaScript environment. `StringEncoding` and `transcode.cc` translate between this and N-API.
+ */
+class Backend {
+	public:
+	virtual ~Backend() {}
+
+	/** Whether the given encoding is known to, and supported by, this backend. */
+	virtual bool isEncodingAvailable(EncodingId encoding) const = 0;
+
+	/** The encoding the operating system uses by default. */
+	virtual EncodingId systemEncoding() const = 0;
+
+	/** Every encoding that `isEncodingAvailable` says is available, in no particular order. */
+	virtual std::vector<EncodingId> availableEncodings() const = 0;
+
+	/**
+	 * Each of these looks up an encoding by some other kind of identifier. IANA character set names are in UTF-8, and are compared without regard to ASCII case.
+	 *
+	 * @returns The encoding, or `kEncodingInvalidId` if not recognized.
+	 */
+	virtual EncodingId encodingForIANACharSetName(std::string_view name) const = 0;
+	virtual EncodingId encodingForWindowsCodepage(uint32_t codepage) const = 0;
+	virtual EncodingId encodingForNSStringEncoding(uint32_t nsStringEncoding) const = 0;
+
+	/** Whether `encodingForIANACharSetName` is as quick as looking the name up in a cache would be, and allocates nothing, so that there's no point in caching what it returns. The default implementation says no. */
+	virtual bool isNameLookupCheap() const;
+
+	/** The IANA character set name of the given encoding, in UTF-8, if there is one. */
+	virtual std::optional<std::string> ianaCharSetName(EncodingId encoding) const = 0;
+
+	/** The human-readable name of the given encoding, in UTF-8. */
+	virtual std::string name(EncodingId encoding) const = 0;
+
+	/** The Windows codepage corresponding to the given encoding, or `kNoWindowsCodepage`. */
+	virtual uint32_t windowsCodepage(EncodingId encoding) const = 0;
+
+	/** The Cocoa `NSStringEncoding` constant corresponding to the given encoding. */
+	virtual uint32_t nsStringEncoding(EncodingId encoding) const = 0;
+
+	/**
+	 * Whether the given encoding represents every ASCII character as the same single byte that ASCII does, and uses bytes less than 0x80 for nothing else.
+	 *
+	 * Text that is entirely ASCII can be converted to and from such encodings by simply copying it.
+	 */
+	virtual bool isASCIICompatible(EncodingId encoding) const = 0;
+
+	/**
+	 * Whether `encode` can stop partway through some text and carry on from there later, with the output of both calls joined together being the same as encoding the text in one go. That's so for encodings that have no shift state and no byte order mark.
+	 *
+	 * The default implementation says so only for ASCII-compatible encodings.
+	 */
+	virtual bool isEncodingResumable(EncodingId encoding) const;
+
+	/**
+	 * Whether this backend converts the given encoding with the portable backend's own tables (see `PortableBackend::info`), so that what the tables say about it holds for this backend too.
+	 *
+	 * The default implementation says no.
+	 */
+	virtual bool usesPortableTables(EncodingId encoding) const;
+
+	/**
+	 * Finds every encoding that this library has its own tables for (those of `PortableBackend`) that this backend can represent all of the given text in, and how many bytes the text would take up in each.
+	 *
+	 * This takes one pass over the text, which works out the answer for the Unicode encodings, and the single-byte encodings that `usesPortableTables`, all at once. Multi-byte encodings like Shift JIS, and the other single-byte encodings, are then measured one at a time with `encode`, unless the text is all ASCII.
+	 *
+	 * @returns The encodings, from fewest bytes to most. Encodings that tie are in registry order, so single-byte encodings come before multi-byte ones.
+	 */
+	std::vector<RepresentableEncoding> representableEncodings(std::u16string_view text) const;
+
+	/**
+	 * An encoding that can represent all of the given text in few bytes, and how many.
+	 *
+	 * The default implementation picks the first of `representableEncodings`, which is the smallest, but finds it more quickly than listing them all.
+	 */
+	virtual RepresentableEncoding smallestEncoding(std::u16string_view text) const;
+
+	/** How many bytes from the beginning of the input `detectEncoding` looks at, unless told otherwise. */
+	static constexpr size_t kDefaultDetectionSampleLength = 64 * 1024;
+
+	/**
+	 * Guesses which encoding some bytes are in.
+	 *
+	 * A byte order mark settles the question. Otherwise, each candidate that the sample is valid in is scored by how plausible the decoded characters are as text: common letters of some script score well, while control characters, box drawing, and words with capital letters in the middle (the hallmark of text decoded in the wrong encoding) score badly. The single-byte encodings are all scored from one pass over the sample, which counts how often each byte and each pair of adjacent letters occurs. Multi-byte and Unicode encodings are scored by decoding the sample.
+	 *
+	 * @param candidates - The encodings to consider. If empty, every available encoding that the portable backend has tables for is considered.
+	 * @param sampleLength - Only this many bytes, from the beginning, are examined. A character cut off at the end of the sample doesn't count against an encoding.
+	 * @returns The encodings that the sample is valid in, most likely first.
+	 */
+	std::vector<DetectedEncoding> detectEncoding(const uint8_t *bytes, size_t length, const std::vector<EncodingId> &candidates, size_t sampleLength = kDefaultDetectionSampleLength) const;
+
+	/**
+	 * Decodes the given bytes.
+	 *
+	 * @returns The decoded text, or `std::nullopt` if the bytes are not valid in the given encoding.
+	 */
+	virtual std::optional<DecodedText> decode(EncodingId encoding, const uint8_t *bytes, size_t length) const = 0;
+
+	/**
+	 * Checks whether the given bytes are valid in the given encoding, without decoding them.
+	 *
+	 * The default implementation decodes anyway, and if that fails, searches for the longest prefix that decodes. Backends should override this with something that just scans the bytes, where they can.
+	 *
+	 * @returns `length` if all of the bytes are valid, or else the offset of the first byte of the first sequence that is invalid or cut off at the end.
+	 */
+	virtual size_t validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const;
+
+	/**
+	 * Decodes the given bytes, putting `replacement` in place of each invalid sequence instead of failing.
+	 *
+	 * The default implementation tries `decode` first. If that fails, it goes through the text once, decoding a window of it at a time, and using `validLength` on a window that doesn't decode to find the invalid sequence in it. Each invalid sequence is skipped one byte at a time (or, in UTF-16 and UTF-32, one code unit at a time, in the byte order that any byte order mark chose). Backends should override this with something that replaces invalid sequences as it goes, where they can.
+	 *
+	 * @param replacement - A Unicode scalar value, such as U+FFFD REPLACEMENT CHARACTER.
+	 * @param replacements - If not null, receives how many invalid sequences were replaced.
+	 */
+	virtual DecodedText decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements = nullptr) const;
+
+	/**
+	 * Encodes the given text into `out`, stopping when `capacity` bytes have been written or a character cannot be represented.
+	 *
+	 * This works like `CFStringGetBytes`: if `out` is null, nothing is written and `capacity` is ignored, but the result still reports how many bytes *would* have been written.
+	 *
+	 * @param lossByte - If non-zero, this byte is written in place of each unrepresentable character instead of stopping.
+	 */
+	virtual EncodeResult encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const = 0;
+
+	/**
+	 * Checks whether the given text can be encoded in the given encoding, without encoding it.
+	 *
+	 * @returns `text.size()` if every character is representable, or else the index of the first UTF-16 code unit of the first one that isn't.
+	 */
+	size_t encodableLength(EncodingId encoding, std::u16string_view text) const;
+
+	/**
+	 * Works out how many bytes of some encoded text make up the beginning of its decoded form, by measuring how long that beginning would be in the input encoding. This is exact as long as the text would be encoded the same way again, which is the case for nearly all text.
+	 *
+	 * @param unmarkedEncoding, bomLength - What `skipByteOrderMark` says about the encoded text.
+	 */
+	size_t inputLength(EncodingId unmarkedEncoding, size_t bomLength, std::u16string_view decodedPrefix) const;
+
+	/** Finds the byte offset in some valid encoded text of the first character that can't be encoded in `to`. This decodes the text all over again, so it's only for when an error is about to be reported anyway. */
+	size_t unrepresentableOffset(EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) const;
+
+	/** An upper bound on the number of bytes that encoding `length` UTF-16 code units could produce, including any byte order mark. */
+	virtual size_t maxEncodedLength(EncodingId encoding, size_t length) const = 0;
+
+	/**
+	 * Encodes all of the given text, converting it only once.
+	 *
+	 * Output is written to a buffer big enough for the worst case, if that isn't too wasteful, or else to a buffer that grows as needed. Either way, it is trimmed to size afterward.
+	 *
+	 * @param lossByte - See `encode`.
+	 * @param unrepresentableAt - If not null, and some character is not representable, receives the index of its first UTF-16 code unit.
+	 * @returns The encoded text, or `std::nullopt` if some character is not representable and `lossByte` is zero.
+	 */
+	std::optional<EncodedBytes> encodeAll(EncodingId encoding, std::u16string_view text, uint8_t lossByte, size_t *unrepresentableAt = nullptr) const;
+
+	/** Like `encodeAll`, but for text whose encoded length is already known (from `representableEncodings`), so the output can be allocated at exactly that size. If the length turns out to be wrong, this falls back to plain `encodeAll`. */
+	std::optional<EncodedBytes> encodeAll(EncodingId encoding, std::u16string_view text, uint8_t lossByte, size_t expectedLength, size_t *unrepresentableAt = nullptr) const;
+
+	/**
+	 * Like `encodeAll`, but takes the text as UTF-8, which is half the size of UTF-16 for Latin-1 and mostly-ASCII text. The text is widened to UTF-16 a piece at a time, so there's never a UTF-16 copy of all of it.
+	 *
+	 * The encoding must be ASCII-compatible, since only those can be encoded a piece at a time.
+	 *
+	 * @param utf8 - The text, which must be valid UTF-8.
+	 * @param utf16Length - The length of the text in UTF-16 code units.
+	 * @param unrepresentableAt - As in `encodeAll`, this is an index in UTF-16 code units.
+	 */
+	std::optional<EncodedBytes> encodeAllFromUTF8(EncodingId encoding, const uint8_t *utf8, size_t length, size_t utf16Length, uint8_t lossByte, size_t *unrepresentableAt = nullptr) const;
+
+	/**
+	 * Looks for a byte order mark at the beginning of some text in one of the Unicode encodings.
+	 *
+	 * @param bomLength - Receives the length of the byte order mark, or zero if there isn't one.
+	 * @returns The encoding of the text after the byte order mark. For UTF-16 and UTF-32 without an explicit byte order, this is the big- or little-endian form, as the byte order mark says (or big-endian, if there isn't one). For everything else, it's just `encoding`.
+	 */
+	static EncodingId skipByteOrderMark(EncodingId encoding, const uint8_t *bytes, size_t length, size_t &bomLength) noexcept;
+
+	/** Returned by `incompleteTailLength` when the backend can't tell where characters begin and end. */
+	static constexpr size_t kUnknownTailLength = SIZE_MAX;
+
+	/**
+	 * Looks for a character at the end of the given bytes that is cut off partway through.
+	 *
+	 * The default implementation knows about the Unicode encodings and encodings with one byte per character, and returns `kUnknownTailLength` for everything else.
+	 *
+	 * @returns How many of the trailing bytes belong to an incomplete character (or, in UTF-16, a high surrogate whose low surrogate may be yet to come), or `kUnknownTailLength`.
+	 */
+	virtual size_t incompleteTailLength(EncodingId encoding, const uint8_t *bytes, size_t length) const;
+
+	/**
+	 * Creates an incremental decoder or encoder for the given encoding.
+	 *
+	 * The default implementations work on top of `decode` and `encode`, and are correct for all encodings that have no shift state. Backends that support stateful encodings (like ISO-2022-JP) should override these.
+	 *
+	 * @param lossByte - See `encode`.
+	 */
+	virtual std::unique_ptr<IncrementalDecoder> newDecoder(EncodingId encoding) const;
+	virtual std::unique_ptr<IncrementalEncoder> newEncoder(EncodingId encoding, uint8_t lossByte) const;
+
+	/**
+	 * Checks that the encodings this backend converts with the portable backend's tables, instead of the platform's own converters, really do convert the same way with both, and returns those that don't.
+	 *
+	 * This is for the tests. It's slow. The default implementation returns nothing, for backends that don't mix the two.
+	 */
+	virtual std::vector<EncodingId> tableMismatches() const;
+
+	/**
+	 * The backend used by default on this platform.
+	 *
+	 * This is Core Foundation on macOS (unless built with `ICCF_PORTABLE_BACKEND`), and the portable backend everywhere else.
+	 */
+	static const Backend &Default();
+};
@@ -0,0 +1,463 @@
+#include "CFBackend.hh"
+#include "CFHandle.hh"
+#include "IconvCoders.hh"
+#include "PortableBackend.hh"
+#include "pool.hh"
+#include "unicode.hh"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <CoreFoundation/CFString.h>
+#include <CoreFoundation/CFStringEncodingExt.h>
+
+static std::string CFStringToUTF8(CFStringRef text) {
+	if (auto ptr = CFStringGetCStringPtr(text, kCFStringEncodingUTF8))
+		return ptr;
+
+	auto const maxSize = CFStringGetMaximumSizeForEncoding(CFStringGetLength(text), kCFStringEncodingUTF8) + 1;
+	std::string result(maxSize, '\0');
+
+	if (!CFStringGetCString(text, &result[0], maxSize, kCFStringEncodingUTF8))
+		return std::string();
+
+	result.resize(std::char_traits<char>::length(result.data()));
+	return result;
+}
+
+/** A `CFAllocator` that allocates from `Pool`, for the short-lived `CFString`s that conversions make. */
+static CFAllocatorRef pooledAllocator() {
+	static const CFAllocatorRef allocator = [] {
+		CFAllocatorContext context = {};
+
+		context.allocate = [] (CFIndex size, CFOptionFlags, void *) -> void * {
+			try {
+				return Pool::allocate(static_cast<size_t>(size));
+			}
+			catch (const std::bad_alloc &) {
+				return nullptr;
+			}
+		};
+
+		context.reallocate = [] (void *block, CFIndex size, CFOptionFlags, void *) -> void * {
+			try {
+				return Pool::reallocate(block, static_cast<size_t>(size));
+			}
+			catch (const std::bad_alloc &) {
+				return nullptr;
+			}
+		};
+
+		context.deallocate = [] (void *block, void *) {
+			Pool::deallocate(block);
+		};
+
+		// This is never released, since it's used until the process exits.
+		auto const allocator = CFAllocatorCreate(kCFAllocatorDefault, &context);
+		return allocator != nullptr ? allocator : kCFAllocatorDefault;
+	}();
+
+	return allocator;
+}
+
+/** Wraps the given UTF-16 text in a `CFString`, without copying it. The text must outlive the returned handle. */
+static CFStringHandle UTF16ToCFStringNoCopy(std::u16string_view text) {
+	return CFStringHandle(CFStringCreateWithCharactersNoCopy(
+		pooledAllocator(),
+		reinterpret_cast<const UniChar *>(text.data()),
+		text.size(),
+		kCFAllocatorNull
+	));
+}
+
+namespace {
+	/** Reads characters out of a `CFString` that doesn't have a contiguous UTF-16 buffer to borrow. */
+	class CFStringSource : public DecodedText::Source {
+		const std::shared_ptr<const void> _string;
+		const size_t _length;
+
+		public:
+		inline CFStringSource(std::shared_ptr<const void> string, size_t length) noexcept
+		: _string(std::move(string))
+		, _length(length)
+		{}
+
+		size_t size() const noexcept override {
+			return _length;
+		}
+
+		void read(size_t start, size_t length, char16_t *out) const noexcept override {
+			CFStringGetCharacters(
+				static_cast<CFStringRef>(_string.get()),
+				{ static_cast<CFIndex>(start), static_cast<CFIndex>(length) },
+				reinterpret_cast<UniChar *>(out)
+			);
+		}
+	};
+
+	/**
+	 * The iconv name of the given encoding, if it's one that has a shift state.
+	 *
+	 * Core Foundation can only convert whole strings, so it can't carry a shift state from one piece of a stream to the next. These encodings are converted incrementally with iconv instead.
+	 */
+	const char *statefulIconvName(EncodingId encoding) noexcept {
+		switch (encoding) {
+			case kCFStringEncodingISO_2022_JP: return "ISO-2022-JP";
+			case kCFStringEncodingISO_2022_JP_1: return "ISO-2022-JP-1";
+			case kCFStringEncodingISO_2022_JP_2: return "ISO-2022-JP-2";
+			case kCFStringEncodingISO_2022_JP_3: return "ISO-2022-JP-3";
+			case kCFStringEncodingISO_2022_CN: return "ISO-2022-CN";
+			case kCFStringEncodingISO_2022_CN_EXT: return "ISO-2022-CN-EXT";
+			case kCFStringEncodingISO_2022_KR: return "ISO-2022-KR";
+			case kCFStringEncodingUTF7: return "UTF-7";
+			case kCFStringEncodingUTF7_IMAP: return "UTF-7-IMAP";
+			case kCFStringEncodingHZ_GB_2312: return "HZ";
+			default: return nullptr;
+		}
+	}
+
+	/**
+	 * Whether `codec` converts exactly as Core Foundation does in `encoding`: every byte decodes to the same characters or is rejected by both, and every BMP character encodes to the same byte, or is unrepresentable in both and gets the same loss byte.
+	 *
+	 * This is slow, so it isn't done in normal use. It's how `CFBackend::tableMismatches` checks `kTableEncodings`.
+	 */
+	bool agreesWithCoreFoundation(EncodingId encoding, const Codec &codec) {
+		std::u16string cfChars;
+
+		for (unsigned b = 0; b < 256; b++) {
+			const uint8_t byte = static_cast<uint8_t>(b);
+			PooledU16String expected;
+			const bool valid = codec.decode(&byte, 1, expected);
+			auto const cfString = CFStringCreateWithBytes(kCFAllocatorDefault, &byte, 1, encoding, false);
+
+			if (cfString == nullptr) {
+				if (valid)
+					return false;
+				continue;
+			}
+
+			const CFStringHandle handle(cfString);
+			const CFIndex length = CFStringGetLength(cfString);
+
+			if (!valid || static_cast<size_t>(length) != expected.size())
+				return false;
+
+			cfChars.resize(expected.size());
+			CFStringGetCharacters(cfString, { 0, length }, reinterpret_cast<UniChar *>(&cfChars[0]));
+
+			if (std::u16string_view(cfChars) != std::u16string_view(expected.data(), expected.size()))
+				return false;
+		}
+
+		// Sort the BMP into characters that the codec can encode and those it can't, then convert each group with both in one go.
+		std::u16string mapped, unmapped;
+		std::string mappedBytes;
+
+		for (uint32_t c = 0; c <= 0xffff; c++) {
+			if (c >= 0xd800 && c <= 0xdfff)
+				continue;
+
+			const char16_t unit = static_cast<char16_t>(c);
+			uint8_t byte;
+
+			if (codec.encode({ &unit, 1 }, 0, &byte, 1).status == EncodeResult::Status::ok) {
+				mapped.push_back(unit);
+				mappedBytes.push_back(static_cast<char>(byte));
+			}
+			else
+				unmapped.push_back(unit);
+		}
+
+		// Surrogates, paired and not, get loss bytes too.
+		unmapped.append(u"\xd83d\xdc4d\xdc00\xd800");
+
+		auto const cfGetBytes = [encoding] (std::u16string_view text, uint8_t lossByte, std::string &out) {
+			// Twice the room, so that any extra bytes from Core Foundation show up as a difference.
+			out.assign(text.size() * 2, '\0');
+			CFIndex used = 0;
+			auto const converted = CFStringGetBytes(UTF16ToCFStringNoCopy(text), { 0, static_cast<CFIndex>(text.size()) }, encoding, lossByte, false, reinterpret_cast<UInt8 *>(&out[0]), static_cast<CFIndex>(out.size()), &used);
+			out.resize(static_cast<size_t>(used));
+			return static_cast<size_t>(converted) == text.size();
+		};
+
+		std::string cfBytes;
+
+		if (!cfGetBytes(mapped, 0, cfBytes) || cfBytes != mappedBytes)
+			return false;
+
+		// Two different loss bytes, so that a character Core Foundation really maps to the loss byte can't pass for an unrepresentable one.
+		for (const uint8_t lossByte : std::initializer_list<uint8_t> { '?', 0x1a }) {
+			std::string expected(unmapped.size(), '\0');
+			auto const result = codec.encode(unmapped, lossByte, reinterpret_cast<uint8_t *>(&expected[0]), expected.size());
+			expected.resize(result.written);
+
+			if (!cfGetBytes(unmapped, lossByte, cfBytes) || cfBytes != expected)
+				return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * The single-byte encodings that are converted with the portable backend's tables instead of Core Foundation, because the two are known to convert them exactly the same way.
+	 *
+	 * The portable tables are generated from Python's codecs, and vendor mappings are known to differ between the two in places, so an encoding only goes in this list once the tests have shown, on macOS, that `agreesWithCoreFoundation` holds for it.
+	 */
+	constexpr EncodingId kTableEncodings[] = {
+		kCFStringEncodingISOLatin1
+	};
+
+	/**
+	 * The table-driven codec for the given encoding, if it's one of `kTableEncodings`.
+	 *
+	 * Converting with a table is much faster than making a `CFString`, so these encodings don't go through Core Foundation at all.
+	 */
+	const Codec *singleByteCodec(EncodingId encoding) noexcept {
+		if (std::find(std::begin(kTableEncodings), std::end(kTableEncodings), encoding) == std::end(kTableEncodings))
+			return nullptr;
+
+		auto const entry = PortableBackend::info(encoding);
+		return entry != nullptr ? &entry->codec : nullptr;
+	}
+}
+
+std::vector<EncodingId> CFBackend::tableMismatches() const {
+	std::vector<EncodingId> mismatches;
+
+	for (const EncodingId encoding : kTableEncodings) {
+		auto const codec = singleByteCodec(encoding);
+
+		if (codec == nullptr || !agreesWithCoreFoundation(encoding, *codec))
+			mismatches.push_back(encoding);
+	}
+
+	return mismatches;
+}
+
+bool CFBackend::isEncodingAvailable(EncodingId encoding) const {
+	return CFStringIsEncodingAvailable(encoding);
+}
+
+EncodingId CFBackend::systemEncoding() const {
+	return CFStringGetSystemEncoding();
+}
+
+std::vector<EncodingId> CFBackend::availableEncodings() const {
+	std::vector<EncodingId> encodings;
+
+	for (auto encoding = CFStringGetListOfAvailableEncodings(); *encoding != kCFStringEncodingInvalidId; encoding++)
+		encodings.push_back(*encoding);
+
+	return encodings;
+}
+
+EncodingId CFBackend::encodingForIANACharSetName(std::string_view name) const {
+	auto cfName = CFStringCreateWithBytes(
+		kCFAllocatorDefault,
+		reinterpret_cast<const UInt8 *>(name.data()),
+		name.size(),
+		kCFStringEncodingUTF8,
+		false
+	);
+
+	if (cfName == nullptr)
+		return kEncodingInvalidId;
+
+	return CFStringConvertIANACharSetNameToEncoding(CFStringHandle(cfName));
+}
+
+EncodingId CFBackend::encodingForWindowsCodepage(uint32_t codepage) const {
+	return CFStringConvertWindowsCodepageToEncoding(codepage);
+}
+
+EncodingId CFBackend::encodingForNSStringEncoding(uint32_t nsStringEncoding) const {
+	return CFStringConvertNSStringEncodingToEncoding(nsStringEncoding);
+}
+
+std::optional<std::string> CFBackend::ianaCharSetName(EncodingId encoding) const {
+	auto cfString = CFStringConvertEncodingToIANACharSetName(encoding);
+
+	if (cfString == nullptr)
+		return std::nullopt;
+	else
+		return CFStringToUTF8(cfString);
+}
+
+std::string CFBackend::name(EncodingId encoding) const {
+	return CFStringToUTF8(CFStringGetNameOfEncoding(encoding));
+}
+
+uint32_t CFBackend::windowsCodepage(EncodingId encoding) const {
+	return CFStringConvertEncodingToWindowsCodepage(encoding);
+}
+
+uint32_t CFBackend::nsStringEncoding(EncodingId encoding) const {
+	return CFStringConvertEncodingToNSStringEncoding(encoding);
+}
+
+bool CFBackend::isASCIICompatible(EncodingId encoding) const {
+	if (auto const codec = singleByteCodec(encoding))
+		return codec->isASCIICompatible();
+
+	// Core Foundation doesn't have a way to ask this, so here are the ones that are known to qualify. Some encodings that look like they should (like Mac OS Japanese and Shift JIS) actually map some ASCII bytes to other characters, such as the yen sign.
+	switch (encoding) {
+		case kCFStringEncodingMacRoman:
+		case kCFStringEncodingASCII:
+		case kCFStringEncodingUTF8:
+		case kCFStringEncodingKOI8_R:
+		case kCFStringEncodingKOI8_U:
+			return true;
+
+		default:
+			return
+				(encoding >= kCFStringEncodingISOLatin1 && encoding <= kCFStringEncodingISOLatin10) ||
+				(encoding >= kCFStringEncodingWindowsLatin1 && encoding <= kCFStringEncodingWindowsVietnamese);
+	}
+}
+
+bool CFBackend::usesPortableTables(EncodingId encoding) const {
+	return singleByteCodec(encoding) != nullptr;
+}
+
+RepresentableEncoding CFBackend::smallestEncoding(std::u16string_view text) const {
+	// Core Foundation's choice, so that encodeSmallest behaves on macOS as it always has. It only ever picks the system encoding or UTF-16, so this is not necessarily the first of `representableEncodings`.
+	const EncodingId encoding = CFStringGetSmallestEncoding(UTF16ToCFStringNoCopy(text));
+	auto const measured = encode(encoding, text, 0, nullptr, 0);
+
+	if (measured.status == EncodeResult::Status::ok)
+		return { encoding, measured.written };
+	else
+		return Backend::smallestEncoding(text);
+}
+
+std::optional<DecodedText> CFBackend::decode(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	if (auto const codec = singleByteCodec(encoding)) {
+		PooledU16String out;
+		if (!codec->decode(bytes, length, out))
+			return std::nullopt;
+		return DecodedText(std::move(out));
+	}
+
+	// There's no getting around it: we have to copy the bytes here. There is a CFStringCreateWithBytesNoCopy function, but this may result in the buffer's contents being overwritten, or the whole thing being garbage-collected before the CFString is freed (which would leave the CFString with a dangling pointer). Nor does N-API offer any way to detach a buffer and take ownership of the underlying memory (assuming the JavaScript program is even okay with that). Nor does CF offer any way (as far as I can tell) to transcode a string without making a supposedly-immutable CFString in the process.
+	auto cfString = CFStringCreateWithBytes(
+		pooledAllocator(),
+		bytes,
+		length,
+		encoding,
+		true
+	);
+
+	if (cfString == nullptr)
+		return std::nullopt;
+
+	std::shared_ptr<const void> owner(cfString, CFRelease);
+	auto const strLength = CFStringGetLength(cfString);
+
+	// Try to avoid copying, by borrowing the CFString's own storage.
+	if (auto chars = CFStringGetCharactersPtr(cfString))
+		return DecodedText(reinterpret_cast<const char16_t *>(chars), strLength, std::move(owner));
+
+	// Otherwise, leave the characters where they are, and let the caller copy them out in whatever size pieces it likes.
+	return DecodedText(std::make_shared<CFStringSource>(std::move(owner), strLength));
+}
+
+size_t CFBackend::validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	if (auto const codec = singleByteCodec(encoding))
+		return codec->validLength(bytes, length);
+
+	return Backend::validLength(encoding, bytes, length);
+}
+
+DecodedText CFBackend::decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements) const {
+	// Core Foundation has no way to replace invalid sequences, so use the portable codec wherever it agrees with Core Foundation about what's valid: the single-byte encodings whose tables have been checked, and the Unicode encoding forms. The portable tables for the multi-byte encodings don't always agree with Core Foundation's (see the README), so those are left to `Backend::decodeLossy`.
+	auto codec = singleByteCodec(encoding);
+
+	if (codec == nullptr && isUnicodeEncoding(encoding))
+		codec = &PortableBackend::info(encoding)->codec;
+
+	if (codec != nullptr) {
+		PooledU16String out;
+		const size_t replaced = codec->decodeLossy(bytes, length, replacement, out);
+
+		if (replacements != nullptr)
+			*replacements = replaced;
+
+		return DecodedText(std::move(out));
+	}
+
+	return Backend::decodeLossy(encoding, bytes, length, replacement, replacements);
+}
+
+EncodeResult CFBackend::encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	if (auto const codec = singleByteCodec(encoding))
+		return codec->encode(text, lossByte, out, capacity);
+
+	auto const cfText = UTF16ToCFStringNoCopy(text);
+	auto const strLength = static_cast<CFIndex>(text.size());
+	CFIndex bytesConverted;
+
+	auto const charsConverted = CFStringGetBytes(
+		cfText,
+		{ 0, strLength },
+		encoding,
+		lossByte,
+		true,
+		out,
+		out == nullptr ? std::numeric_limits<CFIndex>::max() : static_cast<CFIndex>(capacity),
+		&bytesConverted
+	);
+
+	EncodeResult result {
+		EncodeResult::Status::ok,
+		static_cast<size_t>(charsConverted),
+		static_cast<size_t>(bytesConverted)
+	};
+
+	if (charsConverted == strLength)
+		return result;
+
+	// CFStringGetBytes doesn't say why it stopped. If it can convert the next character when given unlimited room, then it must have stopped because the buffer was full. (Two code units is enough to cover a surrogate pair.)
+	auto const nextCharConverted = out == nullptr ? 0 : CFStringGetBytes(
+		cfText,
+		{ charsConverted, std::min<CFIndex>(2, strLength - charsConverted) },
+		encoding,
+		lossByte,
+		false,
+		nullptr,
+		std::numeric_limits<CFIndex>::max(),
+		nullptr
+	);
+
+	result.status = nextCharConverted > 0 ? EncodeResult::Status::outputFull : EncodeResult::Status::unrepresentable;
+	return result;
+}
+
+size_t CFBackend::maxEncodedLength(EncodingId encoding, size_t length) const {
+	if (singleByteCodec(encoding) != nullptr)
+		return length;
+
+	auto const max = CFStringGetMaximumSizeForEncoding(static_cast<CFIndex>(length), encoding);
+
+	if (max == kCFNotFound)
+		return SIZE_MAX;
+
+	// CFStringGetMaximumSizeForEncoding doesn't count the byte order mark that CFStringGetBytes adds to external representations.
+	return static_cast<size_t>(max) + 4;
+}
+
+std::unique_ptr<IncrementalDecoder> CFBackend::newDecoder(EncodingId encoding) const {
+	if (auto const iconvName = statefulIconvName(encoding)) {
+		if (auto decoder = IconvDecoder::open(iconvName))
+			return decoder;
+	}
+
+	return Backend::newDecoder(encoding);
+}
+
+std::unique_ptr<IncrementalEncoder> CFBackend::newEncoder(EncodingId encoding, uint8_t lossByte) const {
+	if (auto const iconvName = statefulIconvName(encoding)) {
+		if (auto encoder = IconvEncoder::open(iconvName, lossByte))
+			return encoder;
+	}
+
+	return Backend::newEncoder(encoding, lossByte);
+}
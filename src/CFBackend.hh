@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Backend.hh"
+
+/** `Backend` implemented with the Core Foundation framework. Only available on macOS. */
+class CFBackend : public Backend {
+	public:
+	bool isEncodingAvailable(EncodingId encoding) const override;
+	EncodingId systemEncoding() const override;
+	std::vector<EncodingId> availableEncodings() const override;
+	EncodingId encodingForIANACharSetName(std::string_view name) const override;
+	EncodingId encodingForWindowsCodepage(uint32_t codepage) const override;
+	EncodingId encodingForNSStringEncoding(uint32_t nsStringEncoding) const override;
+	std::optional<std::string> ianaCharSetName(EncodingId encoding) const override;
+	std::string name(EncodingId encoding) const override;
+	uint32_t windowsCodepage(EncodingId encoding) const override;
+	uint32_t nsStringEncoding(EncodingId encoding) const override;
+	bool isASCIICompatible(EncodingId encoding) const override;
+	bool usesPortableTables(EncodingId encoding) const override;
+	RepresentableEncoding smallestEncoding(std::u16string_view text) const override;
+	std::optional<DecodedText> decode(EncodingId encoding, const uint8_t *bytes, size_t length) const override;
+	size_t validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const override;
+	DecodedText decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements = nullptr) const override;
+	EncodeResult encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t maxEncodedLength(EncodingId encoding, size_t length) const override;
+	std::unique_ptr<IncrementalDecoder> newDecoder(EncodingId encoding) const override;
+	std::unique_ptr<IncrementalEncoder> newEncoder(EncodingId encoding, uint8_t lossByte) const override;
+	std::vector<EncodingId> tableMismatches() const override;
+};
@@ -0,0 +1,167 @@
+#include "ChunkedCoders.hh"
+#include <algorithm>
+
+namespace {
+	inline bool isNativeLittleEndian() noexcept {
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+	}
+
+	inline bool startsWith(const uint8_t *bytes, size_t length, std::initializer_list<uint8_t> prefix) noexcept {
+		return length >= prefix.size() && std::equal(prefix.begin(), prefix.end(), bytes);
+	}
+
+	/** Whether `pending` followed by `bytes`, which together are shorter than a UTF-8 byte order mark, could be the beginning of one. */
+	inline bool mayStartUTF8BOM(const std::vector<uint8_t> &pending, const uint8_t *bytes, size_t length) noexcept {
+		static constexpr uint8_t bom[] = { 0xef, 0xbb, 0xbf };
+		return std::equal(pending.begin(), pending.end(), bom) && std::equal(bytes, bytes + length, bom + pending.size());
+	}
+}
+
+bool ChunkedDecoder::write(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) {
+	if (_started)
+		return decode(bytes, length, end, out);
+
+	// Wait until there are enough bytes to recognize a byte order mark. In UTF-8, a character can be shorter than that, so only wait if the bytes so far could be one.
+	const size_t bomLength =
+		_encoding == kEncodingUTF8 ? 3
+		: _encoding == kEncodingUTF16 ? 2
+		: _encoding == kEncodingUTF32 ? 4
+		: 0;
+
+	if (_pending.size() + length < bomLength && !end && (_encoding != kEncodingUTF8 || mayStartUTF8BOM(_pending, bytes, length))) {
+		_pending.insert(_pending.end(), bytes, bytes + length);
+		return true;
+	}
+
+	_started = true;
+
+	if (_pending.empty()) {
+		const size_t skip = start(bytes, length);
+		return decode(bytes + skip, length - skip, end, out);
+	}
+	else {
+		// This only happens if the first piece was tiny, so copying it isn't a big deal.
+		std::vector<uint8_t> head;
+		head.swap(_pending);
+		head.insert(head.end(), bytes, bytes + length);
+
+		const size_t skip = start(head.data(), head.size());
+		return decode(head.data() + skip, head.size() - skip, end, out);
+	}
+}
+
+/** Looks for a byte order mark, and returns its length. */
+size_t ChunkedDecoder::start(const uint8_t *bytes, size_t length) {
+	size_t bomLength;
+	_encoding = Backend::skipByteOrderMark(_encoding, bytes, length, bomLength);
+	return bomLength;
+}
+
+bool ChunkedDecoder::decode(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) {
+	// First, finish the character left incomplete at the end of the previous piece, one byte at a time.
+	while (!_pending.empty() && length != 0) {
+		std::vector<uint8_t> pending;
+		pending.swap(_pending);
+		pending.push_back(*bytes);
+		bytes++;
+		length--;
+
+		// If this completes the character, it's decoded and _pending stays empty. Otherwise, it goes back into _pending.
+		if (!decode(pending.data(), pending.size(), false, out) || _pending.size() > kMaxHeldBytes)
+			return false;
+	}
+
+	if (!_pending.empty()) {
+		if (!end)
+			return true;
+
+		// A high surrogate is held back in case its low surrogate is in the next piece. If there isn't one, it's still a whole code unit, and lone surrogates are decoded like any other, same as when the text is decoded all at once.
+		const bool utf16 = _encoding == kEncodingUTF16 || _encoding == kEncodingUTF16BE || _encoding == kEncodingUTF16LE;
+
+		if (utf16 && _pending.size() == 2) {
+			std::vector<uint8_t> pending;
+			pending.swap(_pending);
+			return append(pending.data(), pending.size(), out);
+		}
+
+		return false;
+	}
+
+	const size_t tailLength = end ? 0 : _backend.incompleteTailLength(_encoding, bytes, length);
+
+	if (tailLength != Backend::kUnknownTailLength) {
+		if (!append(bytes, length - tailLength, out))
+			return false;
+		_pending.assign(bytes + length - tailLength, bytes + length);
+		return true;
+	}
+
+	// The backend can't tell where characters end in this encoding, so find out by trial and error: hold back more and more bytes until the rest can be decoded.
+	for (size_t held = 0; held <= std::min(kMaxHeldBytes, length); held++) {
+		if (append(bytes, length - held, out)) {
+			_pending.assign(bytes + length - held, bytes + length);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/** Decodes some bytes that are known to consist of whole characters. */
+bool ChunkedDecoder::append(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	// Backends skip a UTF-8 byte order mark at the beginning of their input, but this isn't the beginning of the text any more, so it's really a U+FEFF character.
+	if (_encoding == kEncodingUTF8 && startsWith(bytes, length, { 0xef, 0xbb, 0xbf })) {
+		out.push_back(0xfeff);
+		bytes += 3;
+		length -= 3;
+	}
+
+	if (length == 0)
+		return true;
+
+	auto const decoded = _backend.decode(_encoding, bytes, length);
+
+	if (!decoded)
+		return false;
+
+	out.append(*decoded);
+	return true;
+}
+
+std::optional<EncodedBytes> ChunkedEncoder::write(std::u16string_view text, bool end) {
+	PooledU16String joined;
+
+	if (_heldSurrogate != 0) {
+		// This copies the text, but it only happens when a surrogate pair was split between two pieces.
+		joined.reserve(text.size() + 1);
+		joined.push_back(_heldSurrogate);
+		joined.append(text);
+		text = joined;
+		_heldSurrogate = 0;
+	}
+
+	if (!end && !text.empty() && text.back() >= 0xd800 && text.back() <= 0xdbff) {
+		_heldSurrogate = text.back();
+		text.remove_suffix(1);
+	}
+
+	auto const encoding = _started ? continuationEncoding(_encoding) : _encoding;
+	_started = true;
+
+	return _backend.encodeAll(encoding, text, _lossByte);
+}
+
+EncodingId ChunkedEncoder::continuationEncoding(EncodingId encoding) noexcept {
+	// Both backends write UTF-16 and UTF-32 in native byte order, after the byte order mark.
+	switch (encoding) {
+		case kEncodingUTF16:
+			return isNativeLittleEndian() ? kEncodingUTF16LE : kEncodingUTF16BE;
+
+		case kEncodingUTF32:
+			return isNativeLittleEndian() ? kEncodingUTF32LE : kEncodingUTF32BE;
+
+		default:
+			return encoding;
+	}
+}
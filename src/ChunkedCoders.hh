@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Backend.hh"
+#include <vector>
+
+/**
+ * The default `IncrementalDecoder`, which decodes each piece of text with `Backend::decode`.
+ *
+ * This takes care of byte order marks, which only count at the very beginning of the text, and holds back bytes at the end of each piece that don't make up a whole character. It doesn't know about shift states, so it's only correct for stateless encodings.
+ */
+class ChunkedDecoder : public IncrementalDecoder {
+	/** Longest character that will be held back when `Backend::incompleteTailLength` doesn't know where characters end. */
+	static constexpr size_t kMaxHeldBytes = 4;
+
+	const Backend &_backend;
+
+	/** The encoding being decoded. For UTF-16 and UTF-32, this becomes the explicitly big- or little-endian form once the byte order mark has been seen. */
+	EncodingId _encoding;
+
+	bool _started = false;
+
+	/** Bytes that have been received, but not decoded yet. */
+	std::vector<uint8_t> _pending;
+
+	size_t start(const uint8_t *bytes, size_t length);
+	bool decode(const uint8_t *bytes, size_t length, bool end, PooledU16String &out);
+	bool append(const uint8_t *bytes, size_t length, PooledU16String &out) const;
+
+	public:
+	inline ChunkedDecoder(const Backend &backend, EncodingId encoding) noexcept
+	: _backend(backend)
+	, _encoding(encoding)
+	{}
+
+	bool write(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) override;
+
+	inline size_t pendingLength() const noexcept override {
+		return _pending.size();
+	}
+};
+
+/**
+ * The default `IncrementalEncoder`, which encodes each piece of text with `Backend::encodeAll`.
+ *
+ * Only the first piece is encoded in the given encoding. Later pieces are encoded in `continuationEncoding`, so that a byte order mark isn't written again. Like `ChunkedDecoder`, this is only correct for stateless encodings.
+ */
+class ChunkedEncoder : public IncrementalEncoder {
+	const Backend &_backend;
+	const EncodingId _encoding;
+	const uint8_t _lossByte;
+	bool _started = false;
+	char16_t _heldSurrogate = 0;
+
+	public:
+	inline ChunkedEncoder(const Backend &backend, EncodingId encoding, uint8_t lossByte) noexcept
+	: _backend(backend)
+	, _encoding(encoding)
+	, _lossByte(lossByte)
+	{}
+
+	std::optional<EncodedBytes> write(std::u16string_view text, bool end) override;
+
+	/** The encoding to use for all but the first piece of text. This is the same as `encoding`, except for UTF-16 and UTF-32, whose byte order mark is written only at the beginning. */
+	static EncodingId continuationEncoding(EncodingId encoding) noexcept;
+};
@@ -0,0 +1,886 @@
+#include "Codec.hh"
+#include "MultiByteTables.hh"
+#include "ascii.hh"
+#include <algorithm>
+
+namespace {
+	constexpr bool isHighSurrogate(char16_t c) noexcept {
+		return c >= 0xd800 && c <= 0xdbff;
+	}
+
+	constexpr bool isLowSurrogate(char16_t c) noexcept {
+		return c >= 0xdc00 && c <= 0xdfff;
+	}
+
+	constexpr bool isSurrogate(uint32_t c) noexcept {
+		return c >= 0xd800 && c <= 0xdfff;
+	}
+
+	inline bool isNativeLittleEndian() noexcept {
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+	}
+
+	/** A Unicode scalar value (or lone surrogate) read from UTF-16 text, and how many code units it took up. */
+	struct CodePoint {
+		uint32_t value;
+		size_t units;
+
+		inline bool isLoneSurrogate() const noexcept {
+			return isSurrogate(value);
+		}
+	};
+
+	inline CodePoint readCodePoint(std::u16string_view text, size_t index) noexcept {
+		const char16_t c = text[index];
+
+		if (isHighSurrogate(c) && index + 1 < text.size() && isLowSurrogate(text[index + 1]))
+			return { 0x10000 + ((uint32_t(c) - 0xd800) << 10) + (uint32_t(text[index + 1]) - 0xdc00), 2 };
+		else
+			return { c, 1 };
+	}
+
+	inline void appendLatin1(PooledU16String &out, const uint8_t *bytes, size_t length) {
+		const size_t oldSize = out.size();
+		out.resize(oldSize + length);
+		latin1ToUTF16(bytes, length, &out[oldSize]);
+	}
+
+	inline void appendCodePoint(PooledU16String &out, uint32_t c) {
+		if (c < 0x10000)
+			out.push_back(static_cast<char16_t>(c));
+		else {
+			c -= 0x10000;
+			out.push_back(static_cast<char16_t>(0xd800 + (c >> 10)));
+			out.push_back(static_cast<char16_t>(0xdc00 + (c & 0x3ff)));
+		}
+	}
+
+	/** Keeps track of output for `Codec::encode`, including when only measuring. */
+	class ByteWriter {
+		uint8_t * const _out;
+		const size_t _capacity;
+
+		public:
+		size_t written = 0;
+
+		inline ByteWriter(uint8_t *out, size_t capacity) noexcept : _out(out), _capacity(capacity) {}
+
+		inline bool fits(size_t count) const noexcept {
+			return _out == nullptr || _capacity - written >= count;
+		}
+
+		inline size_t room() const noexcept {
+			return _out == nullptr ? SIZE_MAX : _capacity - written;
+		}
+
+		inline void put(uint8_t byte) noexcept {
+			if (_out != nullptr)
+				_out[written] = byte;
+			written++;
+		}
+
+		/** Writes code units that are all less than 0x100, one byte each. */
+		inline void putLatin1(const char16_t *text, size_t length) noexcept {
+			if (_out != nullptr)
+				utf16ToLatin1(text, length, _out + written);
+			written += length;
+		}
+
+		inline EncodeResult result(EncodeResult::Status status, size_t read) const noexcept {
+			return { status, read, written };
+		}
+	};
+
+	/**
+	 * Runs the loop common to all `Codec::encode` implementations.
+	 *
+	 * `size(c)` returns how many bytes the code point `c` takes up, or 0 if it can't be represented. `put(writer, c)` then writes it.
+	 *
+	 * If `asciiRuns` is true, runs of ASCII characters are copied in bulk instead, which is only correct for ASCII-compatible encodings.
+	 */
+	template <typename Size, typename Put>
+	inline EncodeResult encodeLoop(std::u16string_view text, uint8_t lossByte, ByteWriter &writer, bool asciiRuns, Size size, Put put) {
+		size_t i = 0;
+
+		while (i < text.size()) {
+			if (asciiRuns && text[i] < 0x80) {
+				const size_t run = asciiPrefixLength(text.data() + i, text.size() - i);
+				const size_t fitting = std::min(run, writer.room());
+
+				writer.putLatin1(text.data() + i, fitting);
+				i += fitting;
+
+				if (fitting < run)
+					return writer.result(EncodeResult::Status::outputFull, i);
+				continue;
+			}
+
+			const auto cp = readCodePoint(text, i);
+			const size_t n = size(cp);
+
+			if (n == 0) {
+				if (lossByte == 0)
+					return writer.result(EncodeResult::Status::unrepresentable, i);
+				else if (!writer.fits(1))
+					return writer.result(EncodeResult::Status::outputFull, i);
+				writer.put(lossByte);
+			}
+			else if (!writer.fits(n))
+				return writer.result(EncodeResult::Status::outputFull, i);
+			else
+				put(writer, cp.value);
+
+			i += cp.units;
+		}
+
+		return writer.result(EncodeResult::Status::ok, i);
+	}
+
+	/** Resolves `ByteOrder::external` when encoding, and writes the byte order mark if needed. Returns whether the output is little-endian. */
+	inline bool startExternal(ByteOrder byteOrder, ByteWriter &writer, size_t bomSize, bool &bomFits) noexcept {
+		bomFits = true;
+
+		if (byteOrder != ByteOrder::external)
+			return byteOrder == ByteOrder::littleEndian;
+
+		const bool le = isNativeLittleEndian();
+
+		if (!writer.fits(bomSize)) {
+			bomFits = false;
+			return le;
+		}
+
+		// U+FEFF, in the appropriate width and byte order.
+		for (size_t i = 0; i < bomSize; i++) {
+			const size_t significance = le ? i : bomSize - 1 - i;
+			writer.put(significance == 0 ? 0xff : significance == 1 ? 0xfe : 0);
+		}
+
+		return le;
+	}
+}
+
+namespace {
+	/** For `walkUTF8` and `walkMultiByte`: stop at the first invalid sequence. */
+	constexpr auto stopAtInvalid = [] (size_t) {
+		return false;
+	};
+
+	/**
+	 * Walks through UTF-8 text, calling `asciiRun(bytes, length)` for each run of ASCII characters and `character(c)` for each other character, until it reaches the end.
+	 *
+	 * At each sequence that is invalid or cut off, this calls `invalid(skip)`. If that returns true, the `skip` bytes of the sequence are skipped, and the walk goes on. These are the maximal subpart of the ill-formed sequence, as the Unicode standard recommends (and the WHATWG Encoding Standard requires) for counting replacement characters: the lead byte and as many bytes after it as could still have been part of a valid character.
+	 *
+	 * @returns Where the walk stopped: the beginning of an invalid sequence, or `length`.
+	 */
+	template <typename ASCIIRun, typename Character, typename Invalid>
+	inline size_t walkUTF8(const uint8_t *bytes, size_t length, size_t i, ASCIIRun asciiRun, Character character, Invalid invalid) {
+		while (i < length) {
+			const uint8_t b0 = bytes[i];
+
+			if (b0 < 0x80) {
+				const size_t run = asciiPrefixLength(bytes + i, length - i);
+				asciiRun(bytes + i, run);
+				i += run;
+				continue;
+			}
+
+			// The range of the byte after the lead byte is narrower for some lead bytes, which rules out overlong sequences, surrogates, and code points beyond U+10FFFF.
+			size_t n = 0;
+			uint32_t c = 0;
+			uint8_t lo = 0x80, hi = 0xbf;
+
+			if (b0 >= 0xc2 && b0 <= 0xdf) {
+				n = 2;
+				c = b0 & 0x1f;
+			}
+			else if (b0 >= 0xe0 && b0 <= 0xef) {
+				n = 3;
+				c = b0 & 0x0f;
+				if (b0 == 0xe0)
+					lo = 0xa0;
+				else if (b0 == 0xed)
+					hi = 0x9f;
+			}
+			else if (b0 >= 0xf0 && b0 <= 0xf4) {
+				n = 4;
+				c = b0 & 0x07;
+				if (b0 == 0xf0)
+					lo = 0x90;
+				else if (b0 == 0xf4)
+					hi = 0x8f;
+			}
+
+			size_t j = 1;
+
+			if (n != 0) {
+				for (; j < n && i + j < length; j++) {
+					const uint8_t b = bytes[i + j];
+					if (b < lo || b > hi)
+						break;
+					c = (c << 6) | (b & 0x3f);
+					lo = 0x80;
+					hi = 0xbf;
+				}
+			}
+
+			if (j == n) {
+				character(c);
+				i += n;
+			}
+			else if (invalid(j))
+				i += j;
+			else
+				return i;
+		}
+
+		return length;
+	}
+}
+
+bool UTF8Codec::decode(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	size_t i = 0;
+
+	// Skip the byte order mark, if any.
+	if (length >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf)
+		i = 3;
+
+	out.reserve(out.size() + length - i);
+
+	return walkUTF8(
+		bytes,
+		length,
+		i,
+		[&out] (const uint8_t *run, size_t runLength) {
+			appendLatin1(out, run, runLength);
+		},
+		[&out] (uint32_t c) {
+			appendCodePoint(out, c);
+		},
+		stopAtInvalid
+	) == length;
+}
+
+size_t UTF8Codec::decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const {
+	size_t i = 0, replaced = 0;
+
+	if (length >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf)
+		i = 3;
+
+	out.reserve(out.size() + length - i);
+
+	walkUTF8(
+		bytes,
+		length,
+		i,
+		[&out] (const uint8_t *run, size_t runLength) {
+			appendLatin1(out, run, runLength);
+		},
+		[&out] (uint32_t c) {
+			appendCodePoint(out, c);
+		},
+		[&out, &replaced, replacement] (size_t) {
+			appendCodePoint(out, replacement);
+			replaced++;
+			return true;
+		}
+	);
+
+	return replaced;
+}
+
+size_t UTF8Codec::validLength(const uint8_t *bytes, size_t length) const {
+	// A byte order mark is a valid character anyway, so there's no need to skip it.
+	return walkUTF8(bytes, length, 0, [] (const uint8_t *, size_t) {}, [] (uint32_t) {}, stopAtInvalid);
+}
+
+EncodeResult UTF8Codec::encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	ByteWriter writer(out, capacity);
+
+	return encodeLoop(
+		text,
+		lossByte,
+		writer,
+		true,
+		[] (const CodePoint &cp) -> size_t {
+			if (cp.isLoneSurrogate())
+				return 0;
+			else if (cp.value < 0x80)
+				return 1;
+			else if (cp.value < 0x800)
+				return 2;
+			else if (cp.value < 0x10000)
+				return 3;
+			else
+				return 4;
+		},
+		[] (ByteWriter &writer, uint32_t c) {
+			if (c < 0x80)
+				writer.put(c);
+			else if (c < 0x800) {
+				writer.put(0xc0 | (c >> 6));
+				writer.put(0x80 | (c & 0x3f));
+			}
+			else if (c < 0x10000) {
+				writer.put(0xe0 | (c >> 12));
+				writer.put(0x80 | ((c >> 6) & 0x3f));
+				writer.put(0x80 | (c & 0x3f));
+			}
+			else {
+				writer.put(0xf0 | (c >> 18));
+				writer.put(0x80 | ((c >> 12) & 0x3f));
+				writer.put(0x80 | ((c >> 6) & 0x3f));
+				writer.put(0x80 | (c & 0x3f));
+			}
+		}
+	);
+}
+
+bool UTF16Codec::decode(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	if (length % 2 != 0)
+		return false;
+
+	bool le = _byteOrder == ByteOrder::littleEndian;
+
+	if (_byteOrder == ByteOrder::external && length >= 2) {
+		if (bytes[0] == 0xfe && bytes[1] == 0xff) {
+			bytes += 2;
+			length -= 2;
+		}
+		else if (bytes[0] == 0xff && bytes[1] == 0xfe) {
+			le = true;
+			bytes += 2;
+			length -= 2;
+		}
+	}
+
+	out.reserve(out.size() + length / 2);
+
+	// Lone surrogates are allowed, as they are in JavaScript strings.
+	for (size_t i = 0; i < length; i += 2)
+		out.push_back(le ? bytes[i] | (bytes[i + 1] << 8) : (bytes[i] << 8) | bytes[i + 1]);
+
+	return true;
+}
+
+size_t UTF16Codec::decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const {
+	decode(bytes, length - length % 2, out);
+
+	if (length % 2 == 0)
+		return 0;
+
+	appendCodePoint(out, replacement);
+	return 1;
+}
+
+size_t UTF16Codec::validLength(const uint8_t *, size_t length) const {
+	// Any whole code units are valid, lone surrogates included. Only an odd byte at the end isn't.
+	return length - length % 2;
+}
+
+EncodeResult UTF16Codec::encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	ByteWriter writer(out, capacity);
+	bool bomFits;
+	const bool le = startExternal(_byteOrder, writer, 2, bomFits);
+
+	if (!bomFits)
+		return writer.result(EncodeResult::Status::outputFull, 0);
+
+	return encodeLoop(
+		text,
+		lossByte,
+		writer,
+		false,
+		[] (const CodePoint &cp) -> size_t {
+			return cp.units * 2;
+		},
+		[le] (ByteWriter &writer, uint32_t c) {
+			char16_t units[2];
+			size_t count = 1;
+
+			if (c < 0x10000)
+				units[0] = c;
+			else {
+				units[0] = 0xd800 + ((c - 0x10000) >> 10);
+				units[1] = 0xdc00 + ((c - 0x10000) & 0x3ff);
+				count = 2;
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				if (le) {
+					writer.put(units[i] & 0xff);
+					writer.put(units[i] >> 8);
+				}
+				else {
+					writer.put(units[i] >> 8);
+					writer.put(units[i] & 0xff);
+				}
+			}
+		}
+	);
+}
+
+bool UTF32Codec::decode(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	if (length % 4 != 0)
+		return false;
+
+	bool le = _byteOrder == ByteOrder::littleEndian;
+
+	if (_byteOrder == ByteOrder::external && length >= 4) {
+		if (bytes[0] == 0 && bytes[1] == 0 && bytes[2] == 0xfe && bytes[3] == 0xff) {
+			bytes += 4;
+			length -= 4;
+		}
+		else if (bytes[0] == 0xff && bytes[1] == 0xfe && bytes[2] == 0 && bytes[3] == 0) {
+			le = true;
+			bytes += 4;
+			length -= 4;
+		}
+	}
+
+	out.reserve(out.size() + length / 4);
+
+	for (size_t i = 0; i < length; i += 4) {
+		const uint32_t c = le
+			? uint32_t(bytes[i]) | (uint32_t(bytes[i + 1]) << 8) | (uint32_t(bytes[i + 2]) << 16) | (uint32_t(bytes[i + 3]) << 24)
+			: (uint32_t(bytes[i]) << 24) | (uint32_t(bytes[i + 1]) << 16) | (uint32_t(bytes[i + 2]) << 8) | uint32_t(bytes[i + 3]);
+
+		if (c > 0x10ffff || isSurrogate(c))
+			return false;
+
+		appendCodePoint(out, c);
+	}
+
+	return true;
+}
+
+size_t UTF32Codec::decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const {
+	bool le = _byteOrder == ByteOrder::littleEndian;
+	size_t i = 0, replaced = 0;
+
+	if (_byteOrder == ByteOrder::external && length >= 4) {
+		if (bytes[0] == 0 && bytes[1] == 0 && bytes[2] == 0xfe && bytes[3] == 0xff)
+			i = 4;
+		else if (bytes[0] == 0xff && bytes[1] == 0xfe && bytes[2] == 0 && bytes[3] == 0) {
+			le = true;
+			i = 4;
+		}
+	}
+
+	out.reserve(out.size() + (length - i) / 4 + 1);
+
+	for (; length - i >= 4; i += 4) {
+		const uint32_t c = le
+			? uint32_t(bytes[i]) | (uint32_t(bytes[i + 1]) << 8) | (uint32_t(bytes[i + 2]) << 16) | (uint32_t(bytes[i + 3]) << 24)
+			: (uint32_t(bytes[i]) << 24) | (uint32_t(bytes[i + 1]) << 16) | (uint32_t(bytes[i + 2]) << 8) | uint32_t(bytes[i + 3]);
+
+		if (c > 0x10ffff || isSurrogate(c)) {
+			appendCodePoint(out, replacement);
+			replaced++;
+		}
+		else
+			appendCodePoint(out, c);
+	}
+
+	// A code unit cut off at the end.
+	if (i < length) {
+		appendCodePoint(out, replacement);
+		replaced++;
+	}
+
+	return replaced;
+}
+
+size_t UTF32Codec::validLength(const uint8_t *bytes, size_t length) const {
+	bool le = _byteOrder == ByteOrder::littleEndian;
+	size_t i = 0;
+
+	if (_byteOrder == ByteOrder::external && length >= 4) {
+		if (bytes[0] == 0 && bytes[1] == 0 && bytes[2] == 0xfe && bytes[3] == 0xff)
+			i = 4;
+		else if (bytes[0] == 0xff && bytes[1] == 0xfe && bytes[2] == 0 && bytes[3] == 0) {
+			le = true;
+			i = 4;
+		}
+	}
+
+	for (; length - i >= 4; i += 4) {
+		const uint32_t c = le
+			? uint32_t(bytes[i]) | (uint32_t(bytes[i + 1]) << 8) | (uint32_t(bytes[i + 2]) << 16) | (uint32_t(bytes[i + 3]) << 24)
+			: (uint32_t(bytes[i]) << 24) | (uint32_t(bytes[i + 1]) << 16) | (uint32_t(bytes[i + 2]) << 8) | uint32_t(bytes[i + 3]);
+
+		if (c > 0x10ffff || isSurrogate(c))
+			return i;
+	}
+
+	return i;
+}
+
+EncodeResult UTF32Codec::encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	ByteWriter writer(out, capacity);
+	bool bomFits;
+	const bool le = startExternal(_byteOrder, writer, 4, bomFits);
+
+	if (!bomFits)
+		return writer.result(EncodeResult::Status::outputFull, 0);
+
+	return encodeLoop(
+		text,
+		lossByte,
+		writer,
+		false,
+		[] (const CodePoint &cp) -> size_t {
+			return cp.isLoneSurrogate() ? 0 : 4;
+		},
+		[le] (ByteWriter &writer, uint32_t c) {
+			for (int i = 0; i < 4; i++)
+				writer.put(c >> (le ? i * 8 : (3 - i) * 8));
+		}
+	);
+}
+
+bool SingleByteCodec::decode(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	// ASCII runs are widened in bulk. Everything else goes through the table a block at a time, ASCII or not, so that text with ASCII scattered through it (such as spaces between Cyrillic words) doesn't keep switching between the two.
+	constexpr size_t kBlock = 16;
+
+	const size_t start = out.size();
+	out.resize(start + length);
+	char16_t * const o = &out[start];
+
+	for (size_t i = 0; i < length;) {
+		if (_asciiCompatible && bytes[i] < 0x80) {
+			const size_t run = asciiPrefixLength(bytes + i, length - i);
+			latin1ToUTF16(bytes + i, run, o + i);
+			i += run;
+			continue;
+		}
+
+		const size_t n = std::min(kBlock, length - i);
+
+		if (!mapBytesToUTF16(bytes + i, n, _decode, o + i)) {
+			out.resize(start);
+			return false;
+		}
+
+		i += n;
+	}
+
+	return true;
+}
+
+size_t SingleByteCodec::decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const {
+	if (_complete) {
+		decode(bytes, length, out);
+		return 0;
+	}
+
+	// Like `decode`, but each block is mapped into a scratch buffer first, and if there's an unmapped byte in it, the block is done over one byte at a time.
+	constexpr size_t kBlock = 16;
+	char16_t block[kBlock];
+	size_t replaced = 0;
+
+	out.reserve(out.size() + length);
+
+	for (size_t i = 0; i < length;) {
+		if (_asciiCompatible && bytes[i] < 0x80) {
+			const size_t run = asciiPrefixLength(bytes + i, length - i);
+			appendLatin1(out, bytes + i, run);
+			i += run;
+			continue;
+		}
+
+		const size_t n = std::min(kBlock, length - i);
+
+		if (mapBytesToUTF16(bytes + i, n, _decode, block))
+			out.append(block, n);
+		else {
+			for (size_t j = 0; j < n; j++) {
+				const char16_t c = _decode[bytes[i + j]];
+
+				if (c != kUnmappedByte)
+					out.push_back(c);
+				else {
+					appendCodePoint(out, replacement);
+					replaced++;
+				}
+			}
+		}
+
+		i += n;
+	}
+
+	return replaced;
+}
+
+size_t SingleByteCodec::validLength(const uint8_t *bytes, size_t length) const {
+	if (_complete)
+		return length;
+
+	for (size_t i = 0; i < length;) {
+		if (_asciiCompatible && bytes[i] < 0x80) {
+			i += asciiPrefixLength(bytes + i, length - i);
+			continue;
+		}
+
+		if (_decode[bytes[i]] == kUnmappedByte)
+			return i;
+
+		i++;
+	}
+
+	return length;
+}
+
+EncodeResult SingleByteCodec::encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	ByteWriter writer(out, capacity);
+	size_t i = 0;
+
+	// This is `encodeLoop`, specialized so that each character is looked up only once, and unmappable characters are replaced in the same pass.
+	while (i < text.size()) {
+		const char16_t c = text[i];
+
+		if (_asciiCompatible && c < 0x80) {
+			const size_t run = asciiPrefixLength(text.data() + i, text.size() - i);
+			const size_t fitting = std::min(run, writer.room());
+
+			writer.putLatin1(text.data() + i, fitting);
+			i += fitting;
+
+			if (fitting < run)
+				return writer.result(EncodeResult::Status::outputFull, i);
+			continue;
+		}
+
+		const int b = lookup(c);
+
+		if (b < 0 && lossByte == 0)
+			return writer.result(EncodeResult::Status::unrepresentable, i);
+		else if (!writer.fits(1))
+			return writer.result(EncodeResult::Status::outputFull, i);
+
+		if (b >= 0) {
+			writer.put(b);
+			i++;
+			continue;
+		}
+
+		// A surrogate pair is one character, so it gets one loss byte.
+		writer.put(lossByte);
+		i += readCodePoint(text, i).units;
+	}
+
+	return writer.result(EncodeResult::Status::ok, i);
+}
+
+namespace {
+	constexpr uint32_t kNoCodePoint = UINT32_MAX;
+
+	/** Decodes a GB 18030 four-byte sequence, or returns `kNoCodePoint` if it isn't valid. */
+	uint32_t decodeGB18030FourByte(const MultiByteTables &tables, const uint8_t *b) noexcept {
+		if (b[0] < 0x81 || b[0] > 0xfe || b[1] < 0x30 || b[1] > 0x39 || b[2] < 0x81 || b[2] > 0xfe || b[3] < 0x30 || b[3] > 0x39)
+			return kNoCodePoint;
+
+		const uint32_t linear = (((b[0] - 0x81) * 10 + (b[1] - 0x30)) * 126 + (b[2] - 0x81)) * 10 + (b[3] - 0x30);
+		const auto ranges = tables.ranges, end = ranges + tables.rangeCount - 1;
+
+		if (linear < end->linear) {
+			const auto range = std::upper_bound(ranges, end, linear, [] (uint32_t linear, const MultiByteTables::Range &range) {
+				return linear < range.linear;
+			});
+			return range == ranges ? kNoCodePoint : range[-1].codePoint + (linear - range[-1].linear);
+		}
+		else if (linear >= MultiByteTables::kGB18030SupplementaryStart && linear - MultiByteTables::kGB18030SupplementaryStart < 0x100000)
+			return 0x10000 + (linear - MultiByteTables::kGB18030SupplementaryStart);
+		else
+			return kNoCodePoint;
+	}
+
+	/** A character encoded by `MultiByteCodec`: up to four bytes, first byte highest. A length of 0 means it's unmappable. */
+	struct MultiByteSequence {
+		uint32_t bytes;
+		uint8_t length;
+	};
+
+	inline MultiByteSequence gb18030FourByte(uint32_t linear) noexcept {
+		uint32_t bytes = 0x30 + linear % 10;
+		linear /= 10;
+		bytes |= (0x81 + linear % 126) << 8;
+		linear /= 126;
+		bytes |= (0x30 + linear % 10) << 16;
+		linear /= 10;
+		bytes |= (0x81 + linear) << 24;
+		return { bytes, 4 };
+	}
+
+	/**
+	 * Like `walkUTF8`, but for a `MultiByteCodec`'s encoding.
+	 *
+	 * Invalid sequences are skipped the way the WHATWG Encoding Standard does: the lead byte and any bytes after it that didn't make the sequence invalid, plus the one that did, unless that one is ASCII (in which case it's more likely the beginning of the next character than part of a broken one). A sequence cut off at the end is skipped in its entirety.
+	 */
+	template <typename ASCIIRun, typename Character, typename Invalid>
+	inline size_t walkMultiByte(const MultiByteTables &tables, const uint8_t *bytes, size_t length, ASCIIRun asciiRun, Character character, Invalid invalid) {
+		for (size_t i = 0; i < length;) {
+			if (bytes[i] < 0x80) {
+				const size_t run = asciiPrefixLength(bytes + i, length - i);
+				asciiRun(bytes + i, run);
+				i += run;
+				continue;
+			}
+
+			// Walk the trie until it reaches a character, or finds the sequence invalid or cut off.
+			uint16_t e = tables.nodes[0][bytes[i]];
+			size_t next = i + 1;
+
+			while (e >= MultiByteTables::kChildNode && e < MultiByteTables::kChildNodeEnd && next < length)
+				e = tables.nodes[e - MultiByteTables::kChildNode][bytes[next++]];
+
+			uint32_t c = e;
+			size_t skip = 0;
+
+			if (e >= MultiByteTables::kChildNode && e < MultiByteTables::kChildNodeEnd) {
+				c = kNoCodePoint;
+				skip = length - i;
+			}
+			else if (e == MultiByteTables::kFourByteSequence) {
+				if (length - i >= 4) {
+					c = decodeGB18030FourByte(tables, bytes + i);
+					skip = bytes[i + 2] >= 0x81 && bytes[i + 2] <= 0xfe && bytes[i + 3] >= 0x30 && bytes[i + 3] <= 0x39 ? 4 : 1;
+				}
+				else {
+					c = kNoCodePoint;
+					skip = length - i;
+				}
+				next = i + 4;
+			}
+			else if (e == MultiByteTables::kInvalidSequence) {
+				c = kNoCodePoint;
+				skip = next - i == 1 || bytes[next - 1] >= 0x80 ? next - i : next - i - 1;
+			}
+
+			if (c != kNoCodePoint) {
+				character(c);
+				i = next;
+			}
+			else if (invalid(skip))
+				i += skip;
+			else
+				return i;
+		}
+
+		return length;
+	}
+
+	MultiByteSequence lookupMultiByte(const MultiByteTables &tables, uint32_t c) noexcept {
+		if (c >= 0x10000)
+			return tables.gb18030 ? gb18030FourByte(MultiByteTables::kGB18030SupplementaryStart + (c - 0x10000)) : MultiByteSequence { 0, 0 };
+
+		const uint32_t e = tables.pages[tables.index[c >> 8]][c & 0xff];
+
+		if (e != 0 || !tables.gb18030 || isSurrogate(c))
+			return { e & 0xffffff, static_cast<uint8_t>(e >> 24) };
+
+		// Every other character in the BMP has a four-byte sequence in GB 18030, found through the range it falls in.
+		const auto ranges = tables.ranges, end = ranges + tables.rangeCount - 1;
+		const auto range = std::upper_bound(ranges, end, c, [] (uint32_t c, const MultiByteTables::Range &range) {
+			return c < range.codePoint;
+		});
+
+		if (range == ranges || c - range[-1].codePoint >= range->linear - range[-1].linear)
+			return { 0, 0 };
+		else
+			return gb18030FourByte(range[-1].linear + (c - range[-1].codePoint));
+	}
+}
+
+bool MultiByteCodec::isAvailable() const {
+	return MultiByteTables::find(_encoding) != nullptr;
+}
+
+bool MultiByteCodec::decode(const uint8_t *bytes, size_t length, PooledU16String &out) const {
+	const auto tables = MultiByteTables::find(_encoding);
+	if (tables == nullptr)
+		return false;
+
+	const size_t start = out.size();
+	out.reserve(start + length);
+
+	const bool valid = walkMultiByte(
+		*tables,
+		bytes,
+		length,
+		[&out] (const uint8_t *run, size_t runLength) {
+			appendLatin1(out, run, runLength);
+		},
+		[&out] (uint32_t c) {
+			appendCodePoint(out, c);
+		},
+		stopAtInvalid
+	) == length;
+
+	if (!valid)
+		out.resize(start);
+
+	return valid;
+}
+
+size_t MultiByteCodec::decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const {
+	const auto tables = MultiByteTables::find(_encoding);
+	if (tables == nullptr)
+		return 0;
+
+	size_t replaced = 0;
+	out.reserve(out.size() + length);
+
+	walkMultiByte(
+		*tables,
+		bytes,
+		length,
+		[&out] (const uint8_t *run, size_t runLength) {
+			appendLatin1(out, run, runLength);
+		},
+		[&out] (uint32_t c) {
+			appendCodePoint(out, c);
+		},
+		[&out, &replaced, replacement] (size_t) {
+			appendCodePoint(out, replacement);
+			replaced++;
+			return true;
+		}
+	);
+
+	return replaced;
+}
+
+size_t MultiByteCodec::validLength(const uint8_t *bytes, size_t length) const {
+	const auto tables = MultiByteTables::find(_encoding);
+	if (tables == nullptr)
+		return 0;
+
+	return walkMultiByte(*tables, bytes, length, [] (const uint8_t *, size_t) {}, [] (uint32_t) {}, stopAtInvalid);
+}
+
+EncodeResult MultiByteCodec::encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	const auto tables = MultiByteTables::find(_encoding);
+	if (tables == nullptr)
+		return { EncodeResult::Status::unrepresentable, 0, 0 };
+
+	ByteWriter writer(out, capacity);
+	MultiByteSequence sequence;
+
+	// `size` looks the character up, and `put` writes what it found.
+	return encodeLoop(
+		text,
+		lossByte,
+		writer,
+		true,
+		[&] (const CodePoint &cp) -> size_t {
+			sequence = lookupMultiByte(*tables, cp.value);
+			return sequence.length;
+		},
+		[&] (ByteWriter &writer, uint32_t) {
+			for (size_t i = sequence.length; i-- > 0;)
+				writer.put(static_cast<uint8_t>(sequence.bytes >> (i * 8)));
+		}
+	);
+}
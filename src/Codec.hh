@@ -0,0 +1,269 @@
+#pragma once
+
+#include "Backend.hh"
+#include <string>
+#include <string_view>
+
+/**
+ * Converts between one particular encoding and UTF-16. These are the building blocks of `PortableBackend`.
+ *
+ * `encode` has the same contract as `Backend::encode`, and `validLength` the same as `Backend::validLength`. `decode` appends to `out`, and returns false if the bytes are not valid in this encoding. `decodeLossy` appends to `out` too, but puts `replacement` in place of each invalid sequence, and returns how many it replaced.
+ */
+class Codec {
+	public:
+	virtual ~Codec() {}
+	virtual bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const = 0;
+	virtual EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const = 0;
+	virtual size_t validLength(const uint8_t *bytes, size_t length) const = 0;
+	virtual size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const = 0;
+
+	/** See `Backend::maxEncodedLength`. */
+	virtual size_t maxEncodedLength(size_t length) const = 0;
+
+	/** See `Backend::isASCIICompatible`. */
+	virtual bool isASCIICompatible() const {
+		return false;
+	}
+
+	/** See `Backend::isEncodingResumable`. */
+	virtual bool isResumable() const {
+		return isASCIICompatible();
+	}
+
+	/** Whether this is a `SingleByteCodec`. */
+	virtual bool isSingleByte() const {
+		return false;
+	}
+
+	/** Whether this codec can be used at all. Only a `MultiByteCodec` can be unavailable, if its tables couldn't be loaded. */
+	virtual bool isAvailable() const {
+		return true;
+	}
+};
+
+/**
+ * Byte order of a multi-byte Unicode encoding form.
+ *
+ * `external` is the byte order of Core Foundation's unmarked `kCFStringEncodingUTF16` and `kCFStringEncodingUTF32`: decoding honors a byte order mark (and assumes big-endian if there isn't one), and encoding writes a byte order mark followed by text in native byte order.
+ */
+enum class ByteOrder {
+	bigEndian,
+	littleEndian,
+	external
+};
+
+class UTF8Codec : public Codec {
+	public:
+	bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const override;
+	EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t validLength(const uint8_t *bytes, size_t length) const override;
+	size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const override;
+
+	inline size_t maxEncodedLength(size_t length) const override {
+		// A surrogate pair is 4 bytes, so the most per code unit is 3, for characters in U+0800–U+FFFF.
+		return length * 3;
+	}
+
+	inline bool isASCIICompatible() const override {
+		return true;
+	}
+};
+
+class UTF16Codec : public Codec {
+	const ByteOrder _byteOrder;
+
+	public:
+	constexpr UTF16Codec(ByteOrder byteOrder) : _byteOrder(byteOrder) {}
+	bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const override;
+	EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t validLength(const uint8_t *bytes, size_t length) const override;
+	size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const override;
+
+	inline size_t maxEncodedLength(size_t length) const override {
+		return (length + (_byteOrder == ByteOrder::external ? 1 : 0)) * 2;
+	}
+};
+
+class UTF32Codec : public Codec {
+	const ByteOrder _byteOrder;
+
+	public:
+	constexpr UTF32Codec(ByteOrder byteOrder) : _byteOrder(byteOrder) {}
+	bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const override;
+	EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t validLength(const uint8_t *bytes, size_t length) const override;
+	size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const override;
+
+	inline size_t maxEncodedLength(size_t length) const override {
+		return (length + (_byteOrder == ByteOrder::external ? 1 : 0)) * 4;
+	}
+};
+
+/** Marks bytes that have no mapping in a single-byte decoding table. */
+static constexpr char16_t kUnmappedByte = 0xffff;
+
+/**
+ * Conversion tables for a single-byte encoding, built at compile time from its 256-entry decoding table by `makeSingleByteTables`.
+ *
+ * Encoding uses a two-level map. `index` has one entry for each block of 256 code units, naming the page of `pages` that maps the code units in that block to bytes. Blocks without any characters in the encoding all share page 0, which maps everything to byte 0. Every lookup is checked against `decode`, so unmapped code units don't need a marker of their own.
+ */
+template <size_t Pages>
+struct SingleByteTables {
+	/** The decoding table. There's one extra entry at the end, so that vector code can safely read a 32-bit word at any of the real entries. */
+	char16_t decode[257];
+
+	uint8_t index[256];
+	uint8_t pages[Pages][256];
+};
+
+/** How many pages `makeSingleByteTables` needs for the given decoding table. */
+constexpr size_t singleByteTablePages(const char16_t (&table)[256]) {
+	bool used[256] = {};
+	size_t pages = 1;
+
+	for (size_t b = 0; b < 256; b++) {
+		const char16_t c = table[b];
+		if (c != kUnmappedByte && !used[c >> 8]) {
+			used[c >> 8] = true;
+			pages++;
+		}
+	}
+
+	return pages;
+}
+
+template <size_t Pages>
+constexpr SingleByteTables<Pages> makeSingleByteTables(const char16_t (&table)[256]) {
+	SingleByteTables<Pages> tables {};
+	size_t nextPage = 1;
+
+	for (size_t b = 0; b < 256; b++)
+		tables.decode[b] = table[b];
+	tables.decode[256] = kUnmappedByte;
+
+	// Go backward, so that if several bytes decode to the same character, the first one is used to encode it.
+	for (size_t b = 256; b-- > 0;) {
+		const char16_t c = table[b];
+
+		if (c == kUnmappedByte)
+			continue;
+
+		if (tables.index[c >> 8] == 0)
+			tables.index[c >> 8] = static_cast<uint8_t>(nextPage++);
+
+		tables.pages[tables.index[c >> 8]][c & 0xff] = static_cast<uint8_t>(b);
+	}
+
+	return tables;
+}
+
+/** The conversion tables for the given decoding table. Each is only generated (and stored in the binary) once. */
+template <const char16_t (&Table)[256]>
+inline constexpr auto kSingleByteTables = makeSingleByteTables<singleByteTablePages(Table)>(Table);
+
+/**
+ * Codec for encodings where every character is one byte, driven by tables from `kSingleByteTables`.
+ *
+ * Bytes that have no mapping are marked in the decoding table with `kUnmappedByte`, and are rejected when decoding.
+ */
+class SingleByteCodec : public Codec {
+	const char16_t * const _decode;
+	const uint8_t * const _index;
+	const uint8_t (* const _pages)[256];
+	const bool _asciiCompatible;
+
+	/** Whether every byte has a mapping, so that any bytes at all are valid. */
+	const bool _complete;
+
+	static constexpr bool tableIsASCIICompatible(const char16_t *table) {
+		for (char16_t c = 0; c < 0x80; c++) {
+			if (table[c] != c)
+				return false;
+		}
+		return true;
+	}
+
+	static constexpr bool tableIsComplete(const char16_t *table) {
+		for (size_t b = 0; b < 256; b++) {
+			if (table[b] == kUnmappedByte)
+				return false;
+		}
+		return true;
+	}
+
+	public:
+	template <size_t Pages>
+	constexpr SingleByteCodec(const SingleByteTables<Pages> &tables)
+	: _decode(tables.decode)
+	, _index(tables.index)
+	, _pages(tables.pages)
+	, _asciiCompatible(tableIsASCIICompatible(tables.decode))
+	, _complete(tableIsComplete(tables.decode))
+	{}
+
+	bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const override;
+	EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t validLength(const uint8_t *bytes, size_t length) const override;
+	size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const override;
+
+	inline size_t maxEncodedLength(size_t length) const override {
+		return length;
+	}
+
+	inline bool isASCIICompatible() const override {
+		return _asciiCompatible;
+	}
+
+	inline bool isSingleByte() const override {
+		return true;
+	}
+
+	/** Returns the byte that encodes the code unit `c`, or -1 if there isn't one. */
+	inline int lookup(char16_t c) const noexcept {
+		const uint8_t b = _pages[_index[c >> 8]][c & 0xff];
+		return _decode[b] == c && c != kUnmappedByte ? b : -1;
+	}
+};
+
+/**
+ * Codec for the multi-byte encodings of China, Japan, and Korea, driven by tables from `MultiByteTables`.
+ *
+ * If the tables aren't available, this codec isn't either. Decoding then always fails, and encoding reports everything as unrepresentable.
+ */
+class MultiByteCodec : public Codec {
+	const EncodingId _encoding;
+	const uint8_t _maxBytesPerUnit;
+	const bool _asciiCompatible;
+
+	public:
+	/**
+	 * `maxBytesPerUnit` is the most bytes that one UTF-16 code unit can take up in this encoding.
+	 *
+	 * `asciiCompatible` is for `isASCIICompatible`. Only the EUC encodings qualify. In the others, the second byte of a two-byte character can be less than 0x80.
+	 */
+	constexpr MultiByteCodec(EncodingId encoding, uint8_t maxBytesPerUnit, bool asciiCompatible)
+	: _encoding(encoding)
+	, _maxBytesPerUnit(maxBytesPerUnit)
+	, _asciiCompatible(asciiCompatible)
+	{}
+
+	bool decode(const uint8_t *bytes, size_t length, PooledU16String &out) const override;
+	EncodeResult encode(std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t validLength(const uint8_t *bytes, size_t length) const override;
+	size_t decodeLossy(const uint8_t *bytes, size_t length, char32_t replacement, PooledU16String &out) const override;
+
+	inline size_t maxEncodedLength(size_t length) const override {
+		return length * _maxBytesPerUnit;
+	}
+
+	inline bool isASCIICompatible() const override {
+		return _asciiCompatible;
+	}
+
+	/** None of these encodings have a shift state, so encoding can stop and start again anywhere. */
+	inline bool isResumable() const override {
+		return true;
+	}
+
+	bool isAvailable() const override;
+};
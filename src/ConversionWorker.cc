@@ -0,0 +1,107 @@
+#include "ConversionWorker.hh"
+#include "iccf.hh"
+#include <new>
+
+// The constructors of Napi::AsyncWorker that don't take a callback aren't available in all versions of node-addon-api that we support. This one is passed instead, and never called, because OnOK and OnError are overridden.
+static Napi::Function unusedCallback(Napi::Env env) {
+	return Napi::Function::New(env, [] (const Napi::CallbackInfo &info) {});
+}
+
+ConversionWorker::ConversionWorker(Napi::Env env, const Iccf *iccf, Napi::Object kept, Work work, Finish finish)
+: Napi::AsyncWorker(unusedCallback(env), "iconv-corefoundation:conversion")
+, _iccf(iccf)
+, _deferred(Napi::Promise::Deferred::New(env))
+, _kept(Napi::Persistent(kept))
+, _cancelled(std::make_shared<std::atomic<bool>>(false))
+, _work(std::move(work))
+, _finish(std::move(finish))
+{}
+
+Napi::Promise ConversionWorker::Start(
+	Napi::Env env,
+	const Iccf *iccf,
+	Napi::Object kept,
+	Napi::Value signal,
+	Work work,
+	Finish finish
+) {
+	auto const worker = new ConversionWorker(env, iccf, kept, std::move(work), std::move(finish));
+	auto const promise = worker->_deferred.Promise();
+
+	if (signal.IsObject()) {
+		auto const _signal = signal.As<Napi::Object>();
+
+		if (_signal.Get("aborted").ToBoolean()) {
+			worker->_deferred.Reject(iccf->newAbortError(env).Value());
+			delete worker;
+			return promise;
+		}
+
+		// The listener only holds on to the cancellation flag, not the worker, because the worker may be gone by the time the signal fires.
+		auto const listener = Napi::Function::New(env, [cancelled = worker->_cancelled] (const Napi::CallbackInfo &info) {
+			*cancelled = true;
+		}, "onAbort");
+
+		_signal.Get("addEventListener").As<Napi::Function>().Call(_signal, { Napi::String::New(env, "abort"), listener });
+		worker->_signal = Napi::Persistent(_signal);
+		worker->_abortListener = Napi::Persistent(listener);
+	}
+
+	worker->Queue();
+	return promise;
+}
+
+Napi::Value ConversionWorker::AbortSignalFromOptions(Napi::Value options) {
+	if (options.IsObject())
+		return options.As<Napi::Object>().Get("signal");
+	else
+		return options.Env().Undefined();
+}
+
+void ConversionWorker::Execute() {
+	if (*_cancelled)
+		return;
+
+	try {
+		_work(*_cancelled);
+	}
+	catch (const std::bad_alloc &) {
+		SetError("Out of memory.");
+	}
+}
+
+void ConversionWorker::OnOK() {
+	const auto env = Env();
+	Napi::HandleScope scope(env);
+
+	unlisten();
+
+	if (*_cancelled) {
+		_deferred.Reject(_iccf->newAbortError(env).Value());
+		return;
+	}
+
+	// Errors thrown from here would otherwise become uncaught exceptions, instead of rejecting the promise.
+	try {
+		_deferred.Resolve(_finish(env, _kept.Value()));
+	}
+	catch (const Napi::Error &error) {
+		_deferred.Reject(error.Value());
+	}
+}
+
+void ConversionWorker::OnError(const Napi::Error &error) {
+	Napi::HandleScope scope(Env());
+	unlisten();
+	_deferred.Reject(error.Value());
+}
+
+void ConversionWorker::unlisten() {
+	if (_signal.IsEmpty())
+		return;
+
+	auto const signal = _signal.Value();
+	signal.Get("removeEventListener").As<Napi::Function>().Call(signal, { Napi::String::New(Env(), "abort"), _abortListener.Value() });
+	_signal.Reset();
+	_abortListener.Reset();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "napi.hh"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+struct Iccf;
+
+/**
+ * Runs a conversion on the libuv thread pool, and settles a `Promise` with the result.
+ *
+ * The conversion is split into two parts. `Work` runs on a worker thread, so it must not touch any JavaScript values; everything it needs must be copied out of the JavaScript heap beforehand. `Finish` then runs on the main thread, and either returns the result as a JavaScript value or throws a `Napi::Error` to reject the promise with.
+ *
+ * JavaScript values that `Finish` needs (such as the original input, for error messages) can't be kept as plain `Napi::Value`s, because those are only valid until the calling function returns. Instead, put them in the `kept` object, which is passed back to `Finish`. This also keeps them from being garbage collected in the meantime.
+ *
+ * If an `AbortSignal` is given, aborting it makes the promise reject with an `AbortError`. If the conversion hasn't started yet, it's skipped entirely. If it has, `Work` can check the `cancelled` flag and stop early.
+ */
+class ConversionWorker : public Napi::AsyncWorker {
+	public:
+	typedef std::function<void(const std::atomic<bool> &cancelled)> Work;
+	typedef std::function<Napi::Value(Napi::Env env, Napi::Object kept)> Finish;
+
+	/**
+	 * Starts a conversion.
+	 *
+	 * @param signal - An `AbortSignal` (or any object with an `aborted` property and `addEventListener`/`removeEventListener` methods), or `undefined`.
+	 * @returns The promise for the result of `finish`.
+	 */
+	static Napi::Promise Start(
+		Napi::Env env,
+		const Iccf *iccf,
+		Napi::Object kept,
+		Napi::Value signal,
+		Work work,
+		Finish finish
+	);
+
+	/** Gets the `signal` property of the given options object, or `undefined` if there isn't one. */
+	static Napi::Value AbortSignalFromOptions(Napi::Value options);
+
+	protected:
+	void Execute() override;
+	void OnOK() override;
+	void OnError(const Napi::Error &error) override;
+
+	private:
+	const Iccf * const _iccf;
+	const Napi::Promise::Deferred _deferred;
+	const Napi::ObjectReference _kept;
+	const std::shared_ptr<std::atomic<bool>> _cancelled;
+	const Work _work;
+	const Finish _finish;
+	Napi::ObjectReference _signal;
+	Napi::FunctionReference _abortListener;
+
+	ConversionWorker(Napi::Env env, const Iccf *iccf, Napi::Object kept, Work work, Finish finish);
+
+	/** Stops listening to the `AbortSignal`, if any, so that it doesn't keep this worker's listener alive. */
+	void unlisten();
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Backend.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+/** A `std::malloc`ed output buffer, which can grow and then be handed off as `EncodedBytes`. */
+class GrowableBuffer {
+	uint8_t *_data = nullptr;
+	size_t _capacity = 0;
+
+	public:
+	inline GrowableBuffer(size_t capacity) {
+		resize(capacity);
+	}
+
+	inline ~GrowableBuffer() {
+		std::free(_data);
+	}
+
+	GrowableBuffer(const GrowableBuffer &) = delete;
+	GrowableBuffer &operator=(const GrowableBuffer &) = delete;
+
+	inline uint8_t *data() const noexcept {
+		return _data;
+	}
+
+	inline size_t capacity() const noexcept {
+		return _capacity;
+	}
+
+	/** Changes the capacity, keeping the existing contents. */
+	void resize(size_t capacity) {
+		// realloc(p, 0) may or may not free p, so always ask for at least one byte.
+		auto const data = static_cast<uint8_t *>(std::realloc(_data, std::max<size_t>(capacity, 1)));
+
+		if (data == nullptr)
+			throw std::bad_alloc();
+
+		_data = data;
+		_capacity = capacity;
+	}
+
+	/** Trims the buffer to `length` bytes, and gives up ownership of it. */
+	EncodedBytes finish(size_t length) noexcept {
+		if (length != 0 && length < _capacity) {
+			// If the system can't shrink the allocation, then just keep the bigger one.
+			auto const data = static_cast<uint8_t *>(std::realloc(_data, length));
+			if (data != nullptr)
+				_data = data;
+		}
+
+		EncodedBytes result(_data, length);
+		_data = nullptr;
+		_capacity = 0;
+		return result;
+	}
+};
@@ -0,0 +1,146 @@
+#include "IconvCoders.hh"
+#include "GrowableBuffer.hh"
+#include <cerrno>
+
+const char *IconvHandle::nativeUTF16() noexcept {
+	const uint16_t probe = 1;
+	return *reinterpret_cast<const uint8_t *>(&probe) == 1 ? "UTF-16LE" : "UTF-16BE";
+}
+
+std::unique_ptr<IncrementalDecoder> IconvDecoder::open(const char *charset) {
+	auto const cd = iconv_open(nativeUTF16(), charset);
+
+	if (cd == reinterpret_cast<iconv_t>(-1))
+		return nullptr;
+
+	return std::unique_ptr<IncrementalDecoder>(new IconvDecoder(cd));
+}
+
+bool IconvDecoder::write(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) {
+	// There's nothing to do, and calling iconv without input would reset the shift state.
+	if (length == 0 && !end)
+		return true;
+
+	std::vector<uint8_t> joined;
+
+	if (!_pending.empty()) {
+		joined.swap(_pending);
+		joined.insert(joined.end(), bytes, bytes + length);
+		bytes = joined.data();
+		length = joined.size();
+	}
+
+	auto in = reinterpret_cast<char *>(const_cast<uint8_t *>(bytes));
+	size_t inLeft = length;
+
+	// Most encodings that need this are multi-byte, so there are usually fewer characters than bytes.
+	size_t written = out.size();
+	out.resize(written + length + 4);
+
+	// Once all of the input is converted, the last piece is followed by a call without input, which flushes the shift state.
+	bool flushed = false;
+
+	while (inLeft != 0 || (end && !flushed)) {
+		auto outPtr = reinterpret_cast<char *>(&out[written]);
+		size_t outLeft = (out.size() - written) * sizeof(char16_t);
+
+		const bool flushing = inLeft == 0;
+		const size_t result = flushing
+			? iconv(cd(), nullptr, nullptr, &outPtr, &outLeft)
+			: iconv(cd(), &in, &inLeft, &outPtr, &outLeft);
+		const int error = errno;
+
+		written = out.size() - outLeft / sizeof(char16_t);
+
+		if (result != static_cast<size_t>(-1))
+			flushed = flushing;
+		else if (error == E2BIG)
+			out.resize(out.size() * 2);
+		else if (error == EINVAL && !end) {
+			// The input ends partway through a character.
+			_pending.assign(in, in + inLeft);
+			break;
+		}
+		else
+			return false;
+	}
+
+	out.resize(written);
+	return true;
+}
+
+std::unique_ptr<IncrementalEncoder> IconvEncoder::open(const char *charset, uint8_t lossByte) {
+	auto const cd = iconv_open(charset, nativeUTF16());
+
+	if (cd == reinterpret_cast<iconv_t>(-1))
+		return nullptr;
+
+	return std::unique_ptr<IncrementalEncoder>(new IconvEncoder(cd, lossByte));
+}
+
+std::optional<EncodedBytes> IconvEncoder::write(std::u16string_view text, bool end) {
+	PooledU16String joined;
+
+	if (_heldSurrogate != 0) {
+		joined.reserve(text.size() + 1);
+		joined.push_back(_heldSurrogate);
+		joined.append(text);
+		text = joined;
+		_heldSurrogate = 0;
+	}
+
+	if (!end && !text.empty() && text.back() >= 0xd800 && text.back() <= 0xdbff) {
+		_heldSurrogate = text.back();
+		text.remove_suffix(1);
+	}
+
+	auto in = reinterpret_cast<char *>(const_cast<char16_t *>(text.data()));
+	size_t inLeft = text.size() * sizeof(char16_t);
+
+	// Leave room for shift sequences, which can be several bytes long.
+	GrowableBuffer buf(text.size() * 2 + 16);
+	size_t written = 0;
+	bool flushed = !end;
+
+	while (inLeft != 0 || !flushed) {
+		auto outPtr = reinterpret_cast<char *>(buf.data() + written);
+		size_t outLeft = buf.capacity() - written;
+
+		// Once all of the text is converted, return to the initial shift state.
+		const bool flushing = inLeft == 0;
+		const size_t result = flushing
+			? iconv(cd(), nullptr, nullptr, &outPtr, &outLeft)
+			: iconv(cd(), &in, &inLeft, &outPtr, &outLeft);
+		const int error = errno;
+
+		written = buf.capacity() - outLeft;
+
+		if (result != static_cast<size_t>(-1)) {
+			if (flushing)
+				flushed = true;
+			continue;
+		}
+		else if (error == E2BIG)
+			buf.resize(buf.capacity() * 2);
+		else if ((error == EILSEQ || error == EINVAL) && _lossByte != 0) {
+			// Get back to the initial shift state, so that the loss byte means what it would in ASCII, then skip the unrepresentable character.
+			if (buf.capacity() - written < 16)
+				buf.resize(buf.capacity() * 2);
+
+			outPtr = reinterpret_cast<char *>(buf.data() + written);
+			outLeft = buf.capacity() - written - 1;
+			iconv(cd(), nullptr, nullptr, &outPtr, &outLeft);
+			written = buf.capacity() - outLeft - 1;
+			buf.data()[written++] = _lossByte;
+
+			const char16_t unit = *reinterpret_cast<const char16_t *>(in);
+			const size_t skip = unit >= 0xd800 && unit <= 0xdbff && inLeft >= 2 * sizeof(char16_t) ? 2 : 1;
+			in += skip * sizeof(char16_t);
+			inLeft -= skip * sizeof(char16_t);
+		}
+		else
+			return std::nullopt;
+	}
+
+	return buf.finish(written);
+}
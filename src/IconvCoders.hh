@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Backend.hh"
+#include <iconv.h>
+#include <vector>
+
+/**
+ * Owns an `iconv_t` conversion descriptor.
+ *
+ * These are used for incremental conversion of stateful encodings like ISO-2022-JP, whose shift state Core Foundation has no way to carry over from one piece of text to the next.
+ */
+class IconvHandle {
+	iconv_t _cd;
+
+	protected:
+	inline IconvHandle(iconv_t cd) noexcept : _cd(cd) {}
+
+	inline iconv_t cd() const noexcept {
+		return _cd;
+	}
+
+	public:
+	IconvHandle(const IconvHandle &) = delete;
+	IconvHandle &operator=(const IconvHandle &) = delete;
+
+	inline ~IconvHandle() {
+		iconv_close(_cd);
+	}
+
+	/** The name iconv uses for UTF-16 in native byte order, without a byte order mark. */
+	static const char *nativeUTF16() noexcept;
+};
+
+class IconvDecoder : public IncrementalDecoder, IconvHandle {
+	/** Bytes at the end of the previous piece that don't make up a whole character. */
+	std::vector<uint8_t> _pending;
+
+	inline IconvDecoder(iconv_t cd) noexcept : IconvHandle(cd) {}
+
+	public:
+	/** @returns The decoder, or null if iconv doesn't know the given character set. */
+	static std::unique_ptr<IncrementalDecoder> open(const char *charset);
+
+	bool write(const uint8_t *bytes, size_t length, bool end, PooledU16String &out) override;
+
+	inline size_t pendingLength() const noexcept override {
+		return _pending.size();
+	}
+};
+
+class IconvEncoder : public IncrementalEncoder, IconvHandle {
+	const uint8_t _lossByte;
+
+	/** A high surrogate at the end of the previous piece. */
+	char16_t _heldSurrogate = 0;
+
+	inline IconvEncoder(iconv_t cd, uint8_t lossByte) noexcept : IconvHandle(cd), _lossByte(lossByte) {}
+
+	public:
+	/** @returns The encoder, or null if iconv doesn't know the given character set. */
+	static std::unique_ptr<IncrementalEncoder> open(const char *charset, uint8_t lossByte);
+
+	std::optional<EncodedBytes> write(std::u16string_view text, bool end) override;
+};
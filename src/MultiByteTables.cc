@@ -0,0 +1,145 @@
+#include "MultiByteTables.hh"
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	constexpr char kMagic[8] = { 'I', 'C', 'C', 'F', 'M', 'B', '0', '1' };
+	constexpr uint32_t kFlagGB18030 = 1;
+	constexpr size_t kMaxSections = 16;
+
+	struct Section {
+		EncodingId encoding;
+		MultiByteTables tables;
+	};
+
+	std::mutex pathMutex;
+	std::string filePath;
+
+	std::once_flag loaded;
+	Section sections[kMaxSections];
+	size_t sectionCount = 0;
+
+	inline bool isNativeLittleEndian() noexcept {
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+	}
+
+	/** Whether `count` items of `size` bytes each, starting at `offset`, are all inside the file and suitably aligned. */
+	inline bool inBounds(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize) noexcept {
+		return offset % 4 == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+	}
+
+	/** Checks one directory entry, so that nothing read through its tables later can go out of bounds. */
+	bool loadSection(const uint8_t *file, size_t fileSize, const uint32_t *entry, Section &section) noexcept {
+		const uint32_t encoding = entry[0], flags = entry[1];
+		const uint32_t nodes = entry[2], nodeCount = entry[3];
+		const uint32_t index = entry[4];
+		const uint32_t pages = entry[5], pageCount = entry[6];
+		const uint32_t ranges = entry[7], rangeCount = entry[8];
+		const bool gb18030 = (flags & kFlagGB18030) != 0;
+
+		if (
+			nodeCount == 0 || nodeCount > MultiByteTables::kChildNodeEnd - MultiByteTables::kChildNode ||
+			pageCount == 0 ||
+			(gb18030 && rangeCount == 0) ||
+			!inBounds(nodes, nodeCount, 512, fileSize) ||
+			!inBounds(index, 1, 512, fileSize) ||
+			!inBounds(pages, pageCount, 1024, fileSize) ||
+			!inBounds(ranges, rangeCount, sizeof(MultiByteTables::Range), fileSize)
+		)
+			return false;
+
+		MultiByteTables &tables = section.tables;
+		tables.nodes = reinterpret_cast<const uint16_t (*)[256]>(file + nodes);
+		tables.index = reinterpret_cast<const uint16_t *>(file + index);
+		tables.pages = reinterpret_cast<const uint32_t (*)[256]>(file + pages);
+		tables.ranges = reinterpret_cast<const MultiByteTables::Range *>(file + ranges);
+		tables.rangeCount = rangeCount;
+		tables.gb18030 = gb18030;
+
+		// `MultiByteCodec` copies ASCII runs without looking them up.
+		for (uint16_t b = 0; b < 0x80; b++) {
+			if (tables.nodes[0][b] != b)
+				return false;
+		}
+
+		for (size_t n = 0; n < nodeCount; n++) {
+			for (const uint16_t e : tables.nodes[n]) {
+				if (e >= MultiByteTables::kChildNode && e < MultiByteTables::kChildNodeEnd && uint32_t(e - MultiByteTables::kChildNode) >= nodeCount)
+					return false;
+			}
+		}
+
+		for (size_t i = 0; i < 256; i++) {
+			if (tables.index[i] >= pageCount)
+				return false;
+		}
+
+		section.encoding = encoding;
+		return true;
+	}
+
+	void load() noexcept {
+		std::string path;
+		{
+			std::lock_guard<std::mutex> lock(pathMutex);
+			path = filePath;
+		}
+
+		// The file is little-endian, and every platform this library supports is too.
+		if (path.empty() || !isNativeLittleEndian())
+			return;
+
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		struct stat st;
+		void *mapping = MAP_FAILED;
+
+		if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(kMagic) + 4))
+			mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		close(fd);
+
+		if (mapping == MAP_FAILED)
+			return;
+
+		const auto file = static_cast<const uint8_t *>(mapping);
+		const size_t fileSize = static_cast<size_t>(st.st_size);
+		const uint32_t count = *reinterpret_cast<const uint32_t *>(file + sizeof(kMagic));
+
+		if (memcmp(file, kMagic, sizeof(kMagic)) == 0 && count <= kMaxSections && inBounds(sizeof(kMagic) + 4, count, 9 * 4, fileSize)) {
+			const auto directory = reinterpret_cast<const uint32_t *>(file + sizeof(kMagic) + 4);
+
+			for (size_t i = 0; i < count; i++) {
+				if (loadSection(file, fileSize, directory + i * 9, sections[sectionCount]))
+					sectionCount++;
+			}
+		}
+
+		// If any tables were loaded, the mapping is never undone, since they're needed for as long as the process runs. Otherwise, the file is no use.
+		if (sectionCount == 0)
+			munmap(mapping, fileSize);
+	}
+}
+
+const MultiByteTables *MultiByteTables::find(EncodingId encoding) noexcept {
+	std::call_once(loaded, load);
+
+	for (size_t i = 0; i < sectionCount; i++) {
+		if (sections[i].encoding == encoding)
+			return &sections[i].tables;
+	}
+
+	return nullptr;
+}
+
+void MultiByteTables::setFilePath(std::string path) {
+	std::lock_guard<std::mutex> lock(pathMutex);
+	filePath = std::move(path);
+}
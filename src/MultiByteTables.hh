@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Backend.hh"
+#include <string>
+
+/**
+ * Conversion tables for one multi-byte (Chinese, Japanese, or Korean) encoding, as memory-mapped from the table file made by `tools/generate-cjk-tables.py`. That script documents the layout.
+ *
+ * These tables are far too big to compile into the module the way the single-byte tables are, so they're kept in a file next to it, and only mapped into memory the first time one of these encodings is used.
+ */
+struct MultiByteTables {
+	/** Node entries that aren't characters. An entry from `kChildNode` up to `kChildNodeEnd` leads to another node. */
+	static constexpr uint16_t kChildNode = 0xd800, kChildNodeEnd = 0xe000, kFourByteSequence = 0xfffe, kInvalidSequence = 0xffff;
+
+	/** In GB 18030, where the four-byte sequences for supplementary characters start, counting the way `ranges` does. */
+	static constexpr uint32_t kGB18030SupplementaryStart = 189000;
+
+	/** One contiguous run of GB 18030 four-byte sequences for characters in the BMP. */
+	struct Range {
+		uint32_t linear;
+		uint32_t codePoint;
+	};
+
+	/** The decoding trie. Decoding starts with `nodes[0]`, indexed by the first byte. */
+	const uint16_t (*nodes)[256];
+
+	/** Encoding map: `pages[index[c >> 8]][c & 0xff]` is the encoded form of the code unit `c`, with its length in the top byte, or 0 if it's unmappable. */
+	const uint16_t *index;
+	const uint32_t (*pages)[256];
+
+	/** For GB 18030 only (otherwise empty), sorted, and ending with a marker that isn't a range itself. */
+	const Range *ranges;
+	size_t rangeCount;
+
+	bool gb18030;
+
+	/** Returns the tables for the given encoding, or null if the table file couldn't be loaded or doesn't have them. The first call loads the file. */
+	static const MultiByteTables *find(EncodingId encoding) noexcept;
+
+	/**
+	 * Sets the location of the table file. This only has an effect before the file is loaded.
+	 *
+	 * The Node.js module sets this when it starts up, to the `cjk-tables.bin` that's installed next to it. Native code that uses `PortableBackend` directly must set it too, or these encodings won't be available.
+	 */
+	static void setFilePath(std::string path);
+};
@@ -0,0 +1,460 @@
+#include "PortableBackend.hh"
+#include "sbcs-tables.hh"
+#include "name-index.hh"
+#include <iterator>
+
+namespace {
+	const UTF8Codec utf8;
+	const UTF16Codec utf16(ByteOrder::external), utf16BE(ByteOrder::bigEndian), utf16LE(ByteOrder::littleEndian);
+	const UTF32Codec utf32(ByteOrder::external), utf32BE(ByteOrder::bigEndian), utf32LE(ByteOrder::littleEndian);
+	const SingleByteCodec
+		ascii(kSingleByteTables<kASCIITable>),
+		macRoman(kSingleByteTables<kMacRomanTable>),
+		isoLatin1(kSingleByteTables<kISOLatin1Table>),
+		windowsLatin1(kSingleByteTables<kWindowsLatin1Table>),
+		windowsLatin2(kSingleByteTables<kWindowsLatin2Table>),
+		windowsCyrillic(kSingleByteTables<kWindowsCyrillicTable>),
+		windowsGreek(kSingleByteTables<kWindowsGreekTable>),
+		windowsLatin5(kSingleByteTables<kWindowsLatin5Table>),
+		windowsHebrew(kSingleByteTables<kWindowsHebrewTable>),
+		windowsArabic(kSingleByteTables<kWindowsArabicTable>),
+		windowsBalticRim(kSingleByteTables<kWindowsBalticRimTable>),
+		windowsVietnamese(kSingleByteTables<kWindowsVietnameseTable>),
+		isoLatin2(kSingleByteTables<kISOLatin2Table>),
+		isoLatin3(kSingleByteTables<kISOLatin3Table>),
+		isoLatin4(kSingleByteTables<kISOLatin4Table>),
+		isoLatinCyrillic(kSingleByteTables<kISOLatinCyrillicTable>),
+		isoLatinArabic(kSingleByteTables<kISOLatinArabicTable>),
+		isoLatinGreek(kSingleByteTables<kISOLatinGreekTable>),
+		isoLatinHebrew(kSingleByteTables<kISOLatinHebrewTable>),
+		isoLatin5(kSingleByteTables<kISOLatin5Table>),
+		isoLatin6(kSingleByteTables<kISOLatin6Table>),
+		isoLatinThai(kSingleByteTables<kISOLatinThaiTable>),
+		isoLatin7(kSingleByteTables<kISOLatin7Table>),
+		isoLatin8(kSingleByteTables<kISOLatin8Table>),
+		isoLatin9(kSingleByteTables<kISOLatin9Table>),
+		isoLatin10(kSingleByteTables<kISOLatin10Table>),
+		koi8R(kSingleByteTables<kKOI8RTable>),
+		koi8U(kSingleByteTables<kKOI8UTable>),
+		dosLatinUS(kSingleByteTables<kDOSLatinUSTable>),
+		dosGreek(kSingleByteTables<kDOSGreekTable>),
+		dosBalticRim(kSingleByteTables<kDOSBalticRimTable>),
+		dosLatin1(kSingleByteTables<kDOSLatin1Table>),
+		dosLatin2(kSingleByteTables<kDOSLatin2Table>),
+		dosCyrillic(kSingleByteTables<kDOSCyrillicTable>),
+		dosTurkish(kSingleByteTables<kDOSTurkishTable>),
+		dosPortuguese(kSingleByteTables<kDOSPortugueseTable>),
+		dosIcelandic(kSingleByteTables<kDOSIcelandicTable>),
+		dosHebrew(kSingleByteTables<kDOSHebrewTable>),
+		dosCanadianFrench(kSingleByteTables<kDOSCanadianFrenchTable>),
+		dosArabic(kSingleByteTables<kDOSArabicTable>),
+		dosNordic(kSingleByteTables<kDOSNordicTable>),
+		dosRussian(kSingleByteTables<kDOSRussianTable>),
+		dosGreek2(kSingleByteTables<kDOSGreek2Table>),
+		dosThai(kSingleByteTables<kDOSThaiTable>),
+		macCyrillic(kSingleByteTables<kMacCyrillicTable>),
+		macGreek(kSingleByteTables<kMacGreekTable>),
+		macCentralEurRoman(kSingleByteTables<kMacCentralEurRomanTable>),
+		macIcelandic(kSingleByteTables<kMacIcelandicTable>),
+		macTurkish(kSingleByteTables<kMacTurkishTable>),
+		macCroatian(kSingleByteTables<kMacCroatianTable>),
+		macRomanian(kSingleByteTables<kMacRomanianTable>);
+	const MultiByteCodec
+		shiftJIS(0x0A01, 2, false),
+		eucJP(0x0920, 3, true),
+		gbk(0x0631, 2, false),
+		gb18030(0x0632, 4, false),
+		big5(0x0A03, 2, false),
+		eucKR(0x0940, 2, true);
+
+	constexpr const char * const asciiNames[] = { "US-ASCII", "ascii", "us", "iso646-us", "iso-ir-6", "ansi_x3.4-1968", "ansi_x3.4-1986", "cp367", "ibm367", "csascii", nullptr };
+	constexpr const char * const macRomanNames[] = { "macintosh", "mac", "macroman", "x-mac-roman", "csmacintosh", nullptr };
+	constexpr const char * const isoLatin1Names[] = { "ISO-8859-1", "iso8859-1", "iso_8859-1", "iso_8859-1:1987", "iso-ir-100", "latin1", "l1", "cp819", "ibm819", "csisolatin1", nullptr };
+	constexpr const char * const windowsLatin1Names[] = { "windows-1252", "cp1252", "x-cp1252", nullptr };
+	constexpr const char * const windowsLatin2Names[] = { "windows-1250", "cp1250", "x-cp1250", nullptr };
+	constexpr const char * const windowsCyrillicNames[] = { "windows-1251", "cp1251", "x-cp1251", nullptr };
+	constexpr const char * const windowsGreekNames[] = { "windows-1253", "cp1253", "x-cp1253", nullptr };
+	constexpr const char * const windowsLatin5Names[] = { "windows-1254", "cp1254", "x-cp1254", nullptr };
+	constexpr const char * const windowsHebrewNames[] = { "windows-1255", "cp1255", "x-cp1255", nullptr };
+	constexpr const char * const windowsArabicNames[] = { "windows-1256", "cp1256", "x-cp1256", nullptr };
+	constexpr const char * const windowsBalticRimNames[] = { "windows-1257", "cp1257", "x-cp1257", nullptr };
+	constexpr const char * const windowsVietnameseNames[] = { "windows-1258", "cp1258", "x-cp1258", nullptr };
+	constexpr const char * const isoLatin2Names[] = { "ISO-8859-2", "iso8859-2", "iso_8859-2", "iso_8859-2:1987", "iso-ir-101", "latin2", "l2", "csisolatin2", nullptr };
+	constexpr const char * const isoLatin3Names[] = { "ISO-8859-3", "iso8859-3", "iso_8859-3", "iso_8859-3:1988", "iso-ir-109", "latin3", "l3", "csisolatin3", nullptr };
+	constexpr const char * const isoLatin4Names[] = { "ISO-8859-4", "iso8859-4", "iso_8859-4", "iso_8859-4:1988", "iso-ir-110", "latin4", "l4", "csisolatin4", nullptr };
+	constexpr const char * const isoLatinCyrillicNames[] = { "ISO-8859-5", "iso8859-5", "iso_8859-5", "iso_8859-5:1988", "iso-ir-144", "cyrillic", "csisolatincyrillic", nullptr };
+	constexpr const char * const isoLatinArabicNames[] = { "ISO-8859-6", "iso8859-6", "iso_8859-6", "iso_8859-6:1987", "iso-ir-127", "ecma-114", "asmo-708", "arabic", "csisolatinarabic", nullptr };
+	constexpr const char * const isoLatinGreekNames[] = { "ISO-8859-7", "iso8859-7", "iso_8859-7", "iso_8859-7:1987", "iso-ir-126", "elot_928", "ecma-118", "greek", "greek8", "csisolatingreek", nullptr };
+	constexpr const char * const isoLatinHebrewNames[] = { "ISO-8859-8", "iso8859-8", "iso_8859-8", "iso_8859-8:1988", "iso-ir-138", "hebrew", "csisolatinhebrew", nullptr };
+	constexpr const char * const isoLatin5Names[] = { "ISO-8859-9", "iso8859-9", "iso_8859-9", "iso_8859-9:1989", "iso-ir-148", "latin5", "l5", "csisolatin5", nullptr };
+	constexpr const char * const isoLatin6Names[] = { "ISO-8859-10", "iso8859-10", "iso_8859-10", "iso_8859-10:1992", "iso-ir-157", "latin6", "l6", "csisolatin6", nullptr };
+	constexpr const char * const isoLatinThaiNames[] = { "ISO-8859-11", "iso8859-11", "iso_8859-11", nullptr };
+	constexpr const char * const isoLatin7Names[] = { "ISO-8859-13", "iso8859-13", "iso_8859-13", "latin7", "csiso885913", nullptr };
+	constexpr const char * const isoLatin8Names[] = { "ISO-8859-14", "iso8859-14", "iso_8859-14", "iso_8859-14:1998", "iso-ir-199", "iso-celtic", "latin8", "l8", "csiso885914", nullptr };
+	constexpr const char * const isoLatin9Names[] = { "ISO-8859-15", "iso8859-15", "iso_8859-15", "latin-9", "latin9", "csiso885915", nullptr };
+	constexpr const char * const isoLatin10Names[] = { "ISO-8859-16", "iso8859-16", "iso_8859-16", "iso_8859-16:2001", "iso-ir-226", "latin10", "l10", "csiso885916", nullptr };
+	constexpr const char * const koi8RNames[] = { "KOI8-R", "koi8r", "cskoi8r", nullptr };
+	constexpr const char * const koi8UNames[] = { "KOI8-U", "koi8u", "cskoi8u", nullptr };
+	constexpr const char * const dosLatinUSNames[] = { "IBM437", "cp437", "437", "cspc8codepage437", nullptr };
+	constexpr const char * const dosGreekNames[] = { "cp737", "ibm737", nullptr };
+	constexpr const char * const dosBalticRimNames[] = { "IBM775", "cp775", "cspc775baltic", nullptr };
+	constexpr const char * const dosLatin1Names[] = { "IBM850", "cp850", "850", "cspc850multilingual", nullptr };
+	constexpr const char * const dosLatin2Names[] = { "IBM852", "cp852", "852", "cspcp852", nullptr };
+	constexpr const char * const dosCyrillicNames[] = { "IBM855", "cp855", "855", "csibm855", nullptr };
+	constexpr const char * const dosTurkishNames[] = { "IBM857", "cp857", "857", "csibm857", nullptr };
+	constexpr const char * const dosPortugueseNames[] = { "IBM860", "cp860", "860", "csibm860", nullptr };
+	constexpr const char * const dosIcelandicNames[] = { "IBM861", "cp861", "861", "cp-is", "csibm861", nullptr };
+	constexpr const char * const dosHebrewNames[] = { "IBM862", "cp862", "862", "cspc862latinhebrew", nullptr };
+	constexpr const char * const dosCanadianFrenchNames[] = { "IBM863", "cp863", "863", "csibm863", nullptr };
+	constexpr const char * const dosArabicNames[] = { "IBM864", "cp864", "csibm864", nullptr };
+	constexpr const char * const dosNordicNames[] = { "IBM865", "cp865", "865", "csibm865", nullptr };
+	constexpr const char * const dosRussianNames[] = { "IBM866", "cp866", "866", "csibm866", nullptr };
+	constexpr const char * const dosGreek2Names[] = { "IBM869", "cp869", "869", "cp-gr", "csibm869", nullptr };
+	constexpr const char * const dosThaiNames[] = { "windows-874", "cp874", "x-cp874", nullptr };
+	constexpr const char * const macCyrillicNames[] = { "x-mac-cyrillic", "maccyrillic", nullptr };
+	constexpr const char * const macGreekNames[] = { "x-mac-greek", "macgreek", nullptr };
+	constexpr const char * const macCentralEurRomanNames[] = { "x-mac-ce", "x-mac-centraleurroman", "maccentraleurope", nullptr };
+	constexpr const char * const macIcelandicNames[] = { "x-mac-icelandic", "maciceland", nullptr };
+	constexpr const char * const macTurkishNames[] = { "x-mac-turkish", "macturkish", nullptr };
+	constexpr const char * const macCroatianNames[] = { "x-mac-croatian", "maccroatian", nullptr };
+	constexpr const char * const macRomanianNames[] = { "x-mac-romanian", "macromania", nullptr };
+	constexpr const char * const shiftJISNames[] = { "Shift_JIS", "shift-jis", "sjis", "x-sjis", "ms_kanji", "csshiftjis", nullptr };
+	constexpr const char * const eucJPNames[] = { "EUC-JP", "eucjp", "x-euc-jp", "cseucpkdfmtjapanese", nullptr };
+	constexpr const char * const gbkNames[] = { "GBK", "cp936", "ms936", "windows-936", "x-gbk", nullptr };
+	constexpr const char * const gb18030Names[] = { "GB18030", "gb-18030", nullptr };
+	constexpr const char * const big5Names[] = { "Big5", "big-5", "cn-big5", "x-x-big5", "csbig5", nullptr };
+	constexpr const char * const eucKRNames[] = { "EUC-KR", "euckr", "cseuckr", nullptr };
+	constexpr const char * const utf8Names[] = { "UTF-8", "utf8", "unicode-1-1-utf-8", nullptr };
+	constexpr const char * const utf16Names[] = { "UTF-16", "utf16", nullptr };
+	constexpr const char * const utf16BENames[] = { "UTF-16BE", "utf16be", nullptr };
+	constexpr const char * const utf16LENames[] = { "UTF-16LE", "utf16le", nullptr };
+	constexpr const char * const utf32Names[] = { "UTF-32", "utf32", nullptr };
+	constexpr const char * const utf32BENames[] = { "UTF-32BE", "utf32be", nullptr };
+	constexpr const char * const utf32LENames[] = { "UTF-32LE", "utf32le", nullptr };
+
+	/** Every encoding supported by the portable backend. Single-byte encodings come first, so that `Backend::representableEncodings` prefers them over others of the same length. The multi-byte encodings are only supported if their tables can be loaded (see `MultiByteTables`). */
+	constexpr EncodingInfo registry[] = {
+		{ 0x0600, "Western (ASCII)", asciiNames, 20127, ascii },
+		{ 0x0000, "Western (Mac OS Roman)", macRomanNames, 10000, macRoman },
+		{ 0x0201, "Western (ISO Latin 1)", isoLatin1Names, 28591, isoLatin1 },
+		{ 0x0500, "Western (Windows Latin 1)", windowsLatin1Names, 1252, windowsLatin1 },
+		{ 0x0501, "Central European (Windows Latin 2)", windowsLatin2Names, 1250, windowsLatin2 },
+		{ 0x0502, "Cyrillic (Windows)", windowsCyrillicNames, 1251, windowsCyrillic },
+		{ 0x0503, "Greek (Windows)", windowsGreekNames, 1253, windowsGreek },
+		{ 0x0504, "Turkish (Windows Latin 5)", windowsLatin5Names, 1254, windowsLatin5 },
+		{ 0x0505, "Hebrew (Windows)", windowsHebrewNames, 1255, windowsHebrew },
+		{ 0x0506, "Arabic (Windows)", windowsArabicNames, 1256, windowsArabic },
+		{ 0x0507, "Baltic (Windows)", windowsBalticRimNames, 1257, windowsBalticRim },
+		{ 0x0508, "Vietnamese (Windows)", windowsVietnameseNames, 1258, windowsVietnamese },
+		{ 0x0202, "Central European (ISO Latin 2)", isoLatin2Names, 28592, isoLatin2 },
+		{ 0x0203, "Western (ISO Latin 3)", isoLatin3Names, 28593, isoLatin3 },
+		{ 0x0204, "Central European (ISO Latin 4)", isoLatin4Names, 28594, isoLatin4 },
+		{ 0x0205, "Cyrillic (ISO 8859-5)", isoLatinCyrillicNames, 28595, isoLatinCyrillic },
+		{ 0x0206, "Arabic (ISO 8859-6)", isoLatinArabicNames, 28596, isoLatinArabic },
+		{ 0x0207, "Greek (ISO 8859-7)", isoLatinGreekNames, 28597, isoLatinGreek },
+		{ 0x0208, "Hebrew (ISO 8859-8)", isoLatinHebrewNames, 28598, isoLatinHebrew },
+		{ 0x0209, "Turkish (ISO Latin 5)", isoLatin5Names, 28599, isoLatin5 },
+		{ 0x020A, "Nordic (ISO Latin 6)", isoLatin6Names, kNoWindowsCodepage, isoLatin6 },
+		{ 0x020B, "Thai (ISO 8859-11)", isoLatinThaiNames, kNoWindowsCodepage, isoLatinThai },
+		{ 0x020D, "Baltic (ISO Latin 7)", isoLatin7Names, 28603, isoLatin7 },
+		{ 0x020E, "Celtic (ISO Latin 8)", isoLatin8Names, kNoWindowsCodepage, isoLatin8 },
+		{ 0x020F, "Western (ISO Latin 9)", isoLatin9Names, 28605, isoLatin9 },
+		{ 0x0210, "Romanian (ISO Latin 10)", isoLatin10Names, kNoWindowsCodepage, isoLatin10 },
+		{ 0x0A02, "Cyrillic (KOI8-R)", koi8RNames, 20866, koi8R },
+		{ 0x0A08, "Ukrainian (KOI8-U)", koi8UNames, 21866, koi8U },
+		{ 0x0400, "Latin-US (DOS)", dosLatinUSNames, 437, dosLatinUS },
+		{ 0x0405, "Greek (DOS)", dosGreekNames, 737, dosGreek },
+		{ 0x0406, "Baltic (DOS)", dosBalticRimNames, 775, dosBalticRim },
+		{ 0x0410, "Western (DOS Latin 1)", dosLatin1Names, 850, dosLatin1 },
+		{ 0x0412, "Central European (DOS Latin 2)", dosLatin2Names, 852, dosLatin2 },
+		{ 0x0413, "Cyrillic (DOS)", dosCyrillicNames, 855, dosCyrillic },
+		{ 0x0414, "Turkish (DOS)", dosTurkishNames, 857, dosTurkish },
+		{ 0x0415, "Portuguese (DOS)", dosPortugueseNames, 860, dosPortuguese },
+		{ 0x0416, "Icelandic (DOS)", dosIcelandicNames, 861, dosIcelandic },
+		{ 0x0417, "Hebrew (DOS)", dosHebrewNames, 862, dosHebrew },
+		{ 0x0418, "Canadian French (DOS)", dosCanadianFrenchNames, 863, dosCanadianFrench },
+		{ 0x0419, "Arabic (DOS)", dosArabicNames, 864, dosArabic },
+		{ 0x041A, "Nordic (DOS)", dosNordicNames, 865, dosNordic },
+		{ 0x041B, "Russian (DOS)", dosRussianNames, 866, dosRussian },
+		{ 0x041C, "Greek (DOS Greek 2)", dosGreek2Names, 869, dosGreek2 },
+		{ 0x041D, "Thai (Windows, DOS)", dosThaiNames, 874, dosThai },
+		{ 0x0007, "Cyrillic (Mac OS)", macCyrillicNames, 10007, macCyrillic },
+		{ 0x0006, "Greek (Mac OS)", macGreekNames, 10006, macGreek },
+		{ 0x001D, "Central European (Mac OS)", macCentralEurRomanNames, 10029, macCentralEurRoman },
+		{ 0x0025, "Icelandic (Mac OS)", macIcelandicNames, 10079, macIcelandic },
+		{ 0x0023, "Turkish (Mac OS)", macTurkishNames, 10081, macTurkish },
+		{ 0x0024, "Croatian (Mac OS)", macCroatianNames, 10082, macCroatian },
+		{ 0x0026, "Romanian (Mac OS)", macRomanianNames, 10010, macRomanian },
+		{ 0x0A01, "Japanese (Shift JIS)", shiftJISNames, 932, shiftJIS },
+		{ 0x0920, "Japanese (EUC)", eucJPNames, 51932, eucJP },
+		{ 0x0631, "Simplified Chinese (GBK)", gbkNames, 936, gbk },
+		{ 0x0632, "Simplified Chinese (GB 18030)", gb18030Names, 54936, gb18030 },
+		{ 0x0A03, "Traditional Chinese (Big 5)", big5Names, 950, big5 },
+		{ 0x0940, "Korean (EUC)", eucKRNames, 51949, eucKR },
+		{ 0x08000100, "Unicode (UTF-8)", utf8Names, 65001, utf8 },
+		{ 0x00000100, "Unicode (UTF-16)", utf16Names, kNoWindowsCodepage, utf16 },
+		{ 0x10000100, "Unicode (UTF-16BE)", utf16BENames, 1201, utf16BE },
+		{ 0x14000100, "Unicode (UTF-16LE)", utf16LENames, 1200, utf16LE },
+		{ 0x0c000100, "Unicode (UTF-32)", utf32Names, kNoWindowsCodepage, utf32 },
+		{ 0x18000100, "Unicode (UTF-32BE)", utf32BENames, 12001, utf32BE },
+		{ 0x1c000100, "Unicode (UTF-32LE)", utf32LENames, 12000, utf32LE }
+	};
+
+	/** The `NSStringEncoding` constants that don't follow the usual rule of being the `CFStringEncoding` with the high bit set. */
+	constexpr struct {
+		EncodingId encoding;
+		uint32_t nsStringEncoding;
+	} nsStringEncodings[] = {
+		{ 0x0600, 1 },
+		{ 0x0B01, 2 },
+		{ 0x0920, 3 },
+		{ 0x08000100, 4 },
+		{ 0x0201, 5 },
+		{ 0x0BFF, 7 },
+		{ 0x0A01, 8 },
+		{ 0x0202, 9 },
+		{ 0x0100, 10 },
+		{ 0x0502, 11 },
+		{ 0x0500, 12 },
+		{ 0x0503, 13 },
+		{ 0x0504, 14 },
+		{ 0x0501, 15 },
+		{ 0x0820, 21 },
+		{ 0x0000, 30 }
+	};
+
+	/** `PortableBackend::info`, but only for encodings that are actually available. */
+	const EncodingInfo *availableInfo(EncodingId encoding) noexcept {
+		auto const entry = PortableBackend::info(encoding);
+		return entry != nullptr && entry->codec.isAvailable() ? entry : nullptr;
+	}
+
+	static_assert(std::size(registry) == kIndexedRegistrySize, "The registry has changed. Run tools/generate-name-index.py to bring src/name-index.hh up to date.");
+
+	constexpr char lowerASCII(char c) noexcept {
+		return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+
+	/** The hash functions that the tables in `name-index.hh` were built with. See `tools/generate-name-index.py`. */
+	constexpr uint32_t mix(uint32_t h) noexcept {
+		h ^= h >> 16;
+		h *= 0x85ebca6b;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35;
+		h ^= h >> 16;
+		return h;
+	}
+
+	constexpr uint32_t hashName(std::string_view name, uint32_t seed) noexcept {
+		uint32_t h = 0x811c9dc5 ^ seed;
+		for (const char c : name)
+			h = (h ^ static_cast<uint8_t>(lowerASCII(c))) * 0x01000193;
+		return mix(h);
+	}
+
+	constexpr uint32_t hashNumber(uint32_t n, uint32_t seed) noexcept {
+		return mix(n ^ seed * 0x9e3779b9);
+	}
+
+	/** Finds the registry entry with the given name, ignoring ASCII case. */
+	constexpr const EncodingInfo *indexedName(std::string_view name) noexcept {
+		// This also keeps anything too long to be a name from being hashed at all.
+		if (name.size() > kMaxIndexedNameLength)
+			return nullptr;
+
+		const uint16_t displacement = kNameDisplacements[hashName(name, 0) & (std::size(kNameDisplacements) - 1)];
+		const IndexedName &slot = kNameSlots[hashName(name, displacement) & (std::size(kNameSlots) - 1)];
+
+		if (slot.entry == kNoIndexEntry || slot.length != name.size())
+			return nullptr;
+
+		// The names in the table are already in lower case.
+		for (size_t i = 0; i < name.size(); i++) {
+			if (lowerASCII(name[i]) != slot.name[i])
+				return nullptr;
+		}
+
+		return &registry[slot.entry];
+	}
+
+	/** Finds the registry entry with the given key in one of the number tables of `name-index.hh`. */
+	template <size_t buckets, size_t slots>
+	constexpr const EncodingInfo *indexedNumber(const uint16_t (&displacements)[buckets], const IndexedNumber (&table)[slots], uint32_t key) noexcept {
+		const uint16_t displacement = displacements[hashNumber(key, 0) & (buckets - 1)];
+		const IndexedNumber &slot = table[hashNumber(key, displacement) & (slots - 1)];
+		return slot.entry != kNoIndexEntry && slot.key == key ? &registry[slot.entry] : nullptr;
+	}
+
+	/** The first registry entry for which `matches` is true. As when searching the registry from the beginning, that's the one the index should find for a key that several entries share. */
+	template <typename Predicate>
+	constexpr const EncodingInfo *firstEntry(Predicate matches) noexcept {
+		for (const auto &entry : registry) {
+			if (matches(entry))
+				return &entry;
+		}
+		return nullptr;
+	}
+
+	/** Whether every name, Windows codepage, `NSStringEncoding` constant, and ID in the registry and `nsStringEncodings` leads to its own entry through the tables in `name-index.hh`. If not, the tables are out of date. */
+	constexpr bool indexMatchesRegistry() noexcept {
+		for (const auto &entry : registry) {
+			const EncodingId id = entry.id;
+			const uint32_t codepage = entry.windowsCodepage;
+
+			if (indexedNumber(kEncodingDisplacements, kEncodingSlots, id) != firstEntry([id] (const EncodingInfo &e) { return e.id == id; }))
+				return false;
+
+			for (auto name = entry.ianaNames; *name != nullptr; name++) {
+				if (indexedName(*name) != &entry)
+					return false;
+			}
+
+			if (codepage != kNoWindowsCodepage && indexedNumber(kWindowsCodepageDisplacements, kWindowsCodepageSlots, codepage) != firstEntry([codepage] (const EncodingInfo &e) { return e.windowsCodepage == codepage; }))
+				return false;
+
+			if (indexedNumber(kNSStringEncodingDisplacements, kNSStringEncodingSlots, id | 0x80000000) != &entry)
+				return false;
+		}
+
+		for (const auto &mapping : nsStringEncodings) {
+			const EncodingId id = mapping.encoding;
+			auto const entry = firstEntry([id] (const EncodingInfo &e) { return e.id == id; });
+
+			if (entry != nullptr && indexedNumber(kNSStringEncodingDisplacements, kNSStringEncodingSlots, mapping.nsStringEncoding) != entry)
+				return false;
+		}
+
+		return true;
+	}
+
+	static_assert(indexMatchesRegistry(), "The registry has changed. Run tools/generate-name-index.py to bring src/name-index.hh up to date.");
+
+	/** The ID of the given entry, if its codec is available. */
+	inline EncodingId availableId(const EncodingInfo *entry) noexcept {
+		return entry != nullptr && entry->codec.isAvailable() ? entry->id : kEncodingInvalidId;
+	}
+}
+
+const EncodingInfo *PortableBackend::info(EncodingId encoding) noexcept {
+	return indexedNumber(kEncodingDisplacements, kEncodingSlots, encoding);
+}
+
+EncodingInfoRange PortableBackend::all() noexcept {
+	return { std::begin(registry), std::end(registry) };
+}
+
+bool PortableBackend::isEncodingAvailable(EncodingId encoding) const {
+	return availableInfo(encoding) != nullptr;
+}
+
+EncodingId PortableBackend::systemEncoding() const {
+	return 0x08000100;
+}
+
+std::vector<EncodingId> PortableBackend::availableEncodings() const {
+	std::vector<EncodingId> encodings;
+
+	for (const auto &entry : registry) {
+		if (entry.codec.isAvailable())
+			encodings.push_back(entry.id);
+	}
+
+	return encodings;
+}
+
+EncodingId PortableBackend::encodingForIANACharSetName(std::string_view name) const {
+	return availableId(indexedName(name));
+}
+
+EncodingId PortableBackend::encodingForWindowsCodepage(uint32_t codepage) const {
+	return availableId(indexedNumber(kWindowsCodepageDisplacements, kWindowsCodepageSlots, codepage));
+}
+
+EncodingId PortableBackend::encodingForNSStringEncoding(uint32_t nsStringEncoding) const {
+	return availableId(indexedNumber(kNSStringEncodingDisplacements, kNSStringEncodingSlots, nsStringEncoding));
+}
+
+bool PortableBackend::isNameLookupCheap() const {
+	// Names are found with a perfect hash, in one probe.
+	return true;
+}
+
+std::optional<std::string> PortableBackend::ianaCharSetName(EncodingId encoding) const {
+	auto entry = availableInfo(encoding);
+	if (entry == nullptr)
+		return std::nullopt;
+	else
+		return std::string(entry->ianaNames[0]);
+}
+
+std::string PortableBackend::name(EncodingId encoding) const {
+	auto entry = availableInfo(encoding);
+	return entry == nullptr ? std::string() : std::string(entry->name);
+}
+
+uint32_t PortableBackend::windowsCodepage(EncodingId encoding) const {
+	auto entry = availableInfo(encoding);
+	return entry == nullptr ? kNoWindowsCodepage : entry->windowsCodepage;
+}
+
+uint32_t PortableBackend::nsStringEncoding(EncodingId encoding) const {
+	for (const auto &mapping : nsStringEncodings) {
+		if (mapping.encoding == encoding)
+			return mapping.nsStringEncoding;
+	}
+	return encoding | 0x80000000;
+}
+
+bool PortableBackend::isASCIICompatible(EncodingId encoding) const {
+	auto entry = availableInfo(encoding);
+	return entry != nullptr && entry->codec.isASCIICompatible();
+}
+
+bool PortableBackend::usesPortableTables(EncodingId encoding) const {
+	return isEncodingAvailable(encoding);
+}
+
+bool PortableBackend::isEncodingResumable(EncodingId encoding) const {
+	auto entry = availableInfo(encoding);
+	return entry != nullptr && entry->codec.isResumable();
+}
+
+std::optional<DecodedText> PortableBackend::decode(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	auto entry = availableInfo(encoding);
+	PooledU16String out;
+
+	if (entry == nullptr || !entry->codec.decode(bytes, length, out))
+		return std::nullopt;
+	else
+		return DecodedText(std::move(out));
+}
+
+size_t PortableBackend::validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const {
+	auto entry = availableInfo(encoding);
+	return entry == nullptr ? 0 : entry->codec.validLength(bytes, length);
+}
+
+DecodedText PortableBackend::decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements) const {
+	auto entry = availableInfo(encoding);
+	PooledU16String out;
+	const size_t replaced = entry == nullptr ? 0 : entry->codec.decodeLossy(bytes, length, replacement, out);
+
+	if (replacements != nullptr)
+		*replacements = replaced;
+
+	return DecodedText(std::move(out));
+}
+
+EncodeResult PortableBackend::encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const {
+	auto entry = availableInfo(encoding);
+
+	if (entry == nullptr)
+		return { EncodeResult::Status::unrepresentable, 0, 0 };
+	else
+		return entry->codec.encode(text, lossByte, out, capacity);
+}
+
+size_t PortableBackend::maxEncodedLength(EncodingId encoding, size_t length) const {
+	auto entry = availableInfo(encoding);
+	return entry == nullptr ? 0 : entry->codec.maxEncodedLength(length);
+}
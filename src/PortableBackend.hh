@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Backend.hh"
+#include "Codec.hh"
+
+/** Everything the portable backend knows about one encoding. */
+struct EncodingInfo {
+	EncodingId id;
+
+	/** Human-readable name, in the same style as `CFStringGetNameOfEncoding`. */
+	const char *name;
+
+	/** IANA character set names. The first is the preferred one; the rest are aliases accepted when looking up by name. Terminated by a null pointer. */
+	const char * const *ianaNames;
+
+	uint32_t windowsCodepage;
+
+	const Codec &codec;
+};
+
+/** The entries of the portable backend's registry, for use in a range-based `for` loop. */
+struct EncodingInfoRange {
+	const EncodingInfo *first, *last;
+
+	inline const EncodingInfo *begin() const noexcept {
+		return first;
+	}
+
+	inline const EncodingInfo *end() const noexcept {
+		return last;
+	}
+};
+
+/**
+ * `Backend` implemented entirely with this library's own conversion tables and code, with no dependency on any platform API.
+ *
+ * This supports fewer encodings than Core Foundation does, but works everywhere.
+ */
+class PortableBackend : public Backend {
+	public:
+	/** Looks up the registry entry for an encoding, or returns null if this backend doesn't support it. The entry may be for a multi-byte encoding whose codec isn't available; see `Codec::isAvailable`. */
+	static const EncodingInfo *info(EncodingId encoding) noexcept;
+
+	/** Every entry in the registry, in order: single-byte encodings, then multi-byte, then Unicode. Like `info`, this includes entries whose codecs aren't available. */
+	static EncodingInfoRange all() noexcept;
+
+	bool isEncodingAvailable(EncodingId encoding) const override;
+	EncodingId systemEncoding() const override;
+	std::vector<EncodingId> availableEncodings() const override;
+	EncodingId encodingForIANACharSetName(std::string_view name) const override;
+	EncodingId encodingForWindowsCodepage(uint32_t codepage) const override;
+	EncodingId encodingForNSStringEncoding(uint32_t nsStringEncoding) const override;
+	bool isNameLookupCheap() const override;
+	std::optional<std::string> ianaCharSetName(EncodingId encoding) const override;
+	std::string name(EncodingId encoding) const override;
+	uint32_t windowsCodepage(EncodingId encoding) const override;
+	uint32_t nsStringEncoding(EncodingId encoding) const override;
+	bool isASCIICompatible(EncodingId encoding) const override;
+	bool usesPortableTables(EncodingId encoding) const override;
+	bool isEncodingResumable(EncodingId encoding) const override;
+	std::optional<DecodedText> decode(EncodingId encoding, const uint8_t *bytes, size_t length) const override;
+	size_t validLength(EncodingId encoding, const uint8_t *bytes, size_t length) const override;
+	DecodedText decodeLossy(EncodingId encoding, const uint8_t *bytes, size_t length, char32_t replacement, size_t *replacements = nullptr) const override;
+	EncodeResult encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte, uint8_t *out, size_t capacity) const override;
+	size_t maxEncodedLength(EncodingId encoding, size_t length) const override;
+};
@@ -1,6 +1,10 @@
 #include "StringEncoding.hh"
 #include "string-utils.hh"
 #include "transcode.hh"
+#include "ascii.hh"
+#include "ConversionWorker.hh"
+#include "stats.hh"
+#include <algorithm>
 #include <sstream>
 #include <optional>
 #include <stdexcept>
@@ -21,11 +25,20 @@ StringEncodingClass::StringEncodingClass(Napi::Env env, Iccf *iccf)
 		StringEncoding::InstanceAccessor("name", &StringEncoding::name, nullptr, napi_enumerable, this),
 		StringEncoding::InstanceMethod("decode", &StringEncoding::decode, napi_default, this),
 		StringEncoding::InstanceMethod("encode", &StringEncoding::encode, napi_default, this),
+		StringEncoding::InstanceMethod("decodeAsync", &StringEncoding::decodeAsync, napi_default, this),
+		StringEncoding::InstanceMethod("encodeAsync", &StringEncoding::encodeAsync, napi_default, this),
+		StringEncoding::InstanceMethod("tryDecode", &StringEncoding::tryDecode, napi_default, this),
+		StringEncoding::InstanceMethod("tryEncode", &StringEncoding::tryEncode, napi_default, this),
+		StringEncoding::InstanceMethod("isValid", &StringEncoding::isValid, napi_default, this),
+		StringEncoding::InstanceMethod("validLength", &StringEncoding::validLength, napi_default, this),
+		StringEncoding::InstanceMethod("canEncode", &StringEncoding::canEncode, napi_default, this),
+		StringEncoding::InstanceMethod("encodableLength", &StringEncoding::encodableLength, napi_default, this),
 		StringEncoding::InstanceMethod(Napi::Symbol::WellKnown(env, "toPrimitive"), &StringEncoding::toPrimitive, napi_default, this),
 		StringEncoding::StaticMethod("byCFStringEncoding", &StringEncoding::byCFStringEncoding, napi_default, this),
 		StringEncoding::StaticMethod("byIANACharSetName", &StringEncoding::byIANACharSetName, napi_default, this),
 		StringEncoding::StaticMethod("byWindowsCodepage", &StringEncoding::byWindowsCodepage, napi_default, this),
 		StringEncoding::StaticMethod("byNSStringEncoding", &StringEncoding::byNSStringEncoding, napi_default, this),
+		StringEncoding::StaticMethod("all", &StringEncoding::all, napi_default, this),
 		StringEncoding::StaticMethod(Napi::Symbol::WellKnown(env, "hasInstance"), &StringEncoding::hasInstance, napi_default, this),
 		StringEncoding::StaticAccessor("system", &StringEncoding::system, nullptr, napi_enumerable, this)
 	}, this);
@@ -39,6 +52,7 @@ StringEncodingClass::StringEncodingClass(Napi::Env env, Iccf *iccf)
 	ref.SuppressDestruct();
 	return ref;
 }())
+, _interned(std::make_shared<InternTable>())
 {}
 
 StringEncodingClass *StringEncodingClass::ForMethodCall(const Napi::CallbackInfo &info) {
@@ -48,14 +62,42 @@ StringEncodingClass *StringEncodingClass::ForMethodCall(const Napi::CallbackInfo
 	return ptr;
 }
 
-StringEncoding *StringEncodingClass::New(Napi::Env env, CFStringEncoding encoding) const {
+StringEncoding *StringEncodingClass::New(Napi::Env env, EncodingId encoding) const {
+	{
+		auto const found = _interned->find(encoding);
+
+		// A weak reference becomes empty as soon as its object is garbage collected, which may be a while before the finalizer runs and removes it from the table.
+		if (found != _interned->end() && !found->second.weakRef.Value().IsEmpty())
+			return found->second.instance;
+	}
+
 	StringEncoding::ConstructorCookie cookie(encoding);
 	auto extCookie = Napi::External<StringEncoding::ConstructorCookie>::New(env, &cookie);
 	auto wrapper = constructor().New({ extCookie });
-	return *Unwrap(wrapper, false);
+	auto se = *Unwrap(wrapper, false);
+
+	// Constructing the instance can run the garbage collector, and with it the finalizer of an older instance for this encoding, which removes that instance's entry. So the entry is only looked up now.
+	se->_internedIn = _interned;
+	auto &entry = (*_interned)[encoding];
+	entry.instance = se;
+	entry.weakRef = Napi::Weak(wrapper);
+	return se;
 }
 
-StringEncoding::ConstructorCookie::ConstructorCookie(CFStringEncoding encoding)
+const EncodingMetadata &StringEncodingClass::metadata(EncodingId encoding) const {
+	auto found = _metadata.find(encoding);
+
+	if (found == _metadata.end()) {
+		found = _metadata.emplace(encoding, EncodingMetadata {
+			iccf->backend.ianaCharSetName(encoding),
+			iccf->backend.name(encoding)
+		}).first;
+	}
+
+	return found->second;
+}
+
+StringEncoding::ConstructorCookie::ConstructorCookie(EncodingId encoding)
 : magic(MAGIC)
 , encoding(encoding)
 {}
@@ -93,9 +135,22 @@ StringEncoding::StringEncoding(const Napi::CallbackInfo &info)
 }
 
 StringEncoding::~StringEncoding() {
+	if (auto const interned = _internedIn.lock()) {
+		// There may already be a newer instance for this encoding, if this one was collected and then the encoding was looked up again before this finalizer ran.
+		auto const found = interned->find(_cfStringEncoding);
+		if (found != interned->end() && found->second.instance == this)
+			interned->erase(found);
+	}
+
 	Napi::MemoryManagement::AdjustExternalMemory(Env(), -sizeof(StringEncoding));
 }
 
+Napi::Object StringEncoding::cache(Napi::Env env) {
+	if (_cache.IsEmpty())
+		_cache = Napi::Persistent(Napi::Object::New(env));
+	return _cache.Value();
+}
+
 std::optional<StringEncoding *> StringEncodingClass::Unwrap(Napi::Value wrapper, bool acceptStrings) const {
 	if (acceptStrings && wrapper.IsString())
 		return byIANACharSetName(wrapper.As<Napi::String>());
@@ -126,105 +181,101 @@ StringEncoding *StringEncodingClass::UnwrapOrThrow(Napi::Value wrapper, bool acc
 		throw iccf->newFormattedTypeError(wrapper.Env(), "a StringEncoding or IANA character set name", wrapper);
 }
 
-Napi::Buffer<uint8_t> StringEncoding::cfEncode(
+const Backend &StringEncoding::backend() const {
+	return _class->iccf->backend;
+}
+
+Napi::Buffer<uint8_t> StringEncoding::encodeText(
 	Napi::Env env,
-	CFStringRef text,
-	UInt8 lossByte,
-	std::function<Napi::Value(CFStringRef, Napi::Env)> origString
+	std::u16string_view text,
+	uint8_t lossByte,
+	std::function<Napi::Value(std::u16string_view, Napi::Env)> origString
 ) const {
-	class NotRepr {};
+	size_t unrepresentableAt;
+	auto encoded = backend().encodeAll(_cfStringEncoding, text, lossByte, &unrepresentableAt);
 
-	try {
-		auto const strLength = CFStringGetLength(text);
-		CFIndex bytesConverted, charsConverted;
-
-		charsConverted = CFStringGetBytes(
-			text,
-			{ 0, strLength },
-			_cfStringEncoding,
-			lossByte,
-			true,
-			nullptr,
-			std::numeric_limits<size_t>::max(),
-			&bytesConverted
-		);
-
-		if (charsConverted != strLength)
-			throw NotRepr();
-
-		auto const buf = Napi::Buffer<uint8_t>::New(env, bytesConverted);
-
-		charsConverted = CFStringGetBytes(
-			text,
-			{ 0, strLength },
-			_cfStringEncoding,
-			lossByte,
-			true,
-			buf.Data(),
-			bytesConverted,
-			nullptr
-		);
-
-		if (charsConverted != strLength)
-			throw NotRepr();
-
-		return buf;
-	}
-	catch (NotRepr) {
-		throw _class->iccf->newNotRepresentableError(env, origString(text, env), Value());
-	}
+	if (!encoded)
+		throw _class->iccf->newNotRepresentableError(env, origString(text, env), Value(), unrepresentableAt);
+
+	return EncodedBytesToNapiBuffer(std::move(*encoded), env);
 }
 
-CFStringHandle StringEncoding::cfDecode(Napi::Value text) const {
+BufferContents StringEncodingClass::bufferContents(Napi::Value text) const {
 	const auto env = text.Env();
 	void *data;
 	size_t length;
 
-	{
-		class NotABuffer {};
-		try {
-			if (text.IsArrayBuffer())
-				throwIfFailed(env, napi_get_arraybuffer_info(env, text, &data, &length));
-			else if (text.IsDataView())
-				throwIfFailed(env, napi_get_dataview_info(env, text, &length, &data, nullptr, nullptr));
-			else if (text.IsTypedArray() || text.IsBuffer()) {
-				napi_typedarray_type type;
-				throwIfFailed(env, napi_get_typedarray_info(env, text, &type, &length, &data, nullptr, nullptr));
-
-				if (type != napi_uint8_array)
-					throw NotABuffer();
-			}
-			else
+	class NotABuffer {};
+	try {
+		if (text.IsArrayBuffer())
+			throwIfFailed(env, napi_get_arraybuffer_info(env, text, &data, &length));
+		else if (text.IsDataView())
+			throwIfFailed(env, napi_get_dataview_info(env, text, &length, &data, nullptr, nullptr));
+		else if (text.IsTypedArray() || text.IsBuffer()) {
+			napi_typedarray_type type;
+			throwIfFailed(env, napi_get_typedarray_info(env, text, &type, &length, &data, nullptr, nullptr));
+
+			if (type != napi_uint8_array)
 				throw NotABuffer();
 		}
-		catch (NotABuffer) {
-			throw _class->iccf->newFormattedTypeError(env, "a Buffer, ArrayBuffer, DataView, or Uint8Array", text);
-		}
+		else
+			throw NotABuffer();
+	}
+	catch (NotABuffer) {
+		throw iccf->newFormattedTypeError(env, "a Buffer, ArrayBuffer, DataView, or Uint8Array", text);
 	}
 
-	// There's no getting around it: we have to copy the buffer here. There is a CFStringCreateWithBytesNoCopy function, but this may result in the buffer's contents being overwritten, or the whole thing being garbage-collected before the CFString is freed (which would leave the CFString with a dangling pointer). Nor does N-API offer any way to detach a buffer and take ownership of the underlying memory (assuming the JavaScript program is even okay with that). Nor does CF offer any way (as far as I can tell) to transcode a string without making a supposedly-immutable CFString in the process.
+	return { reinterpret_cast<const uint8_t *>(data), length };
+}
 
-	auto cfString = CFStringCreateWithBytes(
-		kCFAllocatorDefault,
-		const_cast<const UInt8 *>(reinterpret_cast<UInt8 *>(data)),
-		length,
-		_cfStringEncoding,
-		true
-	);
+bool StringEncoding::isCopyableASCII(BufferContents contents) const {
+	if (!isASCIICompatible())
+		return false;
 
-	if (cfString == nullptr)
-		throw _class->iccf->newInvalidEncodedTextError(env, text, Value());
+	const bool ascii = asciiPrefixLength(contents.data, contents.length) == contents.length;
+	Stats::fastPath(Stats::FastPath::ascii, ascii);
+	return ascii;
+}
 
-	return CFStringHandle(cfString);
+DecodedText StringEncoding::decodeText(Napi::Value text) const {
+	return decodeText(text, bufferContents(text));
+}
+
+DecodedText StringEncoding::decodeText(Napi::Value text, BufferContents contents) const {
+	return decodeText(text, contents, DecodeOptions());
+}
+
+DecodedText StringEncoding::decodeText(Napi::Value text, BufferContents contents, const DecodeOptions &options) const {
+	size_t replaced = 0;
+	auto decoded = options.decode(backend(), _cfStringEncoding, contents.data, contents.length, replaced);
+
+	// Finding where the problem is takes another pass, but only as far as the problem, and only when there is one.
+	if (!decoded)
+		throw _class->iccf->newInvalidEncodedTextError(text.Env(), text, Value(), backend().validLength(_cfStringEncoding, contents.data, contents.length));
+
+	options.reportReplacements(replaced);
+	return std::move(*decoded);
 }
 
 std::optional<Napi::String> StringEncoding::ianaCharSetName(const Napi::Env &env) {
-	auto cfString = CFStringConvertEncodingToIANACharSetName(_cfStringEncoding);
+	auto cache = this->cache(env);
+	auto cached = cache.Get("ianaCharSetName");
 
-	if (cfString == nullptr)
+	if (cached.IsString())
+		return cached.As<Napi::String>();
+	else if (cached.IsNull())
 		return std::nullopt;
-	else
-		return CFStringToNapiString(cfString, env);
+
+	auto &name = _class->metadata(_cfStringEncoding).ianaCharSetName;
+
+	if (!name) {
+		cache["ianaCharSetName"] = env.Null();
+		return std::nullopt;
+	}
+
+	auto result = Napi::String::New(env, *name);
+	cache["ianaCharSetName"] = result;
+	return result;
 }
 
 Napi::Value StringEncoding::ianaCharSetName(const Napi::CallbackInfo &info) {
@@ -236,30 +287,252 @@ Napi::Value StringEncoding::ianaCharSetName(const Napi::CallbackInfo &info) {
 }
 
 Napi::Value StringEncoding::windowsCodepage(const Napi::CallbackInfo &info) {
-	auto codepage = CFStringConvertEncodingToWindowsCodepage(_cfStringEncoding);
-	if (codepage == UINT32_MAX)
+	auto codepage = backend().windowsCodepage(_cfStringEncoding);
+	if (codepage == kNoWindowsCodepage)
 		return info.Env().Null();
 	else
 		return Napi::Number::New(info.Env(), codepage);
 }
 
 Napi::Value StringEncoding::nsStringEncoding(const Napi::CallbackInfo &info) {
-	return Napi::Number::New(info.Env(), CFStringConvertEncodingToNSStringEncoding(_cfStringEncoding));
+	return Napi::Number::New(info.Env(), backend().nsStringEncoding(_cfStringEncoding));
 }
 
 Napi::Value StringEncoding::decode(const Napi::CallbackInfo &info) {
-	return CFStringToNapiString(cfDecode(info[0]), info.Env());
+	const auto contents = bufferContents(info[0]);
+	const DecodeOptions options(info[1]);
+	Stats::Call stats(Stats::Operation::decode, _cfStringEncoding, contents.length);
+
+	// All-ASCII text can go straight into a one-byte JavaScript string, without being widened to UTF-16 first.
+	if (isCopyableASCII(contents)) {
+		options.reportReplacements(0);
+		stats.succeeded(contents.length * sizeof(char16_t));
+		return Latin1ToNapiString(contents.data, contents.length, info.Env());
+	}
+
+	auto decoded = decodeText(info[0], contents, options);
+	stats.succeeded(decoded.size() * sizeof(char16_t));
+	return DecodedTextToNapiString(std::move(decoded), info.Env(), _class->iccf->stringConcat.Value(), _class->iccf->externalStringThreshold);
 }
 
 Napi::Value StringEncoding::encode(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	auto text = info[0].ToString();
+	const EncodeOptions options(info[1]);
+	Stats::Call stats(Stats::Operation::encode, _cfStringEncoding);
+
+	NapiStringToEncode copy(text, isASCIICompatible());
+	stats.input(copy.length() * sizeof(char16_t));
+
+	size_t unrepresentableAt;
+	auto encoded = copy.encode(backend(), _cfStringEncoding, options.lossByte, &unrepresentableAt);
+
+	if (!encoded)
+		throw _class->iccf->newNotRepresentableError(env, text, Value(), unrepresentableAt);
+
+	stats.succeeded(encoded->size());
+	return EncodedBytesToNapiBuffer(std::move(*encoded), env);
+}
+
+namespace {
+	/** What `tryDecode` and `tryEncode` return instead of throwing an error. Unlike an error, this doesn't capture a stack trace or hold on to the text. */
+	Napi::Object conversionFailure(Napi::Env env, const char *reason, size_t offset) {
+		auto result = Napi::Object::New(env);
+		result["reason"] = Napi::String::New(env, reason);
+		result["offset"] = Napi::Number::New(env, static_cast<double>(offset));
+		return result;
+	}
+}
+
+Napi::Value StringEncoding::tryDecode(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto contents = bufferContents(info[0]);
+	const DecodeOptions options(info[1]);
+	Stats::Call stats(Stats::Operation::decode, _cfStringEncoding, contents.length);
+
+	if (isCopyableASCII(contents)) {
+		options.reportReplacements(0);
+		stats.succeeded(contents.length * sizeof(char16_t));
+		return Latin1ToNapiString(contents.data, contents.length, env);
+	}
+
+	size_t replaced = 0;
+	auto decoded = options.decode(backend(), _cfStringEncoding, contents.data, contents.length, replaced);
+
+	if (!decoded)
+		return conversionFailure(env, "invalid", backend().validLength(_cfStringEncoding, contents.data, contents.length));
+
+	options.reportReplacements(replaced);
+	stats.succeeded(decoded->size() * sizeof(char16_t));
+	return DecodedTextToNapiString(std::move(*decoded), env, _class->iccf->stringConcat.Value(), _class->iccf->externalStringThreshold);
+}
+
+Napi::Value StringEncoding::tryEncode(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	auto text = info[0].ToString();
+	const EncodeOptions options(info[1]);
+	Stats::Call stats(Stats::Operation::encode, _cfStringEncoding);
+
+	NapiStringToEncode copy(text, isASCIICompatible());
+	stats.input(copy.length() * sizeof(char16_t));
+
+	size_t unrepresentableAt;
+	auto encoded = copy.encode(backend(), _cfStringEncoding, options.lossByte, &unrepresentableAt);
+
+	if (!encoded)
+		return conversionFailure(env, "unrepresentable", unrepresentableAt);
+
+	stats.succeeded(encoded->size());
+	return EncodedBytesToNapiBuffer(std::move(*encoded), env);
+}
+
+Napi::Value StringEncoding::isValid(const Napi::CallbackInfo &info) {
+	const auto contents = bufferContents(info[0]);
+	return Napi::Boolean::New(info.Env(), backend().validLength(_cfStringEncoding, contents.data, contents.length) == contents.length);
+}
+
+Napi::Value StringEncoding::validLength(const Napi::CallbackInfo &info) {
+	const auto contents = bufferContents(info[0]);
+	return Napi::Number::New(info.Env(), static_cast<double>(backend().validLength(_cfStringEncoding, contents.data, contents.length)));
+}
+
+Napi::Value StringEncoding::canEncode(const Napi::CallbackInfo &info) {
+	const auto text = NapiStringToScratchUTF16(info[0].ToString());
+	return Napi::Boolean::New(info.Env(), backend().encodableLength(_cfStringEncoding, text) == text.size());
+}
+
+Napi::Value StringEncoding::encodableLength(const Napi::CallbackInfo &info) {
+	const auto text = NapiStringToScratchUTF16(info[0].ToString());
+	return Napi::Number::New(info.Env(), static_cast<double>(backend().encodableLength(_cfStringEncoding, text)));
+}
+
+Napi::Value StringEncoding::decodeAsync(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto contents = bufferContents(info[0]);
+
+	struct State {
+		EncodedBytes bytes;
+		bool isASCII = false;
+		std::optional<DecodedText> decoded;
+		size_t invalidAt = 0;
+		size_t replaced = 0;
+		Stats::Timer timer;
+	};
+
+	// Copy the input, since the buffer could be modified (or its ArrayBuffer detached) while the conversion is running.
+	auto const state = std::make_shared<State>();
+	state->bytes = EncodedBytes::copy(contents.data, contents.length);
+
+	const DecodeOptions options(info[1]);
+
+	auto kept = Napi::Object::New(env);
+	kept["text"] = info[0];
+	kept["encoding"] = Value();
+	if (!options._replacements.IsEmpty())
+		kept["replacements"] = options._replacements.Value();
+
+	auto const &backend = this->backend();
+	auto const encoding = _cfStringEncoding;
+	auto const iccf = _class->iccf;
+	const bool fatal = options.fatal;
+	const char32_t replacement = options.replacement;
+
+	return ConversionWorker::Start(
+		env,
+		iccf,
+		kept,
+		ConversionWorker::AbortSignalFromOptions(info[1]),
+		[state, &backend, encoding, fatal, replacement] (const std::atomic<bool> &cancelled) {
+			auto const &bytes = state->bytes;
+
+			if (backend.isASCIICompatible(encoding)) {
+				state->isASCII = asciiPrefixLength(bytes.data(), bytes.size()) == bytes.size();
+				Stats::fastPath(Stats::FastPath::ascii, state->isASCII);
+			}
+
+			if (state->isASCII)
+				return;
+			else if (!fatal)
+				state->decoded = backend.decodeLossy(encoding, bytes.data(), bytes.size(), replacement, &state->replaced);
+			else {
+				state->decoded = backend.decode(encoding, bytes.data(), bytes.size());
+
+				if (!state->decoded)
+					state->invalidAt = backend.validLength(encoding, bytes.data(), bytes.size());
+			}
+		},
+		[state, iccf, encoding] (Napi::Env env, Napi::Object kept) -> Napi::Value {
+			const size_t length = state->isASCII ? state->bytes.size() : state->decoded ? state->decoded->size() : 0;
+			Stats::record(Stats::Operation::decode, encoding, state->timer, state->bytes.size(), length * sizeof(char16_t), state->isASCII || state->decoded);
+
+			if (state->isASCII || state->decoded)
+				DecodeOptions::reportReplacements(kept.Get("replacements"), state->replaced);
+
+			// The copy of the input was only needed for this, so it can become the string.
+			if (state->isASCII)
+				return Latin1ToNapiString(std::move(state->bytes), env, iccf->externalStringThreshold);
+			else if (!state->decoded)
+				throw iccf->newInvalidEncodedTextError(env, kept.Get("text"), kept.Get("encoding").As<Napi::Object>(), state->invalidAt);
+			else
+				return DecodedTextToNapiString(std::move(*state->decoded), env, iccf->stringConcat.Value(), iccf->externalStringThreshold);
+		}
+	);
+}
+
+Napi::Value StringEncoding::encodeAsync(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
 	auto text = info[0].ToString();
 	EncodeOptions options(info[1]);
 
-	return cfEncode(info.Env(), NapiStringToCFString(text), options.lossByte, text);
+	struct State {
+		NapiStringToEncode text;
+		std::optional<EncodedBytes> encoded;
+		size_t unrepresentableAt = 0;
+		Stats::Timer timer;
+
+		inline State(NapiStringToEncode &&text) : text(std::move(text)) {}
+	};
+
+	auto const state = std::make_shared<State>(NapiStringToEncode(text, isASCIICompatible()));
+
+	auto kept = Napi::Object::New(env);
+	kept["text"] = text;
+	kept["encoding"] = Value();
+
+	auto const &backend = this->backend();
+	auto const encoding = _cfStringEncoding;
+	auto const lossByte = options.lossByte;
+	auto const iccf = _class->iccf;
+
+	return ConversionWorker::Start(
+		env,
+		iccf,
+		kept,
+		ConversionWorker::AbortSignalFromOptions(info[1]),
+		[state, &backend, encoding, lossByte] (const std::atomic<bool> &cancelled) {
+			state->encoded = state->text.encode(backend, encoding, lossByte, &state->unrepresentableAt);
+		},
+		[state, iccf, encoding] (Napi::Env env, Napi::Object kept) -> Napi::Value {
+			Stats::record(Stats::Operation::encode, encoding, state->timer, state->text.length() * sizeof(char16_t), state->encoded ? state->encoded->size() : 0, state->encoded.has_value());
+
+			if (!state->encoded)
+				throw iccf->newNotRepresentableError(env, kept.Get("text"), kept.Get("encoding").As<Napi::Object>(), state->unrepresentableAt);
+			else
+				return EncodedBytesToNapiBuffer(std::move(*state->encoded), env);
+		}
+	);
 }
 
 Napi::String StringEncoding::name(const Napi::Env &env) {
-	return CFStringToNapiString(CFStringGetNameOfEncoding(_cfStringEncoding), env);
+	auto cache = this->cache(env);
+	auto cached = cache.Get("name");
+
+	if (cached.IsString())
+		return cached.As<Napi::String>();
+
+	auto result = Napi::String::New(env, _class->metadata(_cfStringEncoding).name);
+	cache["name"] = result;
+	return result;
 }
 
 Napi::Value StringEncoding::name(const Napi::CallbackInfo &info) {
@@ -281,9 +554,9 @@ Napi::Value StringEncoding::toPrimitive(const Napi::CallbackInfo &info) {
 
 Napi::Value StringEncoding::byCFStringEncoding(const Napi::CallbackInfo &info) {
 	const auto _class = StringEncodingClass::ForMethodCall(info);
-	CFStringEncoding encoding = info[0].As<Napi::Number>();
+	EncodingId encoding = info[0].As<Napi::Number>();
 
-	if (CFStringIsEncodingAvailable(encoding))
+	if (_class->iccf->backend.isEncodingAvailable(encoding))
 		return _class->New(info.Env(), encoding)->Value();
 	else
 		throw _class->iccf->newUnrecognizedEncodingError(info.Env(), info[0], Iccf::EncodingSpecifierKind::CFStringEncoding);
@@ -294,23 +567,55 @@ Napi::Value StringEncoding::byIANACharSetName(const Napi::CallbackInfo &info) {
 	return _class->byIANACharSetName(info[0].As<Napi::String>())->Value();
 }
 
+namespace {
+	inline char lowerASCII(char c) noexcept {
+		return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+	}
+}
+
+bool StringEncodingClass::NameLess::operator()(std::string_view a, std::string_view b) const noexcept {
+	return std::lexicographical_compare(
+		a.begin(), a.end(),
+		b.begin(), b.end(),
+		[] (char x, char y) {
+			return static_cast<uint8_t>(lowerASCII(x)) < static_cast<uint8_t>(lowerASCII(y));
+		}
+	);
+}
+
 StringEncoding *StringEncodingClass::byIANACharSetName(const Napi::String name) const {
 	const auto env = name.Env();
-	auto cfName = NapiStringToCFString(name);
-	auto encoding = CFStringConvertIANACharSetNameToEncoding(cfName);
+	const NapiStringToShortUTF8 utf8Name(name);
+	const bool cached = !iccf->backend.isNameLookupCheap();
 
-	if (encoding == kCFStringEncodingInvalidId)
+	if (cached) {
+		auto found = _encodingsByIANACharSetName.find(std::string_view(utf8Name));
+
+		if (found != _encodingsByIANACharSetName.end())
+			return New(env, found->second);
+	}
+
+	auto encoding = iccf->backend.encodingForIANACharSetName(utf8Name);
+
+	if (encoding == kEncodingInvalidId)
 		throw iccf->newUnrecognizedEncodingError(env, name, Iccf::EncodingSpecifierKind::IANACharSetName);
-	else
-		return New(env, encoding);
+
+	// Only recognized names are remembered, and only once however they're capitalized, so the table can't grow past the backend's list of names.
+	if (cached) {
+		std::string key { std::string_view(utf8Name) };
+		std::transform(key.begin(), key.end(), key.begin(), lowerASCII);
+		_encodingsByIANACharSetName.emplace(std::move(key), encoding);
+	}
+
+	return New(env, encoding);
 }
 
 Napi::Value StringEncoding::byWindowsCodepage(const Napi::CallbackInfo &info) {
 	const auto _class = StringEncodingClass::ForMethodCall(info);
-	UInt32 codepage = info[0].As<Napi::Number>();
-	auto encoding = CFStringConvertWindowsCodepageToEncoding(codepage);
+	uint32_t codepage = info[0].As<Napi::Number>();
+	auto encoding = _class->iccf->backend.encodingForWindowsCodepage(codepage);
 
-	if (encoding == kCFStringEncodingInvalidId)
+	if (encoding == kEncodingInvalidId)
 		throw _class->iccf->newUnrecognizedEncodingError(info.Env(), info[0], Iccf::EncodingSpecifierKind::WindowsCodepage);
 	else
 		return _class->New(info.Env(), encoding)->Value();
@@ -327,9 +632,9 @@ Napi::Value StringEncoding::byNSStringEncoding(const Napi::CallbackInfo &info) {
 		if (nsEncoding < 0)
 			throw Unrecognized();
 
-		auto encoding = CFStringConvertNSStringEncodingToEncoding(nsEncoding);
+		auto encoding = _class->iccf->backend.encodingForNSStringEncoding(nsEncoding);
 
-		if (encoding == kCFStringEncodingInvalidId)
+		if (encoding == kEncodingInvalidId)
 			throw Unrecognized();
 		else
 			return _class->New(info.Env(), encoding)->Value();
@@ -339,9 +644,21 @@ Napi::Value StringEncoding::byNSStringEncoding(const Napi::CallbackInfo &info) {
 	}
 }
 
+Napi::Value StringEncoding::all(const Napi::CallbackInfo &info) {
+	const auto _class = StringEncodingClass::ForMethodCall(info);
+	const auto env = info.Env();
+	const auto encodings = _class->iccf->backend.availableEncodings();
+	auto result = Napi::Array::New(env, encodings.size());
+
+	for (size_t index = 0; index < encodings.size(); index++)
+		result.Set(static_cast<uint32_t>(index), _class->New(env, encodings[index])->Value());
+
+	return result;
+}
+
 Napi::Value StringEncoding::system(const Napi::CallbackInfo &info) {
 	const auto _class = StringEncodingClass::ForMethodCall(info);
-	return _class->New(info.Env(), CFStringGetSystemEncoding())->Value();
+	return _class->New(info.Env(), _class->iccf->backend.systemEncoding())->Value();
 }
 
 Napi::Value StringEncoding::hasInstance(const Napi::CallbackInfo &info) {
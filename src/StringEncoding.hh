@@ -1,14 +1,30 @@
 #pragma once
 
 #include "napi.hh"
-#include "CFHandle.hh"
+#include "Backend.hh"
 #include "string-utils.hh"
+#include <functional>
+#include <map>
+#include <memory>
 #include <optional>
-#include <CoreFoundation/CFString.h>
+#include <unordered_map>
 
 struct Iccf;
+struct DecodeOptions;
 class StringEncoding;
 
+/** Location of the bytes in a `Buffer`, `ArrayBuffer`, `DataView`, or `Uint8Array`. */
+struct BufferContents {
+	const uint8_t *data;
+	size_t length;
+};
+
+/** Information about an encoding that is looked up from the backend the first time it's needed, then kept. */
+struct EncodingMetadata {
+	std::optional<std::string> ianaCharSetName;
+	std::string name;
+};
+
 class StringEncodingClass {
 	static const void * const MAGIC;
 	const void * const magic;
@@ -16,16 +32,41 @@ class StringEncodingClass {
 	public:
 	const Iccf * const iccf;
 
+	struct InternEntry {
+		StringEncoding *instance;
+		Napi::ObjectReference weakRef;
+	};
+
+	/** Live instances, by encoding. Each instance removes itself from here when it's garbage collected, unless the table is already gone by then. */
+	using InternTable = std::unordered_map<EncodingId, InternEntry>;
+
 	private:
 	const Napi::FunctionReference _constructor;
+	const std::shared_ptr<InternTable> _interned;
+	mutable std::unordered_map<EncodingId, EncodingMetadata> _metadata;
+
+	/** Orders names as if they were in ASCII lower case, which is how they are compared. */
+	struct NameLess {
+		using is_transparent = void;
+		bool operator()(std::string_view a, std::string_view b) const noexcept;
+	};
+
+	/** Names that the backend has recognized already, in ASCII lower case, so that names differing only in case share an entry. This is only used if the backend's own lookup isn't cheap (see `Backend::isNameLookupCheap`). It's ordered, rather than hashed, so that it can be searched with a `std::string_view` without making a `std::string` first. */
+	mutable std::map<std::string, EncodingId, NameLess> _encodingsByIANACharSetName;
 
 	public:
 	StringEncodingClass(Napi::Env env, Iccf *iccf);
-	StringEncoding *New(Napi::Env env, CFStringEncoding encoding) const;
+
+	/** Returns the existing instance for the given encoding, if there is one that hasn't been garbage collected yet, or else creates one. */
+	StringEncoding *New(Napi::Env env, EncodingId encoding) const;
 	StringEncoding *byIANACharSetName(const Napi::String name) const;
+	const EncodingMetadata &metadata(EncodingId encoding) const;
 	std::optional<StringEncoding *> Unwrap(Napi::Value wrapper, bool acceptStrings = true) const;
 	StringEncoding *UnwrapOrThrow(Napi::Value wrapper, bool acceptStrings = true) const;
 
+	/** Finds the bytes of some encoded text, throwing a `TypeError` if it isn't a suitable buffer. For when there's no `StringEncoding` at hand; otherwise, see `StringEncoding::bufferContents`. */
+	BufferContents bufferContents(Napi::Value text) const;
+
 	inline Napi::Function constructor() const {
 		return _constructor.Value();
 	}
@@ -45,6 +86,14 @@ class StringEncoding : public Napi::ObjectWrap<StringEncoding> {
 	Napi::Value nsStringEncoding(const Napi::CallbackInfo &info);
 	Napi::Value decode(const Napi::CallbackInfo &info);
 	Napi::Value encode(const Napi::CallbackInfo &info);
+	Napi::Value tryDecode(const Napi::CallbackInfo &info);
+	Napi::Value tryEncode(const Napi::CallbackInfo &info);
+	Napi::Value isValid(const Napi::CallbackInfo &info);
+	Napi::Value validLength(const Napi::CallbackInfo &info);
+	Napi::Value canEncode(const Napi::CallbackInfo &info);
+	Napi::Value encodableLength(const Napi::CallbackInfo &info);
+	Napi::Value decodeAsync(const Napi::CallbackInfo &info);
+	Napi::Value encodeAsync(const Napi::CallbackInfo &info);
 	Napi::Value toPrimitive(const Napi::CallbackInfo &info);
 	Napi::Value name(const Napi::CallbackInfo &info);
 
@@ -52,46 +101,57 @@ class StringEncoding : public Napi::ObjectWrap<StringEncoding> {
 	static Napi::Value byIANACharSetName(const Napi::CallbackInfo &info);
 	static Napi::Value byWindowsCodepage(const Napi::CallbackInfo &info);
 	static Napi::Value byNSStringEncoding(const Napi::CallbackInfo &info);
+	static Napi::Value all(const Napi::CallbackInfo &info);
 	static Napi::Value system(const Napi::CallbackInfo &info);
 	static Napi::Value hasInstance(const Napi::CallbackInfo &info);
 
 	StringEncoding(const Napi::CallbackInfo &info);
 	~StringEncoding();
 
+	/** The intern table this instance is in. */
+	std::weak_ptr<StringEncodingClass::InternTable> _internedIn;
+
+	/** JavaScript values of properties that have been computed once already. */
+	Napi::ObjectReference _cache;
+
+	Napi::Object cache(Napi::Env env);
+
 	class ConstructorCookie {
 		const void *magic;
 
 		public:
-		const CFStringEncoding encoding;
-		ConstructorCookie(CFStringEncoding encoding);
+		const EncodingId encoding;
+		ConstructorCookie(EncodingId encoding);
 		static ConstructorCookie *ForCtorCall(const Napi::CallbackInfo &info);
 	};
 
 	public:
 	const StringEncodingClass * const _class;
-	const CFStringEncoding _cfStringEncoding;
+	const EncodingId _cfStringEncoding;
 
-	inline operator CFStringEncoding() const {
+	inline operator EncodingId() const {
 		return _cfStringEncoding;
 	}
 
+	const Backend &backend() const;
+
 	std::optional<Napi::String> ianaCharSetName(const Napi::Env &env);
 	Napi::String name(const Napi::Env &env);
 
-	Napi::Buffer<uint8_t> cfEncode(
+	Napi::Buffer<uint8_t> encodeText(
 		Napi::Env env,
-		CFStringRef text,
-		UInt8 lossByte = 0,
-		std::function<Napi::Value(CFStringRef, Napi::Env)> origString = CFStringToNapiString
+		std::u16string_view text,
+		uint8_t lossByte = 0,
+		std::function<Napi::Value(std::u16string_view, Napi::Env)> origString = UTF16ToNapiString
 	) const;
 
-	inline Napi::Buffer<uint8_t> cfEncode(
+	inline Napi::Buffer<uint8_t> encodeText(
 		Napi::Env env,
-		CFStringRef text,
-		UInt8 lossByte,
+		std::u16string_view text,
+		uint8_t lossByte,
 		Napi::Value origString
 	) const {
-		return cfEncode(
+		return encodeText(
 			env,
 			text,
 			lossByte,
@@ -101,12 +161,12 @@ class StringEncoding : public Napi::ObjectWrap<StringEncoding> {
 		);
 	}
 
-	inline Napi::Buffer<uint8_t> cfEncode(
+	inline Napi::Buffer<uint8_t> encodeText(
 		Napi::Env env,
-		CFStringRef text,
+		std::u16string_view text,
 		Napi::Value origString
 	) const {
-		return cfEncode(
+		return encodeText(
 			env,
 			text,
 			0,
@@ -114,7 +174,24 @@ class StringEncoding : public Napi::ObjectWrap<StringEncoding> {
 		);
 	}
 
-	CFStringHandle cfDecode(Napi::Value text) const;
+	/** Finds the bytes of the given encoded text, throwing a `TypeError` if it isn't a suitable buffer. */
+	inline BufferContents bufferContents(Napi::Value text) const {
+		return _class->bufferContents(text);
+	}
+
+	DecodedText decodeText(Napi::Value text) const;
+	DecodedText decodeText(Napi::Value text, BufferContents contents) const;
+
+	/** Like the other `decodeText`, but as the given options say. If they aren't `fatal`, invalid sequences are replaced instead of throwing an error, and the options' `replacements` object is told how many. */
+	DecodedText decodeText(Napi::Value text, BufferContents contents, const DecodeOptions &options) const;
+
+	/** Whether encoding text that is entirely ASCII (or decoding bytes that are all less than 0x80) is just a copy. */
+	inline bool isASCIICompatible() const {
+		return backend().isASCIICompatible(_cfStringEncoding);
+	}
+
+	/** Whether the given encoded text can be copied instead of decoded, because this encoding is ASCII-compatible and the text is all ASCII. Counts towards `Stats::FastPath::ascii`. */
+	bool isCopyableASCII(BufferContents contents) const;
 };
 
 #include "iccf.hh"
@@ -0,0 +1,413 @@
+#include "ascii.hh"
+#include <cstring>
+
+#if defined(__x86_64__)
+#define ICCF_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+// Every AArch64 processor has NEON. 32-bit ARM processors might too, but they lack the across-vector instructions (such as vmaxvq_u8) used here.
+#define ICCF_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+	size_t asciiPrefixLengthScalar(const uint8_t *bytes, size_t length, size_t i) noexcept {
+		for (; i < length; i++) {
+			if (bytes[i] >= 0x80)
+				break;
+		}
+		return i;
+	}
+
+	size_t asciiPrefixLengthScalar(const char16_t *text, size_t length, size_t i) noexcept {
+		for (; i < length; i++) {
+			if (text[i] >= 0x80)
+				break;
+		}
+		return i;
+	}
+
+#ifdef ICCF_X86
+	// AVX2 is chosen at run time, so that the same binary still works on x86 processors that lack it.
+	const bool hasAVX2 = [] () {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+	}();
+
+	__attribute__((target("avx2")))
+	size_t asciiPrefixLengthAVX2(const uint8_t *bytes, size_t length) noexcept {
+		size_t i = 0;
+		for (; i + 32 <= length; i += 32) {
+			const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i))));
+			if (mask != 0)
+				return i + __builtin_ctz(mask);
+		}
+		return asciiPrefixLengthScalar(bytes, length, i);
+	}
+
+	__attribute__((target("avx2")))
+	size_t asciiPrefixLengthAVX2(const char16_t *text, size_t length) noexcept {
+		const auto highBits = _mm256_set1_epi16(static_cast<short>(0xff80));
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16) {
+			const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+			const auto isASCII = _mm256_cmpeq_epi16(_mm256_and_si256(v, highBits), _mm256_setzero_si256());
+			const auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(isASCII));
+			if (mask != 0)
+				return i + __builtin_ctz(mask) / 2;
+		}
+		return asciiPrefixLengthScalar(text, length, i);
+	}
+
+	__attribute__((target("avx2")))
+	void latin1ToUTF16AVX2(const uint8_t *in, size_t length, char16_t *out) noexcept {
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepu8_epi16(v));
+		}
+		for (; i < length; i++)
+			out[i] = in[i];
+	}
+#endif
+}
+
+size_t asciiPrefixLength(const uint8_t *bytes, size_t length) noexcept {
+	size_t i = 0;
+
+#if defined(ICCF_X86)
+	if (hasAVX2)
+		return asciiPrefixLengthAVX2(bytes, length);
+
+	for (; i + 16 <= length; i += 16) {
+		const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i))));
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+#elif defined(ICCF_NEON)
+	for (; i + 16 <= length; i += 16) {
+		if (vmaxvq_u8(vld1q_u8(bytes + i)) >= 0x80)
+			break;
+	}
+#else
+	// Check eight bytes at a time.
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		__builtin_memcpy(&word, bytes + i, 8);
+		if ((word & 0x8080808080808080ULL) != 0)
+			break;
+	}
+#endif
+
+	return asciiPrefixLengthScalar(bytes, length, i);
+}
+
+size_t asciiPrefixLength(const char16_t *text, size_t length) noexcept {
+	size_t i = 0;
+
+#if defined(ICCF_X86)
+	if (hasAVX2)
+		return asciiPrefixLengthAVX2(text, length);
+
+	const auto highBits = _mm_set1_epi16(static_cast<short>(0xff80));
+	for (; i + 8 <= length; i += 8) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+		const auto isASCII = _mm_cmpeq_epi16(_mm_and_si128(v, highBits), _mm_setzero_si128());
+		const auto mask = ~static_cast<uint32_t>(_mm_movemask_epi8(isASCII)) & 0xffff;
+		if (mask != 0)
+			return i + __builtin_ctz(mask) / 2;
+	}
+#elif defined(ICCF_NEON)
+	for (; i + 8 <= length; i += 8) {
+		if (vmaxvq_u16(vld1q_u16(reinterpret_cast<const uint16_t *>(text + i))) >= 0x80)
+			break;
+	}
+#endif
+
+	return asciiPrefixLengthScalar(text, length, i);
+}
+
+void latin1ToUTF16(const uint8_t *in, size_t length, char16_t *out) noexcept {
+	size_t i = 0;
+
+#if defined(ICCF_X86)
+	if (hasAVX2)
+		return latin1ToUTF16AVX2(in, length, out);
+
+	for (; i + 16 <= length; i += 16) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+	}
+#elif defined(ICCF_NEON)
+	for (; i + 16 <= length; i += 16) {
+		const auto v = vld1q_u8(in + i);
+		vst1q_u16(reinterpret_cast<uint16_t *>(out + i), vmovl_u8(vget_low_u8(v)));
+		vst1q_u16(reinterpret_cast<uint16_t *>(out + i + 8), vmovl_u8(vget_high_u8(v)));
+	}
+#endif
+
+	for (; i < length; i++)
+		out[i] = in[i];
+}
+
+void utf16ToLatin1(const char16_t *in, size_t length, uint8_t *out) noexcept {
+	size_t i = 0;
+
+#if defined(ICCF_X86)
+	for (; i + 16 <= length; i += 16) {
+		const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(a, b));
+	}
+#elif defined(ICCF_NEON)
+	for (; i + 8 <= length; i += 8)
+		vst1_u8(out + i, vmovn_u16(vld1q_u16(reinterpret_cast<const uint16_t *>(in + i))));
+#endif
+
+	for (; i < length; i++)
+		out[i] = static_cast<uint8_t>(in[i]);
+}
+
+namespace {
+	bool mapBytesToUTF16Scalar(const uint8_t *in, size_t length, const char16_t *table, char16_t *out, size_t i) noexcept {
+		char16_t unmapped = 0;
+
+		// Check for unmapped bytes once at the end, rather than branching on every byte.
+		for (; i < length; i++) {
+			const char16_t c = table[in[i]];
+			out[i] = c;
+			unmapped |= c == 0xffff;
+		}
+
+		return !unmapped;
+	}
+
+#ifdef ICCF_X86
+	__attribute__((target("avx2")))
+	bool mapBytesToUTF16AVX2(const uint8_t *in, size_t length, const char16_t *table, char16_t *out) noexcept {
+		// Gather 32-bit words starting at each table entry, and keep the low half. This is why the table needs an extra entry at the end.
+		const auto base = reinterpret_cast<const int *>(table);
+		const auto lowHalf = _mm256_set1_epi32(0xffff);
+		auto unmapped = _mm256_setzero_si256();
+		size_t i = 0;
+
+		for (; i + 16 <= length; i += 16) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			const auto lo = _mm256_and_si256(_mm256_i32gather_epi32(base, _mm256_cvtepu8_epi32(v), 2), lowHalf);
+			const auto hi = _mm256_and_si256(_mm256_i32gather_epi32(base, _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), 2), lowHalf);
+			unmapped = _mm256_or_si256(unmapped, _mm256_or_si256(_mm256_cmpeq_epi32(lo, lowHalf), _mm256_cmpeq_epi32(hi, lowHalf)));
+
+			// packus works within each 128-bit lane, so put the 64-bit quarters back in order afterward.
+			const auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+		}
+
+		return _mm256_testz_si256(unmapped, unmapped) && mapBytesToUTF16Scalar(in, length, table, out, i);
+	}
+#endif
+}
+
+bool mapBytesToUTF16(const uint8_t *in, size_t length, const char16_t *table, char16_t *out) noexcept {
+#ifdef ICCF_X86
+	if (hasAVX2)
+		return mapBytesToUTF16AVX2(in, length, table, out);
+#endif
+
+	return mapBytesToUTF16Scalar(in, length, table, out, 0);
+}
+
+namespace {
+	inline uint32_t loadUnit(const uint8_t *bytes, UnitLayout layout) noexcept {
+		uint32_t value = 0;
+		for (size_t k = 0; k < layout.size; k++)
+			value |= uint32_t(bytes[k]) << ((layout.littleEndian ? k : layout.size - 1 - k) * 8);
+		return value;
+	}
+
+	inline void storeUnit(uint8_t *bytes, UnitLayout layout, uint32_t value) noexcept {
+		for (size_t k = 0; k < layout.size; k++)
+			bytes[k] = static_cast<uint8_t>(value >> ((layout.littleEndian ? k : layout.size - 1 - k) * 8));
+	}
+
+	size_t asciiPrefixLengthScalar(const uint8_t *bytes, size_t units, UnitLayout layout, size_t i) noexcept {
+		for (; i < units; i++) {
+			if (loadUnit(bytes + i * layout.size, layout) >= 0x80)
+				break;
+		}
+		return i;
+	}
+
+#if defined(ICCF_X86) || defined(ICCF_NEON)
+	/** A 16-byte mask of the bits that must be zero in every code unit of an ASCII character: the high bit of the least significant byte, and all of the other bytes. */
+	inline void nonASCIIBits(UnitLayout layout, uint8_t pattern[16]) noexcept {
+		for (size_t j = 0; j < 16; j++) {
+			const size_t k = j % layout.size;
+			const size_t significance = layout.littleEndian ? k : layout.size - 1 - k;
+			pattern[j] = significance == 0 ? 0x80 : 0xff;
+		}
+	}
+#endif
+}
+
+size_t asciiPrefixLength(const uint8_t *bytes, size_t units, UnitLayout layout) noexcept {
+	if (layout.size == 1)
+		return asciiPrefixLength(bytes, units);
+
+	size_t i = 0;
+
+#if defined(ICCF_X86) || defined(ICCF_NEON)
+	const size_t perVector = 16 / layout.size;
+	uint8_t patternBytes[16];
+	nonASCIIBits(layout, patternBytes);
+#endif
+
+#if defined(ICCF_X86)
+	const auto pattern = _mm_loadu_si128(reinterpret_cast<const __m128i *>(patternBytes));
+	for (; i + perVector <= units; i += perVector) {
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i * layout.size));
+		const auto clear = _mm_cmpeq_epi8(_mm_and_si128(v, pattern), _mm_setzero_si128());
+		const auto mask = ~static_cast<uint32_t>(_mm_movemask_epi8(clear)) & 0xffff;
+		if (mask != 0)
+			return i + __builtin_ctz(mask) / layout.size;
+	}
+#elif defined(ICCF_NEON)
+	const auto pattern = vld1q_u8(patternBytes);
+	for (; i + perVector <= units; i += perVector) {
+		if (vmaxvq_u8(vandq_u8(vld1q_u8(bytes + i * layout.size), pattern)) != 0)
+			break;
+	}
+#endif
+
+	return asciiPrefixLengthScalar(bytes, units, layout, i);
+}
+
+void convertASCII(const uint8_t *in, UnitLayout inLayout, size_t units, uint8_t *out, UnitLayout outLayout) noexcept {
+	// Both layouts are the same, or differ only in the byte order of one-byte units.
+	if (inLayout.size == outLayout.size && (inLayout.size == 1 || inLayout.littleEndian == outLayout.littleEndian)) {
+		std::memcpy(out, in, units * inLayout.size);
+		return;
+	}
+
+	size_t i = 0;
+
+#if defined(ICCF_X86)
+	const auto zero = _mm_setzero_si128();
+
+	if (inLayout.size == 1 && outLayout.size == 2) {
+		for (; i + 16 <= units; i += 16) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			const auto lo = outLayout.littleEndian ? _mm_unpacklo_epi8(v, zero) : _mm_unpacklo_epi8(zero, v);
+			const auto hi = outLayout.littleEndian ? _mm_unpackhi_epi8(v, zero) : _mm_unpackhi_epi8(zero, v);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2 + 16), hi);
+		}
+	}
+	else if (inLayout.size == 2 && outLayout.size == 1) {
+		for (; i + 16 <= units; i += 16) {
+			auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+			auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2 + 16));
+			if (!inLayout.littleEndian) {
+				a = _mm_srli_epi16(a, 8);
+				b = _mm_srli_epi16(b, 8);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(a, b));
+		}
+	}
+	else if (inLayout.size == 1 && outLayout.size == 4) {
+		for (; i + 16 <= units; i += 16) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+			const auto lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+			__m128i quarters[4] = {
+				_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+				_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+			};
+			for (int q = 0; q < 4; q++) {
+				if (!outLayout.littleEndian)
+					quarters[q] = _mm_slli_epi32(quarters[q], 24);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4 + q * 16), quarters[q]);
+			}
+		}
+	}
+	else if (inLayout.size == 4 && outLayout.size == 1) {
+		for (; i + 16 <= units; i += 16) {
+			__m128i quarters[4];
+			for (int q = 0; q < 4; q++) {
+				quarters[q] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4 + q * 16));
+				if (!inLayout.littleEndian)
+					quarters[q] = _mm_srli_epi32(quarters[q], 24);
+			}
+			const auto lo = _mm_packs_epi32(quarters[0], quarters[1]), hi = _mm_packs_epi32(quarters[2], quarters[3]);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+	else if (inLayout.size == 2 && outLayout.size == 4) {
+		for (; i + 8 <= units; i += 8) {
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+			if (!inLayout.littleEndian)
+				v = _mm_srli_epi16(v, 8);
+			auto lo = _mm_unpacklo_epi16(v, zero), hi = _mm_unpackhi_epi16(v, zero);
+			if (!outLayout.littleEndian) {
+				lo = _mm_slli_epi32(lo, 24);
+				hi = _mm_slli_epi32(hi, 24);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4 + 16), hi);
+		}
+	}
+	else if (inLayout.size == 4 && outLayout.size == 2) {
+		for (; i + 8 <= units; i += 8) {
+			auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4));
+			auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4 + 16));
+			if (!inLayout.littleEndian) {
+				lo = _mm_srli_epi32(lo, 24);
+				hi = _mm_srli_epi32(hi, 24);
+			}
+			auto v = _mm_packs_epi32(lo, hi);
+			if (!outLayout.littleEndian)
+				v = _mm_slli_epi16(v, 8);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), v);
+		}
+	}
+	else if (inLayout.size == 2) {
+		// Same size, opposite byte order.
+		for (; i + 8 <= units; i += 8) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+		}
+	}
+	else {
+		// Same size, opposite byte order. Only one byte of each unit is nonzero, so it just moves to the other end.
+		for (; i + 4 <= units; i += 4) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 4), inLayout.littleEndian ? _mm_slli_epi32(v, 24) : _mm_srli_epi32(v, 24));
+		}
+	}
+#elif defined(ICCF_NEON)
+	if (inLayout.size == 1 && outLayout.size == 2) {
+		for (; i + 16 <= units; i += 16) {
+			const auto v = vld1q_u8(in + i);
+			auto lo = vreinterpretq_u8_u16(vmovl_u8(vget_low_u8(v))), hi = vreinterpretq_u8_u16(vmovl_u8(vget_high_u8(v)));
+			if (!outLayout.littleEndian) {
+				lo = vrev16q_u8(lo);
+				hi = vrev16q_u8(hi);
+			}
+			vst1q_u8(out + i * 2, lo);
+			vst1q_u8(out + i * 2 + 16, hi);
+		}
+	}
+	else if (inLayout.size == 2 && outLayout.size == 1) {
+		for (; i + 8 <= units; i += 8) {
+			const auto v = vreinterpretq_u16_u8(vld1q_u8(in + i * 2));
+			vst1_u8(out + i, inLayout.littleEndian ? vmovn_u16(v) : vshrn_n_u16(v, 8));
+		}
+	}
+	else if (inLayout.size == 2 && outLayout.size == 2) {
+		for (; i + 8 <= units; i += 8)
+			vst1q_u8(out + i * 2, vrev16q_u8(vld1q_u8(in + i * 2)));
+	}
+#endif
+
+	for (; i < units; i++)
+		storeUnit(out + i * outLayout.size, outLayout, loadUnit(in + i * inLayout.size, inLayout));
+}
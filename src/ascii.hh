@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Vectorized helpers for runs of ASCII (or Latin-1) text, and for single-byte code page tables. These use AVX2 or SSE2 on x86, and NEON on ARM, with a portable fallback everywhere else.
+ */
+
+/** Returns the number of leading bytes that are ASCII (less than 0x80). */
+size_t asciiPrefixLength(const uint8_t *bytes, size_t length) noexcept;
+
+/** Returns the number of leading UTF-16 code units that are ASCII (less than 0x80). */
+size_t asciiPrefixLength(const char16_t *text, size_t length) noexcept;
+
+/** Widens Latin-1 bytes to UTF-16 code units. */
+void latin1ToUTF16(const uint8_t *in, size_t length, char16_t *out) noexcept;
+
+/** Narrows UTF-16 code units to bytes. Every code unit must be less than 0x100. */
+void utf16ToLatin1(const char16_t *in, size_t length, uint8_t *out) noexcept;
+
+/**
+ * Maps each byte through `table`, a 256-entry single-byte decoding table, and writes the resulting UTF-16 code units. Returns false if any of the bytes maps to 0xffff (an unmapped byte).
+ *
+ * `table` must be readable for one code unit past its end.
+ */
+bool mapBytesToUTF16(const uint8_t *in, size_t length, const char16_t *table, char16_t *out) noexcept;
+
+/** How a code unit is laid out in memory: its size in bytes (1, 2, or 4), and, if bigger than one byte, its byte order. */
+struct UnitLayout {
+	uint8_t size;
+	bool littleEndian;
+};
+
+/** Returns the number of leading code units that are ASCII, in text whose code units have the given layout. `bytes` need not be aligned. */
+size_t asciiPrefixLength(const uint8_t *bytes, size_t units, UnitLayout layout) noexcept;
+
+/** Copies ASCII code units from one layout to another. Every code unit must be less than 0x80. Neither pointer needs to be aligned. */
+void convertASCII(const uint8_t *in, UnitLayout inLayout, size_t units, uint8_t *out, UnitLayout outLayout) noexcept;
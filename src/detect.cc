@@ -0,0 +1,547 @@
+#include "Backend.hh"
+#include "PortableBackend.hh"
+#include "ascii.hh"
+#include <algorithm>
+#include <array>
+#include <bitset>
+
+namespace {
+	/** How plausible a character is as part of some text, in hundredths, so that sums are exact. The confidence in an encoding comes from the average of these over the characters it decodes to. */
+	constexpr int kCommon = 100, kLetter = 50, kPunctuation = 25, kMark = 25, kIdeograph = 10, kSyllable = 0, kSymbol = -25, kBoxDrawing = -50, kControl = -100;
+
+	/** Added for adjacent letters that don't belong together: a capital letter that follows a small one, as in `Ã©tÃ©` (UTF-8 read as ISO Latin 1); letters of different alphabets, as in `Ð¿Ñ€Ð¸`; or two accented Latin letters in a row, as in `ñîâåò` (Windows Cyrillic read as ISO Latin 1). The last does happen in real text, but rarely. */
+	constexpr int kCaseAnomaly = -100, kMixedAlphabets = -100, kAccentedRun = -50;
+
+	enum class LetterCase : uint8_t {
+		none,
+		lower,
+		upper
+	};
+
+	/** The case of a letter in the Latin, Greek, or Cyrillic alphabets. Other characters are `none`. This is a rough approximation of the Unicode character database that is good enough for scoring. */
+	LetterCase letterCase(char16_t c) noexcept {
+		const auto evenIsUpper = [c] {
+			return c & 1 ? LetterCase::lower : LetterCase::upper;
+		};
+
+		if (c >= 'a' && c <= 'z')
+			return LetterCase::lower;
+		else if (c >= 'A' && c <= 'Z')
+			return LetterCase::upper;
+		else if (c < 0xc0 || c == 0xd7 || c == 0xf7)
+			return LetterCase::none;
+		else if (c <= 0xde)
+			return LetterCase::upper;
+		else if (c <= 0xff)
+			return LetterCase::lower;
+		else if (c <= 0x17f) {
+			if (c == 0x130)
+				return LetterCase::upper;
+			else if (c == 0x131 || c == 0x138 || c == 0x149 || c == 0x17f)
+				return LetterCase::lower;
+			else if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e))
+				return c & 1 ? LetterCase::upper : LetterCase::lower;
+			else
+				return evenIsUpper();
+		}
+		else if (c >= 0x218 && c <= 0x21b)
+			return evenIsUpper();
+		else if (c == 0x386 || (c >= 0x388 && c <= 0x38f) || (c >= 0x391 && c <= 0x3ab))
+			return LetterCase::upper;
+		else if (c >= 0x3ac && c <= 0x3ce)
+			return LetterCase::lower;
+		else if (c >= 0x400 && c <= 0x42f)
+			return LetterCase::upper;
+		else if (c >= 0x430 && c <= 0x45f)
+			return LetterCase::lower;
+		else if ((c >= 0x490 && c <= 0x4bf) || (c >= 0x1e00 && c <= 0x1eff))
+			return evenIsUpper();
+		else
+			return LetterCase::none;
+	}
+
+	enum class Alphabet : uint8_t {
+		none,
+		latin,
+		greek,
+		cyrillic
+	};
+
+	/** Which alphabet a letter with case (see `letterCase`) belongs to. */
+	Alphabet alphabet(char16_t c) noexcept {
+		if (letterCase(c) == LetterCase::none)
+			return Alphabet::none;
+		else if (c >= 0x386 && c <= 0x3ce)
+			return Alphabet::greek;
+		else if (c >= 0x400 && c <= 0x4bf)
+			return Alphabet::cyrillic;
+		else
+			return Alphabet::latin;
+	}
+
+	/** The most frequent non-ASCII characters of the languages written in the encodings this library has tables for. Kana are always common, so they're handled separately. */
+	class CommonCharacters {
+		std::bitset<0x10000> _set;
+
+		public:
+		CommonCharacters() {
+			static const char16_t * const lists[] = {
+				// Western, Central European, Baltic, Turkish, Romanian, and Vietnamese.
+				u"éèàçêâîôûëïüäößñáíóúãõåøæœłśćźżąęńčřšžěůýőűășțşğıāēīūėįųğươđạảấầậắếềệịọỏốồộớờợụủứừự",
+				u"ÉÀÇÖÜÄ",
+				// Russian, Ukrainian, Bulgarian, and Serbian.
+				u"оеаинтсрвлкмдпуяыьіїєјћ",
+				// Greek.
+				u"αοιεντσρκπμλυηόάέίωςύ",
+				// Hebrew and Arabic.
+				u"יוהלארמבתנשעכדםן",
+				u"الميونرتبعدكسفهقحةى",
+				// Thai.
+				u"นาอรกเงมยลวดทสตะคไบปั่้",
+				// Simplified Chinese.
+				u"的一是不了在人有我他这个们中来上大为和国地到以说时要就出会可也你对生能而子那得于着下自之年过发后作里用道行所然家种事成方多经么去法学如都同现当没动面起看定天分还进好小部其些主样理心她本前开但因只从想实",
+				// Traditional Chinese.
+				u"這個們來為國說時會對於著過發後裡種經麼學現當沒動還進樣實開從與們問關頭見電話長們點",
+				// Japanese.
+				u"日本年月時会社者事見行間新聞記表",
+				// Korean.
+				u"이다는의에가고하을를지기서한로으도리사자시나인대수해게있정그아보것적일요라어전상들주부만없내제우면여원오화장과까계무위안성신동소문세회공경연중조구마개발모재미영선실후물말진습니했니"
+			};
+
+			for (const char16_t *list : lists) {
+				for (const char16_t *c = list; *c; c++)
+					_set.set(*c);
+			}
+		}
+
+		inline bool operator[](char16_t c) const noexcept {
+			return _set[c];
+		}
+	};
+
+	int plausibility(char16_t c) noexcept {
+		static const CommonCharacters common;
+
+		if (c < 0x20)
+			return c == '\t' || c == '\n' || c == '\r' ? kCommon : kControl;
+		else if (c < 0xa0)
+			return c < 0x80 ? kCommon : kControl;
+		else if (common[c])
+			return kCommon;
+
+		switch (letterCase(c)) {
+			case LetterCase::lower:
+			case LetterCase::upper:
+				return kLetter;
+			default:
+				break;
+		}
+
+		if (
+			(c >= 0x180 && c <= 0x24f) ||
+			(c >= 0x531 && c <= 0x587) ||
+			(c >= 0x5d0 && c <= 0x5ea) ||
+			(c >= 0x620 && c <= 0x64a) ||
+			(c >= 0x671 && c <= 0x6d3) ||
+			(c >= 0xe01 && c <= 0xe30) ||
+			(c >= 0xe32 && c <= 0xe33) ||
+			(c >= 0xe40 && c <= 0xe46)
+		)
+			return kLetter;
+		else if (
+			(c >= 0x300 && c <= 0x36f) ||
+			(c >= 0x591 && c <= 0x5c7) ||
+			(c >= 0x64b && c <= 0x65f) ||
+			c == 0xe31 ||
+			(c >= 0xe34 && c <= 0xe3a) ||
+			(c >= 0xe47 && c <= 0xe4e)
+		)
+			return kMark;
+		else if ((c >= 0x3041 && c <= 0x3096) || (c >= 0x30a1 && c <= 0x30fc))
+			return kCommon;
+		else if (c >= 0x4e00 && c <= 0x9fff)
+			return kIdeograph;
+		else if (c >= 0xac00 && c <= 0xd7a3)
+			return kSyllable;
+		else if (c >= 0xd800 && c <= 0xdfff)
+			// Supplementary characters, such as emoji. Neither here nor there.
+			return 0;
+		else if (
+			c == 0xa0 || c == 0xa1 || c == 0xab || c == 0xb0 || c == 0xbb || c == 0xbf ||
+			(c >= 0x2010 && c <= 0x203a) ||
+			(c >= 0x3000 && c <= 0x303f) ||
+			(c >= 0xff01 && c <= 0xff5e) ||
+			c == 0x60c || c == 0x61b || c == 0x61f || c == 0x5be || c == 0x2116
+		)
+			return kPunctuation;
+		else if (c >= 0x2500 && c <= 0x259f)
+			return kBoxDrawing;
+		else if (c >= 0xe000 && c <= 0xf8ff)
+			return kControl;
+		else
+			return kSymbol;
+	}
+
+	/** What scoring needs to know about a character. */
+	struct CharacterClass {
+		int8_t plausibility;
+		LetterCase letterCase;
+		Alphabet alphabet;
+	};
+
+	/** `CharacterClass` of every UTF-16 code unit, worked out once so that scoring is just a table lookup per character. */
+	class CharacterClasses {
+		std::vector<CharacterClass> _classes;
+
+		public:
+		CharacterClasses() : _classes(0x10000) {
+			for (size_t c = 0; c < _classes.size(); c++) {
+				const auto unit = static_cast<char16_t>(c);
+				_classes[c] = { static_cast<int8_t>(plausibility(unit)), letterCase(unit), alphabet(unit) };
+			}
+		}
+
+		inline const CharacterClass &operator[](char16_t c) const noexcept {
+			return _classes[c];
+		}
+	};
+
+	const CharacterClasses &characterClasses() {
+		static const CharacterClasses classes;
+		return classes;
+	}
+
+	/**
+	 * How implausible it is for one letter to follow the other in a word, as a negative number. Zero if nothing is wrong.
+	 *
+	 * @param bothNonASCII - Whether both characters are outside of ASCII.
+	 */
+	inline int adjacency(const CharacterClass &first, const CharacterClass &second, bool bothNonASCII) noexcept {
+		int penalty = 0;
+
+		if (first.letterCase == LetterCase::lower && second.letterCase == LetterCase::upper)
+			penalty += kCaseAnomaly;
+
+		if (first.alphabet != second.alphabet && first.alphabet != Alphabet::none && second.alphabet != Alphabet::none)
+			penalty += kMixedAlphabets;
+		else if (first.alphabet == Alphabet::latin && bothNonASCII)
+			penalty += kAccentedRun;
+
+		return penalty;
+	}
+
+	/** Running total of `plausibility` over some decoded text. */
+	struct Score {
+		int64_t sum = 0;
+
+		/** How many characters were scored. */
+		size_t count = 0;
+
+		/** Turns the average plausibility into a confidence, pulling it toward 1/2 when there's little to go on. */
+		double confidence() const noexcept {
+			if (count == 0)
+				return 0.5;
+
+			const double average = std::clamp(static_cast<double>(sum) / static_cast<double>(count) / kCommon, -1.0, 1.0);
+			const double weight = static_cast<double>(count) / static_cast<double>(count + 2);
+			return 0.5 + average / 2 * weight;
+		}
+	};
+
+	/**
+	 * Scores some decoded text.
+	 *
+	 * @param scoreASCII - Whether to score ASCII characters too. They're ignored when scoring ASCII-compatible encodings, since they'd be the same in all of them, but in UTF-16 and UTF-32 they're good evidence: random bytes rarely decode to ASCII in those.
+	 */
+	Score scoreText(std::u16string_view text, bool scoreASCII) noexcept {
+		const CharacterClasses &classes = characterClasses();
+		Score score;
+		char16_t previous = ' ';
+
+		for (const char16_t c : text) {
+			const CharacterClass &thisClass = classes[c];
+			const bool isASCII = c < 0x80;
+
+			if (!isASCII || scoreASCII) {
+				score.count++;
+				score.sum += thisClass.plausibility;
+			}
+
+			if (!isASCII || previous >= 0x80)
+				score.sum += adjacency(classes[previous], thisClass, !isASCII && previous >= 0x80);
+
+			previous = c;
+		}
+
+		return score;
+	}
+
+	/**
+	 * Byte counts from one pass over the sample, from which every ASCII-compatible single-byte encoding can be scored without decoding the sample in each.
+	 *
+	 * Besides how often each byte occurs, this counts adjacent pairs of letter bytes that involve at least one non-ASCII byte, for `adjacency`. To keep that table small, ASCII letters are collapsed into two symbols, one for each case, and non-ASCII bytes get one symbol each.
+	 */
+	struct ByteStatistics {
+		static constexpr size_t kSymbols = 2 + 0x80;
+		static constexpr uint16_t kNoSymbol = 0xffff;
+
+		std::array<size_t, 256> counts = {};
+		std::vector<uint32_t> pairs;
+
+		/** Which entries of `pairs` are non-zero, so that scoring needn't look at all of them. */
+		std::vector<uint16_t> pairList;
+
+		size_t nonASCII = 0, zeros = 0;
+
+		static inline uint16_t symbol(uint8_t b) noexcept {
+			if (b >= 0x80)
+				return static_cast<uint16_t>(2 + (b - 0x80));
+			else if (b >= 'a' && b <= 'z')
+				return 0;
+			else if (b >= 'A' && b <= 'Z')
+				return 1;
+			else
+				return kNoSymbol;
+		}
+
+		ByteStatistics(const uint8_t *bytes, size_t length) : pairs(kSymbols * kSymbols) {
+			for (size_t i = 0; i < length; i++)
+				zeros += bytes[i] == 0;
+
+			for (size_t i = 0; i < length;) {
+				const uint8_t b = bytes[i];
+
+				// ASCII is the same in every encoding scored this way, so runs of it are skipped in bulk. Only the letters at either end of a run matter, for pairs. Single ASCII characters, such as spaces between words, are common enough to be worth skipping without a call.
+				if (b < 0x80) {
+					i += i + 1 < length && bytes[i + 1] >= 0x80 ? 1 : asciiPrefixLength(bytes + i, length - i);
+					continue;
+				}
+
+				counts[b]++;
+				nonASCII++;
+
+				if (i > 0)
+					addPair(bytes[i - 1], b);
+				if (i + 1 < length && bytes[i + 1] < 0x80)
+					addPair(b, bytes[i + 1]);
+
+				i++;
+			}
+		}
+
+		private:
+		inline void addPair(uint8_t first, uint8_t second) {
+			const uint16_t a = symbol(first), b = symbol(second);
+
+			if (a == kNoSymbol || b == kNoSymbol)
+				return;
+
+			const uint16_t index = static_cast<uint16_t>(a * kSymbols + b);
+
+			if (pairs[index]++ == 0)
+				pairList.push_back(index);
+		}
+	};
+
+	/** What each non-ASCII byte decodes to in each ASCII-compatible single-byte encoding of the registry, or U+FFFF if it's unmapped, indexed by registry position. Entries for other encodings are left empty. */
+	class SingleByteMaps {
+		std::vector<std::array<char16_t, 0x80>> _maps;
+
+		public:
+		SingleByteMaps() {
+			PooledU16String decoded;
+
+			for (const auto &entry : PortableBackend::all()) {
+				auto &map = _maps.emplace_back();
+
+				if (!entry.codec.isSingleByte() || !entry.codec.isASCIICompatible())
+					continue;
+
+				for (unsigned b = 0x80; b < 0x100; b++) {
+					const uint8_t byte = static_cast<uint8_t>(b);
+
+					decoded.clear();
+					map[b - 0x80] = entry.codec.decode(&byte, 1, decoded) ? decoded[0] : char16_t(0xffff);
+				}
+			}
+		}
+
+		inline const std::array<char16_t, 0x80> &operator[](const EncodingInfo &entry) const noexcept {
+			return _maps[static_cast<size_t>(&entry - PortableBackend::all().begin())];
+		}
+	};
+
+	/** Scores an ASCII-compatible single-byte encoding from the statistics. Returns false if the sample contains a byte that's unmapped in it. */
+	bool scoreSingleByte(const std::array<char16_t, 0x80> &map, const ByteStatistics &statistics, Score &score) noexcept {
+		const CharacterClasses &classes = characterClasses();
+
+		for (size_t b = 0x80; b < 0x100; b++) {
+			const size_t count = statistics.counts[b];
+
+			if (count == 0)
+				continue;
+			else if (map[b - 0x80] == 0xffff)
+				return false;
+
+			score.sum += static_cast<int64_t>(count) * classes[map[b - 0x80]].plausibility;
+		}
+
+		score.count = statistics.nonASCII;
+
+		const auto symbolClass = [&] (size_t symbol) -> const CharacterClass & {
+			return classes[symbol == 0 ? u'a' : symbol == 1 ? u'A' : map[symbol - 2]];
+		};
+
+		for (const uint16_t index : statistics.pairList) {
+			const size_t first = index / ByteStatistics::kSymbols, second = index % ByteStatistics::kSymbols;
+			score.sum += static_cast<int64_t>(statistics.pairs[index]) * adjacency(symbolClass(first), symbolClass(second), first >= 2 && second >= 2);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Decodes the sample in the given encoding, using this library's own codec if it has one. If the sample was cut off from longer input, up to three bytes at the end may be dropped to make it valid, since the cut may have fallen in the middle of a character.
+	 *
+	 * @returns Whether the sample is valid in the encoding.
+	 */
+	bool decodeSample(const Backend &backend, EncodingId encoding, const uint8_t *bytes, size_t length, bool truncated, PooledU16String &out) {
+		auto const entry = PortableBackend::info(encoding);
+		const size_t maxTrim = truncated ? std::min<size_t>(3, length) : 0;
+
+		for (size_t trim = 0; trim <= maxTrim; trim++) {
+			out.clear();
+
+			if (entry != nullptr && entry->codec.isAvailable()) {
+				if (entry->codec.decode(bytes, length - trim, out))
+					return true;
+			}
+			else if (auto decoded = backend.decode(encoding, bytes, length - trim)) {
+				out.assign(std::u16string_view(*decoded));
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/** How to order encodings that are equally likely: UTF-8 first, then Windows code pages, which are the most widely used of the legacy encodings, then everything else. */
+	int preference(EncodingId encoding) noexcept {
+		if (encoding == kEncodingUTF8)
+			return 0;
+		else if (encoding == 0x0600)
+			return 1;
+		else if ((encoding & 0xff00) == 0x0500)
+			return 2;
+		else
+			return 3;
+	}
+}
+
+std::vector<DetectedEncoding> Backend::detectEncoding(const uint8_t *bytes, size_t length, const std::vector<EncodingId> &requestedCandidates, size_t sampleLength) const {
+	std::vector<EncodingId> candidates = requestedCandidates;
+
+	if (candidates.empty()) {
+		for (const auto &entry : PortableBackend::all()) {
+			if (isEncodingAvailable(entry.id))
+				candidates.push_back(entry.id);
+		}
+	}
+
+	const auto isCandidate = [&candidates] (EncodingId encoding) {
+		return std::find(candidates.begin(), candidates.end(), encoding) != candidates.end();
+	};
+
+	// A byte order mark settles it. The unmarked forms of UTF-16 and UTF-32 are the ones that understand byte order marks, so they're preferred, but a specific byte order will do. UTF-32 is checked first because its little-endian byte order mark starts with UTF-16's.
+	for (const auto [marked, littleEndian, bigEndian] : {
+		std::array<EncodingId, 3>{ kEncodingUTF32, kEncodingUTF32LE, kEncodingUTF32BE },
+		std::array<EncodingId, 3>{ kEncodingUTF16, kEncodingUTF16LE, kEncodingUTF16BE },
+		std::array<EncodingId, 3>{ kEncodingUTF8, kEncodingUTF8, kEncodingUTF8 }
+	}) {
+		size_t bomLength;
+		const EncodingId specific = skipByteOrderMark(marked, bytes, length, bomLength);
+
+		if (bomLength == 0)
+			continue;
+		else if (isCandidate(marked))
+			return { { marked, 1 } };
+		else if (isCandidate(specific))
+			return { { specific, 1 } };
+	}
+
+	const bool truncated = length > sampleLength;
+	const size_t sampled = std::min(length, sampleLength);
+	const ByteStatistics statistics(bytes, sampled);
+	const bool allASCII = statistics.nonASCII == 0 && statistics.zeros == 0;
+
+	// Text doesn't contain null characters, so a sample that's full of zero bytes is probably UTF-16 or UTF-32, and not any of the others. UTF-32 always has at least one zero byte in four.
+	const double zeroFraction = sampled == 0 ? 0 : static_cast<double>(statistics.zeros) / static_cast<double>(sampled);
+	const double legacyWeight = std::max(0.0, 1 - 4 * zeroFraction);
+
+	static const SingleByteMaps singleByteMaps;
+	std::vector<DetectedEncoding> result;
+	PooledU16String decoded;
+
+	for (const EncodingId encoding : candidates) {
+		// Without a byte order mark, these are just big-endian.
+		if (encoding == kEncodingUTF16 || encoding == kEncodingUTF32 || !isEncodingAvailable(encoding))
+			continue;
+
+		const bool isUTF16 = encoding == kEncodingUTF16BE || encoding == kEncodingUTF16LE;
+		const bool isUTF32 = encoding == kEncodingUTF32BE || encoding == kEncodingUTF32LE;
+
+		if (allASCII) {
+			// Nothing to tell the ASCII-compatible encodings apart. ASCII itself is the best answer, unless the rest of the input (past the sample) may not be ASCII.
+			if (encoding == 0x0600)
+				result.push_back({ encoding, truncated ? 0.9 : 1 });
+			else if (isASCIICompatible(encoding))
+				result.push_back({ encoding, 0.5 });
+			continue;
+		}
+
+		if (isUTF32 && zeroFraction < 0.25)
+			continue;
+
+		auto const entry = PortableBackend::info(encoding);
+		Score score;
+
+		if (entry != nullptr && entry->codec.isSingleByte() && entry->codec.isASCIICompatible()) {
+			if (!scoreSingleByte(singleByteMaps[*entry], statistics, score))
+				continue;
+		}
+		else if (encoding == kEncodingUTF8) {
+			// Valid UTF-8 hardly ever happens by accident, so the more multi-byte sequences there are, the more certain this is.
+			if (!decodeSample(*this, encoding, bytes, sampled, truncated, decoded))
+				continue;
+
+			const auto sequences = static_cast<size_t>(std::count_if(decoded.begin(), decoded.end(), [] (char16_t c) {
+				return c >= 0x80 && (c < 0xdc00 || c > 0xdfff);
+			}));
+
+			result.push_back({ encoding, sequences == 0 ? 0.5 * legacyWeight : std::min(0.999, 1 - 0.5 / static_cast<double>(sequences + 1)) });
+			continue;
+		}
+		else {
+			if (!decodeSample(*this, encoding, bytes, sampled, truncated, decoded))
+				continue;
+
+			score = scoreText(decoded, isUTF16 || isUTF32);
+		}
+
+		double confidence = score.confidence();
+
+		if (!isUTF16 && !isUTF32)
+			confidence *= legacyWeight;
+
+		result.push_back({ encoding, confidence });
+	}
+
+	std::stable_sort(result.begin(), result.end(), [] (const DetectedEncoding &a, const DetectedEncoding &b) {
+		if (a.confidence != b.confidence)
+			return a.confidence > b.confidence;
+		else
+			return preference(a.encoding) < preference(b.encoding);
+	});
+
+	return result;
+}
@@ -0,0 +1,335 @@
+#include "file.hh"
+#include "parallel.hh"
+#include "unicode.hh"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <functional>
+#include <optional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+	/** How many bytes of input to convert at a time. */
+	constexpr size_t kPieceLength = 1024 * 1024;
+
+	/** How many bytes of output to collect before writing them out. */
+	constexpr size_t kWriteLength = 4 * 1024 * 1024;
+
+	/** How many bytes of converted input to let go of at a time. */
+	constexpr size_t kReleaseLength = 32 * 1024 * 1024;
+
+	/** Thrown when a system call fails, and turned into a `FileConversionResult` by `convertFile`. */
+	struct SystemError {
+		int error;
+		const char *syscall;
+		const std::string &path;
+	};
+
+	/** The input file, mapped into memory. */
+	class InputFile {
+		int _fd = -1;
+		void *_mapping = MAP_FAILED;
+		size_t _length = 0, _released = 0;
+
+		public:
+		struct stat st;
+
+		InputFile(const std::string &path) {
+			_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (_fd < 0)
+				throw SystemError { errno, "open", path };
+
+			int error = 0;
+			const char *syscall = nullptr;
+
+			if (fstat(_fd, &st) != 0) {
+				error = errno;
+				syscall = "fstat";
+			}
+			else if (S_ISDIR(st.st_mode)) {
+				error = EISDIR;
+				syscall = "read";
+			}
+			else if (st.st_size < 0 || static_cast<uintmax_t>(st.st_size) > SIZE_MAX) {
+				error = EFBIG;
+				syscall = "mmap";
+			}
+			else if (st.st_size != 0) {
+				// An empty file can't be mapped, but there's nothing to map anyway.
+				_length = static_cast<size_t>(st.st_size);
+				_mapping = mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, _fd, 0);
+
+				if (_mapping == MAP_FAILED) {
+					error = errno;
+					syscall = "mmap";
+				}
+				else {
+					// This is only a hint, so it doesn't matter if it fails.
+					madvise(_mapping, _length, MADV_SEQUENTIAL);
+				}
+			}
+
+			// The destructor doesn't run if the constructor throws, so close the file here.
+			if (syscall != nullptr) {
+				close(_fd);
+				throw SystemError { error, syscall, path };
+			}
+		}
+
+		InputFile(const InputFile &) = delete;
+		InputFile &operator=(const InputFile &) = delete;
+
+		~InputFile() {
+			if (_mapping != MAP_FAILED)
+				munmap(_mapping, _length);
+			if (_fd >= 0)
+				close(_fd);
+		}
+
+		inline const uint8_t *bytes() const noexcept {
+			static const uint8_t empty = 0;
+			return _mapping != MAP_FAILED ? static_cast<const uint8_t *>(_mapping) : &empty;
+		}
+
+		inline size_t length() const noexcept {
+			return _length;
+		}
+
+		/** Says that the bytes before `offset` won't be looked at again, so their pages can be dropped from memory. */
+		void release(size_t offset) noexcept {
+			const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			const size_t end = offset - offset % pageSize;
+
+			if (_mapping != MAP_FAILED && end - _released >= kReleaseLength) {
+				madvise(static_cast<uint8_t *>(_mapping) + _released, end - _released, MADV_DONTNEED);
+				_released = end;
+			}
+		}
+	};
+
+	/** The output file, with a buffer that collects converted text so that it's written in big pieces. */
+	class OutputFile {
+		const std::string &_path;
+		int _fd = -1;
+		std::vector<uint8_t> _buffer;
+		bool _keep = true;
+
+		void writeFully(const uint8_t *bytes, size_t length) {
+			while (length != 0) {
+				const ssize_t written = ::write(_fd, bytes, length);
+
+				if (written < 0) {
+					if (errno == EINTR)
+						continue;
+					throw SystemError { errno, "write", _path };
+				}
+
+				bytes += written;
+				length -= static_cast<size_t>(written);
+			}
+		}
+
+		public:
+		size_t written = 0;
+
+		/** Opens the output file. It isn't truncated until `truncate` is called, in case it's the input file. */
+		OutputFile(const std::string &path)
+		: _path(path)
+		{
+			_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+			if (_fd < 0)
+				throw SystemError { errno, "open", path };
+		}
+
+		OutputFile(const OutputFile &) = delete;
+		OutputFile &operator=(const OutputFile &) = delete;
+
+		/** Whether this is the same file as `input`. */
+		bool isSameFileAs(const InputFile &input) const {
+			struct stat st;
+			if (fstat(_fd, &st) != 0)
+				throw SystemError { errno, "fstat", _path };
+
+			return st.st_dev == input.st.st_dev && st.st_ino == input.st.st_ino;
+		}
+
+		/** Empties the file. From then on, it's removed if it isn't finished. */
+		void truncate() {
+			if (ftruncate(_fd, 0) != 0)
+				throw SystemError { errno, "ftruncate", _path };
+
+			_keep = false;
+			_buffer.reserve(kWriteLength);
+		}
+
+		/** Closes the file. Unless `close` was called first, the file is removed if it was truncated, since it's incomplete. */
+		~OutputFile() {
+			if (_fd >= 0) {
+				::close(_fd);
+
+				if (!_keep)
+					unlink(_path.c_str());
+			}
+		}
+
+		void write(const uint8_t *bytes, size_t length) {
+			if (_buffer.size() + length > kWriteLength)
+				flush();
+
+			// Output that would fill the buffer by itself goes straight to the file.
+			if (length >= kWriteLength)
+				writeFully(bytes, length);
+			else
+				_buffer.insert(_buffer.end(), bytes, bytes + length);
+
+			written += length;
+		}
+
+		void flush() {
+			writeFully(_buffer.data(), _buffer.size());
+			_buffer.clear();
+		}
+
+		/** Writes out what's left in the buffer, and closes the file. */
+		void close() {
+			flush();
+
+			const int fd = _fd;
+			_fd = -1;
+
+			if (::close(fd) != 0 && errno != EINTR) {
+				unlink(_path.c_str());
+				throw SystemError { errno, "close", _path };
+			}
+		}
+	};
+
+	/**
+	 * Converts the input in pieces cut by a `TextChunker`, so that errors are found at the same offsets as `transcode` finds them.
+	 *
+	 * As in `parallelTranscode`, that means an unrepresentable character is only reported once the rest of the input has been checked for invalid text, unless both encodings are Unicode encodings.
+	 */
+	void convertChunked(const TextChunker &chunker, bool decodeFirst, const InputFile &input, OutputFile &output, uint8_t lossByte, const std::atomic<bool> &cancelled, FileConversionResult &result, const std::function<void(size_t)> &progress) {
+		const size_t length = input.length();
+		size_t start = 0;
+		std::optional<size_t> unrepresentableAt;
+
+		do {
+			if (cancelled) {
+				result.status = FileConversionResult::Status::cancelled;
+				return;
+			}
+
+			// If there's no boundary near the end of a piece, try again further on.
+			size_t end = length;
+			for (size_t target = start + kPieceLength; target < length; target += kPieceLength) {
+				if (const size_t boundary = chunker.boundary(start, target)) {
+					end = boundary;
+					break;
+				}
+			}
+
+			auto converted = chunker.convert(start, end, lossByte);
+
+			if (converted.status == ParallelTranscodeResult::Status::invalid || (converted.status != ParallelTranscodeResult::Status::ok && !decodeFirst)) {
+				result.status = converted.status == ParallelTranscodeResult::Status::invalid ? FileConversionResult::Status::invalid : FileConversionResult::Status::unrepresentable;
+				result.offset = converted.offset;
+				return;
+			}
+			else if (converted.status != ParallelTranscodeResult::Status::ok) {
+				if (!unrepresentableAt)
+					unrepresentableAt = converted.offset;
+			}
+			else if (!unrepresentableAt)
+				output.write(converted.bytes.data(), converted.bytes.size());
+
+			start = end;
+			progress(start);
+		}
+		while (start < length);
+
+		if (unrepresentableAt) {
+			result.status = FileConversionResult::Status::unrepresentable;
+			result.offset = *unrepresentableAt;
+		}
+	}
+
+	/** Converts the input with an incremental decoder and encoder, which works in any encoding, but can't tell where an error is. */
+	void convertIncrementally(const Backend &backend, EncodingId from, EncodingId to, const InputFile &input, OutputFile &output, uint8_t lossByte, const std::atomic<bool> &cancelled, FileConversionResult &result, const std::function<void(size_t)> &progress) {
+		const auto decoder = backend.newDecoder(from);
+		const auto encoder = backend.newEncoder(to, lossByte);
+		const size_t length = input.length();
+		PooledU16String text;
+		size_t start = 0;
+
+		do {
+			if (cancelled) {
+				result.status = FileConversionResult::Status::cancelled;
+				return;
+			}
+
+			const size_t end = std::min(length, start + kPieceLength);
+			const bool last = end == length;
+			text.clear();
+
+			if (!decoder->write(input.bytes() + start, end - start, last, text)) {
+				result.status = FileConversionResult::Status::invalid;
+				return;
+			}
+
+			auto const encoded = encoder->write(text, last);
+
+			if (!encoded) {
+				result.status = FileConversionResult::Status::unrepresentable;
+				return;
+			}
+
+			output.write(encoded->data(), encoded->size());
+			start = end;
+			progress(start);
+		}
+		while (start < length);
+	}
+}
+
+FileConversionResult convertFile(const Backend &backend, const std::string &inPath, const std::string &outPath, EncodingId from, EncodingId to, uint8_t lossByte, const std::atomic<bool> &cancelled) {
+	FileConversionResult result;
+
+	try {
+		InputFile input(inPath);
+		OutputFile output(outPath);
+
+		if (output.isSameFileAs(input)) {
+			result.status = FileConversionResult::Status::sameFile;
+			return result;
+		}
+
+		output.truncate();
+
+		const auto progress = [&input, &result] (size_t offset) {
+			result.bytesRead = offset;
+			input.release(offset);
+		};
+
+		if (auto const chunker = TextChunker::make(backend, from, to, input.bytes(), input.length()))
+			convertChunked(*chunker, !(isUnicodeEncoding(from) && isUnicodeEncoding(to)), input, output, lossByte, cancelled, result, progress);
+		else
+			convertIncrementally(backend, from, to, input, output, lossByte, cancelled, result, progress);
+
+		if (result.status == FileConversionResult::Status::ok) {
+			output.close();
+			result.bytesWritten = output.written;
+		}
+	}
+	catch (const SystemError &error) {
+		result.status = FileConversionResult::Status::systemError;
+		result.error = error.error;
+		result.syscall = error.syscall;
+		result.path = error.path;
+	}
+
+	return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Backend.hh"
+#include <atomic>
+#include <optional>
+#include <string>
+
+/** Outcome of a call to `convertFile`. */
+struct FileConversionResult {
+	enum class Status {
+		ok,
+
+		/** The input is not valid in the source encoding. */
+		invalid,
+
+		/** The input contains a character that can't be represented in the target encoding, and no loss byte was given. */
+		unrepresentable,
+
+		/** A system call failed. `error`, `syscall`, and `path` say which and why. */
+		systemError,
+
+		/** The input and output paths are the same file. */
+		sameFile,
+
+		/** The conversion was cancelled before it finished. */
+		cancelled
+	};
+
+	Status status = Status::ok;
+
+	/** Where the problem is in the input, if `status` is `invalid` or `unrepresentable`, and that's known. */
+	std::optional<size_t> offset;
+
+	/** If `status` is `systemError`, the `errno` value, the name of the function that failed, and the path it was given. */
+	int error = 0;
+	const char *syscall = nullptr;
+	std::string path;
+
+	/** How many bytes were read and written. */
+	size_t bytesRead = 0, bytesWritten = 0;
+};
+
+/**
+ * Converts the contents of one file into another, without holding either one in memory all at once.
+ *
+ * The input file is mapped into memory and converted a piece at a time. The converted text is collected into a buffer of a few megabytes, which is written out whenever it fills up. Pages of the input that have been converted are released as it goes, so memory use doesn't grow with the size of the file.
+ *
+ * Where `TextChunker` can cut the input into pieces, errors are found at the same offsets as `transcode` finds them, although in a file with both invalid text and unrepresentable characters, the first of them is reported, whichever it is. Otherwise, the input is converted with `Backend::newDecoder` and `Backend::newEncoder`, and where an error is isn't known.
+ *
+ * The output file is created if it doesn't exist, and replaced if it does. If the conversion fails or is cancelled, the output file is removed.
+ *
+ * @param cancelled - Checked between pieces. If it becomes true, the conversion stops.
+ */
+FileConversionResult convertFile(const Backend &backend, const std::string &inPath, const std::string &outPath, EncodingId from, EncodingId to, uint8_t lossByte, const std::atomic<bool> &cancelled);
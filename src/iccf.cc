@@ -1,14 +1,161 @@
 #include "iccf.hh"
 #include "StringEncoding.hh"
 #include "transcode.hh"
+#include "incremental.hh"
+#include "MultiByteTables.hh"
+#include "parallel.hh"
+#include "pool.hh"
+#include "stats.hh"
 #include "napi.hh"
+#include <limits>
 #include <sstream>
 
 static Napi::Value encodingExists(const Napi::CallbackInfo &info) {
-	auto jsEncodingName = info[0].As<Napi::String>();
-	auto encodingName = NapiStringToCFString(jsEncodingName);
-	auto encoding = CFStringConvertIANACharSetNameToEncoding(encodingName);
-	return Napi::Boolean::New(info.Env(), encoding != kCFStringEncodingInvalidId);
+	const auto iccf = reinterpret_cast<Iccf *>(info.Data());
+	const NapiStringToShortUTF8 encodingName(info[0].As<Napi::String>());
+	auto encoding = iccf->backend.encodingForIANACharSetName(encodingName);
+	return Napi::Boolean::New(info.Env(), encoding != kEncodingInvalidId);
+}
+
+static Napi::Value setExternalStringThreshold(const Napi::CallbackInfo &info) {
+	const auto iccf = reinterpret_cast<Iccf *>(info.Data());
+	const double threshold = info[0].As<Napi::Number>().DoubleValue();
+
+	// The negated comparison also catches NaN.
+	if (!(threshold >= 0))
+		throw Napi::RangeError::New(info.Env(), "The external string threshold must not be negative.");
+
+	iccf->externalStringThreshold = threshold >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(threshold);
+	return info.Env().Undefined();
+}
+
+static Napi::Value setStatsEnabled(const Napi::CallbackInfo &info) {
+	Stats::setEnabled(info[0].ToBoolean());
+	return info.Env().Undefined();
+}
+
+static Napi::Value getStats(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = reinterpret_cast<Iccf *>(info.Data());
+	const auto snapshot = Stats::collect();
+
+	static const char *const operationNames[Stats::kOperationCount] = { "decode", "encode", "transcode" };
+	static const char *const fastPathNames[Stats::kFastPathCount] = { "ascii", "contiguousText", "externalString" };
+
+	auto operations = Napi::Array::New(env, snapshot.entries.size());
+	for (size_t index = 0; index < snapshot.entries.size(); index++) {
+		const auto &entry = snapshot.entries[index];
+		const auto &counters = entry.counters;
+
+		auto latency = Napi::Array::New(env, Stats::kLatencyBuckets);
+		for (uint32_t bucket = 0; bucket < Stats::kLatencyBuckets; bucket++)
+			latency[bucket] = Napi::Number::New(env, static_cast<double>(counters.latency[bucket]));
+
+		auto object = Napi::Object::New(env);
+		object["operation"] = Napi::String::New(env, operationNames[static_cast<size_t>(entry.operation)]);
+		object["encoding"] = iccf->StringEncoding.New(env, entry.encoding)->Value();
+		object["calls"] = Napi::Number::New(env, static_cast<double>(counters.calls));
+		object["errors"] = Napi::Number::New(env, static_cast<double>(counters.errors));
+		object["bytesIn"] = Napi::Number::New(env, static_cast<double>(counters.bytesIn));
+		object["bytesOut"] = Napi::Number::New(env, static_cast<double>(counters.bytesOut));
+		object["latency"] = latency;
+		operations[static_cast<uint32_t>(index)] = object;
+	}
+
+	auto fastPaths = Napi::Object::New(env);
+	for (size_t path = 0; path < Stats::kFastPathCount; path++) {
+		auto object = Napi::Object::New(env);
+		object["taken"] = Napi::Number::New(env, static_cast<double>(snapshot.fastPaths[path][1]));
+		object["missed"] = Napi::Number::New(env, static_cast<double>(snapshot.fastPaths[path][0]));
+		fastPaths[fastPathNames[path]] = object;
+	}
+
+	auto result = Napi::Object::New(env);
+	result["enabled"] = Napi::Boolean::New(env, Stats::enabled());
+	result["operations"] = operations;
+	result["fastPaths"] = fastPaths;
+	result["copies"] = Napi::Number::New(env, static_cast<double>(snapshot.copies));
+	result["copiedBytes"] = Napi::Number::New(env, static_cast<double>(snapshot.copiedBytes));
+	return result;
+}
+
+static Napi::Value resetStats(const Napi::CallbackInfo &info) {
+	Stats::reset();
+	Pool::resetStatistics();
+	return info.Env().Undefined();
+}
+
+/** Reads one of the numbers given to `setPoolLimits` or `setParallelTranscodeOptions`, keeping the current value if it's missing. Numbers too big for `max` become `max`. */
+static size_t sizeSetting(Napi::Object settings, const char *name, size_t current, const char *what, size_t max = SIZE_MAX) {
+	const Napi::Value value = settings[name];
+
+	if (value.IsUndefined())
+		return current;
+
+	const double setting = value.ToNumber().DoubleValue();
+
+	// The negated comparison also catches NaN.
+	if (!(setting >= 0)) {
+		std::stringstream ss;
+		ss << "The " << what << " " << name << " must not be negative.";
+		throw Napi::RangeError::New(settings.Env(), ss.str());
+	}
+
+	return setting >= static_cast<double>(max) ? max : static_cast<size_t>(setting);
+}
+
+static Napi::Value setPoolLimits(const Napi::CallbackInfo &info) {
+	const auto limits = info[0].ToObject();
+	auto newLimits = Pool::limits();
+	newLimits.threadBytes = sizeSetting(limits, "threadBytes", newLimits.threadBytes, "pool limit");
+	newLimits.classBlocks = sizeSetting(limits, "classBlocks", newLimits.classBlocks, "pool limit");
+	Pool::setLimits(newLimits);
+	return info.Env().Undefined();
+}
+
+static Napi::Value getPoolStats(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto stats = Pool::collect();
+	const auto limits = Pool::limits();
+
+	const auto limitNumber = [env] (size_t limit) {
+		return Napi::Number::New(env, limit == SIZE_MAX ? std::numeric_limits<double>::infinity() : static_cast<double>(limit));
+	};
+
+	auto limitsObject = Napi::Object::New(env);
+	limitsObject["threadBytes"] = limitNumber(limits.threadBytes);
+	limitsObject["classBlocks"] = limitNumber(limits.classBlocks);
+
+	auto result = Napi::Object::New(env);
+	result["allocations"] = Napi::Number::New(env, static_cast<double>(stats.allocations));
+	result["reused"] = Napi::Number::New(env, static_cast<double>(stats.reused));
+	result["oversize"] = Napi::Number::New(env, static_cast<double>(stats.oversize));
+	result["released"] = Napi::Number::New(env, static_cast<double>(stats.released));
+	result["cachedBlocks"] = Napi::Number::New(env, static_cast<double>(stats.cachedBlocks));
+	result["cachedBytes"] = Napi::Number::New(env, static_cast<double>(stats.cachedBytes));
+	result["limits"] = limitsObject;
+	return result;
+}
+
+static Napi::Value setParallelTranscodeOptions(const Napi::CallbackInfo &info) {
+	const auto options = info[0].ToObject();
+	auto settings = parallelSettings();
+	settings.threshold = sizeSetting(options, "threshold", settings.threshold, "parallel transcoding option");
+	settings.threads = static_cast<unsigned>(sizeSetting(options, "threads", settings.threads, "parallel transcoding option", std::numeric_limits<unsigned>::max()));
+	setParallelSettings(settings);
+	return info.Env().Undefined();
+}
+
+/** For the tests. See `Backend::tableMismatches`. */
+static Napi::Value tableMismatches(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = reinterpret_cast<Iccf *>(info.Data());
+	const auto mismatches = iccf->backend.tableMismatches();
+
+	auto result = Napi::Array::New(env, mismatches.size());
+	for (size_t index = 0; index < mismatches.size(); index++)
+		result[static_cast<uint32_t>(index)] = Napi::Number::New(env, static_cast<double>(mismatches[index]));
+	return result;
 }
 
 static Napi::Object init(Napi::Env env, Napi::Object exports) {
@@ -47,19 +194,43 @@ static Napi::FunctionReference funcRef(Napi::Object imports, const char *name) {
 	}
 }
 
-Iccf::Iccf(Napi::Object imports, Napi::Object exports)
+static Napi::FunctionReference stringConcatRef(Napi::Env env) {
+	auto ref = Napi::Persistent(env.Global().Get("String").As<Napi::Object>().Get("prototype").As<Napi::Object>().Get("concat").As<Napi::Function>());
+	ref.SuppressDestruct();
+	return ref;
+}
+
+Iccf::Iccf(Napi::Object imports, Napi::Object exports, const Backend &backend)
 : InvalidEncodedTextError(funcRef(imports, "InvalidEncodedTextError"))
 , NotRepresentableError(funcRef(imports, "NotRepresentableError"))
 , UnrecognizedEncodingError(funcRef(imports, "UnrecognizedEncodingError"))
+, AbortError(funcRef(imports, "AbortError"))
 , _newFormattedTypeError(funcRef(imports, "newFormattedTypeError"))
+, stringConcat(stringConcatRef(imports.Env()))
+, backend(backend)
 , StringEncoding(imports.Env(), this)
 {
 	const auto env = imports.Env();
 
+	// Where the tables for the portable backend's multi-byte encodings were installed. They're only loaded if one of those encodings is used.
+	const Napi::Value multiByteTablePath = imports["multiByteTablePath"];
+	if (multiByteTablePath.IsString())
+		MultiByteTables::setFilePath(multiByteTablePath.As<Napi::String>().Utf8Value());
+
 	exports.DefineProperties({
 		Napi::PropertyDescriptor::Value("StringEncoding", StringEncoding.constructor(), napi_enumerable),
-		Napi::PropertyDescriptor::Function(env, exports, "encodingExists", encodingExists, napi_enumerable)
+		Napi::PropertyDescriptor::Function(env, exports, "encodingExists", encodingExists, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "setExternalStringThreshold", setExternalStringThreshold, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "setStatsEnabled", setStatsEnabled, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "getStats", getStats, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "resetStats", resetStats, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "setPoolLimits", setPoolLimits, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "getPoolStats", getPoolStats, napi_enumerable, this),
+		Napi::PropertyDescriptor::Function(env, exports, "setParallelTranscodeOptions", setParallelTranscodeOptions, napi_enumerable, this),
+		// Not enumerable, so that it isn't re-exported from index.ts.
+		Napi::PropertyDescriptor::Function(env, exports, "_tableMismatches", tableMismatches, napi_default, this)
 	});
 
 	TranscodeInit(env, exports, this);
+	IncrementalInit(env, exports, this);
 }
@@ -1,20 +1,40 @@
 #pragma once
 
 #include "napi.hh"
+#include "Backend.hh"
 #include "StringEncoding.hh"
+#include <optional>
+#include <vector>
 
 struct Iccf {
-	const Napi::FunctionReference InvalidEncodedTextError, NotRepresentableError, UnrecognizedEncodingError, _newFormattedTypeError;
+	const Napi::FunctionReference InvalidEncodedTextError, NotRepresentableError, UnrecognizedEncodingError, AbortError, _newFormattedTypeError;
+
+	/** `String.prototype.concat`, as it was when the module was loaded. See `DecodedTextToNapiString`. */
+	const Napi::FunctionReference stringConcat;
+
+	const Backend &backend;
 	const StringEncodingClass StringEncoding;
 
-	Iccf(Napi::Object imports, Napi::Object exports);
+	/** Decoded strings at least this many UTF-16 code units long are made into external strings, if Node.js supports them. See `DecodedTextToNapiString`. */
+	size_t externalStringThreshold = 256 * 1024;
 
-	inline Napi::Error newInvalidEncodedTextError(const Napi::Env env, Napi::Value text, Napi::Object encoding) const {
-		return InvalidEncodedTextError.New({ text, encoding }).As<Napi::Error>();
+	Iccf(Napi::Object imports, Napi::Object exports, const Backend &backend = Backend::Default());
+
+	/**
+	 * Each of these makes an error about some text that couldn't be converted.
+	 *
+	 * @param offset - Where in the `text` the problem is, if known: a byte offset for encoded text, or an index in UTF-16 code units for a string. Becomes the error's `offset` property.
+	 */
+	inline Napi::Error newInvalidEncodedTextError(const Napi::Env env, Napi::Value text, Napi::Object encoding, std::optional<size_t> offset = std::nullopt) const {
+		return InvalidEncodedTextError.New({ text, encoding, offsetValue(env, offset) }).As<Napi::Error>();
 	}
 
-	inline Napi::Error newNotRepresentableError(const Napi::Env env, Napi::Value text, Napi::Object encoding) const {
-		return NotRepresentableError.New({ text, encoding }).As<Napi::Error>();
+	inline Napi::Error newNotRepresentableError(const Napi::Env env, Napi::Value text, Napi::Object encoding, std::optional<size_t> offset = std::nullopt) const {
+		return NotRepresentableError.New({ text, encoding, offsetValue(env, offset) }).As<Napi::Error>();
+	}
+
+	inline Napi::Error newAbortError(const Napi::Env env) const {
+		return AbortError.New(std::vector<napi_value>()).As<Napi::Error>();
 	}
 
 	enum class EncodingSpecifierKind : uint32_t {
@@ -32,6 +52,10 @@ struct Iccf {
 		return UnrecognizedEncodingError.New({ encodingSpecifier, Napi::Number::New(env, static_cast<uint32_t>(specifierKind)) }).As<Napi::Error>();
 	}
 
+	static inline Napi::Value offsetValue(const Napi::Env env, std::optional<size_t> offset) {
+		return offset ? Napi::Value(Napi::Number::New(env, static_cast<double>(*offset))) : env.Undefined();
+	}
+
 	inline Napi::TypeError newFormattedTypeError(const Napi::Env env, const char *expected, Napi::Value actual) const {
 		return _newFormattedTypeError({ Napi::String::New(env, expected), actual }).As<Napi::TypeError>();
 	}
@@ -0,0 +1,114 @@
+#include "incremental.hh"
+#include "iccf.hh"
+#include "string-utils.hh"
+#include "StringEncoding.hh"
+#include "transcode.hh"
+
+static Iccf *getIccf(const Napi::CallbackInfo &info) {
+	return reinterpret_cast<Iccf *>(info.Data());
+}
+
+/** Defines the read-only `encoding` property of a `Decoder` or `Encoder`, which also keeps the `StringEncoding` alive for as long as the coder is. */
+static StringEncoding *defineEncoding(const Napi::CallbackInfo &info, const Iccf *iccf) {
+	auto const encoding = iccf->StringEncoding.UnwrapOrThrow(info[0]);
+
+	info.This().As<Napi::Object>().DefineProperty(
+		Napi::PropertyDescriptor::Value("encoding", encoding->Value(), napi_enumerable)
+	);
+
+	return encoding;
+}
+
+static Napi::Error newEndedError(Napi::Env env) {
+	return Napi::Error::New(env, "Cannot write after end, or after an error.");
+}
+
+Decoder::Decoder(const Napi::CallbackInfo &info)
+: ObjectWrap(info)
+, _iccf(getIccf(info))
+, _encoding(defineEncoding(info, _iccf))
+, _decoder(_encoding->backend().newDecoder(*_encoding))
+{
+	// Telling a character cut off at the end of a piece from an invalid one depends on decoding failing.
+	if (!DecodeOptions(info[1]).fatal)
+		throw Napi::RangeError::New(info.Env(), "Decoder does not support the fatal: false option.");
+}
+
+Napi::Value Decoder::decode(Napi::Value chunk, bool end) {
+	const auto env = chunk.Env();
+
+	if (!_decoder)
+		throw newEndedError(env);
+
+	const BufferContents contents = chunk.IsUndefined() ? BufferContents { nullptr, 0 } : _encoding->bufferContents(chunk);
+	PooledU16String out;
+	const bool ok = _decoder->write(contents.data, contents.length, end, out);
+
+	if (!ok || end)
+		_decoder.reset();
+
+	if (!ok)
+		throw _iccf->newInvalidEncodedTextError(env, chunk, _encoding->Value());
+
+	return UTF16ToNapiString(out, env);
+}
+
+Napi::Value Decoder::write(const Napi::CallbackInfo &info) {
+	return decode(info[0], false);
+}
+
+Napi::Value Decoder::end(const Napi::CallbackInfo &info) {
+	return decode(info[0], true);
+}
+
+Encoder::Encoder(const Napi::CallbackInfo &info)
+: ObjectWrap(info)
+, _iccf(getIccf(info))
+, _encoding(defineEncoding(info, _iccf))
+, _encoder(_encoding->backend().newEncoder(*_encoding, EncodeOptions(info[1]).lossByte))
+{}
+
+Napi::Value Encoder::encode(Napi::Value chunk, bool end) {
+	const auto env = chunk.Env();
+
+	if (!_encoder)
+		throw newEndedError(env);
+
+	auto const text = chunk.IsUndefined() ? Napi::String::New(env, "") : chunk.ToString();
+	auto encoded = _encoder->write(NapiStringToUTF16(text), end);
+
+	if (!encoded || end)
+		_encoder.reset();
+
+	if (!encoded)
+		throw _iccf->newNotRepresentableError(env, text, _encoding->Value());
+
+	return EncodedBytesToNapiBuffer(std::move(*encoded), env);
+}
+
+Napi::Value Encoder::write(const Napi::CallbackInfo &info) {
+	return encode(info[0], false);
+}
+
+Napi::Value Encoder::end(const Napi::CallbackInfo &info) {
+	return encode(info[0], true);
+}
+
+void IncrementalInit(Napi::Env env, Napi::Object exports, Iccf *iccf) {
+	Napi::HandleScope scope(env);
+
+	auto const decoder = Decoder::DefineClass(env, "Decoder", {
+		Decoder::InstanceMethod("write", &Decoder::write, napi_default, iccf),
+		Decoder::InstanceMethod("end", &Decoder::end, napi_default, iccf)
+	}, iccf);
+
+	auto const encoder = Encoder::DefineClass(env, "Encoder", {
+		Encoder::InstanceMethod("write", &Encoder::write, napi_default, iccf),
+		Encoder::InstanceMethod("end", &Encoder::end, napi_default, iccf)
+	}, iccf);
+
+	exports.DefineProperties({
+		Napi::PropertyDescriptor::Value("Decoder", decoder, napi_enumerable),
+		Napi::PropertyDescriptor::Value("Encoder", encoder, napi_enumerable)
+	});
+}
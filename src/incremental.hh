@@ -0,0 +1,45 @@
+#pragma once
+
+#include "napi.hh"
+#include "Backend.hh"
+#include <memory>
+
+struct Iccf;
+class StringEncoding;
+
+void IncrementalInit(Napi::Env env, Napi::Object exports, Iccf *iccf);
+
+/** JavaScript class `Decoder`, which decodes text that arrives in pieces. */
+class Decoder : public Napi::ObjectWrap<Decoder> {
+	friend void IncrementalInit(Napi::Env env, Napi::Object exports, Iccf *iccf);
+
+	const Iccf * const _iccf;
+	StringEncoding * const _encoding;
+	std::unique_ptr<IncrementalDecoder> _decoder;
+
+	Napi::Value write(const Napi::CallbackInfo &info);
+	Napi::Value end(const Napi::CallbackInfo &info);
+	Napi::Value decode(Napi::Value chunk, bool end);
+
+	public:
+	Decoder(const Napi::CallbackInfo &info);
+};
+
+/** JavaScript class `Encoder`, which encodes text that arrives in pieces. */
+class Encoder : public Napi::ObjectWrap<Encoder> {
+	friend void IncrementalInit(Napi::Env env, Napi::Object exports, Iccf *iccf);
+
+	const Iccf * const _iccf;
+	StringEncoding * const _encoding;
+	std::unique_ptr<IncrementalEncoder> _encoder;
+
+	Napi::Value write(const Napi::CallbackInfo &info);
+	Napi::Value end(const Napi::CallbackInfo &info);
+	Napi::Value encode(Napi::Value chunk, bool end);
+
+	public:
+	Encoder(const Napi::CallbackInfo &info);
+};
+
+#include "iccf.hh"
+#include "StringEncoding.hh"
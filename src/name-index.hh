@@ -0,0 +1,956 @@
+// Generated by tools/generate-name-index.py from src/PortableBackend.cc. Do not edit.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** A slot in one of the tables below. `entry` is a position in the registry, or `kNoIndexEntry` if the slot is empty. */
+struct IndexedName {
+	const char *name;
+	uint8_t length;
+	uint8_t entry;
+};
+
+struct IndexedNumber {
+	uint32_t key;
+	uint8_t entry;
+};
+
+static constexpr uint8_t kNoIndexEntry = 0xff;
+static constexpr size_t kIndexedRegistrySize = 64;
+static constexpr size_t kMaxIndexedNameLength = 21;
+
+// IANA character set names, in lower case
+static constexpr uint16_t kNameDisplacements[128] = {
+	1, 2, 1, 0, 2, 1, 0, 1, 1, 4, 1, 1, 1, 1, 0, 1,
+	3, 2, 1, 2, 1, 2, 1, 2, 3, 2, 2, 3, 3, 4, 1, 3,
+	1, 4, 7, 1, 0, 1, 4, 1, 1, 1, 1, 2, 0, 1, 2, 2,
+	6, 2, 1, 2, 4, 0, 3, 0, 3, 0, 2, 2, 1, 1, 1, 1,
+	1, 0, 1, 1, 1, 0, 2, 1, 1, 3, 1, 3, 1, 3, 3, 1,
+	0, 1, 4, 4, 0, 1, 3, 9, 2, 2, 7, 4, 0, 1, 1, 3,
+	1, 1, 2, 2, 3, 3, 2, 5, 4, 2, 1, 1, 2, 1, 1, 1,
+	1, 5, 2, 1, 1, 1, 6, 1, 1, 7, 0, 0, 1, 1, 1, 2,
+};
+static constexpr IndexedName kNameSlots[512] = {
+	{ "iso8859-5", 9, 15 },
+	{ "869", 3, 42 },
+	{ "iso8859-11", 10, 21 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "euc-jp", 6, 52 },
+	{ "csisolatin4", 11, 14 },
+	{ "csshiftjis", 10, 51 },
+	{ "csiso885916", 11, 25 },
+	{ "", 0, kNoIndexEntry },
+	{ "cspc850multilingual", 19, 31 },
+	{ "", 0, kNoIndexEntry },
+	{ "koi8-u", 6, 27 },
+	{ "iso8859-9", 9, 19 },
+	{ "", 0, kNoIndexEntry },
+	{ "latin4", 6, 14 },
+	{ "", 0, kNoIndexEntry },
+	{ "csisolatin3", 11, 13 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-110", 10, 14 },
+	{ "", 0, kNoIndexEntry },
+	{ "eucjp", 5, 52 },
+	{ "iso_8859-7", 10, 17 },
+	{ "cp855", 5, 33 },
+	{ "", 0, kNoIndexEntry },
+	{ "ecma-114", 8, 16 },
+	{ "csiso885915", 11, 24 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp1255", 6, 8 },
+	{ "iso_8859-16", 11, 25 },
+	{ "", 0, kNoIndexEntry },
+	{ "mac", 3, 1 },
+	{ "", 0, kNoIndexEntry },
+	{ "ascii", 5, 0 },
+	{ "iso-8859-10", 11, 20 },
+	{ "ibm775", 6, 30 },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-1255", 12, 8 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-5", 10, 15 },
+	{ "iso-8859-2", 10, 12 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cp775", 5, 30 },
+	{ "", 0, kNoIndexEntry },
+	{ "csmacintosh", 11, 1 },
+	{ "x-mac-ce", 8, 46 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-1256", 12, 9 },
+	{ "utf-16le", 8, 60 },
+	{ "us", 2, 0 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-mac-centraleurroman", 21, 46 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "csibm866", 8, 41 },
+	{ "x-x-big5", 8, 55 },
+	{ "ibm852", 6, 32 },
+	{ "", 0, kNoIndexEntry },
+	{ "koi8u", 5, 27 },
+	{ "utf-32", 6, 61 },
+	{ "big-5", 5, 55 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-gbk", 5, 53 },
+	{ "", 0, kNoIndexEntry },
+	{ "utf-8", 5, 57 },
+	{ "iso_8859-4", 10, 14 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso8859-4", 9, 14 },
+	{ "iso-celtic", 10, 23 },
+	{ "", 0, kNoIndexEntry },
+	{ "852", 3, 32 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "utf8", 4, 57 },
+	{ "utf-16", 6, 58 },
+	{ "cp866", 5, 41 },
+	{ "utf16", 5, 58 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "elot_928", 8, 17 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm863", 6, 38 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cp860", 5, 35 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cspc775baltic", 13, 30 },
+	{ "x-sjis", 6, 51 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "l3", 2, 13 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "shift_jis", 9, 51 },
+	{ "ecma-118", 8, 17 },
+	{ "cp1254", 6, 7 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-cp1257", 8, 10 },
+	{ "hebrew", 6, 18 },
+	{ "iso-ir-126", 10, 17 },
+	{ "maccentraleurope", 16, 46 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "latin10", 7, 25 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-1", 10, 2 },
+	{ "greek8", 6, 17 },
+	{ "ibm850", 6, 31 },
+	{ "iso-8859-11", 11, 21 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-cp1255", 8, 8 },
+	{ "csisolatinarabic", 16, 16 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cseuckr", 7, 56 },
+	{ "utf32", 5, 61 },
+	{ "iso-ir-138", 10, 18 },
+	{ "iso8859-14", 10, 23 },
+	{ "iso-8859-16", 11, 25 },
+	{ "", 0, kNoIndexEntry },
+	{ "l5", 2, 19 },
+	{ "maciceland", 10, 47 },
+	{ "iso_8859-10:1992", 16, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "latin8", 6, 23 },
+	{ "x-cp874", 7, 43 },
+	{ "macromania", 10, 50 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-101", 10, 12 },
+	{ "ibm819", 6, 2 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp737", 5, 29 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm864", 6, 39 },
+	{ "iso_8859-8", 10, 18 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-cp1252", 8, 3 },
+	{ "iso8859-2", 9, 12 },
+	{ "", 0, kNoIndexEntry },
+	{ "csisolatin2", 11, 12 },
+	{ "macroman", 8, 1 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "latin6", 6, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-936", 11, 53 },
+	{ "iso_8859-16:2001", 16, 25 },
+	{ "windows-1253", 12, 6 },
+	{ "iso-8859-8", 10, 18 },
+	{ "cp-gr", 5, 42 },
+	{ "csibm861", 8, 36 },
+	{ "iso_8859-11", 11, 21 },
+	{ "iso_8859-13", 11, 22 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-7", 10, 17 },
+	{ "iso-8859-3", 10, 13 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-6:1987", 15, 16 },
+	{ "cp1257", 6, 10 },
+	{ "cseucpkdfmtjapanese", 19, 52 },
+	{ "cp-is", 5, 36 },
+	{ "greek", 5, 17 },
+	{ "latin1", 6, 2 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "863", 3, 38 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "866", 3, 41 },
+	{ "", 0, kNoIndexEntry },
+	{ "utf16le", 7, 60 },
+	{ "cp862", 5, 37 },
+	{ "cp936", 5, 53 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-9", 10, 19 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cp864", 5, 39 },
+	{ "iso8859-8", 9, 18 },
+	{ "l4", 2, 14 },
+	{ "x-mac-roman", 11, 1 },
+	{ "csibm855", 8, 33 },
+	{ "csibm863", 8, 38 },
+	{ "", 0, kNoIndexEntry },
+	{ "utf-16be", 8, 59 },
+	{ "iso-8859-5", 10, 15 },
+	{ "ibm367", 6, 0 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "maccyrillic", 11, 44 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-2", 10, 12 },
+	{ "x-cp1256", 8, 9 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-14", 11, 23 },
+	{ "", 0, kNoIndexEntry },
+	{ "latin2", 6, 12 },
+	{ "", 0, kNoIndexEntry },
+	{ "cspc862latinhebrew", 18, 37 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cp874", 5, 43 },
+	{ "cp857", 5, 34 },
+	{ "cp1250", 6, 4 },
+	{ "", 0, kNoIndexEntry },
+	{ "861", 3, 36 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-euc-jp", 8, 52 },
+	{ "", 0, kNoIndexEntry },
+	{ "l8", 2, 23 },
+	{ "arabic", 6, 16 },
+	{ "", 0, kNoIndexEntry },
+	{ "ansi_x3.4-1986", 14, 0 },
+	{ "iso-ir-157", 10, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "csibm864", 8, 39 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-15", 11, 24 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp852", 5, 32 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-mac-greek", 11, 45 },
+	{ "cyrillic", 8, 15 },
+	{ "l1", 2, 2 },
+	{ "iso_8859-6", 10, 16 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "macgreek", 8, 45 },
+	{ "maccroatian", 11, 49 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-9:1989", 15, 19 },
+	{ "cp437", 5, 28 },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-1250", 12, 4 },
+	{ "x-cp1251", 8, 5 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-cp1254", 8, 7 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-109", 10, 13 },
+	{ "iso8859-7", 9, 17 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "latin7", 6, 22 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso8859-16", 10, 25 },
+	{ "windows-1251", 12, 5 },
+	{ "iso-ir-127", 10, 16 },
+	{ "windows-874", 11, 43 },
+	{ "ibm860", 6, 35 },
+	{ "ibm865", 6, 40 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-mac-croatian", 14, 49 },
+	{ "", 0, kNoIndexEntry },
+	{ "cspc8codepage437", 16, 28 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cskoi8u", 7, 27 },
+	{ "ansi_x3.4-1968", 14, 0 },
+	{ "utf-32be", 8, 62 },
+	{ "koi8r", 5, 26 },
+	{ "iso_8859-5:1988", 15, 15 },
+	{ "ibm861", 6, 36 },
+	{ "iso-ir-199", 10, 23 },
+	{ "l2", 2, 12 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "862", 3, 37 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-1", 10, 2 },
+	{ "csibm857", 8, 34 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-13", 11, 22 },
+	{ "", 0, kNoIndexEntry },
+	{ "x-mac-icelandic", 15, 47 },
+	{ "iso646-us", 9, 0 },
+	{ "windows-1258", 12, 11 },
+	{ "csisolatinhebrew", 16, 18 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp869", 5, 42 },
+	{ "865", 3, 40 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "860", 3, 35 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp1258", 6, 11 },
+	{ "ms936", 5, 53 },
+	{ "", 0, kNoIndexEntry },
+	{ "csiso885913", 11, 22 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "cp1252", 6, 3 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp367", 5, 0 },
+	{ "gb-18030", 8, 54 },
+	{ "cp1256", 6, 9 },
+	{ "x-cp1250", 8, 4 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm866", 6, 41 },
+	{ "", 0, kNoIndexEntry },
+	{ "big5", 4, 55 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm857", 6, 34 },
+	{ "iso_8859-1:1987", 15, 2 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-6", 8, 0 },
+	{ "", 0, kNoIndexEntry },
+	{ "macintosh", 9, 1 },
+	{ "cp1253", 6, 6 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm862", 6, 37 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm437", 6, 28 },
+	{ "csisolatingreek", 15, 17 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-148", 10, 19 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "csisolatincyrillic", 18, 15 },
+	{ "", 0, kNoIndexEntry },
+	{ "csisolatin1", 11, 2 },
+	{ "asmo-708", 8, 16 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp819", 5, 2 },
+	{ "csisolatin6", 11, 20 },
+	{ "csiso885914", 11, 23 },
+	{ "iso_8859-9", 10, 19 },
+	{ "iso-8859-6", 10, 16 },
+	{ "437", 3, 28 },
+	{ "", 0, kNoIndexEntry },
+	{ "l10", 3, 25 },
+	{ "", 0, kNoIndexEntry },
+	{ "us-ascii", 8, 0 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm869", 6, 42 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "gb18030", 7, 54 },
+	{ "cn-big5", 7, 55 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-8859-4", 10, 14 },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-1254", 12, 7 },
+	{ "cp861", 5, 36 },
+	{ "iso-ir-144", 10, 15 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp865", 5, 40 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-2:1987", 15, 12 },
+	{ "iso_8859-7:1987", 15, 17 },
+	{ "iso_8859-4:1988", 15, 14 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "csisolatin5", 11, 19 },
+	{ "iso_8859-8:1988", 15, 18 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-3", 10, 13 },
+	{ "x-mac-turkish", 13, 48 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "csbig5", 6, 55 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm737", 6, 29 },
+	{ "cskoi8r", 7, 26 },
+	{ "utf32le", 7, 63 },
+	{ "cp863", 5, 38 },
+	{ "iso8859-10", 10, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "utf32be", 7, 62 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso-ir-100", 10, 2 },
+	{ "iso-ir-226", 10, 25 },
+	{ "iso_8859-14:1998", 16, 23 },
+	{ "euc-kr", 6, 56 },
+	{ "sjis", 4, 51 },
+	{ "", 0, kNoIndexEntry },
+	{ "shift-jis", 9, 51 },
+	{ "cp850", 5, 31 },
+	{ "windows-1257", 12, 10 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "windows-1252", 12, 3 },
+	{ "x-mac-romanian", 14, 50 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-15", 11, 24 },
+	{ "", 0, kNoIndexEntry },
+	{ "csibm869", 8, 42 },
+	{ "", 0, kNoIndexEntry },
+	{ "macturkish", 10, 48 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "iso8859-1", 9, 2 },
+	{ "", 0, kNoIndexEntry },
+	{ "latin5", 6, 19 },
+	{ "", 0, kNoIndexEntry },
+	{ "csibm865", 8, 40 },
+	{ "latin9", 6, 24 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso8859-3", 9, 13 },
+	{ "iso8859-6", 9, 16 },
+	{ "", 0, kNoIndexEntry },
+	{ "iso_8859-3:1988", 15, 13 },
+	{ "", 0, kNoIndexEntry },
+	{ "koi8-r", 6, 26 },
+	{ "x-cp1253", 8, 6 },
+	{ "csibm860", 8, 35 },
+	{ "unicode-1-1-utf-8", 17, 57 },
+	{ "csascii", 7, 0 },
+	{ "iso-8859-14", 11, 23 },
+	{ "iso8859-15", 10, 24 },
+	{ "euckr", 5, 56 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-cp1258", 8, 11 },
+	{ "iso_8859-10", 11, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "ibm855", 6, 33 },
+	{ "850", 3, 31 },
+	{ "utf-32le", 8, 63 },
+	{ "", 0, kNoIndexEntry },
+	{ "cspcp852", 8, 32 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "utf16be", 7, 59 },
+	{ "", 0, kNoIndexEntry },
+	{ "l6", 2, 20 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "latin3", 6, 13 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "x-mac-cyrillic", 14, 44 },
+	{ "", 0, kNoIndexEntry },
+	{ "857", 3, 34 },
+	{ "", 0, kNoIndexEntry },
+	{ "ms_kanji", 8, 51 },
+	{ "iso8859-13", 10, 22 },
+	{ "", 0, kNoIndexEntry },
+	{ "gbk", 3, 53 },
+	{ "", 0, kNoIndexEntry },
+	{ "", 0, kNoIndexEntry },
+	{ "latin-9", 7, 24 },
+	{ "", 0, kNoIndexEntry },
+	{ "cp1251", 6, 5 },
+	{ "855", 3, 33 },
+};
+
+// Windows codepages
+static constexpr uint16_t kWindowsCodepageDisplacements[32] = {
+	2, 2, 2, 3, 3, 2, 1, 1, 1, 1, 1, 3, 1, 0, 5, 1,
+	1, 0, 0, 4, 1, 1, 1, 0, 0, 2, 1, 0, 1, 2, 2, 3,
+};
+static constexpr IndexedNumber kWindowsCodepageSlots[128] = {
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fbd, 24 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000361, 40 },
+	{ 0x000004e3, 5 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00002762, 49 },
+	{ 0x000004e7, 8 },
+	{ 0x00006fb0, 12 },
+	{ 0x00006fb7, 19 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x000004e5, 6 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000359, 34 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00006faf, 2 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000fde9, 57 },
+	{ 0, kNoIndexEntry },
+	{ 0x000004e4, 3 },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fb2, 14 },
+	{ 0x00000365, 42 },
+	{ 0x000004e8, 9 },
+	{ 0x000004e6, 7 },
+	{ 0x0000036a, 43 },
+	{ 0x00000360, 39 },
+	{ 0, kNoIndexEntry },
+	{ 0x000004ea, 11 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00002ee0, 63 },
+	{ 0, kNoIndexEntry },
+	{ 0x000003a8, 53 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000035c, 35 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000035d, 36 },
+	{ 0x00000357, 33 },
+	{ 0x000004b1, 59 },
+	{ 0x00000354, 32 },
+	{ 0x00000307, 30 },
+	{ 0x00006fb5, 17 },
+	{ 0, kNoIndexEntry },
+	{ 0x000003a4, 51 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000271a, 50 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x000004e2, 4 },
+	{ 0x000003b6, 55 },
+	{ 0, kNoIndexEntry },
+	{ 0x00002ee1, 62 },
+	{ 0x000001b5, 28 },
+	{ 0x0000caed, 56 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000035f, 38 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000272d, 46 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x000004e9, 10 },
+	{ 0x00002717, 44 },
+	{ 0x00000352, 31 },
+	{ 0x00000362, 41 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000035e, 37 },
+	{ 0, kNoIndexEntry },
+	{ 0x00004e9f, 0 },
+	{ 0, kNoIndexEntry },
+	{ 0x00002716, 45 },
+	{ 0x000002e1, 29 },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fb3, 15 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fb4, 16 },
+	{ 0x00002710, 1 },
+	{ 0x0000cadc, 52 },
+	{ 0x000004b0, 60 },
+	{ 0x0000d698, 54 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fb1, 13 },
+	{ 0x00005182, 26 },
+	{ 0, kNoIndexEntry },
+	{ 0x00002761, 48 },
+	{ 0, kNoIndexEntry },
+	{ 0x00006fbb, 22 },
+	{ 0x00006fb6, 18 },
+	{ 0x0000556a, 27 },
+	{ 0x0000275f, 47 },
+};
+
+// NSStringEncoding constants
+static constexpr uint16_t kNSStringEncodingDisplacements[32] = {
+	1, 2, 3, 3, 4, 2, 10, 4, 10, 4, 2, 1, 0, 1, 2, 2,
+	1, 2, 3, 2, 1, 2, 5, 2, 2, 3, 9, 1, 3, 2, 12, 2,
+};
+static constexpr IndexedNumber kNSStringEncodingSlots[128] = {
+	{ 0x80000505, 8 },
+	{ 0x8000041b, 41 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000a08, 27 },
+	{ 0x00000009, 12 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000406, 30 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000006, 45 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x9c000100, 63 },
+	{ 0x80000207, 17 },
+	{ 0x80000405, 29 },
+	{ 0x00000001, 0 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x8c000100, 61 },
+	{ 0x80000419, 39 },
+	{ 0x8000020a, 20 },
+	{ 0x80000208, 18 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000004, 57 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000a03, 55 },
+	{ 0x80000210, 25 },
+	{ 0x80000503, 6 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000a02, 26 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000504, 7 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000205, 15 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000026, 50 },
+	{ 0x80000202, 12 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000413, 33 },
+	{ 0x8000041c, 42 },
+	{ 0x0000000b, 5 },
+	{ 0x94000100, 60 },
+	{ 0, kNoIndexEntry },
+	{ 0x8000001d, 46 },
+	{ 0, kNoIndexEntry },
+	{ 0x8000020b, 21 },
+	{ 0x80000201, 2 },
+	{ 0x80000209, 19 },
+	{ 0x80000940, 56 },
+	{ 0x80000206, 16 },
+	{ 0x80000a01, 51 },
+	{ 0x80000023, 48 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000025, 47 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000920, 52 },
+	{ 0x80000417, 37 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000001e, 1 },
+	{ 0x80000100, 58 },
+	{ 0x80000600, 0 },
+	{ 0x0000000e, 7 },
+	{ 0x8000041d, 43 },
+	{ 0x0000000f, 4 },
+	{ 0x80000410, 31 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x8000020e, 23 },
+	{ 0x80000415, 35 },
+	{ 0, kNoIndexEntry },
+	{ 0x98000100, 62 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000632, 54 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000005, 2 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x80000203, 13 },
+	{ 0x80000204, 14 },
+	{ 0x80000007, 44 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000000a, 58 },
+	{ 0x00000003, 52 },
+	{ 0x80000501, 4 },
+	{ 0x80000418, 38 },
+	{ 0x80000506, 9 },
+	{ 0x80000502, 5 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000414, 34 },
+	{ 0x80000500, 3 },
+	{ 0x8000041a, 40 },
+	{ 0x80000416, 36 },
+	{ 0x88000100, 57 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000000, 1 },
+	{ 0x00000008, 51 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000000d, 6 },
+	{ 0x80000508, 11 },
+	{ 0x8000020f, 24 },
+	{ 0x80000400, 28 },
+	{ 0, kNoIndexEntry },
+	{ 0x90000100, 59 },
+	{ 0x0000000c, 3 },
+	{ 0x80000412, 32 },
+	{ 0x80000024, 49 },
+	{ 0, kNoIndexEntry },
+	{ 0x80000631, 53 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x8000020d, 22 },
+	{ 0x80000507, 10 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+};
+
+// CFStringEncodings
+static constexpr uint16_t kEncodingDisplacements[32] = {
+	4, 3, 2, 2, 1, 0, 1, 7, 1, 1, 1, 1, 2, 3, 1, 1,
+	1, 1, 2, 1, 1, 1, 3, 1, 2, 1, 1, 1, 0, 7, 3, 1,
+};
+static constexpr IndexedNumber kEncodingSlots[128] = {
+	{ 0x00000507, 10 },
+	{ 0x00000632, 54 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000026, 50 },
+	{ 0x10000100, 59 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000209, 19 },
+	{ 0, kNoIndexEntry },
+	{ 0x0000020a, 20 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000413, 33 },
+	{ 0x00000202, 12 },
+	{ 0x00000419, 39 },
+	{ 0x00000100, 58 },
+	{ 0x00000504, 7 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000501, 4 },
+	{ 0x0000041a, 40 },
+	{ 0x0000041c, 42 },
+	{ 0x1c000100, 63 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000a08, 27 },
+	{ 0x00000503, 6 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000416, 36 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000400, 28 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000205, 15 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000041b, 41 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000001d, 46 },
+	{ 0x14000100, 60 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000920, 52 },
+	{ 0x00000506, 9 },
+	{ 0x00000406, 30 },
+	{ 0x0000020f, 24 },
+	{ 0x00000203, 13 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000a03, 55 },
+	{ 0x00000023, 48 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000025, 47 },
+	{ 0x00000208, 18 },
+	{ 0x00000405, 29 },
+	{ 0x0000020d, 22 },
+	{ 0x00000000, 1 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000007, 44 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000940, 56 },
+	{ 0x0c000100, 61 },
+	{ 0x00000a01, 51 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000204, 14 },
+	{ 0x00000006, 45 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000207, 17 },
+	{ 0x00000201, 2 },
+	{ 0x00000024, 49 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000502, 5 },
+	{ 0x00000a02, 26 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000020e, 23 },
+	{ 0x00000415, 35 },
+	{ 0x00000210, 25 },
+	{ 0x00000600, 0 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000417, 37 },
+	{ 0x0000020b, 21 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000410, 31 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x0000041d, 43 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000412, 32 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x18000100, 62 },
+	{ 0x00000418, 38 },
+	{ 0x00000206, 16 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000414, 34 },
+	{ 0x00000508, 11 },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0, kNoIndexEntry },
+	{ 0x00000500, 3 },
+	{ 0x00000631, 53 },
+	{ 0x08000100, 57 },
+	{ 0, kNoIndexEntry },
+	{ 0x00000505, 8 },
+};
@@ -0,0 +1,473 @@
+#include "parallel.hh"
+#include "PortableBackend.hh"
+#include "unicode.hh"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	std::atomic<size_t> thresholdSetting(ParallelSettings().threshold);
+	std::atomic<unsigned> threadsSetting(ParallelSettings().threads);
+
+	/**
+	 * A pool of threads that work together on one list of tasks at a time, for `parallelTranscode`.
+	 *
+	 * Each thread working on a job gets its own share of the tasks, and works through it from the front. A thread that runs out takes the back half of the share of some other thread that hasn't, so the threads all finish at about the same time even if some tasks take longer than others. The thread that started the job does its share too.
+	 */
+	class WorkerPool {
+		/** A range of task indices, packed into one word so that it can be changed atomically: the first in the low half, and one past the last in the high half. */
+		using Share = uint64_t;
+
+		static constexpr Share share(uint32_t begin, uint32_t end) noexcept {
+			return Share(begin) | (Share(end) << 32);
+		}
+
+		static constexpr uint32_t begin(Share s) noexcept {
+			return static_cast<uint32_t>(s);
+		}
+
+		static constexpr uint32_t end(Share s) noexcept {
+			return static_cast<uint32_t>(s >> 32);
+		}
+
+		struct Job {
+			const std::function<void(size_t)> &task;
+			std::vector<std::atomic<Share>> shares;
+
+			/** How many threads have joined the job. The thread that started it is the first. */
+			size_t joined = 1;
+
+			/** How many pool threads are still working on the job. */
+			size_t active = 0;
+
+			std::exception_ptr error;
+
+			Job(const std::function<void(size_t)> &task, size_t count, size_t threads)
+			: task(task)
+			, shares(threads)
+			{
+				for (size_t slot = 0; slot < threads; slot++)
+					shares[slot].store(share(static_cast<uint32_t>(count * slot / threads), static_cast<uint32_t>(count * (slot + 1) / threads)), std::memory_order_relaxed);
+			}
+
+			/** Takes the next task from the front of the given share, if there is one. */
+			bool takeFront(size_t slot, size_t &index) noexcept {
+				auto &s = shares[slot];
+				Share current = s.load(std::memory_order_acquire);
+
+				while (begin(current) < end(current)) {
+					if (s.compare_exchange_weak(current, share(begin(current) + 1, end(current)), std::memory_order_acq_rel)) {
+						index = begin(current);
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			/** Takes the back half of some other thread's share, keeping the first task of it to do now and putting the rest in this thread's share, which must be empty. */
+			bool steal(size_t slot, size_t &index) noexcept {
+				for (size_t offset = 1; offset < shares.size(); offset++) {
+					auto &victim = shares[(slot + offset) % shares.size()];
+					Share current = victim.load(std::memory_order_acquire);
+
+					while (begin(current) < end(current)) {
+						const uint32_t middle = begin(current) + (end(current) - begin(current)) / 2;
+
+						if (victim.compare_exchange_weak(current, share(begin(current), middle), std::memory_order_acq_rel)) {
+							shares[slot].store(share(middle + 1, end(current)), std::memory_order_release);
+							index = middle;
+							return true;
+						}
+					}
+				}
+
+				return false;
+			}
+
+			/** Does tasks until there are none left to do or take. */
+			void work(size_t slot, std::mutex &mutex) noexcept {
+				size_t index;
+
+				while (takeFront(slot, index) || steal(slot, index)) {
+					try {
+						task(index);
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> lock(mutex);
+						if (!error)
+							error = std::current_exception();
+					}
+				}
+			}
+		};
+
+		std::mutex _mutex;
+		std::condition_variable _jobAdded, _jobDone;
+		std::vector<Job *> _jobs;
+		size_t _threads = 0;
+
+		void threadMain() {
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			for (;;) {
+				_jobAdded.wait(lock, [this] { return !_jobs.empty(); });
+
+				Job *const job = _jobs.front();
+				const size_t slot = job->joined++;
+
+				// Once every share has a thread, no more threads are needed.
+				if (job->joined == job->shares.size())
+					_jobs.erase(_jobs.begin());
+
+				job->active++;
+				lock.unlock();
+				job->work(slot, _mutex);
+				lock.lock();
+
+				if (--job->active == 0)
+					_jobDone.notify_all();
+			}
+		}
+
+		public:
+		/** The pool. It's never destroyed, since its threads run until the process exits. */
+		static WorkerPool &get() {
+			static WorkerPool *const pool = new WorkerPool();
+			return *pool;
+		}
+
+		/**
+		 * Calls `task` once for each index from 0 to `count - 1`, on up to `threads` threads, including this one. Returns once all of the calls have returned.
+		 *
+		 * If any of the calls throws an exception, the rest still happen, and then the first exception is rethrown.
+		 */
+		void run(size_t count, size_t threads, const std::function<void(size_t)> &task) {
+			threads = std::min(threads, count);
+			Job job(task, count, threads);
+
+			if (threads > 1) {
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				// Start more threads, if there aren't enough yet. If they can't be started, this thread takes their shares.
+				try {
+					while (_threads < threads - 1) {
+						std::thread([this] { threadMain(); }).detach();
+						_threads++;
+					}
+				}
+				catch (const std::system_error &) {}
+
+				_jobs.push_back(&job);
+				_jobAdded.notify_all();
+			}
+
+			job.work(0, _mutex);
+
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			// Don't let any more threads join, now that there's nothing left to take, and wait for those that did to finish.
+			auto const queued = std::find(_jobs.begin(), _jobs.end(), &job);
+			if (queued != _jobs.end())
+				_jobs.erase(queued);
+
+			_jobDone.wait(lock, [&job] { return job.active == 0; });
+
+			if (job.error)
+				std::rethrow_exception(job.error);
+		}
+	};
+
+	/** Chunks are at least this long, so that the cost of handing them out stays small. */
+	constexpr size_t kMinChunkLength = 1024 * 1024;
+
+	/** Each thread gets about this many chunks, so that there are some for idle threads to take from busy ones. */
+	constexpr size_t kChunksPerThread = 4;
+
+	/** How far before the ideal end of a chunk of EUC text to look for the end of a character. */
+	constexpr size_t kMaxResyncDistance = 64 * 1024;
+
+	typedef TextChunker::Boundaries Boundaries;
+
+	Boundaries boundariesOf(EncodingId encoding) noexcept {
+		switch (encoding) {
+			case kEncodingUTF8:
+				return Boundaries::utf8;
+
+			case kEncodingUTF16BE:
+				return Boundaries::utf16BE;
+
+			case kEncodingUTF16LE:
+				return Boundaries::utf16LE;
+
+			case kEncodingUTF32BE:
+			case kEncodingUTF32LE:
+				return Boundaries::utf32;
+
+			default: {
+				auto const entry = PortableBackend::info(encoding);
+
+				if (entry == nullptr)
+					return Boundaries::none;
+				else if (entry->codec.isSingleByte())
+					return Boundaries::singleByte;
+				// In an ASCII-compatible multi-byte encoding (that is, an EUC one), every byte less than 0x80 is a character by itself.
+				else if (entry->codec.isASCIICompatible())
+					return Boundaries::euc;
+				else
+					return Boundaries::none;
+			}
+		}
+	}
+
+	/** Whether text encoded in pieces can simply be joined together. That's not the case for encodings with a shift state, or that begin with a byte order mark. The portable backend's encodings have neither, except for the byte order marks of UTF-16 and UTF-32 without an explicit byte order. */
+	bool canJoinEncodedPieces(EncodingId encoding) noexcept {
+		return encoding != kEncodingUTF16 && encoding != kEncodingUTF32 && PortableBackend::info(encoding) != nullptr;
+	}
+
+	struct Chunk {
+		size_t start, end;
+		ParallelTranscodeResult result;
+	};
+}
+
+TextChunker::TextChunker(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) noexcept
+: _backend(backend)
+, _from(from)
+, _unmarkedFrom(Backend::skipByteOrderMark(from, bytes, length, _bomLength))
+, _to(to)
+, _bytes(bytes)
+, _length(length)
+, _boundaries(boundariesOf(_unmarkedFrom))
+{}
+
+std::optional<TextChunker> TextChunker::make(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) noexcept {
+	const TextChunker chunker(backend, from, to, bytes, length);
+	const auto boundaries = chunker._boundaries;
+
+	if (boundaries == Boundaries::none || !canJoinEncodedPieces(to) || !backend.isEncodingAvailable(from) || !backend.isEncodingAvailable(to))
+		return std::nullopt;
+
+	if ((boundaries == Boundaries::utf16BE || boundaries == Boundaries::utf16LE) ? length % 2 != 0 : boundaries == Boundaries::utf32 && length % 4 != 0)
+		return std::nullopt;
+
+	return chunker;
+}
+
+size_t TextChunker::boundary(size_t start, size_t target) const noexcept {
+	// Don't cut the byte order mark off from the first chunk.
+	start = std::max(start, _bomLength);
+
+	if (target <= start || target >= _length)
+		return 0;
+
+	const uint8_t *const bytes = _bytes;
+	size_t boundary = 0;
+
+	switch (_boundaries) {
+		case Boundaries::utf8:
+			// Back up past continuation bytes. If there are more than three in a row, the text is invalid right there, so any of them will do.
+			boundary = target;
+			for (int i = 0; i < 3 && boundary > start && (bytes[boundary] & 0xc0) == 0x80; i++)
+				boundary--;
+
+			// Decoding skips a byte order mark at the beginning, so don't start a chunk with U+FEFF.
+			while (_length - boundary >= 3 && bytes[boundary] == 0xef && bytes[boundary + 1] == 0xbb && bytes[boundary + 2] == 0xbf)
+				boundary += 3;
+
+			break;
+
+		case Boundaries::utf16BE:
+		case Boundaries::utf16LE: {
+			boundary = target - (target - _bomLength) % 2;
+
+			if (boundary - start >= 2) {
+				const uint8_t *const last = bytes + boundary - 2;
+				const unsigned unit = _boundaries == Boundaries::utf16BE ? (last[0] << 8) | last[1] : last[0] | (last[1] << 8);
+
+				// Keep surrogate pairs together.
+				if (unit >= 0xd800 && unit <= 0xdbff)
+					boundary -= 2;
+			}
+
+			break;
+		}
+
+		case Boundaries::utf32:
+			boundary = target - (target - _bomLength) % 4;
+			break;
+
+		case Boundaries::singleByte:
+			boundary = target;
+			break;
+
+		case Boundaries::euc: {
+			const size_t limit = target - std::min(target - start, kMaxResyncDistance);
+
+			for (size_t end = target; end > limit; end--) {
+				if (bytes[end - 1] < 0x80) {
+					boundary = end;
+					break;
+				}
+			}
+
+			break;
+		}
+
+		case Boundaries::none:
+			break;
+	}
+
+	return boundary > start && boundary < _length ? boundary : 0;
+}
+
+ParallelTranscodeResult TextChunker::convert(size_t start, size_t end, uint8_t lossByte) const {
+	using Status = ParallelTranscodeResult::Status;
+
+	// Only the first chunk can have a byte order mark. The rest are in the encoding that it calls for.
+	const EncodingId from = start == 0 ? _from : _unmarkedFrom, to = _to;
+	const uint8_t *const data = _bytes + start;
+	const size_t length = end - start;
+	ParallelTranscodeResult result;
+
+	if (isUnicodeEncoding(from) && isUnicodeEncoding(to)) {
+		auto unicode = transcodeUnicode(from, to, data, length, lossByte);
+
+		switch (unicode.status) {
+			case UnicodeTranscodeResult::Status::ok:
+				result.status = Status::ok;
+				result.bytes = std::move(unicode.bytes);
+				return result;
+
+			case UnicodeTranscodeResult::Status::unrepresentable:
+				result.status = Status::unrepresentable;
+				result.offset = start + _backend.unrepresentableOffset(from, to, data, length);
+				return result;
+
+			case UnicodeTranscodeResult::Status::invalid:
+				result.status = Status::invalid;
+				result.offset = start + _backend.validLength(from, data, length);
+				return result;
+		}
+	}
+
+	auto const decoded = _backend.decode(from, data, length);
+
+	if (!decoded) {
+		result.status = Status::invalid;
+		result.offset = start + _backend.validLength(from, data, length);
+		return result;
+	}
+
+	const std::u16string_view utf16 = *decoded;
+	size_t unrepresentableAt;
+	auto encoded = _backend.encodeAll(to, utf16, lossByte, &unrepresentableAt);
+
+	if (!encoded) {
+		result.status = Status::unrepresentable;
+		result.offset = start + _backend.inputLength(_unmarkedFrom, start == 0 ? _bomLength : 0, utf16.substr(0, unrepresentableAt));
+		return result;
+	}
+
+	result.status = Status::ok;
+	result.bytes = std::move(*encoded);
+	return result;
+}
+
+ParallelSettings parallelSettings() noexcept {
+	ParallelSettings settings;
+	settings.threshold = thresholdSetting.load(std::memory_order_relaxed);
+	settings.threads = threadsSetting.load(std::memory_order_relaxed);
+	return settings;
+}
+
+void setParallelSettings(const ParallelSettings &settings) noexcept {
+	thresholdSetting.store(settings.threshold, std::memory_order_relaxed);
+	threadsSetting.store(settings.threads, std::memory_order_relaxed);
+}
+
+std::optional<ParallelTranscodeResult> parallelTranscode(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length, uint8_t lossByte) {
+	const auto settings = parallelSettings();
+	const size_t threads = settings.threads != 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+
+	if (threads <= 1 || length < settings.threshold || length < 2 * kMinChunkLength)
+		return std::nullopt;
+
+	const auto chunker = TextChunker::make(backend, from, to, bytes, length);
+
+	if (!chunker)
+		return std::nullopt;
+
+	// Task indices have to fit in 32 bits, which they do by a wide margin, since chunks are at least a megabyte.
+	const size_t chunkCount = std::min(threads * kChunksPerThread, length / kMinChunkLength);
+	const size_t chunkLength = length / chunkCount;
+
+	std::vector<Chunk> chunks;
+	chunks.reserve(chunkCount);
+	size_t start = 0;
+
+	for (size_t index = 1; index < chunkCount; index++) {
+		// If there's no boundary near enough, this chunk just runs on into the next one.
+		if (const size_t boundary = chunker->boundary(start, index * chunkLength)) {
+			chunks.push_back({ start, boundary, {} });
+			start = boundary;
+		}
+	}
+
+	chunks.push_back({ start, length, {} });
+
+	if (chunks.size() == 1)
+		return std::nullopt;
+
+	auto &pool = WorkerPool::get();
+
+	pool.run(chunks.size(), threads, [&] (size_t index) {
+		chunks[index].result = chunker->convert(chunks[index].start, chunks[index].end, lossByte);
+	});
+
+	// Report the error that converting the whole input at once would have. Between Unicode encodings, that's the first one. Otherwise, the whole input is decoded before any of it is encoded, so invalid text anywhere comes before any unrepresentable character.
+	const bool decodeFirst = !(isUnicodeEncoding(from) && isUnicodeEncoding(to));
+	Chunk *failed = nullptr;
+
+	for (auto &chunk : chunks) {
+		const auto status = chunk.result.status;
+
+		if (status == ParallelTranscodeResult::Status::invalid || (status != ParallelTranscodeResult::Status::ok && !decodeFirst)) {
+			failed = &chunk;
+			break;
+		}
+		else if (status != ParallelTranscodeResult::Status::ok && failed == nullptr)
+			failed = &chunk;
+	}
+
+	if (failed != nullptr)
+		return std::move(failed->result);
+
+	// Where each chunk's output goes in the whole output is the sum of the sizes of the outputs before it.
+	std::vector<size_t> offsets(chunks.size() + 1);
+	for (size_t index = 0; index < chunks.size(); index++)
+		offsets[index + 1] = offsets[index] + chunks[index].result.bytes.size();
+
+	const size_t outputLength = offsets.back();
+	auto const output = static_cast<uint8_t *>(std::malloc(outputLength == 0 ? 1 : outputLength));
+	if (output == nullptr)
+		throw std::bad_alloc();
+
+	ParallelTranscodeResult result;
+	result.status = ParallelTranscodeResult::Status::ok;
+	result.bytes = EncodedBytes(output, outputLength);
+
+	pool.run(chunks.size(), threads, [&] (size_t index) {
+		auto &piece = chunks[index].result.bytes;
+		std::memcpy(output + offsets[index], piece.data(), piece.size());
+		piece = EncodedBytes();
+	});
+
+	return result;
+}
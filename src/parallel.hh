@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Backend.hh"
+#include <optional>
+
+/** When `parallelTranscode` splits its input among several threads. */
+struct ParallelSettings {
+	/** Inputs shorter than this many bytes are converted on one thread. */
+	size_t threshold = 32 * 1024 * 1024;
+
+	/** How many threads to use at most, counting the calling thread. Zero means one for each processor. One turns parallel conversion off. */
+	unsigned threads = 0;
+};
+
+ParallelSettings parallelSettings() noexcept;
+void setParallelSettings(const ParallelSettings &settings) noexcept;
+
+/** Outcome of a call to `parallelTranscode`. */
+struct ParallelTranscodeResult {
+	enum class Status {
+		ok,
+
+		/** The input is not valid in the source encoding. */
+		invalid,
+
+		/** The input contains a character that can't be represented in the target encoding, and no loss byte was given. */
+		unrepresentable
+	};
+
+	Status status;
+
+	/** The converted text. Only meaningful if `status` is `ok`. */
+	EncodedBytes bytes;
+
+	/** Where the problem is in the input, if `status` isn't `ok`. This is what the single-threaded conversion in `transcode` would report. */
+	size_t offset = 0;
+};
+
+/**
+ * Cuts encoded text into chunks at character boundaries, such that converting each chunk on its own and joining the results gives exactly what converting the whole text at once would.
+ *
+ * This is only possible where a character boundary can be found by looking at the bytes near it: in the Unicode encodings, the single-byte encodings, and the EUC encodings (in which every byte below 0x80 is a character by itself). Encodings like Shift JIS and GB 18030, whose trailing bytes can look like characters of their own, can't be cut like this.
+ */
+class TextChunker {
+	public:
+	/** How the character boundaries in an encoding can be found. */
+	enum class Boundaries {
+		/** They can't, without decoding from the beginning. */
+		none,
+		utf8,
+		utf16BE,
+		utf16LE,
+		utf32,
+		singleByte,
+
+		/** Every byte below 0x80 is a character by itself, and every byte of a multi-byte character is 0x80 or above. */
+		euc
+	};
+
+	private:
+	const Backend &_backend;
+	const EncodingId _from, _unmarkedFrom, _to;
+	const uint8_t * const _bytes;
+	const size_t _length;
+	size_t _bomLength;
+	const Boundaries _boundaries;
+
+	TextChunker(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) noexcept;
+
+	public:
+	/** Returns a chunker for the given text, or `std::nullopt` if it can't be cut into chunks. UTF-16 and UTF-32 text that isn't a whole number of code units can't be, since it's rejected before any of it is looked at. */
+	static std::optional<TextChunker> make(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length) noexcept;
+
+	/** Finds a character boundary after `start`, and at or a little before `target`, where a chunk that begins at `start` can end. Returns 0 if there isn't one near enough. */
+	size_t boundary(size_t start, size_t target) const noexcept;
+
+	/** Converts the chunk from `start` to `end`, which are boundaries found by `boundary` or the ends of the text, the way `transcode` converts a whole input. Error offsets are from the beginning of the whole text. */
+	ParallelTranscodeResult convert(size_t start, size_t end, uint8_t lossByte) const;
+};
+
+/**
+ * Converts a large input on several threads at once, by splitting it into chunks at character boundaries and converting each chunk on its own. The result is exactly what decoding the whole input and then encoding it would produce.
+ *
+ * This is only possible for text that `TextChunker` can cut into chunks.
+ *
+ * The threads come from a pool that's shared by all calls, and started the first time they're needed. Idle threads take chunks from busy ones, so that a thread that gets slow chunks doesn't hold up the rest.
+ *
+ * @returns The result, or `std::nullopt` if the input is shorter than `ParallelSettings::threshold`, parallel conversion is turned off, or the encodings can't be split into chunks. The caller should then convert on one thread as usual.
+ */
+std::optional<ParallelTranscodeResult> parallelTranscode(const Backend &backend, EncodingId from, EncodingId to, const uint8_t *bytes, size_t length, uint8_t lossByte);
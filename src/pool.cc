@@ -0,0 +1,342 @@
+#include "pool.hh"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+	using Pool::Statistics;
+
+	/**
+	 * Size classes go up by alternating factors of 1.5 and 4/3 (32, 48, 64, 96, 128, 192, …), so no more than a third of a block is ever wasted by rounding up.
+	 *
+	 * Class `i` is 32 << (i / 2) bytes if `i` is even, or 48 << (i / 2) bytes if it's odd. The last one is `kMaxBlockSize`.
+	 */
+	constexpr size_t kClassCount = 23;
+
+	constexpr size_t classSize(size_t sizeClass) noexcept {
+		return (sizeClass & 1 ? 48 : 32) << (sizeClass / 2);
+	}
+
+	static_assert(classSize(kClassCount - 1) == Pool::kMaxBlockSize, "The largest size class must be kMaxBlockSize.");
+
+	/** The smallest size class that can hold `size` bytes, which must not be more than `kMaxBlockSize`. */
+	size_t sizeClassFor(size_t size) noexcept {
+		if (size <= classSize(0))
+			return 0;
+
+		// Find the power of two above size - 1, then choose between it and 3/4 of it.
+		size_t bits = 6;
+		while ((size_t(1) << bits) < size)
+			bits++;
+
+		return size <= (size_t(3) << (bits - 2)) ? 2 * (bits - 6) + 1 : 2 * (bits - 5);
+	}
+
+	/** `sizeClass` of blocks that aren't pooled. */
+	constexpr size_t kUnpooled = SIZE_MAX;
+
+	/** Precedes each block. Its alignment keeps the block itself aligned for any type. */
+	struct alignas(alignof(std::max_align_t)) Header {
+		size_t sizeClass;
+
+		/** How many bytes the block has room for, not counting this header. */
+		size_t capacity;
+
+		inline void *block() noexcept {
+			return this + 1;
+		}
+
+		static inline Header *of(void *block) noexcept {
+			return static_cast<Header *>(block) - 1;
+		}
+	};
+
+	/** A free block, kept in a `ThreadCache`. Free blocks form a linked list through their own memory. */
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	Header *newBlock(size_t sizeClass, size_t capacity) {
+		if (capacity > SIZE_MAX - sizeof(Header))
+			throw std::bad_alloc();
+
+		auto const header = static_cast<Header *>(std::malloc(sizeof(Header) + std::max(capacity, sizeof(FreeBlock))));
+		if (header == nullptr)
+			throw std::bad_alloc();
+
+		header->sizeClass = sizeClass;
+		header->capacity = capacity;
+		return header;
+	}
+
+	std::atomic<size_t> threadBytesLimit(Pool::Limits().threadBytes);
+	std::atomic<size_t> classBlocksLimit(Pool::Limits().classBlocks);
+
+	/** Goes up each time the limits change, so each thread can tell when to trim its free blocks. */
+	std::atomic<unsigned> limitsGeneration(0);
+
+	/** A count that only its own thread changes, but any thread can read. */
+	class Counter {
+		std::atomic<uint64_t> _value { 0 };
+
+		public:
+		inline void set(uint64_t value) noexcept {
+			_value.store(value, std::memory_order_relaxed);
+		}
+
+		inline void add(uint64_t amount) noexcept {
+			set(get() + amount);
+		}
+
+		inline uint64_t get() const noexcept {
+			return _value.load(std::memory_order_relaxed);
+		}
+	};
+
+	class ThreadCache;
+
+	/** Every thread that has a cache, and the counts of those that have exited. */
+	struct Registry {
+		std::mutex mutex;
+		std::vector<ThreadCache *> threads;
+		Statistics exited;
+
+		/** The counts as of the last `resetStatistics`, which `collect` subtracts. */
+		Statistics baseline;
+
+		static Registry &get() {
+			// Never destroyed, so that threads still running at exit can safely unregister.
+			static Registry *const registry = new Registry();
+			return *registry;
+		}
+	};
+
+	/** Set once the current thread's cache has been destroyed. From then on, blocks are allocated and freed without it. */
+	thread_local bool cacheDestroyed = false;
+
+	/** One thread's free blocks and counts. Only the owning thread touches the free blocks. */
+	class ThreadCache {
+		FreeBlock *_lists[kClassCount] = {};
+		size_t _counts[kClassCount] = {};
+		size_t _blocks = 0, _bytes = 0;
+		unsigned _generation;
+		bool _registered = false;
+
+		ThreadCache() noexcept
+		: _generation(limitsGeneration.load(std::memory_order_acquire))
+		{
+			auto &registry = Registry::get();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			// If there's no memory to register this thread, its counts are left out of the statistics, but it's otherwise fine.
+			try {
+				registry.threads.push_back(this);
+				_registered = true;
+			}
+			catch (...) {}
+		}
+
+		/** Frees blocks until there are no more than the given limits. */
+		void trim(size_t classBlocks, size_t threadBytes) noexcept {
+			for (size_t sizeClass = 0; sizeClass < kClassCount; sizeClass++) {
+				while (_counts[sizeClass] > classBlocks)
+					std::free(take(sizeClass));
+			}
+
+			// Free the biggest blocks first, since they make the biggest difference.
+			for (size_t sizeClass = kClassCount; sizeClass-- > 0 && _bytes > threadBytes;) {
+				while (_counts[sizeClass] != 0 && _bytes > threadBytes)
+					std::free(take(sizeClass));
+			}
+		}
+
+		void updateCachedCounts() noexcept {
+			cachedBlocks.set(_blocks);
+			cachedBytes.set(_bytes);
+		}
+
+		public:
+		Counter allocations, reused, oversize, released, cachedBlocks, cachedBytes;
+
+		~ThreadCache() {
+			trim(0, 0);
+			cacheDestroyed = true;
+
+			if (_registered) {
+				auto &registry = Registry::get();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+				addTo(registry.exited);
+			}
+		}
+
+		/** The current thread's cache, or null if it has already been destroyed because the thread is exiting. */
+		static ThreadCache *current() noexcept {
+			if (cacheDestroyed)
+				return nullptr;
+
+			thread_local ThreadCache cache;
+			return &cache;
+		}
+
+		/** Takes a free block of the given size class, or returns null if there isn't one. */
+		Header *take(size_t sizeClass) noexcept {
+			auto const block = _lists[sizeClass];
+			if (block == nullptr)
+				return nullptr;
+
+			_lists[sizeClass] = block->next;
+			_counts[sizeClass]--;
+			_blocks--;
+			_bytes -= classSize(sizeClass);
+			updateCachedCounts();
+			return Header::of(block);
+		}
+
+		/** If the limits have changed since this was last called, frees blocks to fit the new ones. */
+		void checkLimits() noexcept {
+			const unsigned generation = limitsGeneration.load(std::memory_order_acquire);
+
+			if (generation != _generation) {
+				_generation = generation;
+				trim(classBlocksLimit.load(std::memory_order_relaxed), threadBytesLimit.load(std::memory_order_relaxed));
+			}
+		}
+
+		/** Keeps a freed block for reuse, unless that would go over the limits, in which case this returns false and the caller should free it. */
+		bool keep(Header *header) noexcept {
+			checkLimits();
+
+			const size_t classBlocks = classBlocksLimit.load(std::memory_order_relaxed);
+			const size_t threadBytes = threadBytesLimit.load(std::memory_order_relaxed);
+			const size_t sizeClass = header->sizeClass, size = classSize(sizeClass);
+
+			if (_counts[sizeClass] >= classBlocks || _bytes + size > threadBytes) {
+				released.add(1);
+				return false;
+			}
+
+			auto const block = static_cast<FreeBlock *>(header->block());
+			block->next = _lists[sizeClass];
+			_lists[sizeClass] = block;
+			_counts[sizeClass]++;
+			_blocks++;
+			_bytes += size;
+			updateCachedCounts();
+			return true;
+		}
+
+		void addTo(Statistics &stats) const noexcept {
+			stats.allocations += allocations.get();
+			stats.reused += reused.get();
+			stats.oversize += oversize.get();
+			stats.released += released.get();
+			stats.cachedBlocks += cachedBlocks.get();
+			stats.cachedBytes += cachedBytes.get();
+		}
+	};
+}
+
+Pool::Limits Pool::limits() noexcept {
+	Limits limits;
+	limits.threadBytes = threadBytesLimit.load(std::memory_order_relaxed);
+	limits.classBlocks = classBlocksLimit.load(std::memory_order_relaxed);
+	return limits;
+}
+
+void Pool::setLimits(const Limits &limits) noexcept {
+	threadBytesLimit.store(limits.threadBytes, std::memory_order_relaxed);
+	classBlocksLimit.store(limits.classBlocks, std::memory_order_relaxed);
+	limitsGeneration.fetch_add(1, std::memory_order_release);
+}
+
+Statistics Pool::collect() {
+	auto &registry = Registry::get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	Statistics stats = registry.exited;
+	for (auto thread : registry.threads)
+		thread->addTo(stats);
+
+	stats.allocations -= registry.baseline.allocations;
+	stats.reused -= registry.baseline.reused;
+	stats.oversize -= registry.baseline.oversize;
+	stats.released -= registry.baseline.released;
+	return stats;
+}
+
+void Pool::resetStatistics() {
+	auto &registry = Registry::get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	Statistics stats = registry.exited;
+	for (auto thread : registry.threads)
+		thread->addTo(stats);
+
+	registry.baseline = stats;
+}
+
+void *Pool::allocate(size_t size) {
+	auto const cache = ThreadCache::current();
+
+	if (cache != nullptr)
+		cache->allocations.add(1);
+
+	if (size > kMaxBlockSize) {
+		if (cache != nullptr)
+			cache->oversize.add(1);
+		return newBlock(kUnpooled, size)->block();
+	}
+
+	// With pooling turned off, don't waste memory rounding up to a size class. Blocks allocated this way are never kept, so this is also where any blocks kept from before are freed.
+	if (threadBytesLimit.load(std::memory_order_relaxed) == 0) {
+		if (cache != nullptr)
+			cache->checkLimits();
+		return newBlock(kUnpooled, size)->block();
+	}
+
+	const size_t sizeClass = sizeClassFor(size);
+
+	if (cache != nullptr) {
+		if (auto const header = cache->take(sizeClass)) {
+			cache->reused.add(1);
+			return header->block();
+		}
+	}
+
+	return newBlock(sizeClass, classSize(sizeClass))->block();
+}
+
+void Pool::deallocate(void *block) noexcept {
+	if (block == nullptr)
+		return;
+
+	auto const header = Header::of(block);
+
+	if (header->sizeClass != kUnpooled) {
+		auto const cache = ThreadCache::current();
+		if (cache != nullptr && cache->keep(header))
+			return;
+	}
+
+	std::free(header);
+}
+
+void *Pool::reallocate(void *block, size_t size) {
+	if (block == nullptr)
+		return allocate(size);
+
+	auto const header = Header::of(block);
+
+	// Like realloc, keep the same block if it's big enough. Unlike realloc, don't bother shrinking it, since it's only temporary.
+	if (size <= header->capacity)
+		return block;
+
+	void *const moved = allocate(size);
+	std::memcpy(moved, block, header->capacity);
+	deallocate(block);
+	return moved;
+}
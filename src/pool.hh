@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+/**
+ * A memory pool for the temporary buffers that conversions make and then throw away, such as copies of strings and decoded text.
+ *
+ * Blocks up to `kMaxBlockSize` are rounded up to one of a few size classes. When such a block is freed, it's kept on a free list belonging to the thread that freed it, and handed out again by that thread's next allocation of the same size class, without going through `malloc` or taking any locks. Bigger blocks go straight to `malloc` and `free`.
+ *
+ * How much memory each thread keeps around is limited by `setLimits`. Blocks freed beyond those limits go back to `free`, and each thread's free blocks are all released when the thread exits.
+ *
+ * Each block starts with a small header that says which size class it is in, so it can be freed from any thread, not just the one that allocated it.
+ */
+namespace Pool {
+	/** Largest block that is pooled. */
+	constexpr size_t kMaxBlockSize = 64 * 1024;
+
+	/** How much memory each thread may keep for reuse. */
+	struct Limits {
+		/** Most bytes of free blocks that each thread keeps. Zero turns pooling off. */
+		size_t threadBytes = 1024 * 1024;
+
+		/** Most free blocks of each size class that each thread keeps. */
+		size_t classBlocks = 64;
+	};
+
+	/** Counts of what the pool has done, as returned by `collect`. */
+	struct Statistics {
+		/** How many blocks were allocated. */
+		uint64_t allocations = 0;
+
+		/** How many of those were free blocks handed out again, rather than new memory from `malloc`. */
+		uint64_t reused = 0;
+
+		/** How many of those were too big to pool, and went straight to `malloc`. */
+		uint64_t oversize = 0;
+
+		/** How many freed blocks went back to `free` instead of being kept, because of the `Limits`. */
+		uint64_t released = 0;
+
+		/** How many free blocks all threads are keeping right now, and how many bytes they take up. Unlike the other counts, these are not reset by `resetStatistics`. */
+		uint64_t cachedBlocks = 0, cachedBytes = 0;
+	};
+
+	Limits limits() noexcept;
+
+	/** Changes the `Limits`. Each thread trims its free blocks to fit the next time it frees a block. */
+	void setLimits(const Limits &limits) noexcept;
+
+	/** Adds up the counts of every thread. */
+	Statistics collect();
+
+	/** Sets the counts of `Statistics` back to zero. */
+	void resetStatistics();
+
+	/** Allocates at least `size` bytes, suitably aligned for any type. Throws `std::bad_alloc` if memory runs out. */
+	void *allocate(size_t size);
+
+	/** Frees a block from `allocate` or `reallocate`. Any thread may free it. Does nothing if `block` is null. */
+	void deallocate(void *block) noexcept;
+
+	/** Changes the size of a block from `allocate`, keeping its contents, like `std::realloc`. Throws `std::bad_alloc` if memory runs out, in which case `block` is left alone. */
+	void *reallocate(void *block, size_t size);
+
+	/** Allocates from the pool, for standard containers. */
+	template <typename T>
+	struct Allocator {
+		using value_type = T;
+
+		inline Allocator() noexcept {}
+
+		template <typename U>
+		inline Allocator(const Allocator<U> &) noexcept {}
+
+		inline T *allocate(size_t count) {
+			if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+				throw std::bad_alloc();
+			return static_cast<T *>(Pool::allocate(count * sizeof(T)));
+		}
+
+		inline void deallocate(T *block, size_t) noexcept {
+			Pool::deallocate(block);
+		}
+
+		template <typename U>
+		inline bool operator==(const Allocator<U> &) const noexcept {
+			return true;
+		}
+
+		template <typename U>
+		inline bool operator!=(const Allocator<U> &) const noexcept {
+			return false;
+		}
+	};
+}
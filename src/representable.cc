@@ -0,0 +1,195 @@
+#include "Backend.hh"
+#include "PortableBackend.hh"
+#include "ascii.hh"
+#include <algorithm>
+#include <array>
+
+namespace {
+	/**
+	 * For every UTF-16 code unit, which of the ASCII-compatible single-byte encodings can represent it, as a bit for each, in registry order.
+	 *
+	 * Like `SingleByteTables`, this is a two-level map. Blocks of 256 code units that aren't in any single-byte encoding all share the empty page 0.
+	 *
+	 * Leaving out the few encodings that aren't ASCII-compatible (such as DOS Arabic, which has `٪` in place of `%`) means ASCII can never rule out a candidate, so runs of it can be skipped in bulk.
+	 */
+	class Coverage {
+		uint16_t _index[256] = {};
+		std::vector<std::array<uint64_t, 256>> _pages;
+
+		public:
+		/** Bits of all of the encodings covered. Only the first 64 get one; `representableEncodings` measures any others the slow way. */
+		uint64_t all = 0;
+
+		/** Whether the given registry entry has a bit. If it does, it's the next one after the previous entry that has one. */
+		static inline bool covers(const EncodingInfo &entry, size_t bitIndex) noexcept {
+			return entry.codec.isSingleByte() && entry.codec.isASCIICompatible() && bitIndex < 64;
+		}
+
+		Coverage() : _pages(1) {
+			PooledU16String decoded;
+			size_t bitIndex = 0;
+
+			for (const auto &entry : PortableBackend::all()) {
+				if (!covers(entry, bitIndex))
+					continue;
+
+				const uint64_t bit = uint64_t(1) << bitIndex++;
+				all |= bit;
+
+				for (unsigned b = 0; b < 256; b++) {
+					const uint8_t byte = static_cast<uint8_t>(b);
+
+					decoded.clear();
+					if (!entry.codec.decode(&byte, 1, decoded))
+						continue;
+
+					const char16_t c = decoded[0];
+
+					if (_index[c >> 8] == 0) {
+						_index[c >> 8] = static_cast<uint16_t>(_pages.size());
+						_pages.emplace_back();
+					}
+
+					_pages[_index[c >> 8]][c & 0xff] |= bit;
+				}
+			}
+		}
+
+		inline uint64_t operator[](char16_t c) const noexcept {
+			return _pages[_index[c >> 8]][c & 0xff];
+		}
+	};
+
+	/**
+	 * Does the work of `Backend::representableEncodings`.
+	 *
+	 * If `smallestOnly` is true, this skips measuring encodings that can't be any smaller than ones that are already known to work, so only the first result is certain to be right.
+	 */
+	std::vector<RepresentableEncoding> findRepresentable(const Backend &backend, std::u16string_view text, bool smallestOnly) {
+		static const Coverage coverage;
+
+		// Classify the text in one pass: which single-byte encodings can represent all of it, and how long it is in UTF-8 and UTF-32. ASCII can't rule out any single-byte candidate, so runs of it are skipped in bulk.
+		uint64_t singleByte = coverage.all;
+		size_t utf8Length = 0, codePoints = 0;
+		bool loneSurrogate = false;
+
+		for (size_t i = 0; i < text.size();) {
+			const char16_t c = text[i];
+
+			if (c < 0x80) {
+				const size_t run = asciiPrefixLength(text.data() + i, text.size() - i);
+				utf8Length += run;
+				codePoints += run;
+				i += run;
+				continue;
+			}
+
+			codePoints++;
+
+			if (c >= 0xd800 && c <= 0xdfff) {
+				singleByte = 0;
+
+				if (c <= 0xdbff && i + 1 < text.size() && text[i + 1] >= 0xdc00 && text[i + 1] <= 0xdfff) {
+					utf8Length += 4;
+					i += 2;
+				}
+				else {
+					loneSurrogate = true;
+					i++;
+				}
+				continue;
+			}
+
+			singleByte &= coverage[c];
+			utf8Length += c < 0x800 ? 2 : 3;
+			i++;
+		}
+
+		// The bits only say what the portable tables can do. Backends that convert some of those encodings another way (like Core Foundation) measure them with `encode` below instead, since they might not agree.
+		uint64_t tableEncodings = 0;
+		{
+			size_t bitIndex = 0;
+			for (const auto &entry : PortableBackend::all()) {
+				if (Coverage::covers(entry, bitIndex)) {
+					if (backend.usesPortableTables(entry.id))
+						tableEncodings |= uint64_t(1) << bitIndex;
+					bitIndex++;
+				}
+			}
+		}
+		singleByte &= tableEncodings;
+
+		const size_t length = text.size();
+		const bool allASCII = !loneSurrogate && utf8Length == length;
+		std::vector<RepresentableEncoding> result;
+		size_t bitIndex = 0;
+
+		// Nothing takes fewer bytes than there are code units, so once a single-byte encoding is known to work, there's no point in measuring anything else.
+		const bool measureOthers = !smallestOnly || (singleByte == 0 && !allASCII);
+
+		for (const auto &entry : PortableBackend::all()) {
+			const EncodingId encoding = entry.id;
+
+			switch (encoding) {
+				case kEncodingUTF8:
+					if (!loneSurrogate)
+						result.push_back({ encoding, utf8Length });
+					break;
+
+				// Lone surrogates pass through UTF-16 unchanged. The unmarked forms get a byte order mark.
+				case kEncodingUTF16:
+					result.push_back({ encoding, length * 2 + 2 });
+					break;
+
+				case kEncodingUTF16BE:
+				case kEncodingUTF16LE:
+					result.push_back({ encoding, length * 2 });
+					break;
+
+				case kEncodingUTF32:
+					if (!loneSurrogate)
+						result.push_back({ encoding, codePoints * 4 + 4 });
+					break;
+
+				case kEncodingUTF32BE:
+				case kEncodingUTF32LE:
+					if (!loneSurrogate)
+						result.push_back({ encoding, codePoints * 4 });
+					break;
+
+				default: {
+					const uint64_t bit = Coverage::covers(entry, bitIndex) ? uint64_t(1) << bitIndex++ : 0;
+
+					if (tableEncodings & bit) {
+						if (singleByte & bit)
+							result.push_back({ encoding, length });
+					}
+					else if (!measureOthers || !backend.isEncodingAvailable(encoding))
+						break;
+					else if (allASCII && backend.isASCIICompatible(encoding))
+						result.push_back({ encoding, length });
+					else {
+						auto const measured = backend.encode(encoding, text, 0, nullptr, 0);
+						if (measured.status == EncodeResult::Status::ok)
+							result.push_back({ encoding, measured.written });
+					}
+				}
+			}
+		}
+
+		std::stable_sort(result.begin(), result.end(), [] (const RepresentableEncoding &a, const RepresentableEncoding &b) {
+			return a.length < b.length;
+		});
+
+		return result;
+	}
+}
+
+std::vector<RepresentableEncoding> Backend::representableEncodings(std::u16string_view text) const {
+	return findRepresentable(*this, text, false);
+}
+
+RepresentableEncoding Backend::smallestEncoding(std::u16string_view text) const {
+	// UTF-16 can represent anything, so there's always at least one.
+	return findRepresentable(*this, text, true).front();
+}
@@ -0,0 +1,184 @@
+#include "stats.hh"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+std::atomic<bool> Stats::_enabled(false);
+
+void Stats::Counters::add(const Counters &other) noexcept {
+	calls += other.calls;
+	errors += other.errors;
+	bytesIn += other.bytesIn;
+	bytesOut += other.bytesOut;
+
+	for (size_t bucket = 0; bucket < kLatencyBuckets; bucket++)
+		latency[bucket] += other.latency[bucket];
+}
+
+namespace {
+	using Stats::Snapshot;
+
+	/** Key of an entry in `Totals::entries`. Ordering by this orders by operation, then by encoding. */
+	using EntryKey = std::pair<Stats::Operation, EncodingId>;
+
+	/** Counts of one thread, or of all threads that have exited. */
+	struct Totals {
+		std::map<EntryKey, Stats::Counters> entries;
+		std::array<std::array<uint64_t, 2>, Stats::kFastPathCount> fastPaths = {};
+		uint64_t copies = 0, copiedBytes = 0;
+
+		void addTo(Totals &other) const {
+			for (const auto &entry : entries)
+				other.entries[entry.first].add(entry.second);
+
+			for (size_t path = 0; path < Stats::kFastPathCount; path++) {
+				other.fastPaths[path][0] += fastPaths[path][0];
+				other.fastPaths[path][1] += fastPaths[path][1];
+			}
+
+			other.copies += copies;
+			other.copiedBytes += copiedBytes;
+		}
+
+		void clear() {
+			*this = Totals();
+		}
+	};
+
+	class ThreadStats;
+
+	/** Every thread that has counted something, and the counts of those that have exited. */
+	struct Registry {
+		std::mutex mutex;
+		std::vector<ThreadStats *> threads;
+		Totals exited;
+
+		static Registry &get() {
+			// Never destroyed, so that threads still running at exit can safely unregister.
+			static Registry *const registry = new Registry();
+			return *registry;
+		}
+	};
+
+	/**
+	 * One thread's counts.
+	 *
+	 * Only the owning thread adds to these, but `collect` and `reset` read and clear them from other threads, so they're guarded by a mutex. Other threads only take it when statistics are read, so the owning thread nearly always finds it free.
+	 */
+	class ThreadStats {
+		std::mutex _mutex;
+		Totals _totals;
+
+		ThreadStats() {
+			auto &registry = Registry::get();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.threads.push_back(this);
+		}
+
+		public:
+		~ThreadStats() {
+			auto &registry = Registry::get();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+			_totals.addTo(registry.exited);
+		}
+
+		static ThreadStats &current() {
+			thread_local ThreadStats stats;
+			return stats;
+		}
+
+		template <typename Fn>
+		void update(Fn fn) noexcept {
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			// Counting is best-effort. If memory runs out while adding an entry, the count is lost, rather than the conversion failing.
+			try {
+				fn(_totals);
+			}
+			catch (...) {}
+		}
+
+		void addTo(Totals &totals) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_totals.addTo(totals);
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_totals.clear();
+		}
+	};
+
+	/** Index of the latency bucket for a call that took `nanoseconds`: the position of its highest set bit. */
+	size_t latencyBucket(uint64_t nanoseconds) noexcept {
+		size_t bucket = 0;
+		while (nanoseconds > 1 && bucket < Stats::kLatencyBuckets - 1) {
+			nanoseconds >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+}
+
+void Stats::setEnabled(bool enabled) noexcept {
+	_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Stats::_fastPath(FastPath path, bool taken) noexcept {
+	ThreadStats::current().update([&] (Totals &totals) {
+		totals.fastPaths[static_cast<size_t>(path)][taken]++;
+	});
+}
+
+void Stats::_copy(size_t bytes) noexcept {
+	ThreadStats::current().update([&] (Totals &totals) {
+		totals.copies++;
+		totals.copiedBytes += bytes;
+	});
+}
+
+void Stats::_record(Operation operation, EncodingId encoding, uint64_t nanoseconds, size_t bytesIn, size_t bytesOut, bool ok) noexcept {
+	const size_t bucket = latencyBucket(nanoseconds);
+
+	ThreadStats::current().update([&] (Totals &totals) {
+		auto &counters = totals.entries[{ operation, encoding }];
+		counters.calls++;
+		counters.errors += !ok;
+		counters.bytesIn += bytesIn;
+		counters.bytesOut += bytesOut;
+		counters.latency[bucket]++;
+	});
+}
+
+Snapshot Stats::collect() {
+	auto &registry = Registry::get();
+	Totals totals;
+
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.exited.addTo(totals);
+		for (auto thread : registry.threads)
+			thread->addTo(totals);
+	}
+
+	Snapshot snapshot;
+	snapshot.entries.reserve(totals.entries.size());
+	for (const auto &entry : totals.entries)
+		snapshot.entries.push_back({ entry.first.first, entry.first.second, entry.second });
+
+	snapshot.fastPaths = totals.fastPaths;
+	snapshot.copies = totals.copies;
+	snapshot.copiedBytes = totals.copiedBytes;
+	return snapshot;
+}
+
+void Stats::reset() {
+	auto &registry = Registry::get();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	registry.exited.clear();
+	for (auto thread : registry.threads)
+		thread->clear();
+}
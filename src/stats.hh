@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Backend.hh"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Optional statistics about the conversions that the module performs, for `getStats`.
+ *
+ * Collecting them is off until `setEnabled(true)`. While off, each of the functions here costs one relaxed atomic load and a branch.
+ *
+ * Each thread counts into its own `ThreadStats`, so threads never wait on each other to count something. `collect` adds up every thread's counts, including those of threads that have since exited.
+ */
+namespace Stats {
+	enum class Operation : uint8_t {
+		decode,
+		encode,
+		transcode
+	};
+	constexpr size_t kOperationCount = 3;
+
+	/** Shortcuts that are taken when possible. For each, the stats count how many times it was taken and how many times it wasn't. */
+	enum class FastPath : uint8_t {
+		/** All-ASCII text, which is copied without conversion. */
+		ascii,
+
+		/** Decoded text that is contiguous in memory (as it is when Core Foundation's `CFStringGetCharactersPtr` succeeds), rather than being copied out in pieces. */
+		contiguousText,
+
+		/** Decoded text long enough to be made into an external string, which the JavaScript engine uses without copying. Not taken if Node.js doesn't support external strings. */
+		externalString
+	};
+	constexpr size_t kFastPathCount = 3;
+
+	/** Number of latency buckets. Bucket `i` counts calls that took at least 2^i nanoseconds, but less than 2^(i+1). The last bucket also counts anything longer. */
+	constexpr size_t kLatencyBuckets = 32;
+
+	/** Counts for one operation on one encoding. */
+	struct Counters {
+		uint64_t calls = 0;
+		uint64_t errors = 0;
+		uint64_t bytesIn = 0;
+		uint64_t bytesOut = 0;
+		std::array<uint64_t, kLatencyBuckets> latency = {};
+
+		void add(const Counters &other) noexcept;
+	};
+
+	/** All statistics, as returned by `collect`. */
+	struct Snapshot {
+		struct Entry {
+			Operation operation;
+			EncodingId encoding;
+			Counters counters;
+		};
+
+		/** Counts for each operation and encoding that has been used, ordered by operation and then by encoding. */
+		std::vector<Entry> entries;
+
+		/** How many times each `FastPath` was taken (`[path][1]`) and not taken (`[path][0]`). */
+		std::array<std::array<uint64_t, 2>, kFastPathCount> fastPaths = {};
+
+		/** How many times text was copied between JavaScript and native memory, and how many bytes were copied in total. */
+		uint64_t copies = 0, copiedBytes = 0;
+	};
+
+	extern std::atomic<bool> _enabled;
+
+	inline bool enabled() noexcept {
+		return _enabled.load(std::memory_order_relaxed);
+	}
+
+	void setEnabled(bool enabled) noexcept;
+
+	/** Adds up the counts of every thread. */
+	Snapshot collect();
+
+	/** Sets all counts back to zero. */
+	void reset();
+
+	void _fastPath(FastPath path, bool taken) noexcept;
+	void _copy(size_t bytes) noexcept;
+
+	/** Counts one chance to take a `FastPath`, and whether it was `taken`. */
+	inline void fastPath(FastPath path, bool taken) noexcept {
+		if (enabled())
+			_fastPath(path, taken);
+	}
+
+	/** Counts one copy of `bytes` bytes of text between JavaScript and native memory. */
+	inline void copy(size_t bytes) noexcept {
+		if (enabled())
+			_copy(bytes);
+	}
+
+	/** When a call started, if statistics were enabled at the time. Cheap to copy, so it can be carried along to the completion of an asynchronous call. */
+	class Timer {
+		std::chrono::steady_clock::time_point _start;
+		bool _running;
+
+		public:
+		inline Timer() noexcept : _running(enabled()) {
+			if (_running)
+				_start = std::chrono::steady_clock::now();
+		}
+
+		inline bool running() const noexcept {
+			return _running;
+		}
+
+		inline uint64_t elapsedNanoseconds() const noexcept {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+		}
+	};
+
+	void _record(Operation operation, EncodingId encoding, uint64_t nanoseconds, size_t bytesIn, size_t bytesOut, bool ok) noexcept;
+
+	/**
+	 * Counts one call that started when `timer` was made, and has just finished.
+	 *
+	 * @param bytesIn, bytesOut - The size of the input and output. Text in JavaScript strings counts as UTF-16, two bytes per code unit.
+	 * @param ok - Whether the call succeeded. If not, it counts as an error.
+	 */
+	inline void record(Operation operation, EncodingId encoding, const Timer &timer, size_t bytesIn, size_t bytesOut, bool ok) noexcept {
+		if (timer.running())
+			_record(operation, encoding, timer.elapsedNanoseconds(), bytesIn, bytesOut, ok);
+	}
+
+	/**
+	 * Counts one synchronous call, from construction to destruction.
+	 *
+	 * Call `succeeded` with the size of the output before returning it. If the call ends any other way, such as by throwing an error, then it counts as an error. If the size of the input isn't known up front, give it to `input` once it is.
+	 */
+	class Call {
+		const Timer _timer;
+		const Operation _operation;
+		const EncodingId _encoding;
+		size_t _bytesIn;
+		size_t _bytesOut = 0;
+		bool _ok = false;
+
+		public:
+		inline Call(Operation operation, EncodingId encoding, size_t bytesIn = 0) noexcept
+		: _operation(operation)
+		, _encoding(encoding)
+		, _bytesIn(bytesIn)
+		{}
+
+		Call(const Call &) = delete;
+		Call &operator=(const Call &) = delete;
+
+		inline ~Call() {
+			record(_operation, _encoding, _timer, _bytesIn, _bytesOut, _ok);
+		}
+
+		inline void input(size_t bytesIn) noexcept {
+			_bytesIn = bytesIn;
+		}
+
+		inline void succeeded(size_t bytesOut) noexcept {
+			_bytesOut = bytesOut;
+			_ok = true;
+		}
+	};
+}
@@ -1,12 +1,20 @@
 #include "string-utils.hh"
-#include <sstream>
+#include "stats.hh"
+#include <algorithm>
+#include <dlfcn.h>
 #include <cstdlib>
-#include <arpa/inet.h>
+#include <memory>
+#include <new>
+#include <vector>
 
-static constexpr const bool isBigEndian = htonl(1) == 1;
+PooledU16String NapiStringToUTF16(const Napi::String text) {
+	PooledU16String buf;
+	NapiStringToUTF16(text, buf);
+	return buf;
+}
 
-CFStringHandle NapiStringToCFString(const Napi::String text) {
-	// Napi::String::Utf16Value would be painfully inefficient for what we're doing: using it would involve *three* copies of the string (JS VM to std::u16string to CFString) per call to this function! Using raw N-API, we can reduce it to one copy (JS VM to buffer, then transfer ownership of buffer to CFString). I'd rather have zero copies, but N-API makes that impossible, unfortunately.
+void NapiStringToUTF16(const Napi::String text, PooledU16String &buf) {
+	// Napi::String::Utf16Value would be needlessly inefficient for what we're doing, because it measures the string and then copies it into a temporary buffer before making the string. Using raw N-API, we can copy the characters straight from the JS VM into their final home.
 	const napi_env env = text.Env();
 	size_t length;
 
@@ -20,78 +28,317 @@ CFStringHandle NapiStringToCFString(const Napi::String text) {
 		&length
 	));
 
-	// For some insane reason, napi_get_value_string_utf16 adds a null code unit to the end of the UTF-16 string (which is useful in UTF-8 but completely useless in UTF-16), so we need to allocate an extra byte pair for it.
-	const size_t
-		lengthWithNull = length + 1,
-		byteLength = length * 2,
-		byteLengthWithNull = lengthWithNull * 2;
-
-	// Allocate memory for the string.
-	auto buf = static_cast<char16_t *>(CFAllocatorAllocate(kCFAllocatorDefault, byteLengthWithNull, 0));
-
-	try {
-		// Copy string contents.
-		throwIfFailed(env, napi_get_value_string_utf16(
-			env,
-			text,
-			buf,
-			lengthWithNull,
-			nullptr
-		));
-
-		// Make CFString.
-		auto cfstr = CFStringCreateWithBytesNoCopy(
-			kCFAllocatorDefault,
-			reinterpret_cast<UInt8 *>(buf),
-			byteLength,
-			kCFStringEncodingUTF16LE,
-			true,
-			kCFAllocatorDefault // This tells it to deallocate `buf` when ready. In other words, this transfers ownership of the buffer to the new CFString.
-		);
-
-		if (cfstr == nullptr) {
-			auto error = Napi::Error::New(text.Env(), "CFStringCreateWithBytesNoCopy() failed to convert the supplied text.");
-			error.Set("text", text);
-			throw error;
+	buf.resize(length);
+
+	// Copy string contents.
+	// For some insane reason, napi_get_value_string_utf16 adds a null code unit to the end of the UTF-16 string (which is useful in UTF-8 but completely useless in UTF-16), so we need to tell it there's room for one more. std::basic_string always has room for a null terminator past the end.
+	throwIfFailed(env, napi_get_value_string_utf16(
+		env,
+		text,
+		&buf[0],
+		length + 1,
+		nullptr
+	));
+
+	Stats::copy(length * sizeof(char16_t));
+}
+
+namespace {
+	/** Strings longer than this don't get to keep the scratch buffer at their size after `NapiStringToScratchUTF16` is done with them. */
+	constexpr size_t kMaxKeptScratchLength = 64 * 1024;
+}
+
+std::u16string_view NapiStringToScratchUTF16(const Napi::String text, size_t maxLength) {
+	thread_local PooledU16String buffer;
+
+	if (buffer.capacity() > kMaxKeptScratchLength)
+		PooledU16String().swap(buffer);
+
+	const napi_env env = text.Env();
+	size_t length;
+	throwIfFailed(env, napi_get_value_string_utf16(env, text, nullptr, 0, &length));
+
+	if (length <= maxLength) {
+		NapiStringToUTF16(text, buffer);
+		return buffer;
+	}
+
+	// As in NapiStringToUTF16, there's room for the null code unit that napi_get_value_string_utf16 insists on adding.
+	buffer.resize(maxLength);
+	throwIfFailed(env, napi_get_value_string_utf16(env, text, &buffer[0], maxLength + 1, nullptr));
+	Stats::copy(maxLength * sizeof(char16_t));
+
+	if (maxLength != 0 && buffer[maxLength - 1] >= 0xd800 && buffer[maxLength - 1] <= 0xdbff)
+		buffer.pop_back();
+
+	return buffer;
+}
+
+Napi::String UTF16ToNapiString(std::u16string_view text, Napi::Env env) {
+	// This copies the string from native memory to the JS heap.
+	Stats::copy(text.size() * sizeof(char16_t));
+	return Napi::String::New(env, text.data(), text.size());
+}
+
+namespace {
+	/** Size of the pieces that non-contiguous text is copied out in, in UTF-16 code units. */
+	constexpr size_t kChunkLength = 32 * 1024;
+
+	/** How many pieces `DecodedTextToNapiString` joins in one call to `concat`. */
+	constexpr size_t kConcatBatchLength = 64;
+
+	/** Space to copy one piece of text into. Each thread has its own, which is reused from one call to the next. */
+	char16_t *scratchBuffer() {
+		thread_local const std::unique_ptr<char16_t[]> buffer(new char16_t[kChunkLength]);
+		return buffer.get();
+	}
+}
+
+Napi::String DecodedTextToNapiString(const DecodedText &text, Napi::Env env, Napi::Function concat) {
+	Stats::fastPath(Stats::FastPath::contiguousText, text.isContiguous());
+
+	if (text.isContiguous())
+		return UTF16ToNapiString(text, env);
+
+	const size_t length = text.size();
+	auto const scratch = scratchBuffer();
+
+	if (length <= kChunkLength) {
+		text.read(0, length, scratch);
+		return UTF16ToNapiString({ scratch, length }, env);
+	}
+
+	// Make a JS string out of each piece, then concatenate them. JavaScript engines represent the result as a rope that points to the pieces, rather than copying them again. (A surrogate pair may be split between two pieces, but that's fine, because JS strings are just sequences of UTF-16 code units, not necessarily valid ones.)
+	Napi::EscapableHandleScope scope(env);
+	std::vector<napi_value> pieces;
+	pieces.reserve((length + kChunkLength - 1) / kChunkLength);
+
+	for (size_t start = 0; start < length; start += kChunkLength) {
+		const size_t pieceLength = std::min(kChunkLength, length - start);
+		text.read(start, pieceLength, scratch);
+		pieces.push_back(UTF16ToNapiString({ scratch, pieceLength }, env));
+	}
+
+	// Join them a batch at a time, and then the batches, and so on, so that no call to `concat` gets more than `kConcatBatchLength` arguments.
+	while (pieces.size() > 1) {
+		size_t joined = 0;
+
+		for (size_t start = 0; start < pieces.size(); start += kConcatBatchLength) {
+			const size_t batchLength = std::min(kConcatBatchLength, pieces.size() - start);
+
+			if (batchLength == 1)
+				pieces[joined++] = pieces[start];
+			else
+				pieces[joined++] = concat.Call(pieces[start], batchLength - 1, &pieces[start + 1]);
+		}
+
+		pieces.resize(joined);
+	}
+
+	return scope.Escape(pieces.front()).As<Napi::String>();
+}
+
+namespace {
+	/**
+	 * Signature of `node_api_create_external_string_latin1` and `node_api_create_external_string_utf16`.
+	 *
+	 * These are only in newer versions of Node.js, so they're looked up at run time instead of linked to, so that this module still loads in older versions.
+	 */
+	template <typename Char>
+	using CreateExternalString = napi_status (*)(napi_env env, Char *str, size_t length, napi_finalize finalizeCallback, void *finalizeHint, napi_value *result, bool *copied);
+
+	template <typename Char>
+	CreateExternalString<Char> findCreateExternalString(const char *name) noexcept {
+		return reinterpret_cast<CreateExternalString<Char>>(dlsym(RTLD_DEFAULT, name));
+	}
+
+	/** Keeps the characters of an external string alive until the string is garbage collected. */
+	template <typename T>
+	struct ExternalStringContents {
+		T contents;
+		int64_t externalMemory = 0;
+
+		inline ExternalStringContents(T &&contents) : contents(std::move(contents)) {}
+	};
+
+	/**
+	 * Makes a JavaScript string that uses the characters in `holder` where they are, instead of copying them into the JavaScript heap.
+	 *
+	 * If this succeeds, `holder` is released, and it is freed when the string is garbage collected. Otherwise, it is left alone, and the caller should copy the characters instead.
+	 */
+	template <typename T, typename Char>
+	std::optional<Napi::String> newExternalString(
+		Napi::Env env,
+		CreateExternalString<Char> create,
+		std::unique_ptr<ExternalStringContents<T>> &holder,
+		Char *chars,
+		size_t length
+	) {
+		napi_value result;
+		bool copied;
+
+		const auto status = create(env, chars, length, [] (napi_env env, void *, void *hint) {
+			auto const holder = static_cast<ExternalStringContents<T> *>(hint);
+			if (holder->externalMemory != 0)
+				napi_adjust_external_memory(env, -holder->externalMemory, nullptr);
+			delete holder;
+		}, holder.get(), &result, &copied);
+
+		if (status != napi_ok) {
+			Stats::fastPath(Stats::FastPath::externalString, false);
+			return std::nullopt;
 		}
 
-		return CFStringHandle(cfstr);
+		Stats::fastPath(Stats::FastPath::externalString, !copied);
+
+		// Either way, the string now owns the holder. If the characters were copied after all, the finalizer has already freed it.
+		auto const owned = holder.release();
+
+		if (!copied) {
+			owned->externalMemory = static_cast<int64_t>(length * sizeof(Char));
+			Napi::MemoryManagement::AdjustExternalMemory(env, owned->externalMemory);
+		}
+
+		return Napi::String(env, result);
 	}
-	catch (...) {
-		// If any of that failed, we need to free the allocated buffer memory ourselves.
-		CFAllocatorDeallocate(kCFAllocatorDefault, buf);
-		throw;
+}
+
+Napi::String DecodedTextToNapiString(DecodedText &&text, Napi::Env env, Napi::Function concat, size_t externalThreshold) {
+	const size_t length = text.size();
+
+	if (length < externalThreshold || length == 0)
+		return DecodedTextToNapiString(text, env, concat);
+
+	static const auto create = findCreateExternalString<char16_t>("node_api_create_external_string_utf16");
+
+	if (create == nullptr) {
+		Stats::fastPath(Stats::FastPath::externalString, false);
+		return DecodedTextToNapiString(text, env, concat);
+	}
+
+	auto holder = std::make_unique<ExternalStringContents<DecodedText>>(std::move(text));
+
+	// This copies the text into contiguous storage first, if it isn't already. That copy then becomes the string, instead of another copy in the JavaScript heap.
+	auto const chars = const_cast<char16_t *>(holder->contents.data());
+
+	if (auto result = newExternalString(env, create, holder, chars, length))
+		return *result;
+	else
+		return UTF16ToNapiString(holder->contents, env);
+}
+
+Napi::String Latin1ToNapiString(const uint8_t *bytes, size_t length, Napi::Env env) {
+	napi_value result;
+	Stats::copy(length);
+	throwIfFailed(env, napi_create_string_latin1(env, reinterpret_cast<const char *>(bytes), length, &result));
+	return Napi::String(env, result);
+}
+
+Napi::String Latin1ToNapiString(EncodedBytes &&bytes, Napi::Env env, size_t externalThreshold) {
+	const size_t length = bytes.size();
+
+	if (length < externalThreshold || length == 0)
+		return Latin1ToNapiString(bytes.data(), length, env);
+
+	static const auto create = findCreateExternalString<char>("node_api_create_external_string_latin1");
+
+	if (create == nullptr) {
+		Stats::fastPath(Stats::FastPath::externalString, false);
+		return Latin1ToNapiString(bytes.data(), length, env);
+	}
+
+	auto holder = std::make_unique<ExternalStringContents<EncodedBytes>>(std::move(bytes));
+	auto const chars = reinterpret_cast<char *>(const_cast<uint8_t *>(holder->contents.data()));
+
+	if (auto result = newExternalString(env, create, holder, chars, length))
+		return *result;
+	else
+		return Latin1ToNapiString(holder->contents.data(), length, env);
+}
+
+namespace {
+	/** Whether the given UTF-8 text contains U+FFFD REPLACEMENT CHARACTER, which is what `napi_get_value_string_utf8` puts in place of unpaired surrogates. */
+	bool containsReplacementCharacter(const uint8_t *bytes, size_t length) {
+		static constexpr uint8_t replacement[] = { 0xef, 0xbf, 0xbd };
+		return std::search(bytes, bytes + length, std::begin(replacement), std::end(replacement)) != bytes + length;
 	}
 }
 
-Napi::String CFStringToNapiString(CFStringRef text, Napi::Env env) {
-	auto length = CFStringGetLength(text);
+NapiStringToEncode::NapiStringToEncode(const Napi::String text, bool asciiCompatible) {
+	const napi_env env = text.Env();
+	size_t utf8Length = 0;
+
+	throwIfFailed(env, napi_get_value_string_utf16(env, text, nullptr, 0, &_length));
 
-	if (!isBigEndian) {
-		// Try to avoid copying. Only possible if the system is little-endian, because N-API only accepts little-endian UTF-16.
-		auto bytes = CFStringGetCharactersPtr(text);
-		if (bytes != nullptr)
-			// This will still copy the string from CF memory to the JS heap, but at least it's copied only once.
-			return Napi::String::New(env, reinterpret_cast<const char16_t *>(bytes), length);
+	if (asciiCompatible) {
+		throwIfFailed(env, napi_get_value_string_utf8(env, text, nullptr, 0, &utf8Length));
+
+		// Every non-ASCII character takes up more UTF-8 code units than UTF-16 code units, so if the lengths are the same, all of the characters are ASCII.
+		_ascii = utf8Length == _length;
+		Stats::fastPath(Stats::FastPath::ascii, _ascii);
 	}
 
-	// Extract UTF16LE characters from the CFString.
-	// This code path, unfortunately, will copy the string twice: once from CFString to the buffer here, then again to copy the string to the JS heap.
-	const size_t byteLength = length * 2;
-	uint8_t bytes[byteLength];
-	auto charsConverted = CFStringGetBytes(text, { .length = length }, kCFStringEncodingUTF16LE, 0, false, bytes, byteLength, nullptr);
-
-	// Make sure it's the correct length.
-	if (charsConverted != length) {
-		std::stringstream ss;
-		ss << "CFStringGetBytes should have yielded "
-			<< byteLength
-			<< " bytes, but it instead yielded "
-			<< (charsConverted * 2)
-			<< " bytes.";
-		throw Napi::Error::New(env, ss.str());
+	// Copy the text as UTF-8 if that's smaller than UTF-16. Only ASCII-compatible encodings can be encoded from it, because only they can be encoded a piece at a time.
+	if (asciiCompatible && utf8Length < _length * sizeof(char16_t)) {
+		// As with napi_get_value_string_utf16, we need room for a null terminator.
+		auto const data = static_cast<uint8_t *>(std::malloc(utf8Length + 1));
+		if (data == nullptr)
+			throw std::bad_alloc();
+
+		EncodedBytes bytes(data, utf8Length);
+		throwIfFailed(env, napi_get_value_string_utf8(env, text, reinterpret_cast<char *>(data), utf8Length + 1, nullptr));
+		Stats::copy(utf8Length);
+
+		// Unpaired surrogates can't be represented in UTF-8, and come out as U+FFFD instead. Those have to be encoded from UTF-16, so that they're reported as unrepresentable (or replaced with the loss byte) like they would be otherwise. Since U+FFFD is rare in text, this just checks for it, rather than trying to tell real ones apart from unpaired surrogates.
+		if (_ascii || !containsReplacementCharacter(data, utf8Length)) {
+			_utf8 = std::move(bytes);
+			return;
+		}
 	}
 
-	// Construct the JS string. This will copy the characters from the buffer (which is allocated on the stack) to the JS heap.
-	return Napi::String::New(env, reinterpret_cast<char16_t *>(bytes), length);
+	NapiStringToUTF16(text, _utf16);
+}
+
+NapiStringToShortUTF8::NapiStringToShortUTF8(const Napi::String text) {
+	const napi_env env = text.Env();
+	size_t length;
+
+	throwIfFailed(env, napi_get_value_string_utf8(env, text, _short, sizeof(_short), &length));
+
+	// A character that doesn't fit in what's left of the buffer is left out entirely, so unless there's room for at least one more of the longest UTF-8 sequence (plus the null terminator), the string may have been cut short.
+	if (length + 4 < sizeof(_short) - 1)
+		_view = std::string_view(_short, length);
+	else {
+		_long = text.Utf8Value();
+		_view = _long;
+	}
+}
+
+std::optional<EncodedBytes> NapiStringToEncode::encode(const Backend &backend, EncodingId encoding, uint8_t lossByte, size_t *unrepresentableAt) {
+	if (!_utf8)
+		return backend.encodeAll(encoding, _utf16, lossByte, unrepresentableAt);
+
+	// All-ASCII text is the same in every ASCII-compatible encoding, and UTF-8 text is already encoded.
+	if (_ascii || encoding == kEncodingUTF8)
+		return std::move(_utf8);
+
+	return backend.encodeAllFromUTF8(encoding, _utf8->data(), _utf8->size(), _length, lossByte, unrepresentableAt);
+}
+
+Napi::Buffer<uint8_t> EncodedBytesToNapiBuffer(EncodedBytes &&bytes, Napi::Env env) {
+	const size_t length = bytes.size();
+
+	// Zero-length external buffers are troublesome in some Node versions, and there's nothing to hand over anyway.
+	if (length == 0)
+		return Napi::Buffer<uint8_t>::New(env, 0);
+
+	// Let the garbage collector know how much memory the buffer is holding on to. The finalizer gets the length back out of the hint pointer, so that it doesn't need an allocation of its own.
+	auto const buf = Napi::Buffer<uint8_t>::New(env, bytes.release(), length, [] (Napi::Env env, uint8_t *data, void *hint) {
+		std::free(data);
+		Napi::MemoryManagement::AdjustExternalMemory(env, -static_cast<int64_t>(reinterpret_cast<uintptr_t>(hint)));
+	}, reinterpret_cast<void *>(static_cast<uintptr_t>(length)));
+
+	Napi::MemoryManagement::AdjustExternalMemory(env, static_cast<int64_t>(length));
+
+	return buf;
 }
@@ -1,17 +1,113 @@
 #pragma once
 
-#include <CoreFoundation/CFString.h>
-#include "CFHandle.hh"
 #include "napi.hh"
+#include "Backend.hh"
+#include <optional>
+#include <string>
+#include <string_view>
 
 /**
- * Makes a `CFStringRef` from the characters in the given `Napi::String`, making 1 to 2 copies.
+ * Copies the characters in the given `Napi::String` into native memory, as UTF-16. This makes exactly one copy.
  */
-CFStringHandle NapiStringToCFString(const Napi::String text);
+PooledU16String NapiStringToUTF16(const Napi::String text);
 
 /**
- * Makes a `Napi::String` from the characters in the given `CFString`, making 1 to 2 copies.
+ * Like the other `NapiStringToUTF16`, but replaces the contents of `buf`. Converting many strings into the same `buf` saves allocating memory for each one.
+ */
+void NapiStringToUTF16(const Napi::String text, PooledU16String &buf);
+
+/**
+ * Copies the given string into a buffer that each thread reuses from one call to the next, for when the text only needs to be looked at, not kept. If a long string leaves the buffer big, it's let go of on the next call.
+ *
+ * @param maxLength - How many code units to copy, at most. If the string is longer than that, the copy also stops short of a surrogate pair that would be cut in half.
+ */
+std::u16string_view NapiStringToScratchUTF16(const Napi::String text, size_t maxLength = SIZE_MAX);
+
+/**
+ * Makes a `Napi::String` from the given UTF-16 text, making one copy.
+ *
+ * The passed-in text is always copied, so it is safe to free it after this function completes.
+ */
+Napi::String UTF16ToNapiString(std::u16string_view text, Napi::Env env);
+
+/**
+ * Makes a `Napi::String` from the given decoded text.
+ *
+ * If the text isn't stored contiguously, it's copied out in fixed-size pieces through a per-thread scratch buffer, and large texts are assembled from those pieces in the JavaScript heap. Either way, the only full-size copy of the text that this makes is the JavaScript string itself.
+ *
+ * @param concat - `String.prototype.concat`, which joins the pieces of a large text. See `Iccf::stringConcat`.
+ */
+Napi::String DecodedTextToNapiString(const DecodedText &text, Napi::Env env, Napi::Function concat);
+
+/**
+ * Like the other `DecodedTextToNapiString`, but if the text is at least `externalThreshold` code units long, and the running version of Node.js supports external strings, then the JavaScript string uses the text where it is, instead of copying it into the JavaScript heap. The text is then kept until the string is garbage collected.
+ */
+Napi::String DecodedTextToNapiString(DecodedText &&text, Napi::Env env, Napi::Function concat, size_t externalThreshold);
+
+/**
+ * Makes a `Napi::String` from the given Latin-1 bytes. JavaScript engines store such strings compactly (one byte per character), so this is much cheaper than going through UTF-16.
+ */
+Napi::String Latin1ToNapiString(const uint8_t *bytes, size_t length, Napi::Env env);
+
+/** Like the other `Latin1ToNapiString`, but makes an external string out of `bytes` if it's long enough, as `DecodedTextToNapiString` does. */
+Napi::String Latin1ToNapiString(EncodedBytes &&bytes, Napi::Env env, size_t externalThreshold);
+
+/**
+ * The characters of a `Napi::String`, copied into native memory to be encoded.
+ *
+ * If the text is to be encoded in an ASCII-compatible encoding, and it's mostly ASCII or Latin-1 characters, then it's copied as UTF-8, which takes about half the memory that UTF-16 would. It's then widened to UTF-16 a piece at a time as it's encoded (see `Backend::encodeAllFromUTF8`), and if it's being encoded in UTF-8 or is all ASCII, the copy is already the encoded text. Other text is copied as UTF-16, as `NapiStringToUTF16` does.
  *
- * The passed-in string is always copied, so it is safe to `CFRelease` it after this function completes. (That will happen automatically if it's wrapped in a CFHandle.)
+ * N-API can't tell whether a string is stored one byte per character, and `napi_get_value_string_latin1` silently mangles any characters that don't fit in a byte, so UTF-8 is the compact form used here instead of Latin-1.
+ */
+class NapiStringToEncode {
+	PooledU16String _utf16;
+	std::optional<EncodedBytes> _utf8;
+	size_t _length;
+	bool _ascii = false;
+
+	public:
+	NapiStringToEncode(const Napi::String text, bool asciiCompatible);
+
+	/** Length of the text, in UTF-16 code units. */
+	inline size_t length() const {
+		return _length;
+	}
+
+	/** Whether the text consists entirely of ASCII characters. If so, and the encoding is ASCII-compatible, `encode` returns the copy as it is. */
+	inline bool isASCII() const {
+		return _ascii;
+	}
+
+	/**
+	 * Encodes the text, as `Backend::encodeAll` does.
+	 *
+	 * This may hand over the copied text itself as the encoded text, so it can only be called once.
+	 */
+	std::optional<EncodedBytes> encode(const Backend &backend, EncodingId encoding, uint8_t lossByte, size_t *unrepresentableAt = nullptr);
+};
+
+/**
+ * The characters of a `Napi::String` that is usually short, such as the name of an encoding, copied into native memory as UTF-8.
+ *
+ * Strings that fit are copied into this object itself, so looking one up doesn't allocate any memory. Longer ones are copied to the heap.
+ */
+class NapiStringToShortUTF8 {
+	char _short[64];
+	std::string _long;
+	std::string_view _view;
+
+	public:
+	explicit NapiStringToShortUTF8(const Napi::String text);
+
+	NapiStringToShortUTF8(const NapiStringToShortUTF8 &) = delete;
+	NapiStringToShortUTF8 &operator=(const NapiStringToShortUTF8 &) = delete;
+
+	inline operator std::string_view() const noexcept {
+		return _view;
+	}
+};
+
+/**
+ * Hands the given bytes over to a new `Napi::Buffer`, without copying them. The buffer frees them when it is garbage collected.
  */
-Napi::String CFStringToNapiString(CFStringRef text, Napi::Env env);
+Napi::Buffer<uint8_t> EncodedBytesToNapiBuffer(EncodedBytes &&bytes, Napi::Env env);
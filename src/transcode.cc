@@ -1,11 +1,21 @@
 #include "transcode.hh"
 #include "iccf.hh"
-#include "CFHandle.hh"
 #include "string-utils.hh"
 #include "StringEncoding.hh"
+#include "ascii.hh"
+#include "ConversionWorker.hh"
+#include "GrowableBuffer.hh"
+#include "file.hh"
+#include "parallel.hh"
+#include "stats.hh"
+#include "unicode.hh"
+#include <algorithm>
 #include <optional>
 #include <functional>
-#include <CoreFoundation/CFString.h>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include <uv.h>
 
 bool EncodeOptions::isEncodingOk(StringEncoding *encoding) const {
 	if (_isEncodingOk.IsEmpty())
@@ -14,7 +24,7 @@ bool EncodeOptions::isEncodingOk(StringEncoding *encoding) const {
 		return _isEncodingOk({encoding->Value()}).ToBoolean();
 }
 
-bool EncodeOptions::isEncodingOk(Napi::Env env, const Iccf *iccf, CFStringEncoding encoding, StringEncoding **encodingObj) const {
+bool EncodeOptions::isEncodingOk(Napi::Env env, const Iccf *iccf, EncodingId encoding, StringEncoding **encodingObj) const {
 	auto _encodingObj = iccf->StringEncoding.New(env, encoding);
 
 	if (encodingObj != nullptr)
@@ -27,38 +37,45 @@ static Iccf *getIccf(const Napi::CallbackInfo &info) {
 	return reinterpret_cast<Iccf *>(info.Data());
 }
 
+/** Picks an encoding for some text, and says how long the text will be in it. */
+using SelectEncoding = std::function<RepresentableEncoding(std::u16string_view)>;
+
 static Napi::Value selectAndEncode(
 	const Napi::Env env,
 	const Iccf *iccf,
-	const CFStringRef text,
+	const std::u16string_view text,
 	const EncodeOptions &options,
-	const std::function<StringEncoding *(CFStringRef)> &selectEncoding,
+	const SelectEncoding &selectEncoding,
 	StringEncoding **selectedEncoding = nullptr,
-	const std::function<Napi::Value(CFStringRef, Napi::Env)> &origString = CFStringToNapiString
+	const std::function<Napi::Value(std::u16string_view, Napi::Env)> &origString = UTF16ToNapiString
 ) {
-	const auto encoding = selectEncoding(text);
+	const auto selected = selectEncoding(text);
+	const auto encoding = iccf->StringEncoding.New(env, selected.encoding);
 
 	if (selectedEncoding != nullptr)
 		*selectedEncoding = encoding;
 
-	if (options.isEncodingOk(encoding)) {
-		const auto encodedText = encoding->cfEncode(env, text, options.lossByte, origString);
-
-		auto result = Napi::Object::New(env);
-		result["encoding"] = encoding->Value();
-		result["text"] = encodedText;
-		return result;
-	}
-	else
+	if (!options.isEncodingOk(encoding))
 		return env.Null();
+
+	// The length is already known, so this is a single pass into a buffer of exactly the right size.
+	auto encoded = iccf->backend.encodeAll(selected.encoding, text, options.lossByte, selected.length);
+
+	if (!encoded)
+		throw iccf->newNotRepresentableError(env, origString(text, env), encoding->Value());
+
+	auto result = Napi::Object::New(env);
+	result["encoding"] = encoding->Value();
+	result["text"] = EncodedBytesToNapiBuffer(std::move(*encoded), env);
+	return result;
 }
 
 static Napi::Value selectAndEncode(
 	const Napi::Env env,
 	const Iccf *iccf,
-	const CFStringRef text,
+	const std::u16string_view text,
 	const EncodeOptions &options,
-	const std::function<StringEncoding *(CFStringRef)> &selectEncoding,
+	const SelectEncoding &selectEncoding,
 	StringEncoding **selectedEncoding,
 	const Napi::Value &origString
 ) {
@@ -81,9 +98,9 @@ static Napi::Value selectAndEncode(
 static Napi::Value selectAndEncode(
 	const Napi::Env env,
 	const Iccf *iccf,
-	const CFStringRef text,
+	const std::u16string_view text,
 	const EncodeOptions &options,
-	const std::function<StringEncoding *(CFStringRef)> &selectEncoding,
+	const SelectEncoding &selectEncoding,
 	const Napi::Value &origString
 ) {
 	return selectAndEncode(
@@ -97,10 +114,13 @@ static Napi::Value selectAndEncode(
 	);
 }
 
-static Napi::Value selectAndEncode(
-	const Napi::CallbackInfo &info,
-	CFStringEncoding (*selectEncoding)(CFStringRef text)
-) {
+static SelectEncoding selectSmallest(const Iccf *iccf) {
+	return [iccf] (std::u16string_view text) {
+		return iccf->backend.smallestEncoding(text);
+	};
+}
+
+static Napi::Value encodeSmallest(const Napi::CallbackInfo &info) {
 	const auto env = info.Env();
 	const auto iccf = getIccf(info);
 	const Napi::Value text = info[0];
@@ -108,30 +128,357 @@ static Napi::Value selectAndEncode(
 	return selectAndEncode(
 		env,
 		iccf,
-		NapiStringToCFString(text.ToString()),
+		NapiStringToUTF16(text.ToString()),
 		EncodeOptions(info[1]),
-		[&] (auto cfString) {
-			return iccf->StringEncoding.New(env, selectEncoding(cfString));
-		}
+		selectSmallest(iccf)
 	);
 }
 
-static Napi::Value encodeSmallest(const Napi::CallbackInfo &info) {
-	return selectAndEncode(info, CFStringGetSmallestEncoding);
+static Napi::Value representableEncodings(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto representable = iccf->backend.representableEncodings(NapiStringToUTF16(info[0].ToString()));
+
+	auto result = Napi::Array::New(env, representable.size());
+
+	for (size_t index = 0; index < representable.size(); index++) {
+		auto item = Napi::Object::New(env);
+		item["encoding"] = iccf->StringEncoding.New(env, representable[index].encoding)->Value();
+		item["length"] = Napi::Number::New(env, static_cast<double>(representable[index].length));
+		result[static_cast<uint32_t>(index)] = item;
+	}
+
+	return result;
+}
+
+static Napi::Value detectEncoding(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto contents = iccf->StringEncoding.bufferContents(info[0]);
+	std::vector<EncodingId> candidates;
+	size_t sampleLength = Backend::kDefaultDetectionSampleLength;
+
+	if (info[1].IsObject()) {
+		const Napi::Object options = info[1].ToObject();
+
+		{
+			const Napi::Value _candidates = options["candidates"];
+			if (_candidates.IsArray()) {
+				const auto array = _candidates.As<Napi::Array>();
+
+				for (uint32_t index = 0; index < array.Length(); index++)
+					candidates.push_back(*iccf->StringEncoding.UnwrapOrThrow(array.Get(index)));
+
+				// An empty list means no candidates, not the default ones.
+				if (candidates.empty())
+					return Napi::Array::New(env);
+			}
+		}
+
+		{
+			const Napi::Value _sampleBytes = options["sampleBytes"];
+			if (_sampleBytes.IsNumber()) {
+				const double value = _sampleBytes.As<Napi::Number>().DoubleValue();
+
+				if (value >= static_cast<double>(std::numeric_limits<size_t>::max()))
+					sampleLength = std::numeric_limits<size_t>::max();
+				else if (value >= 1)
+					sampleLength = static_cast<size_t>(value);
+			}
+		}
+	}
+
+	const auto detected = iccf->backend.detectEncoding(contents.data, contents.length, candidates, sampleLength);
+	auto result = Napi::Array::New(env, detected.size());
+
+	for (size_t index = 0; index < detected.size(); index++) {
+		auto item = Napi::Object::New(env);
+		item["encoding"] = iccf->StringEncoding.New(env, detected[index].encoding)->Value();
+		item["confidence"] = Napi::Number::New(env, detected[index].confidence);
+		result[static_cast<uint32_t>(index)] = item;
+	}
+
+	return result;
 }
 
 static Napi::Value transcode(const Napi::CallbackInfo &info) {
 	const auto env = info.Env();
 	const auto iccf = getIccf(info);
+	const DecodeOptions decodeOptions(info[3]);
 	const EncodeOptions encodeOptions(info[3]);
 	const auto fromEncoding = iccf->StringEncoding.UnwrapOrThrow(info[1]), toEncoding = iccf->StringEncoding.UnwrapOrThrow(info[2]);
 	const Napi::Value text = info[0];
+	const auto contents = fromEncoding->bufferContents(text);
+	Stats::Call stats(Stats::Operation::transcode, *fromEncoding, contents.length);
+
+	// All-ASCII text is the same in every ASCII-compatible encoding, so there's nothing to convert.
+	if (toEncoding->isASCIICompatible() && fromEncoding->isCopyableASCII(contents)) {
+		decodeOptions.reportReplacements(0);
+		stats.succeeded(contents.length);
+		return Napi::Buffer<uint8_t>::Copy(env, contents.data, contents.length);
+	}
+
+	// Split large inputs among several threads, where that's possible. Invalid text that is to have its invalid sequences replaced is converted on this thread, since where each replacement goes depends on everything before it.
+	if (decodeOptions.fatal) {
+		if (auto result = parallelTranscode(iccf->backend, *fromEncoding, *toEncoding, contents.data, contents.length, encodeOptions.lossByte)) {
+			if (result->status == ParallelTranscodeResult::Status::ok) {
+				decodeOptions.reportReplacements(0);
+				stats.succeeded(result->bytes.size());
+				return EncodedBytesToNapiBuffer(std::move(result->bytes), env);
+			}
+			else if (result->status == ParallelTranscodeResult::Status::unrepresentable)
+				throw iccf->newNotRepresentableError(env, text, toEncoding->Value(), result->offset);
+			else
+				throw iccf->newInvalidEncodedTextError(env, text, fromEncoding->Value(), result->offset);
+		}
+	}
+
+	// Between Unicode encoding forms, convert directly instead of going through a UTF-16 copy of the whole text. Invalid text that is to have its invalid sequences replaced goes the long way, below.
+	if (isUnicodeEncoding(*fromEncoding) && isUnicodeEncoding(*toEncoding)) {
+		auto result = transcodeUnicode(*fromEncoding, *toEncoding, contents.data, contents.length, encodeOptions.lossByte);
+
+		if (result.status == UnicodeTranscodeResult::Status::ok) {
+			decodeOptions.reportReplacements(0);
+			stats.succeeded(result.bytes.size());
+			return EncodedBytesToNapiBuffer(std::move(result.bytes), env);
+		}
+		else if (result.status == UnicodeTranscodeResult::Status::unrepresentable)
+			throw iccf->newNotRepresentableError(env, text, toEncoding->Value(), iccf->backend.unrepresentableOffset(*fromEncoding, *toEncoding, contents.data, contents.length));
+		else if (decodeOptions.fatal)
+			throw iccf->newInvalidEncodedTextError(env, text, fromEncoding->Value(), iccf->backend.validLength(*fromEncoding, contents.data, contents.length));
+	}
+
+	const auto decoded = fromEncoding->decodeText(text, contents, decodeOptions);
+	const std::u16string_view utf16 = decoded;
+	size_t unrepresentableAt;
+	auto encoded = iccf->backend.encodeAll(*toEncoding, utf16, encodeOptions.lossByte, &unrepresentableAt);
+
+	// Where the unrepresentable character is in the input can't be worked out if invalid sequences were replaced before it.
+	if (!encoded && !decodeOptions.fatal)
+		throw iccf->newNotRepresentableError(env, text, toEncoding->Value());
+	else if (!encoded) {
+		size_t bomLength;
+		const auto unmarkedFromEncoding = Backend::skipByteOrderMark(*fromEncoding, contents.data, contents.length, bomLength);
+		throw iccf->newNotRepresentableError(env, text, toEncoding->Value(), iccf->backend.inputLength(unmarkedFromEncoding, bomLength, utf16.substr(0, unrepresentableAt)));
+	}
 
-	return toEncoding->cfEncode(
+	stats.succeeded(encoded->size());
+	return EncodedBytesToNapiBuffer(std::move(*encoded), env);
+}
+
+static Napi::Value transcodeAsync(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const DecodeOptions decodeOptions(info[3]);
+	const EncodeOptions encodeOptions(info[3]);
+	const auto fromEncoding = iccf->StringEncoding.UnwrapOrThrow(info[1]), toEncoding = iccf->StringEncoding.UnwrapOrThrow(info[2]);
+	const Napi::Value text = info[0];
+	const auto contents = fromEncoding->bufferContents(text);
+
+	struct State {
+		EncodedBytes input;
+		bool invalid = false;
+		std::optional<EncodedBytes> output;
+
+		/** Where the problem is in the input, if `invalid` is true or there's no `output`. Not known if invalid sequences were replaced. */
+		std::optional<size_t> offset;
+
+		size_t replaced = 0;
+		size_t inputLength = 0;
+		Stats::Timer timer;
+	};
+
+	// Copy the input, since the buffer could be modified (or its ArrayBuffer detached) while the conversion is running.
+	auto const state = std::make_shared<State>();
+	state->input = EncodedBytes::copy(contents.data, contents.length);
+	state->inputLength = contents.length;
+
+	auto kept = Napi::Object::New(env);
+	kept["text"] = text;
+	kept["fromEncoding"] = fromEncoding->Value();
+	kept["toEncoding"] = toEncoding->Value();
+	if (!decodeOptions._replacements.IsEmpty())
+		kept["replacements"] = decodeOptions._replacements.Value();
+
+	auto const &backend = iccf->backend;
+	const EncodingId from = *fromEncoding, to = *toEncoding;
+	auto const lossByte = encodeOptions.lossByte;
+	const bool fatal = decodeOptions.fatal;
+	const char32_t replacement = decodeOptions.replacement;
+
+	return ConversionWorker::Start(
 		env,
-		fromEncoding->cfDecode(text),
-		encodeOptions.lossByte,
-		text
+		iccf,
+		kept,
+		ConversionWorker::AbortSignalFromOptions(info[3]),
+		[state, &backend, from, to, lossByte, fatal, replacement] (const std::atomic<bool> &cancelled) {
+			auto &input = state->input;
+
+			// As in the synchronous version, all-ASCII text needs no conversion. In this case, the copy of the input becomes the output.
+			if (backend.isASCIICompatible(from) && backend.isASCIICompatible(to)) {
+				const bool ascii = asciiPrefixLength(input.data(), input.size()) == input.size();
+				Stats::fastPath(Stats::FastPath::ascii, ascii);
+
+				if (ascii) {
+					state->output = std::move(input);
+					return;
+				}
+			}
+
+			if (fatal) {
+				if (auto result = parallelTranscode(backend, from, to, input.data(), input.size(), lossByte)) {
+					if (result->status == ParallelTranscodeResult::Status::ok)
+						state->output = std::move(result->bytes);
+					else {
+						state->invalid = result->status == ParallelTranscodeResult::Status::invalid;
+						state->offset = result->offset;
+					}
+					return;
+				}
+			}
+
+			if (isUnicodeEncoding(from) && isUnicodeEncoding(to)) {
+				auto result = transcodeUnicode(from, to, input.data(), input.size(), lossByte);
+
+				if (result.status == UnicodeTranscodeResult::Status::ok) {
+					state->output = std::move(result.bytes);
+					return;
+				}
+				else if (result.status == UnicodeTranscodeResult::Status::unrepresentable) {
+					state->offset = backend.unrepresentableOffset(from, to, input.data(), input.size());
+					return;
+				}
+				else if (fatal) {
+					state->invalid = true;
+					state->offset = backend.validLength(from, input.data(), input.size());
+					return;
+				}
+			}
+
+			auto const decoded = fatal
+				? backend.decode(from, input.data(), input.size())
+				: backend.decodeLossy(from, input.data(), input.size(), replacement, &state->replaced);
+
+			if (!decoded) {
+				state->invalid = true;
+				state->offset = backend.validLength(from, input.data(), input.size());
+				return;
+			}
+
+			// The input isn't needed any more. Free it before making the output, to reduce peak memory use. Only its byte order mark is needed to report where an unrepresentable character was.
+			size_t bomLength;
+			const auto unmarkedFrom = Backend::skipByteOrderMark(from, input.data(), input.size(), bomLength);
+			input = EncodedBytes();
+
+			if (cancelled)
+				return;
+
+			const std::u16string_view utf16 = *decoded;
+			size_t unrepresentableAt;
+			state->output = backend.encodeAll(to, utf16, lossByte, &unrepresentableAt);
+
+			if (!state->output && fatal)
+				state->offset = backend.inputLength(unmarkedFrom, bomLength, utf16.substr(0, unrepresentableAt));
+		},
+		[state, iccf, from] (Napi::Env env, Napi::Object kept) -> Napi::Value {
+			Stats::record(Stats::Operation::transcode, from, state->timer, state->inputLength, state->output ? state->output->size() : 0, !state->invalid && state->output);
+
+			if (state->output)
+				DecodeOptions::reportReplacements(kept.Get("replacements"), state->replaced);
+
+			if (state->invalid)
+				throw iccf->newInvalidEncodedTextError(env, kept.Get("text"), kept.Get("fromEncoding").As<Napi::Object>(), state->offset);
+			else if (!state->output)
+				throw iccf->newNotRepresentableError(env, kept.Get("text"), kept.Get("toEncoding").As<Napi::Object>(), state->offset);
+			else
+				return EncodedBytesToNapiBuffer(std::move(*state->output), env);
+		}
+	);
+}
+
+/** Makes an error like those of Node.js's `fs` module, from the `errno` value of a failed system call. */
+static Napi::Error newSystemError(const Napi::Env env, int error, const char *syscall, const std::string &path) {
+	// On the platforms that this module supports, libuv's error codes are negated `errno` values.
+	const char *const code = uv_err_name(-error);
+
+	std::stringstream ss;
+	ss << code << ": " << uv_strerror(-error) << ", " << syscall << " '" << path << "'";
+
+	auto result = Napi::Error::New(env, ss.str());
+	result.Set("errno", Napi::Number::New(env, -error));
+	result.Set("code", Napi::String::New(env, code));
+	result.Set("syscall", Napi::String::New(env, syscall));
+	result.Set("path", Napi::String::New(env, path));
+	return result;
+}
+
+static Napi::Value transcodeFile(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto fromEncoding = iccf->StringEncoding.UnwrapOrThrow(info[2]), toEncoding = iccf->StringEncoding.UnwrapOrThrow(info[3]);
+	const EncodeOptions encodeOptions(info[4]);
+
+	if (!info[0].IsString())
+		throw iccf->newFormattedTypeError(env, "a string", info[0]);
+	if (!info[1].IsString())
+		throw iccf->newFormattedTypeError(env, "a string", info[1]);
+
+	// Where each replacement goes depends on everything before it, which can't be known for a file that is converted in pieces.
+	if (!DecodeOptions(info[4]).fatal)
+		throw Napi::RangeError::New(env, "transcodeFile does not support the fatal: false option.");
+
+	struct State {
+		std::string inPath, outPath;
+		FileConversionResult result;
+		Stats::Timer timer;
+	};
+
+	auto const state = std::make_shared<State>();
+	state->inPath = info[0].As<Napi::String>().Utf8Value();
+	state->outPath = info[1].As<Napi::String>().Utf8Value();
+
+	auto kept = Napi::Object::New(env);
+	kept["inPath"] = info[0];
+	kept["fromEncoding"] = fromEncoding->Value();
+	kept["toEncoding"] = toEncoding->Value();
+
+	auto const &backend = iccf->backend;
+	const EncodingId from = *fromEncoding, to = *toEncoding;
+	auto const lossByte = encodeOptions.lossByte;
+
+	return ConversionWorker::Start(
+		env,
+		iccf,
+		kept,
+		ConversionWorker::AbortSignalFromOptions(info[4]),
+		[state, &backend, from, to, lossByte] (const std::atomic<bool> &cancelled) {
+			state->result = convertFile(backend, state->inPath, state->outPath, from, to, lossByte, cancelled);
+		},
+		[state, iccf, from] (Napi::Env env, Napi::Object kept) -> Napi::Value {
+			auto const &result = state->result;
+			Stats::record(Stats::Operation::transcode, from, state->timer, result.bytesRead, result.bytesWritten, result.status == FileConversionResult::Status::ok);
+
+			switch (result.status) {
+				case FileConversionResult::Status::ok:
+					return Napi::Number::New(env, static_cast<double>(result.bytesWritten));
+
+				case FileConversionResult::Status::invalid:
+					throw iccf->newInvalidEncodedTextError(env, kept.Get("inPath"), kept.Get("fromEncoding").As<Napi::Object>(), result.offset);
+
+				case FileConversionResult::Status::unrepresentable:
+					throw iccf->newNotRepresentableError(env, kept.Get("inPath"), kept.Get("toEncoding").As<Napi::Object>(), result.offset);
+
+				case FileConversionResult::Status::systemError:
+					throw newSystemError(env, result.error, result.syscall, result.path);
+
+				case FileConversionResult::Status::sameFile:
+					throw Napi::Error::New(env, "transcodeFile cannot write to the file that it is reading from.");
+
+				default:
+					// Cancelled. The promise is rejected with an AbortError instead of this.
+					return env.Undefined();
+			}
+		}
 	);
 }
 
@@ -142,13 +489,13 @@ static Napi::Value selectAndTranscode(
 	const DecodeOptions &decodeOptions,
 	const EncodeOptions &encodeOptions,
 	const StringEncoding *fromEncoding,
-	const std::function<StringEncoding *(CFStringRef)> &selectToEncoding,
+	const SelectEncoding &selectToEncoding,
 	StringEncoding **selectedToEncoding = nullptr
 ) {
 	return selectAndEncode(
 		env,
 		iccf,
-		fromEncoding->cfDecode(text),
+		fromEncoding->decodeText(text, fromEncoding->bufferContents(text), decodeOptions),
 		encodeOptions,
 		selectToEncoding,
 		selectedToEncoding,
@@ -156,10 +503,7 @@ static Napi::Value selectAndTranscode(
 	);
 }
 
-static Napi::Value selectAndTranscode(
-	const Napi::CallbackInfo &info,
-	CFStringEncoding (*selectToEncoding)(CFStringRef text)
-) {
+static Napi::Value transcodeSmallest(const Napi::CallbackInfo &info) {
 	const auto env = info.Env();
 	const auto iccf = getIccf(info);
 
@@ -170,14 +514,440 @@ static Napi::Value selectAndTranscode(
 		DecodeOptions(info[2]),
 		EncodeOptions(info[2]),
 		iccf->StringEncoding.UnwrapOrThrow(info[1]),
-		[&] (auto cfString) {
-			return iccf->StringEncoding.New(env, selectToEncoding(cfString));
-		}
+		selectSmallest(iccf)
 	);
 }
 
-static Napi::Value transcodeSmallest(const Napi::CallbackInfo &info) {
-	return selectAndTranscode(info, CFStringGetSmallestEncoding);
+/** The least input that `transcodeInto` decodes at a time, so that a tiny target doesn't mean many tiny pieces. */
+static constexpr size_t kMinIntoPieceLength = 4096;
+
+/** Finds where in the `target` buffer given to `encodeInto` or `transcodeInto` the output should go. */
+static std::pair<uint8_t *, size_t> intoTarget(const StringEncoding *encoding, Napi::Value target, Napi::Value offset) {
+	const auto contents = encoding->bufferContents(target);
+	const double start = offset.IsUndefined() ? 0 : offset.ToNumber().DoubleValue();
+
+	// The negated comparison also catches NaN.
+	if (!(start >= 0 && start <= contents.length))
+		throw Napi::RangeError::New(target.Env(), "The offset must be within the target buffer.");
+
+	// The target belongs to the caller, who has asked for it to be written to.
+	return { const_cast<uint8_t *>(contents.data) + static_cast<size_t>(start), contents.length - static_cast<size_t>(start) };
+}
+
+/** A place in the input of `transcodeInto` where a character ends, and how many code units the input up to there decodes to. */
+struct DecodedPoint {
+	size_t bytes;
+	size_t units;
+};
+
+static Napi::Object readAndWritten(Napi::Env env, size_t read, size_t written) {
+	auto result = Napi::Object::New(env);
+	result["read"] = Napi::Number::New(env, static_cast<double>(read));
+	result["written"] = Napi::Number::New(env, static_cast<double>(written));
+	return result;
+}
+
+static Napi::Value encodeInto(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto text = info[0].ToString();
+	const auto encoding = iccf->StringEncoding.UnwrapOrThrow(info[1]);
+	const auto target = intoTarget(encoding, info[2], info[3]);
+	const EncodeOptions encodeOptions(info[4]);
+
+	// Every code unit encodes to at least one byte, except that a surrogate pair might become a single loss byte, so there's no need to copy more of the text than twice what the target can hold.
+	const auto utf16 = NapiStringToScratchUTF16(text, target.second > (SIZE_MAX - 2) / 2 ? SIZE_MAX : target.second * 2 + 2);
+	Stats::Call stats(Stats::Operation::encode, *encoding, utf16.size() * sizeof(char16_t));
+
+	auto const result = iccf->backend.encode(*encoding, utf16, encodeOptions.lossByte, target.first, target.second);
+
+	if (result.status == EncodeResult::Status::unrepresentable)
+		throw iccf->newNotRepresentableError(env, text, encoding->Value(), result.read);
+
+	stats.succeeded(result.written);
+	return readAndWritten(env, result.read, result.written);
+}
+
+static Napi::Value transcodeInto(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto fromEncoding = iccf->StringEncoding.UnwrapOrThrow(info[1]), toEncoding = iccf->StringEncoding.UnwrapOrThrow(info[2]);
+	const Napi::Value text = info[0];
+	const auto contents = fromEncoding->bufferContents(text);
+	const auto target = intoTarget(toEncoding, info[3], info[4]);
+	const EncodeOptions encodeOptions(info[5]);
+	const auto &backend = iccf->backend;
+
+	// Input that can't be decoded would be replaced by characters that correspond to no particular input bytes, so where the output stops couldn't be traced back to a place in the input.
+	if (!DecodeOptions(info[5]).fatal)
+		throw Napi::RangeError::New(env, "transcodeInto does not support the fatal: false option.");
+
+	Stats::Call stats(Stats::Operation::transcode, *fromEncoding, contents.length);
+
+	// All-ASCII text is the same in every ASCII-compatible encoding, so just copy as much as fits. Only that much needs to be checked.
+	const BufferContents prefix { contents.data, std::min(contents.length, target.second) };
+
+	if (toEncoding->isASCIICompatible() && fromEncoding->isCopyableASCII(prefix)) {
+		std::copy(prefix.data, prefix.data + prefix.length, target.first);
+		stats.succeeded(prefix.length);
+		return readAndWritten(env, prefix.length, prefix.length);
+	}
+
+	// Decode only enough of the input to fill the target, so that a caller looping over a long input with a small target doesn't decode the rest of it every time. As in encodeInto, that's twice as many code units as the target has bytes. After each piece, note how far into the input the decoder got, and how many code units that came to.
+	const size_t wanted = target.second > (SIZE_MAX - 2) / 2 ? SIZE_MAX : target.second * 2 + 2;
+	auto decoder = backend.newDecoder(*fromEncoding);
+	PooledU16String decoded;
+	std::vector<DecodedPoint> points { { 0, 0 } };
+	size_t fed = 0;
+
+	do {
+		// No encoding takes more than four bytes per code unit, except in escape sequences.
+		const size_t remaining = wanted - decoded.size();
+		const size_t piece = std::min(contents.length - fed, std::max(kMinIntoPieceLength, remaining > SIZE_MAX / 4 ? SIZE_MAX : remaining * 4));
+		const bool last = fed + piece == contents.length;
+
+		if (!decoder->write(contents.data + fed, piece, last, decoded))
+			throw iccf->newInvalidEncodedTextError(env, text, fromEncoding->Value(), backend.validLength(*fromEncoding, contents.data, fed + piece));
+
+		fed += piece;
+		points.push_back({ fed - decoder->pendingLength(), decoded.size() });
+	}
+	while (fed < contents.length && decoded.size() < wanted);
+
+	const std::u16string_view utf16 = decoded;
+	auto result = backend.encode(*toEncoding, utf16, encodeOptions.lossByte, target.first, target.second);
+
+	if (result.status != EncodeResult::Status::unrepresentable && result.read == utf16.size() && fed == contents.length) {
+		stats.succeeded(result.written);
+		return readAndWritten(env, contents.length, result.written);
+	}
+
+	// Either the target is full, or there's an unrepresentable character. Find the last character boundary in the input whose decoded text fits in what was encoded.
+	const size_t encodedUnits = result.read;
+	DecodedPoint reached = *std::find_if(points.rbegin(), points.rend(), [=](const DecodedPoint &point) { return point.units <= encodedUnits; });
+
+	// The pieces were big, so that point is probably well short of it. Decode again from there, in steps no longer than the code units still missing, since every code unit takes at least one byte. If a step overshoots, go back and take smaller ones.
+	PooledU16String redecoded;
+
+	for (size_t step = encodedUnits - reached.units; reached.units < encodedUnits && step != 0;) {
+		decoder = backend.newDecoder(*fromEncoding);
+		redecoded.clear();
+
+		size_t at = reached.bytes, overshot = 0;
+
+		if (at != 0 && !decoder->write(contents.data, at, false, redecoded))
+			break;
+
+		reached = { at - decoder->pendingLength(), redecoded.size() };
+
+		while (reached.units < encodedUnits && at < contents.length) {
+			const size_t piece = std::min({ step, encodedUnits - reached.units, contents.length - at });
+
+			if (!decoder->write(contents.data + at, piece, false, redecoded))
+				break;
+			else if (redecoded.size() > encodedUnits) {
+				overshot = piece;
+				break;
+			}
+
+			at += piece;
+			reached = { at - decoder->pendingLength(), redecoded.size() };
+		}
+
+		step = overshot / 2;
+	}
+
+	if (result.status == EncodeResult::Status::unrepresentable)
+		throw iccf->newNotRepresentableError(env, text, toEncoding->Value(), reached.bytes);
+
+	// If the last character decodes to more than one code unit and only some of them were encoded, leave it out.
+	if (reached.units < encodedUnits)
+		result = backend.encode(*toEncoding, utf16.substr(0, reached.units), encodeOptions.lossByte, target.first, target.second);
+
+	stats.succeeded(result.written);
+	return readAndWritten(env, reached.bytes, result.written);
+}
+
+/**
+ * Splits the input of a batch function into the items to convert.
+ *
+ * The input is either an array of buffers, or an object whose `buffer` contains all of the items back to back, and whose `offsets` (an array or `Uint32Array`) holds the index in `buffer` where each item begins, followed by the index where the last one ends.
+ */
+static std::vector<BufferContents> batchItems(const Iccf *iccf, const StringEncoding *encoding, Napi::Value input) {
+	const auto env = input.Env();
+	std::vector<BufferContents> items;
+
+	if (input.IsArray()) {
+		const auto array = input.As<Napi::Array>();
+		const uint32_t count = array.Length();
+		items.reserve(count);
+
+		for (uint32_t index = 0; index < count; index++)
+			items.push_back(encoding->bufferContents(array.Get(index)));
+
+		return items;
+	}
+	else if (!input.IsObject())
+		throw iccf->newFormattedTypeError(env, "an array of buffers, or an object with buffer and offsets properties", input);
+
+	const auto object = input.As<Napi::Object>();
+	const auto contents = encoding->bufferContents(object.Get("buffer"));
+	const Napi::Value offsets = object.Get("offsets");
+	std::vector<double> boundaries;
+
+	if (offsets.IsTypedArray() && offsets.As<Napi::TypedArray>().TypedArrayType() == napi_uint32_array) {
+		auto typed = offsets.As<Napi::Uint32Array>();
+		boundaries.assign(typed.Data(), typed.Data() + typed.ElementLength());
+	}
+	else if (offsets.IsArray()) {
+		const auto array = offsets.As<Napi::Array>();
+		const uint32_t count = array.Length();
+		boundaries.reserve(count);
+
+		for (uint32_t index = 0; index < count; index++)
+			boundaries.push_back(array.Get(index).ToNumber().DoubleValue());
+	}
+	else
+		throw iccf->newFormattedTypeError(env, "an array or Uint32Array of offsets", offsets);
+
+	items.reserve(boundaries.empty() ? 0 : boundaries.size() - 1);
+
+	for (size_t index = 1; index < boundaries.size(); index++) {
+		const double start = boundaries[index - 1], end = boundaries[index];
+
+		// The negated comparison also catches NaN.
+		if (!(start >= 0 && start <= end && end <= contents.length))
+			throw Napi::RangeError::New(env, "Batch offsets must be in ascending order, and no greater than the length of the buffer.");
+
+		items.push_back({ contents.data + static_cast<size_t>(start), static_cast<size_t>(end - start) });
+	}
+
+	return items;
+}
+
+namespace {
+	/**
+	 * Collects the encoded items of a batch into one buffer, which becomes the result of `encodeMany` or `transcodeMany`.
+	 *
+	 * The result is an object with the `buffer`, a `Uint32Array` of `offsets` in the same form that `batchItems` accepts, and an array of the indices of the items that couldn't be converted. Those items are empty in the `buffer`.
+	 */
+	class BatchOutput {
+		/** Items that could need more room than this are encoded separately with `encodeAll`, rather than reserving that much room for them in the output. */
+		static constexpr size_t kWorstCaseLimit = 64 * 1024;
+
+		const Napi::Env _env;
+		const Backend &_backend;
+		GrowableBuffer _buf;
+		size_t _written = 0;
+		std::vector<uint32_t> _offsets;
+		std::vector<uint32_t> _errors;
+
+		void reserve(size_t length) {
+			if (_buf.capacity() - _written < length)
+				_buf.resize(std::max(_buf.capacity() * 2, _written + length));
+		}
+
+		void next() {
+			if (_written > std::numeric_limits<uint32_t>::max())
+				throw Napi::RangeError::New(_env, "Batch output is too big for 32-bit offsets.");
+			_offsets.push_back(static_cast<uint32_t>(_written));
+		}
+
+		public:
+		BatchOutput(Napi::Env env, const Backend &backend, size_t count, size_t capacity)
+		: _env(env)
+		, _backend(backend)
+		, _buf(capacity)
+		{
+			_offsets.reserve(count + 1);
+			_offsets.push_back(0);
+		}
+
+		void append(const uint8_t *bytes, size_t length) {
+			reserve(length);
+			std::copy(bytes, bytes + length, _buf.data() + _written);
+			_written += length;
+			next();
+		}
+
+		void encode(EncodingId encoding, std::u16string_view text, uint8_t lossByte) {
+			const size_t worstCase = _backend.maxEncodedLength(encoding, text.size());
+
+			if (worstCase <= kWorstCaseLimit) {
+				reserve(worstCase);
+				auto const result = _backend.encode(encoding, text, lossByte, _buf.data() + _written, _buf.capacity() - _written);
+
+				if (result.status == EncodeResult::Status::ok) {
+					_written += result.written;
+					next();
+					return;
+				}
+				else if (result.status == EncodeResult::Status::unrepresentable) {
+					fail();
+					return;
+				}
+			}
+
+			auto const encoded = _backend.encodeAll(encoding, text, lossByte);
+
+			if (encoded)
+				append(encoded->data(), encoded->size());
+			else
+				fail();
+		}
+
+		void fail() {
+			_errors.push_back(static_cast<uint32_t>(_offsets.size() - 1));
+			next();
+		}
+
+		/** How many bytes have been written so far. */
+		inline size_t written() const {
+			return _written;
+		}
+
+		/** Whether any of the items couldn't be converted. */
+		inline bool anyFailed() const {
+			return !_errors.empty();
+		}
+
+		Napi::Object finish() {
+			auto offsets = Napi::Uint32Array::New(_env, _offsets.size(), napi_uint32_array);
+			std::copy(_offsets.begin(), _offsets.end(), offsets.Data());
+
+			auto result = Napi::Object::New(_env);
+			result["buffer"] = EncodedBytesToNapiBuffer(_buf.finish(_written), _env);
+			result["offsets"] = offsets;
+			result["errors"] = errorIndices(_env, _errors);
+			return result;
+		}
+
+		static Napi::Array errorIndices(Napi::Env env, const std::vector<uint32_t> &errors) {
+			auto array = Napi::Array::New(env, errors.size());
+			for (size_t index = 0; index < errors.size(); index++)
+				array[static_cast<uint32_t>(index)] = Napi::Number::New(env, errors[index]);
+			return array;
+		}
+	};
+}
+
+static Napi::Value decodeMany(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto encoding = iccf->StringEncoding.UnwrapOrThrow(info[1]);
+	const DecodeOptions decodeOptions(info[2]);
+	const auto items = batchItems(iccf, encoding, info[0]);
+	const auto &backend = iccf->backend;
+	const bool asciiCompatible = encoding->isASCIICompatible();
+
+	auto strings = Napi::Array::New(env, items.size());
+	std::vector<uint32_t> errors;
+	size_t replaced = 0;
+	size_t bytesIn = 0, bytesOut = 0;
+	Stats::Call stats(Stats::Operation::decode, *encoding);
+
+	for (uint32_t index = 0; index < items.size(); index++) {
+		auto const &item = items[index];
+		bytesIn += item.length;
+
+		if (asciiCompatible && encoding->isCopyableASCII(item)) {
+			bytesOut += item.length * sizeof(char16_t);
+			strings[index] = Latin1ToNapiString(item.data, item.length, env);
+			continue;
+		}
+
+		auto decoded = decodeOptions.decode(backend, *encoding, item.data, item.length, replaced);
+
+		if (decoded) {
+			bytesOut += decoded->size() * sizeof(char16_t);
+			strings[index] = DecodedTextToNapiString(std::move(*decoded), env, iccf->stringConcat.Value(), iccf->externalStringThreshold);
+		}
+		else {
+			strings[index] = env.Null();
+			errors.push_back(index);
+		}
+	}
+
+	decodeOptions.reportReplacements(replaced);
+
+	// The batch as a whole counts as one call. It's an error if any of the items couldn't be converted.
+	stats.input(bytesIn);
+	if (errors.empty())
+		stats.succeeded(bytesOut);
+
+	auto result = Napi::Object::New(env);
+	result["strings"] = strings;
+	result["errors"] = BatchOutput::errorIndices(env, errors);
+	return result;
+}
+
+static Napi::Value encodeMany(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto encoding = iccf->StringEncoding.UnwrapOrThrow(info[1]);
+	const EncodeOptions encodeOptions(info[2]);
+
+	if (!info[0].IsArray())
+		throw iccf->newFormattedTypeError(env, "an array of strings", info[0]);
+
+	const auto texts = info[0].As<Napi::Array>();
+	const uint32_t count = texts.Length();
+	BatchOutput output(env, iccf->backend, count, count * 16);
+	PooledU16String text;
+	Stats::Call stats(Stats::Operation::encode, *encoding);
+	size_t bytesIn = 0;
+
+	for (uint32_t index = 0; index < count; index++) {
+		NapiStringToUTF16(texts.Get(index).ToString(), text);
+		bytesIn += text.size() * sizeof(char16_t);
+		output.encode(*encoding, text, encodeOptions.lossByte);
+	}
+
+	stats.input(bytesIn);
+	if (!output.anyFailed())
+		stats.succeeded(output.written());
+
+	return output.finish();
+}
+
+static Napi::Value transcodeMany(const Napi::CallbackInfo &info) {
+	const auto env = info.Env();
+	const auto iccf = getIccf(info);
+	const auto fromEncoding = iccf->StringEncoding.UnwrapOrThrow(info[1]), toEncoding = iccf->StringEncoding.UnwrapOrThrow(info[2]);
+	const DecodeOptions decodeOptions(info[3]);
+	const EncodeOptions encodeOptions(info[3]);
+	const auto items = batchItems(iccf, fromEncoding, info[0]);
+	const auto &backend = iccf->backend;
+	const bool asciiCopies = fromEncoding->isASCIICompatible() && toEncoding->isASCIICompatible();
+
+	size_t totalLength = 0;
+	for (auto const &item : items)
+		totalLength += item.length;
+
+	BatchOutput output(env, backend, items.size(), totalLength);
+	size_t replaced = 0;
+	Stats::Call stats(Stats::Operation::transcode, *fromEncoding, totalLength);
+
+	for (auto const &item : items) {
+		if (asciiCopies && fromEncoding->isCopyableASCII(item)) {
+			output.append(item.data, item.length);
+			continue;
+		}
+
+		auto const decoded = decodeOptions.decode(backend, *fromEncoding, item.data, item.length, replaced);
+
+		if (decoded)
+			output.encode(*toEncoding, *decoded, encodeOptions.lossByte);
+		else
+			output.fail();
+	}
+
+	decodeOptions.reportReplacements(replaced);
+
+	if (!output.anyFailed())
+		stats.succeeded(output.written());
+
+	return output.finish();
 }
 
 EncodeOptions::EncodeOptions(Napi::Value options) {
@@ -187,7 +957,7 @@ EncodeOptions::EncodeOptions(Napi::Value options) {
 		{
 			const Napi::Value _lossByte = _options["lossByte"];
 			if (_lossByte.IsNumber())
-				lossByte = static_cast<UInt8>(_lossByte.As<Napi::Number>().DoubleValue());
+				lossByte = static_cast<uint8_t>(_lossByte.As<Napi::Number>().DoubleValue());
 		}
 
 		{
@@ -198,12 +968,80 @@ EncodeOptions::EncodeOptions(Napi::Value options) {
 	}
 }
 
+DecodeOptions::DecodeOptions(Napi::Value options) {
+	if (!options.IsObject())
+		return;
+
+	const Napi::Object _options = options.ToObject();
+
+	{
+		const Napi::Value _fatal = _options["fatal"];
+		if (!_fatal.IsUndefined())
+			fatal = _fatal.ToBoolean();
+	}
+
+	{
+		const Napi::Value _replacement = _options["replacement"];
+		bool valid = true;
+
+		if (_replacement.IsNumber()) {
+			const double value = _replacement.As<Napi::Number>().DoubleValue();
+			valid = value >= 0 && value <= 0x10ffff && value == static_cast<char32_t>(value);
+			if (valid)
+				replacement = static_cast<char32_t>(value);
+		}
+		else if (!_replacement.IsUndefined()) {
+			const auto text = _replacement.ToString().Utf16Value();
+
+			if (text.size() == 1)
+				replacement = text[0];
+			else if (text.size() == 2 && text[0] >= 0xd800 && text[0] <= 0xdbff && text[1] >= 0xdc00 && text[1] <= 0xdfff)
+				replacement = 0x10000 + ((char32_t(text[0]) - 0xd800) << 10) + (char32_t(text[1]) - 0xdc00);
+			else
+				valid = false;
+		}
+
+		if (!valid || (replacement >= 0xd800 && replacement <= 0xdfff))
+			throw Napi::RangeError::New(options.Env(), "The replacement must be a single character, or the code point of one, and not a surrogate.");
+	}
+
+	{
+		const Napi::Value _replacementsV = _options["replacements"];
+		if (_replacementsV.IsObject())
+			_replacements = Napi::Persistent(_replacementsV.As<Napi::Object>());
+	}
+}
+
+std::optional<DecodedText> DecodeOptions::decode(const Backend &backend, EncodingId encoding, const uint8_t *bytes, size_t length, size_t &replaced) const {
+	if (fatal)
+		return backend.decode(encoding, bytes, length);
+
+	size_t count;
+	auto decoded = backend.decodeLossy(encoding, bytes, length, replacement, &count);
+	replaced += count;
+	return decoded;
+}
+
+void DecodeOptions::reportReplacements(Napi::Value replacements, size_t replaced) {
+	if (replacements.IsObject())
+		replacements.As<Napi::Object>()["count"] = Napi::Number::New(replacements.Env(), static_cast<double>(replaced));
+}
+
 void TranscodeInit(Napi::Env env, Napi::Object exports, Iccf *iccf) {
 	Napi::HandleScope scope(env);
 
 	exports.DefineProperties({
+		Napi::PropertyDescriptor::Value("decodeMany", Napi::Function::New(env, decodeMany, "decodeMany", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("detectEncoding", Napi::Function::New(env, detectEncoding, "detectEncoding", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("encodeInto", Napi::Function::New(env, encodeInto, "encodeInto", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("encodeMany", Napi::Function::New(env, encodeMany, "encodeMany", iccf), napi_enumerable),
 		Napi::PropertyDescriptor::Value("encodeSmallest", Napi::Function::New(env, encodeSmallest, "encodeSmallest", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("representableEncodings", Napi::Function::New(env, representableEncodings, "representableEncodings", iccf), napi_enumerable),
 		Napi::PropertyDescriptor::Value("transcode", Napi::Function::New(env, transcode, "transcode", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("transcodeAsync", Napi::Function::New(env, transcodeAsync, "transcodeAsync", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("transcodeFile", Napi::Function::New(env, transcodeFile, "transcodeFile", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("transcodeInto", Napi::Function::New(env, transcodeInto, "transcodeInto", iccf), napi_enumerable),
+		Napi::PropertyDescriptor::Value("transcodeMany", Napi::Function::New(env, transcodeMany, "transcodeMany", iccf), napi_enumerable),
 		Napi::PropertyDescriptor::Value("transcodeSmallest", Napi::Function::New(env, transcodeSmallest, "transcodeSmallest", iccf), napi_enumerable)
 	});
 }
@@ -1,26 +1,50 @@
 #pragma once
 
 #include "napi.hh"
-#include <CoreFoundation/CFString.h>
+#include "Backend.hh"
 #include <optional>
 
 class StringEncoding;
 struct Iccf;
 
 struct EncodeOptions {
-	UInt8 lossByte = 0;
+	uint8_t lossByte = 0;
 	Napi::FunctionReference _isEncodingOk;
 
 	inline EncodeOptions() {}
 	EncodeOptions(Napi::Value options);
 
 	bool isEncodingOk(StringEncoding *encoding) const;
-	bool isEncodingOk(Napi::Env env, const Iccf *iccf, CFStringEncoding encoding, StringEncoding **encodingObj = nullptr) const;
+	bool isEncodingOk(Napi::Env env, const Iccf *iccf, EncodingId encoding, StringEncoding **encodingObj = nullptr) const;
 };
 
 struct DecodeOptions {
+	/** Whether invalid text is an error. If not, each invalid sequence is replaced with `replacement`. */
+	bool fatal = true;
+	char32_t replacement = 0xfffd;
+
+	/** The `replacements` object from the options, if any. `reportReplacements` sets its `count`. */
+	Napi::ObjectReference _replacements;
+
 	inline DecodeOptions() {}
-	inline DecodeOptions(Napi::Value options) : DecodeOptions() {}
+	DecodeOptions(Napi::Value options);
+
+	/**
+	 * Decodes the given bytes, with `Backend::decode` if `fatal`, or else with `Backend::decodeLossy`.
+	 *
+	 * @param replaced - How many invalid sequences were replaced is added to this.
+	 * @returns The decoded text, or `std::nullopt` if it's invalid and `fatal` is true.
+	 */
+	std::optional<DecodedText> decode(const Backend &backend, EncodingId encoding, const uint8_t *bytes, size_t length, size_t &replaced) const;
+
+	/** Tells the caller how many invalid sequences were replaced, if they asked. */
+	inline void reportReplacements(size_t replaced) const {
+		if (!_replacements.IsEmpty())
+			reportReplacements(_replacements.Value(), replaced);
+	}
+
+	/** Like the other `reportReplacements`, but for when the `replacements` object was kept somewhere else, as it is during an asynchronous conversion. Does nothing if it's not an object. */
+	static void reportReplacements(Napi::Value replacements, size_t replaced);
 };
 
 void TranscodeInit(Napi::Env env, Napi::Object exports, Iccf *globals);
@@ -0,0 +1,303 @@
+#include "unicode.hh"
+#include "ascii.hh"
+#include "GrowableBuffer.hh"
+#include <cstring>
+
+bool isUnicodeEncoding(EncodingId encoding) noexcept {
+	switch (encoding) {
+		case kEncodingUTF8:
+		case kEncodingUTF16:
+		case kEncodingUTF16BE:
+		case kEncodingUTF16LE:
+		case kEncodingUTF32:
+		case kEncodingUTF32BE:
+		case kEncodingUTF32LE:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+namespace {
+	using Status = UnicodeTranscodeResult::Status;
+
+	inline bool isNativeLittleEndian() noexcept {
+		const uint16_t probe = 1;
+		uint8_t first;
+		std::memcpy(&first, &probe, 1);
+		return first == 1;
+	}
+
+	/** Layout of the code units of an encoding whose byte order is already known (that is, not `kEncodingUTF16` or `kEncodingUTF32`). */
+	inline UnitLayout layoutOf(EncodingId encoding) noexcept {
+		switch (encoding) {
+			case kEncodingUTF16BE: return { 2, false };
+			case kEncodingUTF16LE: return { 2, true };
+			case kEncodingUTF32BE: return { 4, false };
+			case kEncodingUTF32LE: return { 4, true };
+			default: return { 1, false };
+		}
+	}
+
+	template <uint8_t Size, bool LE>
+	inline uint32_t load(const uint8_t *p) noexcept {
+		if constexpr (Size == 1)
+			return p[0];
+		else if constexpr (Size == 2)
+			return LE ? p[0] | (p[1] << 8) : (p[0] << 8) | p[1];
+		else if constexpr (LE)
+			return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+		else
+			return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	template <uint8_t Size, bool LE>
+	inline uint8_t *store(uint8_t *p, uint32_t unit) noexcept {
+		for (size_t k = 0; k < Size; k++)
+			p[k] = static_cast<uint8_t>(unit >> ((LE ? k : Size - 1 - k) * 8));
+		return p + Size;
+	}
+
+	/** ASCII runs at least this long are converted with `convertASCII`. */
+	constexpr size_t kShortRun = 16;
+
+	inline bool isSurrogate(uint32_t c) noexcept {
+		return c >= 0xd800 && c <= 0xdfff;
+	}
+
+	/**
+	 * Converts `units` code units of the input form to the output form. The output buffer must be big enough for the worst case.
+	 *
+	 * The validation rules are the same as those of the portable codecs: UTF-8 and UTF-32 input must not contain surrogates, overlong sequences, or anything above U+10FFFF; UTF-16 input may contain lone surrogates, which can only be written as such in UTF-16, and otherwise become the loss byte.
+	 */
+	template <uint8_t InSize, bool InLE, uint8_t OutSize, bool OutLE>
+	Status convert(const uint8_t *in, size_t units, uint8_t lossByte, uint8_t *out, size_t &written) noexcept {
+		constexpr UnitLayout inLayout { InSize, InLE }, outLayout { OutSize, OutLE };
+		uint8_t *o = out;
+		size_t i = 0;
+
+		while (i < units) {
+			uint32_t c = load<InSize, InLE>(in + i * InSize);
+
+			if (c < 0x80) {
+				// Text in most languages other than English has lots of short ASCII runs (spaces and punctuation), which are cheaper to copy right here. Only runs that turn out to be long are handed to the vector kernels.
+				size_t run = 1;
+				while (run < kShortRun && i + run < units && load<InSize, InLE>(in + (i + run) * InSize) < 0x80)
+					run++;
+
+				if (run == kShortRun) {
+					run += asciiPrefixLength(in + (i + run) * InSize, units - i - run, inLayout);
+					convertASCII(in + i * InSize, inLayout, run, o, outLayout);
+					o += run * OutSize;
+				}
+				else {
+					for (size_t j = 0; j < run; j++)
+						o = store<OutSize, OutLE>(o, load<InSize, InLE>(in + (i + j) * InSize));
+				}
+
+				i += run;
+				continue;
+			}
+
+			bool lone = false;
+
+			if constexpr (InSize == 1) {
+				size_t n;
+				uint32_t min;
+
+				if (c >= 0xc2 && c <= 0xdf) {
+					n = 2;
+					c &= 0x1f;
+					min = 0x80;
+				}
+				else if (c >= 0xe0 && c <= 0xef) {
+					n = 3;
+					c &= 0x0f;
+					min = 0x800;
+				}
+				else if (c >= 0xf0 && c <= 0xf4) {
+					n = 4;
+					c &= 0x07;
+					min = 0x10000;
+				}
+				else
+					return Status::invalid;
+
+				if (units - i < n)
+					return Status::invalid;
+
+				for (size_t j = 1; j < n; j++) {
+					const uint8_t b = in[i + j];
+					if ((b & 0xc0) != 0x80)
+						return Status::invalid;
+					c = (c << 6) | (b & 0x3f);
+				}
+
+				if (c < min || c > 0x10ffff || isSurrogate(c))
+					return Status::invalid;
+
+				i += n;
+			}
+			else if constexpr (InSize == 2) {
+				i++;
+
+				if (c >= 0xd800 && c <= 0xdbff && i < units) {
+					const uint32_t low = load<2, InLE>(in + i * 2);
+
+					if (low >= 0xdc00 && low <= 0xdfff) {
+						c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+						i++;
+					}
+					else
+						lone = true;
+				}
+				else
+					lone = isSurrogate(c);
+			}
+			else {
+				if (c > 0x10ffff || isSurrogate(c))
+					return Status::invalid;
+
+				i++;
+			}
+
+			if constexpr (OutSize == 1) {
+				if (lone) {
+					if (lossByte == 0)
+						return Status::unrepresentable;
+					*o++ = lossByte;
+				}
+				else if (c < 0x800) {
+					*o++ = 0xc0 | (c >> 6);
+					*o++ = 0x80 | (c & 0x3f);
+				}
+				else if (c < 0x10000) {
+					*o++ = 0xe0 | (c >> 12);
+					*o++ = 0x80 | ((c >> 6) & 0x3f);
+					*o++ = 0x80 | (c & 0x3f);
+				}
+				else {
+					*o++ = 0xf0 | (c >> 18);
+					*o++ = 0x80 | ((c >> 12) & 0x3f);
+					*o++ = 0x80 | ((c >> 6) & 0x3f);
+					*o++ = 0x80 | (c & 0x3f);
+				}
+			}
+			else if constexpr (OutSize == 2) {
+				if (c < 0x10000)
+					o = store<2, OutLE>(o, c);
+				else {
+					o = store<2, OutLE>(o, 0xd800 + ((c - 0x10000) >> 10));
+					o = store<2, OutLE>(o, 0xdc00 + ((c - 0x10000) & 0x3ff));
+				}
+			}
+			else {
+				if (lone) {
+					if (lossByte == 0)
+						return Status::unrepresentable;
+					*o++ = lossByte;
+				}
+				else
+					o = store<4, OutLE>(o, c);
+			}
+		}
+
+		written = o - out;
+		return Status::ok;
+	}
+
+	using Converter = Status (*)(const uint8_t *in, size_t units, uint8_t lossByte, uint8_t *out, size_t &written) noexcept;
+
+	template <uint8_t InSize, bool InLE>
+	Converter converterTo(UnitLayout out) noexcept {
+		switch (out.size) {
+			case 1: return convert<InSize, InLE, 1, false>;
+			case 2: return out.littleEndian ? convert<InSize, InLE, 2, true> : convert<InSize, InLE, 2, false>;
+			default: return out.littleEndian ? convert<InSize, InLE, 4, true> : convert<InSize, InLE, 4, false>;
+		}
+	}
+
+	Converter converterFor(UnitLayout in, UnitLayout out) noexcept {
+		switch (in.size) {
+			case 1: return converterTo<1, false>(out);
+			case 2: return in.littleEndian ? converterTo<2, true>(out) : converterTo<2, false>(out);
+			default: return in.littleEndian ? converterTo<4, true>(out) : converterTo<4, false>(out);
+		}
+	}
+
+	/** The most bytes that `units` code units of the input layout can turn into in the output layout. */
+	inline size_t worstCaseLength(UnitLayout in, UnitLayout out, size_t units) noexcept {
+		if (in.size == 4)
+			// Any code point is at most 4 bytes in any form.
+			return units * 4;
+		else if (in.size == 2)
+			// A BMP character is at most 3 bytes of UTF-8; a surrogate pair becomes 4 bytes in any form.
+			return units * (out.size == 1 ? 3 : out.size);
+		else
+			// A 1-byte UTF-8 character can grow to one code unit of any size; longer sequences don't grow at all.
+			return units * out.size;
+	}
+}
+
+UnicodeTranscodeResult transcodeUnicode(EncodingId from, EncodingId to, const uint8_t *bytes, size_t length, uint8_t lossByte) {
+	size_t bomLength;
+	from = Backend::skipByteOrderMark(from, bytes, length, bomLength);
+
+	const UnitLayout inLayout = layoutOf(from);
+
+	if (length % inLayout.size != 0)
+		return { Status::invalid, EncodedBytes() };
+
+	bytes += bomLength;
+	length -= bomLength;
+
+	const size_t units = length / inLayout.size;
+
+	// The unmarked forms are written with a byte order mark, followed by text in native byte order.
+	size_t outBOMLength = 0;
+
+	if (to == kEncodingUTF16 || to == kEncodingUTF32) {
+		outBOMLength = to == kEncodingUTF16 ? 2 : 4;
+		if (to == kEncodingUTF16)
+			to = isNativeLittleEndian() ? kEncodingUTF16LE : kEncodingUTF16BE;
+		else
+			to = isNativeLittleEndian() ? kEncodingUTF32LE : kEncodingUTF32BE;
+	}
+
+	const UnitLayout outLayout = layoutOf(to);
+
+	GrowableBuffer buf(outBOMLength + worstCaseLength(inLayout, outLayout, units));
+	uint8_t * const out = buf.data();
+
+	if (outBOMLength != 0) {
+		if (outLayout.size == 2)
+			outLayout.littleEndian ? store<2, true>(out, 0xfeff) : store<2, false>(out, 0xfeff);
+		else
+			outLayout.littleEndian ? store<4, true>(out, 0xfeff) : store<4, false>(out, 0xfeff);
+	}
+
+	size_t written;
+
+	if (inLayout.size == 2 && outLayout.size == 2) {
+		// UTF-16 isn't validated, so this is just a copy, possibly swapping bytes.
+		if (inLayout.littleEndian == outLayout.littleEndian)
+			std::memcpy(out + outBOMLength, bytes, length);
+		else {
+			for (size_t i = 0; i < length; i += 2) {
+				out[outBOMLength + i] = bytes[i + 1];
+				out[outBOMLength + i + 1] = bytes[i];
+			}
+		}
+
+		written = length;
+	}
+	else {
+		const auto status = converterFor(inLayout, outLayout)(bytes, units, lossByte, out + outBOMLength, written);
+
+		if (status != Status::ok)
+			return { status, EncodedBytes() };
+	}
+
+	return { Status::ok, buf.finish(outBOMLength + written) };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Backend.hh"
+
+/** Whether the given encoding is one of the Unicode encoding forms: UTF-8, or UTF-16 or UTF-32 in any byte order. */
+bool isUnicodeEncoding(EncodingId encoding) noexcept;
+
+/** Outcome of a call to `transcodeUnicode`. */
+struct UnicodeTranscodeResult {
+	enum class Status {
+		ok,
+
+		/** The input is not valid in the source encoding. */
+		invalid,
+
+		/** The input contains a lone surrogate, the target encoding can't represent it, and no loss byte was given. */
+		unrepresentable
+	};
+
+	Status status;
+
+	/** The converted text. Only meaningful if `status` is `ok`. */
+	EncodedBytes bytes;
+};
+
+/**
+ * Converts text directly from one Unicode encoding form to another, without going through UTF-16 in between. Runs of ASCII characters are converted with vector instructions where available.
+ *
+ * Both encodings must satisfy `isUnicodeEncoding`. The result is exactly what `Backend::decode` followed by `Backend::encodeAll` would produce with `PortableBackend`, including the handling of byte order marks and lone surrogates.
+ */
+UnicodeTranscodeResult transcodeUnicode(EncodingId from, EncodingId to, const uint8_t *bytes, size_t length, uint8_t lossByte);
@@ -93,42 +93,138 @@ describe("StringEncoding", () => {
 				}
 			},
 			{
-				testingName: "MacJapanese",
-				se: StringEncoding.byCFStringEncoding(1),
+				testingName: "Windows Cyrillic",
+				se: StringEncoding.byWindowsCodepage(1251),
 				ref: {
-					cfStringEncoding: 1,
-					ianaCharSetName: "x-mac-japanese",
-					windowsCodepage: 10001,
-					name: /Mac.*Japanese|Japanese.*Mac/i,
+					cfStringEncoding: 0x0502,
+					ianaCharSetName: "windows-1251",
+					windowsCodepage: 1251,
+					nsStringEncoding: 11,
+					name: /Cyrillic.*Windows|Windows.*Cyrillic/i,
 					text: [{
-						string: "同意します~",
-						bytes: Buffer.from("k6+I04K1gtyCt34=", "base64")
-					}]
+						string: "Привет, мир",
+						bytes: Buffer.from([0xcf, 0xf0, 0xe8, 0xe2, 0xe5, 0xf2, 0x2c, 0x20, 0xec, 0xe8, 0xf0])
+					}, {
+						comment: "with loss byte '?'",
+						string: "Ё👍ё",
+						bytes: Buffer.from([0xa8, 0x3f, 0xb8]),
+						encodeOptions: {
+							lossByte: 63
+						},
+						decodeOptions: null
+					}],
+					unrepresentable: ["Ελλάδα"]
 				}
 			},
 			{
-				testingName: "Shift JIS",
-				se: StringEncoding.byCFStringEncoding(0x0A01),
+				testingName: "KOI8-R",
+				se: StringEncoding.byIANACharSetName("koi8-r"),
 				ref: {
-					cfStringEncoding: 0x0A01,
-					ianaCharSetName: "Shift_JIS",
-					name: /S(hift)?.*JIS/i,
+					cfStringEncoding: 0x0A02,
+					ianaCharSetName: "KOI8-R",
+					windowsCodepage: 20866,
+					name: /KOI8-R/i,
 					text: [{
-						string: "同意します‾",
-						bytes: Buffer.from("k6+I04K1gtyCt34=", "base64")
+						string: "Привет, мир",
+						bytes: Buffer.from([0xf0, 0xd2, 0xc9, 0xd7, 0xc5, 0xd4, 0x2c, 0x20, 0xcd, 0xc9, 0xd2])
 					}]
 				}
 			},
-			{
-				testingName: "MacInuit",
-				se: StringEncoding.byCFStringEncoding(0xEC),
-				ref: {
-					cfStringEncoding: 0xEC,
-					ianaCharSetName: "x-mac-inuit",
-					windowsCodepage: null,
-					name: /Mac.*Inuit|Inuit.*Mac/i
+			// The portable backend's multi-byte encodings. Core Foundation maps some characters differently (see Shift JIS below), so these are only tested elsewhere.
+			...(process.platform === "darwin" ? [] : [
+				{
+					testingName: "Shift JIS (portable)",
+					se: StringEncoding.byIANACharSetName("sjis"),
+					ref: {
+						cfStringEncoding: 0x0A01,
+						ianaCharSetName: "Shift_JIS",
+						windowsCodepage: 932,
+						nsStringEncoding: 8,
+						name: /S(hift)?.*JIS/i,
+						text: [{
+							string: "同意します~",
+							bytes: Buffer.from("k6+I04K1gtyCt34=", "base64")
+						}],
+						unrepresentable: ["👍"]
+					}
+				},
+				{
+					testingName: "GB 18030",
+					se: StringEncoding.byWindowsCodepage(54936),
+					ref: {
+						cfStringEncoding: 0x0632,
+						ianaCharSetName: "GB18030",
+						name: /GB.*18030/i,
+						text: [{
+							comment: "with four-byte sequences",
+							string: "中文€😀",
+							bytes: Buffer.from([0xd6, 0xd0, 0xce, 0xc4, 0xa2, 0xe3, 0x94, 0x39, 0xfc, 0x36])
+						}]
+					}
+				},
+				{
+					testingName: "EUC-KR",
+					se: StringEncoding.byIANACharSetName("euc-kr"),
+					ref: {
+						cfStringEncoding: 0x0940,
+						ianaCharSetName: "EUC-KR",
+						windowsCodepage: 51949,
+						name: /Korean/i,
+						text: [{
+							string: "안녕하세요",
+							bytes: Buffer.from([0xbe, 0xc8, 0xb3, 0xe7, 0xc7, 0xcf, 0xbc, 0xbc, 0xbf, 0xe4])
+						}, {
+							comment: "with loss byte '?'",
+							string: "안녕👍",
+							bytes: Buffer.from([0xbe, 0xc8, 0xb3, 0xe7, 0x3f]),
+							encodeOptions: {
+								lossByte: 63
+							},
+							decodeOptions: null
+						}]
+					}
 				}
-			}
+			]),
+			// These encodings are supported only by the Core Foundation backend.
+			...(process.platform !== "darwin" ? [] : [
+				{
+					testingName: "MacJapanese",
+					se: StringEncoding.byCFStringEncoding(1),
+					ref: {
+						cfStringEncoding: 1,
+						ianaCharSetName: "x-mac-japanese",
+						windowsCodepage: 10001,
+						name: /Mac.*Japanese|Japanese.*Mac/i,
+						text: [{
+							string: "同意します~",
+							bytes: Buffer.from("k6+I04K1gtyCt34=", "base64")
+						}]
+					}
+				},
+				{
+					testingName: "Shift JIS",
+					se: StringEncoding.byCFStringEncoding(0x0A01),
+					ref: {
+						cfStringEncoding: 0x0A01,
+						ianaCharSetName: "Shift_JIS",
+						name: /S(hift)?.*JIS/i,
+						text: [{
+							string: "同意します‾",
+							bytes: Buffer.from("k6+I04K1gtyCt34=", "base64")
+						}]
+					}
+				},
+				{
+					testingName: "MacInuit",
+					se: StringEncoding.byCFStringEncoding(0xEC),
+					ref: {
+						cfStringEncoding: 0xEC,
+						ianaCharSetName: "x-mac-inuit",
+						windowsCodepage: null,
+						name: /Mac.*Inuit|Inuit.*Mac/i
+					}
+				}
+			])
 		];
 
 		for (const {testingName, se, ref} of testEncodings)
@@ -209,7 +305,7 @@ describe("StringEncoding", () => {
 
 		it("should return false for a different encoding", () => {
 			const a = StringEncoding.byCFStringEncoding(0);
-			const b = StringEncoding.byCFStringEncoding(1);
+			const b = StringEncoding.byCFStringEncoding(0x0600);
 			assert.isFalse(a.equals(b));
 			assert.isFalse(b.equals(a));
 		});
@@ -225,6 +321,46 @@ describe("StringEncoding", () => {
 		});
 	});
 
+	it("should reuse instances for the same encoding", () => {
+		const a = StringEncoding.byIANACharSetName("UTF-8");
+		assert.strictEqual(StringEncoding.byCFStringEncoding(0x08000100), a);
+		assert.strictEqual(StringEncoding.byIANACharSetName("utf-8"), a);
+		assert.strictEqual(a.name, a.name);
+		assert.strictEqual(a.ianaCharSetName.toLowerCase(), "utf-8");
+
+		// A collected instance is replaced with a new one that works just as well.
+		global.gc();
+		assert.strictEqual(StringEncoding.byIANACharSetName("macintosh").decode(Buffer.from([0x8e])), "é");
+	});
+
+	it("should list every supported encoding", () => {
+		const all = StringEncoding.all();
+		assert.include(all, StringEncoding.byIANACharSetName("UTF-8"));
+		assert.include(all, StringEncoding.byCFStringEncoding(0));
+		assert.strictEqual(new Set(all).size, all.length);
+
+		for (const se of all)
+			assert.strictEqual(StringEncoding.byCFStringEncoding(se.cfStringEncoding), se);
+	});
+
+	it("should look up names regardless of case, and only whole names", () => {
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+		assert.strictEqual(StringEncoding.byIANACharSetName("uTf-8"), utf8);
+		assert.throws(() => StringEncoding.byIANACharSetName("UTF-8\0"), UnrecognizedEncodingError);
+		assert.throws(() => StringEncoding.byIANACharSetName("UTF-"), UnrecognizedEncodingError);
+		assert.throws(() => StringEncoding.byIANACharSetName("\u0155TF-8"), UnrecognizedEncodingError);
+		assert.throws(() => StringEncoding.byIANACharSetName("UTF-8".repeat(100)), UnrecognizedEncodingError);
+	});
+
+	it("should only convert with its own tables where they agree with Core Foundation", function () {
+		// This converts the whole BMP for each encoding, with Core Foundation and with the tables.
+		this.timeout(10000);
+
+		// Not part of the public API, so it isn't declared.
+		const { _tableMismatches } = require("../lib/native") as { _tableMismatches(): number[] };
+		assert.deepEqual(_tableMismatches().map(id => StringEncoding.byCFStringEncoding(id).name), []);
+	});
+
 	it("should have its special instanceof behavior", () => {
 		assert.instanceOf(StringEncoding.system, StringEncoding);
 		assert.notInstanceOf({}, StringEncoding);
@@ -250,6 +386,44 @@ describe("StringEncoding", () => {
 		assert.strictEqual(decoded, string);
 	});
 
+	it("should handle long runs of ASCII, with and without other characters", () => {
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+
+		for (const string of ["x".repeat(1000), `${"x".repeat(100)}é${"y".repeat(37)}👍${"z".repeat(5)}`]) {
+			const encoded = utf8.encode(string);
+			assert.equalBytes(encoded, Buffer.from(string, "utf8"));
+			assert.strictEqual(utf8.decode(encoded), string);
+		}
+	});
+
+	it("should encode mostly-Latin text, which is copied as UTF-8", async () => {
+		const latin1 = StringEncoding.byIANACharSetName("windows-1252");
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+
+		// Long enough to be encoded in several pieces.
+		const string = "Déjà vu, naïve café. ".repeat(5000);
+		assert.equalBytes(latin1.encode(string), Buffer.from(string, "latin1"));
+		assert.equalBytes(await latin1.encodeAsync(string), Buffer.from(string, "latin1"));
+		assert.equalBytes(utf8.encode(string), Buffer.from(string, "utf8"));
+
+		// Offsets are still in UTF-16 code units, and unpaired surrogates are still unrepresentable.
+		assert.deepStrictEqual(latin1.tryEncode(`${string}👍`), { reason: "unrepresentable", offset: string.length });
+		assert.deepStrictEqual(utf8.tryEncode(`${"e".repeat(20)}é\ud800`), { reason: "unrepresentable", offset: 21 });
+		assert.equalBytes(utf8.encode(`${"e".repeat(20)}é\ud800`, { lossByte: 0x3f }), Buffer.from(`${"e".repeat(20)}é?`, "utf8"));
+	});
+
+	it("should decode large texts", () => {
+		// Long enough to be decoded in several pieces.
+		const macRoman = StringEncoding.byIANACharSetName("macintosh");
+		const string = "é¶ Ω".repeat(50000);
+		assert.strictEqual(macRoman.decode(macRoman.encode(string)), string);
+
+		// The leading "x" puts surrogate pairs across any power-of-two piece boundary.
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+		const emoji = "x" + "👍".repeat(70000);
+		assert.strictEqual(utf8.decode(utf8.encode(emoji)), emoji);
+	});
+
 	it("should reject invalid encoding specifiers", () => {
 		assert.throws(() => StringEncoding.byCFStringEncoding(0xffffffff /* kCFStringEncodingInvalidId */), UnrecognizedEncodingError);
 		assert.throws(() => StringEncoding.byCFStringEncoding("hi" as any));
@@ -266,4 +440,150 @@ describe("StringEncoding", () => {
 		const text = Buffer.from([0x80, 0xa0, 0xc0, 0xf0]);
 		assert.throws(() => StringEncoding.byIANACharSetName("UTF-8").decode(text), InvalidEncodedTextError);
 	});
+
+	describe("non-fatal decoding", () => {
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+		const bad = Buffer.from([0x61, 0xc3, 0x62, 0xe4, 0xb8, 0xff, 0xf0, 0x9f, 0x91]);
+
+		it("should replace each malformed sequence", () => {
+			const replacements = { count: -1 };
+			assert.strictEqual(utf8.decode(bad, { fatal: false, replacements }), "a\ufffdb\ufffd\ufffd\ufffd");
+			assert.strictEqual(replacements.count, 4);
+
+			assert.strictEqual(utf8.decode(Buffer.from("fine"), { fatal: false, replacements }), "fine");
+			assert.strictEqual(replacements.count, 0);
+		});
+
+		it("should accept a custom replacement", () => {
+			assert.strictEqual(utf8.decode(bad, { fatal: false, replacement: "?" }), "a?b???");
+			assert.strictEqual(utf8.decode(bad, { fatal: false, replacement: 0x1f4a9 }), "a💩b💩💩💩");
+			assert.throws(() => utf8.decode(bad, { fatal: false, replacement: "ab" }), RangeError);
+			assert.throws(() => utf8.decode(bad, { fatal: false, replacement: 0xd800 }), RangeError);
+		});
+
+		it("should work in other encodings, and asynchronously", async () => {
+			const sjis = StringEncoding.byCFStringEncoding(0x0a01 /* kCFStringEncodingShiftJIS */);
+			const text = Buffer.concat([sjis.encode("日本"), Buffer.from([0x81])]);
+			assert.strictEqual(sjis.decode(text, { fatal: false }), "日本\ufffd");
+			assert.strictEqual(await utf8.decodeAsync(bad, { fatal: false, replacement: "?" }), "a?b???");
+		});
+	});
+
+	describe("#tryDecode and #tryEncode", () => {
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+		const ascii = StringEncoding.byIANACharSetName("US-ASCII");
+
+		it("should convert valid text like decode and encode do", () => {
+			assert.strictEqual(utf8.tryDecode(Buffer.from("Grüße", "utf8")), "Grüße");
+			assert.strictEqual(utf8.tryDecode(Buffer.from("plain")), "plain");
+			assert.equalBytes(utf8.tryEncode("Grüße") as Buffer, Buffer.from("Grüße", "utf8"));
+			assert.equalBytes(ascii.tryEncode("Grüße", { lossByte: 63 }) as Buffer, Buffer.from("Gr??e"));
+		});
+
+		it("should read the options whatever the text is", () => {
+			const options = { get lossByte(): number { throw new Error("read"); } };
+			assert.throws(() => ascii.encode("plain", options), "read");
+			assert.throws(() => ascii.tryEncode("plain", options), "read");
+		});
+
+		it("should report failures instead of throwing", () => {
+			assert.deepStrictEqual(utf8.tryDecode(Buffer.from([0x61, 0x62, 0xc3])), { reason: "invalid", offset: 2 });
+			assert.deepStrictEqual(ascii.tryEncode("Grüße"), { reason: "unrepresentable", offset: 2 });
+			assert.deepStrictEqual(ascii.tryEncode("👍"), { reason: "unrepresentable", offset: 0 });
+		});
+	});
+
+	describe("errors", () => {
+		function caught(fn: () => unknown): any {
+			try {
+				fn();
+			}
+			catch (e) {
+				return e;
+			}
+			assert.fail("Nothing was thrown.");
+		}
+
+		it("should say where invalid text is", () => {
+			const error = caught(() => StringEncoding.byIANACharSetName("UTF-8").decode(Buffer.from([0x61, 0xe4, 0xb8, 0x80, 0x80])));
+			assert.instanceOf(error, InvalidEncodedTextError);
+			assert.strictEqual(error.offset, 4);
+			assert.include(error.message, "at offset 4");
+		});
+
+		it("should say where an unrepresentable character is", () => {
+			const error = caught(() => StringEncoding.byIANACharSetName("US-ASCII").encode("ab👍é"));
+			assert.instanceOf(error, NotRepresentableError);
+			assert.strictEqual(error.offset, 2);
+		});
+
+		it("should say where the problem is in asynchronous conversions too", async () => {
+			const decodeError = await StringEncoding.byIANACharSetName("UTF-8").decodeAsync(Buffer.from([0x61, 0xff])).catch(e => e);
+			assert.instanceOf(decodeError, InvalidEncodedTextError);
+			assert.strictEqual(decodeError.offset, 1);
+
+			const encodeError = await StringEncoding.byIANACharSetName("US-ASCII").encodeAsync("abcé").catch(e => e);
+			assert.instanceOf(encodeError, NotRepresentableError);
+			assert.strictEqual(encodeError.offset, 3);
+		});
+	});
+
+	describe("#isValid and #validLength", () => {
+		const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+
+		it("should accept valid text", () => {
+			const text = Buffer.from("Grüße, 世界 🙂", "utf8");
+			assert.isTrue(utf8.isValid(text));
+			assert.strictEqual(utf8.validLength(text), text.length);
+			assert.isTrue(utf8.isValid(new Uint8Array(0)));
+		});
+
+		it("should find the first invalid byte", () => {
+			const text = Buffer.from([0x41, 0xc3, 0xa9, 0x80, 0x42]);
+			assert.isFalse(utf8.isValid(text));
+			assert.strictEqual(utf8.validLength(text), 3);
+		});
+
+		it("should not accept a character cut off at the end", () => {
+			const text = Buffer.from([0x41, 0xe4, 0xb8]);
+			assert.isFalse(utf8.isValid(text));
+			assert.strictEqual(utf8.validLength(text), 1);
+		});
+
+		it("should agree with decode", () => {
+			const sjis = StringEncoding.byCFStringEncoding(0x0a01 /* kCFStringEncodingShiftJIS */);
+			const good = sjis.encode("日本語のテキスト");
+			assert.isTrue(sjis.isValid(good));
+			assert.strictEqual(sjis.decode(good), "日本語のテキスト");
+
+			const bad = Buffer.concat([good, Buffer.from([0x81])]);
+			assert.isFalse(sjis.isValid(bad));
+			assert.strictEqual(sjis.validLength(bad), good.length);
+			assert.throws(() => sjis.decode(bad), InvalidEncodedTextError);
+		});
+
+		it("should throw on things that aren't buffers", () => {
+			assert.throws(() => utf8.isValid("hello" as any), TypeError);
+		});
+	});
+
+	describe("#canEncode and #encodableLength", () => {
+		const latin1 = StringEncoding.byCFStringEncoding(0x0201 /* kCFStringEncodingISOLatin1 */);
+
+		it("should accept representable text", () => {
+			assert.isTrue(latin1.canEncode("Grüße"));
+			assert.strictEqual(latin1.encodableLength("Grüße"), 5);
+			assert.isTrue(latin1.canEncode(""));
+		});
+
+		it("should find the first unrepresentable character", () => {
+			assert.isFalse(latin1.canEncode("café ☕ crème"));
+			assert.strictEqual(latin1.encodableLength("café ☕ crème"), 5);
+		});
+
+		it("should count in UTF-16 code units", () => {
+			assert.strictEqual(latin1.encodableLength("é🙂"), 1);
+			assert.strictEqual(latin1.encodableLength("🙂🙂é☕"), 0);
+		});
+	});
 });
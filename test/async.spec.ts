@@ -0,0 +1,182 @@
+import * as Chai from "chai";
+import { AbortError, AbortSignalLike, decodeAsync, encodeAsync, InvalidEncodedTextError, NotRepresentableError, StringEncoding, transcode, transcodeAsync, transcodeFile } from "..";
+import ChaiBytes = require("chai-bytes");
+import * as fs from "fs";
+import * as os from "os";
+import * as path from "path";
+
+Chai.use(ChaiBytes);
+const { assert } = Chai;
+
+// Check for segfaults in native finalizers.
+afterEach(global.gc);
+
+/** A minimal AbortSignal, so that these tests don't depend on the Node.js version. */
+class TestAbortSignal implements AbortSignalLike {
+	aborted = false;
+	readonly listeners = new Set<() => void>();
+
+	addEventListener(type: "abort", listener: () => void) {
+		this.listeners.add(listener);
+	}
+
+	removeEventListener(type: "abort", listener: () => void) {
+		this.listeners.delete(listener);
+	}
+
+	abort() {
+		this.aborted = true;
+		for (const listener of this.listeners)
+			listener();
+	}
+}
+
+async function assertRejects(promise: Promise<unknown>, errorClass: Function) {
+	try {
+		await promise;
+	}
+	catch (e) {
+		assert.instanceOf(e, errorClass);
+		return;
+	}
+	assert.fail("Expected the promise to reject");
+}
+
+describe("async conversions", () => {
+	const macRoman = StringEncoding.byIANACharSetName("macintosh");
+
+	it("should decode and encode", async () => {
+		const bytes = Buffer.from([72, 101, 108, 108, 111, 44, 32, 119, 111, 114, 108, 100, 193]);
+		assert.strictEqual(await macRoman.decodeAsync(bytes), "Hello, world¡");
+		assert.equalBytes(await macRoman.encodeAsync("Hello, world¡"), bytes);
+		assert.strictEqual(await decodeAsync(bytes, "macintosh"), "Hello, world¡");
+		assert.equalBytes(await encodeAsync("Hello, world¡", "macintosh"), bytes);
+	});
+
+	it("should transcode", async () => {
+		const text = Buffer.from("2 ÷ 2 = 1¶".repeat(1000), "latin1");
+		const expected = transcode(text, "iso-8859-1", "macintosh");
+		assert.equalBytes(await transcodeAsync(text, "iso-8859-1", "macintosh"), expected);
+	});
+
+	it("should not be affected by changes to the input after starting", async () => {
+		const text = Buffer.from("Hello", "latin1");
+		const promise = transcodeAsync(text, "iso-8859-1", "UTF-8");
+		text.fill(0);
+		assert.equalBytes(await promise, Buffer.from("Hello"));
+	});
+
+	it("should reject with the same errors as the synchronous versions", async () => {
+		await assertRejects(StringEncoding.byIANACharSetName("UTF-8").decodeAsync(Buffer.from([0x80, 0xa0, 0xc0, 0xf0])), InvalidEncodedTextError);
+		await assertRejects(StringEncoding.byIANACharSetName("us-ascii").encodeAsync("¡"), NotRepresentableError);
+		await assertRejects(transcodeAsync(Buffer.from("¶", "latin1"), "iso-8859-1", "us-ascii"), NotRepresentableError);
+	});
+
+	it("should reject with AbortError when aborted", async () => {
+		const aborted = new TestAbortSignal();
+		aborted.abort();
+		await assertRejects(macRoman.encodeAsync("Hello", { signal: aborted }), AbortError);
+
+		const signal = new TestAbortSignal();
+		const promise = macRoman.decodeAsync(Buffer.alloc(1 << 20, 65), { signal });
+		signal.abort();
+		await assertRejects(promise, AbortError);
+		assert.strictEqual(signal.listeners.size, 0);
+	});
+
+	it("should stop listening to the signal when done", async () => {
+		const signal = new TestAbortSignal();
+		await macRoman.encodeAsync("Hello", { signal });
+		assert.strictEqual(signal.listeners.size, 0);
+	});
+});
+
+describe("transcodeFile", () => {
+	let dir: string;
+	let inPath: string, outPath: string;
+
+	before(() => {
+		dir = fs.mkdtempSync(path.join(os.tmpdir(), "iccf-"));
+		inPath = path.join(dir, "in");
+		outPath = path.join(dir, "out");
+	});
+
+	after(() => fs.rmdirSync(dir, { recursive: true }));
+
+	it("should convert a file like transcode converts a buffer", async () => {
+		// Long enough to be converted in several pieces.
+		const input = Buffer.from("Grüße, 世界! 👍 ".repeat(200000));
+		fs.writeFileSync(inPath, input);
+
+		for (const to of ["utf-16le", "utf-16", "shift_jis"]) {
+			const expected = transcode(input, "utf-8", to, { lossByte: 63 });
+			assert.strictEqual(await transcodeFile(inPath, outPath, "utf-8", to, { lossByte: 63 }), expected.length, to);
+			assert.equalBytes(fs.readFileSync(outPath), expected, to);
+		}
+
+		fs.writeFileSync(inPath, Buffer.alloc(0));
+		assert.strictEqual(await transcodeFile(inPath, outPath, "utf-8", "utf-16le"), 0);
+		assert.strictEqual(fs.readFileSync(outPath).length, 0);
+	});
+
+	it("should report where the input can't be converted, and remove the output", async () => {
+		const input = Buffer.from("a".repeat(3000000) + "é");
+		fs.writeFileSync(inPath, input);
+
+		try {
+			await transcodeFile(inPath, outPath, "utf-8", "us-ascii");
+			assert.fail("Expected the promise to reject");
+		}
+		catch (e) {
+			assert.instanceOf(e, NotRepresentableError);
+			assert.strictEqual((e as NotRepresentableError).offset, 3000000);
+		}
+
+		assert.isFalse(fs.existsSync(outPath));
+
+		input[1000] = 0xff;
+		fs.writeFileSync(inPath, input);
+		await assertRejects(transcodeFile(inPath, outPath, "utf-8", "utf-16le"), InvalidEncodedTextError);
+	});
+
+	it("should report invalid input before an earlier unrepresentable character, like transcode", async () => {
+		// The invalid byte is in a later piece than the unrepresentable character.
+		const input = Buffer.from("é" + "a".repeat(3000000) + "b");
+		input[input.length - 1] = 0xff;
+		fs.writeFileSync(inPath, input);
+
+		assert.throws(() => transcode(input, "utf-8", "us-ascii"), InvalidEncodedTextError, `at offset ${input.length - 1}`);
+
+		try {
+			await transcodeFile(inPath, outPath, "utf-8", "us-ascii");
+			assert.fail("Expected the promise to reject");
+		}
+		catch (e) {
+			assert.instanceOf(e, InvalidEncodedTextError);
+			assert.strictEqual((e as InvalidEncodedTextError).offset, input.length - 1);
+		}
+
+		assert.isFalse(fs.existsSync(outPath));
+	});
+
+	it("should reject with an fs-style error if a file can't be opened", async () => {
+		try {
+			await transcodeFile(path.join(dir, "missing"), outPath, "utf-8", "utf-16le");
+			assert.fail("Expected the promise to reject");
+		}
+		catch (e) {
+			assert.strictEqual((e as NodeJS.ErrnoException).code, "ENOENT");
+			assert.strictEqual((e as NodeJS.ErrnoException).path, path.join(dir, "missing"));
+		}
+	});
+
+	it("should refuse to overwrite its input", async () => {
+		fs.writeFileSync(inPath, "abc");
+		await assertRejects(transcodeFile(inPath, inPath, "utf-8", "utf-16le"), Error);
+		assert.strictEqual(fs.readFileSync(inPath, "latin1"), "abc");
+	});
+
+	it("should not support fatal: false", () => {
+		assert.throws(() => transcodeFile(inPath, outPath, "utf-8", "utf-16le", { fatal: false }), RangeError);
+	});
+});
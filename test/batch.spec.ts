@@ -0,0 +1,60 @@
+import * as Chai from "chai";
+import { decodeMany, encodeMany, transcodeMany } from "..";
+import ChaiBytes = require("chai-bytes");
+
+Chai.use(ChaiBytes);
+const { assert } = Chai;
+
+// Check for segfaults in native finalizers.
+afterEach(global.gc);
+
+describe("decodeMany", () => {
+	it("should decode an array of buffers, reporting invalid ones", () => {
+		const result = decodeMany([Buffer.from("abc"), Buffer.from([0xff]), Buffer.from("é👍", "utf8")], "UTF-8");
+		assert.deepStrictEqual(result.strings, ["abc", null, "é👍"]);
+		assert.deepStrictEqual(result.errors, [1]);
+	});
+
+	it("should decode a concatenated buffer with offsets", () => {
+		const buffer = Buffer.from([0x61, 0x8e, 0x62, 0x63]);
+		for (const offsets of [[0, 2, 2, 4], new Uint32Array([0, 2, 2, 4])]) {
+			const result = decodeMany({ buffer, offsets }, "macintosh");
+			assert.deepStrictEqual(result.strings, ["aé", "", "bc"]);
+			assert.deepStrictEqual(result.errors, []);
+		}
+	});
+
+	it("should reject offsets that are out of order or out of bounds", () => {
+		const buffer = Buffer.from("abcd");
+		assert.throws(() => decodeMany({ buffer, offsets: [0, 3, 2] }, "UTF-8"), RangeError);
+		assert.throws(() => decodeMany({ buffer, offsets: [0, 5] }, "UTF-8"), RangeError);
+	});
+});
+
+describe("encodeMany", () => {
+	it("should encode strings into one buffer, reporting unrepresentable ones", () => {
+		const result = encodeMany(["ab", "é", "", "c"], "US-ASCII");
+		assert.equalBytes(result.buffer, Buffer.from("abc"));
+		assert.deepStrictEqual(Array.from(result.offsets), [0, 2, 2, 2, 3]);
+		assert.deepStrictEqual(result.errors, [1]);
+	});
+
+	it("should use the loss byte", () => {
+		const result = encodeMany(["é", "x"], "US-ASCII", { lossByte: 63 });
+		assert.equalBytes(result.buffer, Buffer.from("?x"));
+		assert.deepStrictEqual(result.errors, []);
+	});
+});
+
+describe("transcodeMany", () => {
+	it("should transcode each piece", () => {
+		const result = transcodeMany([Buffer.from([0x8e]), Buffer.from("plain"), Buffer.from([0xd9])], "macintosh", "UTF-8");
+		assert.equalBytes(result.buffer, Buffer.from("éplainŸ", "utf8"));
+		assert.deepStrictEqual(Array.from(result.offsets), [0, 2, 7, 9]);
+		assert.deepStrictEqual(result.errors, []);
+
+		const failed = transcodeMany([Buffer.from([0xff]), Buffer.from("a"), Buffer.from("é", "utf8")], "UTF-8", "US-ASCII");
+		assert.equalBytes(failed.buffer, Buffer.from("a"));
+		assert.deepStrictEqual(failed.errors, [0, 2]);
+	});
+});
@@ -0,0 +1,131 @@
+import * as Chai from "chai";
+import { Readable } from "stream";
+import { Decoder, DecoderStream, Encoder, EncoderStream, InvalidEncodedTextError, NotRepresentableError, StringEncoding } from "..";
+import ChaiBytes = require("chai-bytes");
+
+Chai.use(ChaiBytes);
+const { assert } = Chai;
+
+// Check for segfaults in native finalizers.
+afterEach(global.gc);
+
+/** Makes a stream of the given chunks. (`Readable.from` isn't available in older versions of Node.js.) */
+function streamOf(chunks: Array<string | Buffer>): Readable {
+	let next = 0;
+	return new Readable({
+		read() {
+			this.push(next < chunks.length ? chunks[next++] : null);
+		}
+	});
+}
+
+async function collect(stream: NodeJS.ReadableStream): Promise<Array<string | Buffer>> {
+	const chunks: Array<string | Buffer> = [];
+	return new Promise((resolve, reject) => {
+		stream.on("data", chunk => chunks.push(chunk));
+		stream.on("end", () => resolve(chunks));
+		stream.on("error", reject);
+	});
+}
+
+describe("Decoder", () => {
+	it("should decode characters split between pieces", () => {
+		const bytes = Buffer.from("héllo € 👍", "utf8");
+
+		for (let step = 1; step <= 4; step++) {
+			const decoder = new Decoder("UTF-8");
+			let result = "";
+			for (let i = 0; i < bytes.length; i += step)
+				result += decoder.write(bytes.subarray(i, i + step));
+			result += decoder.end();
+			assert.strictEqual(result, "héllo € 👍");
+		}
+	});
+
+	it("should recognize a byte order mark only at the beginning", () => {
+		const decoder = new Decoder(StringEncoding.byCFStringEncoding(0x100));
+		assert.strictEqual(decoder.write(Buffer.from([0xff])), "");
+		assert.strictEqual(decoder.write(Buffer.from([0xfe, 0x61])), "");
+		assert.strictEqual(decoder.write(Buffer.from([0, 0xff, 0xfe])), "a﻿");
+		assert.strictEqual(decoder.end(), "");
+		assert.strictEqual(decoder.encoding.cfStringEncoding, 0x100);
+	});
+
+	it("should keep the shift state across an empty piece", () => {
+		// Stateful encodings like ISO-2022-JP are only available on macOS.
+		if (process.platform !== "darwin")
+			return;
+
+		const decoder = new Decoder("ISO-2022-JP");
+		let result = decoder.write(Buffer.from([0x1b, 0x24, 0x42, 0x30, 0x21]));
+		result += decoder.write(Buffer.alloc(0));
+		result += decoder.write(Buffer.from([0x30, 0x21, 0x1b, 0x28, 0x42, 0x61]));
+		result += decoder.end();
+		assert.strictEqual(result, "亜亜a");
+	});
+
+	it("should pass a lone high surrogate at the end through, like decode", () => {
+		const utf16le = StringEncoding.byCFStringEncoding(0x14000100);
+		const bytes = Buffer.from([0x61, 0x00, 0x3d, 0xd8]);
+		const decoder = new Decoder(utf16le);
+		const result = decoder.write(bytes) + decoder.end();
+		assert.strictEqual(result, "a\ud83d");
+		assert.strictEqual(result, utf16le.decode(bytes));
+	});
+
+	it("should throw if the text ends partway through a character", () => {
+		const decoder = new Decoder("UTF-8");
+		assert.strictEqual(decoder.write(Buffer.from([0x61, 0xe2, 0x82])), "a");
+		assert.throws(() => decoder.end(), InvalidEncodedTextError);
+		assert.throws(() => decoder.write(Buffer.from([0x61])));
+	});
+});
+
+describe("Encoder", () => {
+	it("should encode a surrogate pair split between pieces", () => {
+		const encoder = new Encoder("UTF-8");
+		const result = Buffer.concat(["x", "\ud83d", "\udc4d", "y"].map(s => encoder.write(s)).concat(encoder.end()));
+		assert.equalBytes(result, Buffer.from("x👍y", "utf8"));
+	});
+
+	it("should write a byte order mark only once", () => {
+		const utf16 = StringEncoding.byCFStringEncoding(0x100);
+		const encoder = new Encoder(utf16);
+		const result = Buffer.concat([encoder.write("ab"), encoder.write("cd"), encoder.end()]);
+		assert.equalBytes(result, utf16.encode("abcd"));
+	});
+
+	it("should throw on unrepresentable characters, unless there is a loss byte", () => {
+		assert.throws(() => new Encoder("US-ASCII").write("é"), NotRepresentableError);
+		assert.equalBytes(new Encoder("US-ASCII", { lossByte: 63 }).end("é"), Buffer.from("?"));
+	});
+});
+
+describe("DecoderStream and EncoderStream", () => {
+	it("should transcode piped text", async () => {
+		const text = "Hello, world¡ ".repeat(1000);
+		const macRoman = StringEncoding.byIANACharSetName("macintosh");
+		const encoded = macRoman.encode(text);
+		const pieces: Buffer[] = [];
+		for (let i = 0; i < encoded.length; i += 777)
+			pieces.push(encoded.subarray(i, i + 777));
+
+		const decoded = await collect(streamOf(pieces).pipe(new DecoderStream(macRoman)));
+		assert.strictEqual(decoded.join(""), text);
+
+		const reencoded = await collect(streamOf(decoded).pipe(new EncoderStream("UTF-8")));
+		assert.equalBytes(Buffer.concat(reencoded as Buffer[]), Buffer.from(text, "utf8"));
+	});
+
+	it("should emit errors for invalid text", async () => {
+		const stream = streamOf([Buffer.from([0x61, 0xff])]).pipe(new DecoderStream("UTF-8"));
+		let error: unknown;
+		try {
+			await collect(stream);
+		}
+		catch (e) {
+			error = e;
+		}
+		assert.instanceOf(error, InvalidEncodedTextError);
+	});
+});
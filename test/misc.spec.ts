@@ -1,5 +1,5 @@
 import * as Chai from "chai";
-import { encode, encodingExists } from "..";
+import { decode, decodeAsync, encode, encodingExists, getPoolStats, getStats, OperationStats, resetStats, setExternalStringThreshold, setPoolLimits, setStatsEnabled, StringEncoding } from "..";
 import ChaiBytes = require("chai-bytes");
 
 Chai.use(ChaiBytes);
@@ -17,3 +17,130 @@ describe("encodingExists", () => {
 		assert.isFalse(encodingExists("FOOBIE BLETCH"));
 	});
 });
+
+describe("setExternalStringThreshold", () => {
+	after(() => setExternalStringThreshold(256 * 1024));
+
+	it("should not change the decoded text, above or below the threshold", async () => {
+		const text = "é👍 abc".repeat(1000);
+		const bytes = Buffer.from(text, "utf8");
+		const ascii = Buffer.from("abc".repeat(1000), "ascii");
+
+		for (const threshold of [0, 10, Infinity]) {
+			setExternalStringThreshold(threshold);
+			assert.strictEqual(decode(bytes, "UTF-8"), text);
+			assert.strictEqual(await decodeAsync(bytes, "UTF-8"), text);
+			assert.strictEqual(await decodeAsync(ascii, "UTF-8"), ascii.toString("ascii"));
+		}
+	});
+
+	it("should join long texts without using String.prototype.concat as it is now", () => {
+		// Long enough to be joined from more pieces than are passed to concat at once.
+		const macRoman = StringEncoding.byIANACharSetName("macintosh");
+		const text = "é¶ Ω".repeat(600000);
+		const bytes = macRoman.encode(text);
+		const concat = String.prototype.concat;
+		setExternalStringThreshold(Infinity);
+
+		try {
+			String.prototype.concat = () => assert.fail("String.prototype.concat was looked up again");
+			assert.strictEqual(decode(bytes, macRoman), text);
+		}
+		finally {
+			String.prototype.concat = concat;
+		}
+	});
+
+	it("should reject negative thresholds", () => {
+		assert.throws(() => setExternalStringThreshold(-1), RangeError);
+	});
+});
+
+describe("getStats", () => {
+	const latin1 = StringEncoding.byIANACharSetName("iso-8859-1");
+
+	function find(operation: string): OperationStats | undefined {
+		return getStats().operations.find(o => o.operation === operation && o.encoding.equals(latin1));
+	}
+
+	beforeEach(resetStats);
+	after(() => {
+		setStatsEnabled(false);
+		resetStats();
+	});
+
+	it("should count nothing while disabled", () => {
+		setStatsEnabled(false);
+		decode(Buffer.from("caf\xe9", "latin1"), latin1);
+		assert.isFalse(getStats().enabled);
+		assert.isUndefined(find("decode"));
+	});
+
+	it("should count calls, errors, and bytes", async () => {
+		setStatsEnabled(true);
+		decode(Buffer.from("caf\xe9", "latin1"), latin1);
+		await latin1.decodeAsync(Buffer.from("abc"));
+		encode("café", latin1);
+		assert.throws(() => encode("☕", latin1));
+
+		const decodes = find("decode")!;
+		assert.strictEqual(decodes.calls, 2);
+		assert.strictEqual(decodes.errors, 0);
+		assert.strictEqual(decodes.bytesIn, 7);
+		assert.strictEqual(decodes.bytesOut, 14);
+		assert.strictEqual(decodes.latency.reduce((a, b) => a + b), 2);
+
+		const encodes = find("encode")!;
+		assert.strictEqual(encodes.calls, 2);
+		assert.strictEqual(encodes.errors, 1);
+
+		const stats = getStats();
+		assert.isTrue(stats.enabled);
+		assert.isAtLeast(stats.fastPaths.ascii.taken, 1);
+		assert.isAtLeast(stats.fastPaths.ascii.missed, 1);
+		assert.isAtLeast(stats.copies, 1);
+	});
+
+	it("should start over after resetStats", () => {
+		setStatsEnabled(true);
+		decode(Buffer.from("abc"), latin1);
+		resetStats();
+		assert.deepStrictEqual(getStats().operations, []);
+	});
+});
+
+describe("getPoolStats", () => {
+	const utf8 = StringEncoding.byIANACharSetName("UTF-8");
+	const text = Buffer.from("Grüße aus der Küche ".repeat(10));
+
+	afterEach(() => setPoolLimits({ threadBytes: 1024 * 1024, classBlocks: 64 }));
+
+	it("should reuse buffers for repeated conversions", () => {
+		for (let i = 0; i < 10; i++)
+			utf8.decode(text);
+
+		resetStats();
+		for (let i = 0; i < 10; i++)
+			utf8.decode(text);
+
+		const stats = getPoolStats();
+		assert.isAtLeast(stats.allocations, 10);
+		assert.isAtLeast(stats.reused, 10);
+		assert.isAbove(stats.cachedBytes, 0);
+	});
+
+	it("should keep nothing when pooling is turned off", () => {
+		setPoolLimits({ threadBytes: 0 });
+		assert.strictEqual(getPoolStats().limits.threadBytes, 0);
+		assert.strictEqual(getPoolStats().limits.classBlocks, 64);
+
+		utf8.decode(text);
+		resetStats();
+		utf8.decode(text);
+		assert.strictEqual(getPoolStats().reused, 0);
+	});
+
+	it("should reject negative limits", () => {
+		assert.throws(() => setPoolLimits({ classBlocks: -1 }), RangeError);
+	});
+});
@@ -1,5 +1,5 @@
 import * as Chai from "chai";
-import { encodeSmallest, NotRepresentableError, SelectAndEncodeOptions, StringEncoding, TextAndEncoding, transcode, transcodeSmallest } from "..";
+import { detectEncoding, encodeInto, encodeSmallest, InvalidEncodedTextError, NotRepresentableError, representableEncodings, SelectAndEncodeOptions, setParallelTranscodeOptions, StringEncoding, TextAndEncoding, transcode, transcodeAsync, transcodeInto, transcodeSmallest } from "..";
 import ChaiBytes = require("chai-bytes");
 import { inspect } from "util";
 
@@ -49,6 +49,117 @@ describe("transcode", () => {
 		), NotRepresentableError);
 	});
 
+	it("should report where the input can't be converted", () => {
+		const latin1 = Buffer.from("2 ÷ 2 = 1¶", "latin1");
+		let error: unknown;
+
+		try {
+			transcode(latin1, "iso-8859-1", "us-ascii");
+		}
+		catch (e) {
+			error = e;
+		}
+
+		assert.instanceOf(error, NotRepresentableError);
+		assert.strictEqual((error as NotRepresentableError).offset, 2);
+
+		const withBOM = Buffer.from([0xef, 0xbb, 0xbf, 0x61, 0xc3, 0xa9, 0x62]);
+		assert.throws(() => transcode(withBOM, "UTF-8", "us-ascii"), NotRepresentableError, "at offset 4");
+		assert.throws(() => transcode(Buffer.from([0x61, 0x62, 0xff]), "UTF-8", "UTF-16LE"), InvalidEncodedTextError, "at offset 2");
+	});
+
+	it("should replace invalid input if not fatal", () => {
+		const replacements = { count: 0 };
+		const bad = Buffer.from([0x61, 0xc3, 0x62]);
+		assert.equalBytes(transcode(bad, "UTF-8", "UTF-16LE", { fatal: false, replacements }), Buffer.from("a\ufffdb", "utf16le"));
+		assert.strictEqual(replacements.count, 1);
+		assert.equalBytes(transcode(bad, "UTF-8", "macintosh", { fatal: false, replacement: "?" }), Buffer.from("a?b"));
+		assert.throws(() => transcode(bad, "UTF-8", "macintosh", { fatal: false }), NotRepresentableError);
+		assert.throws(() => transcodeInto(bad, "UTF-8", "UTF-16LE", Buffer.alloc(8), 0, { fatal: false }), RangeError);
+	});
+
+	it("should transcode between Unicode encodings", () => {
+		const text = "Grüße, 世界! 👍 " + "x".repeat(40);
+
+		for (const from of ["utf-8", "utf-16be", "utf-16le", "utf-32be", "utf-32le"]) {
+			const input = StringEncoding.byIANACharSetName(from).encode(text);
+
+			for (const to of ["utf-8", "utf-16be", "utf-16le", "utf-32be", "utf-32le"]) {
+				const toEncoding = StringEncoding.byIANACharSetName(to);
+				assert.equalBytes(transcode(input, from, toEncoding), toEncoding.encode(text), `${from} to ${to}`);
+			}
+		}
+	});
+
+	it("should honor and write byte order marks between Unicode encodings", () => {
+		const le = new Uint8Array([0xff, 0xfe, 0x61, 0, 0x3d, 0xd8, 0x4d, 0xdc]);
+		assert.equalBytes(transcode(le, "utf-16", "utf-8"), Buffer.from("a👍"));
+		assert.equalBytes(transcode(Buffer.from("\ufeffa"), "utf-8", "utf-16be"), Buffer.from([0, 0x61]));
+
+		const utf32 = StringEncoding.byIANACharSetName("utf-32");
+		assert.equalBytes(transcode(Buffer.from("a👍"), "utf-8", utf32), utf32.encode("a👍"));
+	});
+
+	it("should reject invalid text and lone surrogates between Unicode encodings", () => {
+		assert.throws(() => transcode(Buffer.from([0x61, 0xc0, 0xaf]), "utf-8", "utf-16le"), InvalidEncodedTextError);
+		assert.throws(() => transcode(Buffer.from([0, 0, 0xd8, 0]), "utf-32be", "utf-8"), InvalidEncodedTextError);
+		assert.throws(() => transcode(Buffer.from([0x61, 0, 0x62]), "utf-16le", "utf-32le"), InvalidEncodedTextError);
+
+		const lone = Buffer.from([0x61, 0, 0x3d, 0xd8, 0x62, 0]);
+		assert.throws(() => transcode(lone, "utf-16le", "utf-8"), NotRepresentableError);
+		assert.equalBytes(transcode(lone, "utf-16le", "utf-8", { lossByte: 63 }), Buffer.from("a?b"));
+		assert.equalBytes(transcode(lone, "utf-16le", "utf-16be"), Buffer.from([0, 0x61, 0xd8, 0x3d, 0, 0x62]));
+	});
+
+	describe("on several threads", () => {
+		after(() => setParallelTranscodeOptions({ threshold: 32 * 1024 * 1024, threads: 0 }));
+
+		function errorOffset(convert: () => unknown): number | undefined {
+			try {
+				convert();
+			}
+			catch (e) {
+				return (e as InvalidEncodedTextError | NotRepresentableError).offset;
+			}
+		}
+
+		it("should produce the same output and errors as on one thread", async () => {
+			// Long enough to be split into several chunks, with characters of every length falling on the chunk boundaries.
+			const text = "Grüße, 世界! 👍 \ufeff".repeat(300000);
+			const bad = Buffer.from(text);
+			bad[bad.length - 1000] = 0xff;
+
+			const cases: [Buffer, string, string][] = [
+				[Buffer.from(text), "utf-8", "utf-16le"],
+				[Buffer.from("\ufeff" + text), "utf-8", "utf-32be"],
+				[StringEncoding.byIANACharSetName("utf-16").encode(text), "utf-16", "utf-8"],
+				[Buffer.from(text.replace(/[^\0-\xff]/g, "?"), "latin1"), "iso-8859-1", "utf-8"],
+				[Buffer.from(text), "utf-8", "iso-8859-1"],
+				[bad, "utf-8", "utf-16be"]
+			];
+
+			for (const [input, from, to] of cases) {
+				setParallelTranscodeOptions({ threads: 1 });
+				const expected = errorOffset(() => transcode(input, from, to)) ?? transcode(input, from, to);
+
+				setParallelTranscodeOptions({ threshold: 0, threads: 4 });
+				const actual = errorOffset(() => transcode(input, from, to)) ?? transcode(input, from, to);
+				const actualAsync = await transcodeAsync(input, from, to).catch(e => (e as NotRepresentableError).offset);
+
+				for (const result of [actual, actualAsync]) {
+					if (typeof expected === "number")
+						assert.strictEqual(result, expected, `${from} to ${to}`);
+					else
+						assert.equalBytes(result as Buffer, expected, `${from} to ${to}`);
+				}
+			}
+		});
+
+		it("should reject negative options", () => {
+			assert.throws(() => setParallelTranscodeOptions({ threads: -1 }), RangeError);
+		});
+	});
+
 	for (const from of [42, null, true, undefined, transcode, StringEncoding, Symbol.match]) {
 		it(`should reject ${inspect(from)} as an encoding parameter`, () => {
 			assert.throws(() => transcode(Buffer.alloc(0), from as any, "macintosh"), TypeError);
@@ -91,6 +202,80 @@ describe("encodeSmallest", () => {
 	});
 });
 
+describe("representableEncodings", () => {
+	it("should list encodings that can represent the text, smallest first, with correct lengths", () => {
+		const input = "Привет, мир";
+		const found = representableEncodings(input);
+
+		assert.isNotEmpty(found);
+		assert.strictEqual(found[0].length, input.length);
+		assert.isTrue(found.some(({encoding}) => encoding.cfStringEncoding === 0x0502), "Windows Cyrillic is missing");
+		assert.isFalse(found.some(({encoding}) => encoding.cfStringEncoding === 0x0600), "ASCII can't represent Cyrillic");
+
+		for (let index = 0; index < found.length; index++) {
+			const {encoding, length} = found[index];
+			assert.strictEqual(encoding.encode(input).length, length, encoding.name);
+			if (index > 0)
+				assert.isAtLeast(length, found[index - 1].length);
+		}
+	});
+
+	it("should agree with encodeSmallest", () => {
+		for (const input of ["hello", "2 ÷ 2 = 1¶", "👍 ok"]) {
+			const found = representableEncodings(input);
+			const smallest = encodeSmallest(input);
+
+			// On macOS, encodeSmallest goes by CFStringGetSmallestEncoding, which only considers the system encoding and UTF-16.
+			if (process.platform === "darwin") {
+				const entry = found.find(({encoding}) => encoding === smallest.encoding);
+				if (entry !== undefined)
+					assert.strictEqual(smallest.text.length, entry.length);
+			}
+			else
+				assert.strictEqual(smallest.text.length, found[0].length);
+		}
+	});
+
+	it("should only list encodings that the text can be encoded in", () => {
+		for (const input of ["€ ‰ ™ œ", "Ω µ ﬁ", "ÿ Ÿ ‑"]) {
+			for (const {encoding, length} of representableEncodings(input))
+				assert.strictEqual(encoding.encode(input).length, length, encoding.name);
+		}
+	});
+});
+
+describe("detectEncoding", () => {
+	const text = "Съешь же ещё этих мягких французских булок, да выпей чаю.";
+
+	it("should go by the byte order mark, if there is one", () => {
+		const [first] = detectEncoding(Buffer.from([0xff, 0xfe, 0x68, 0, 0x69, 0]));
+		assert.strictEqual(first.encoding.cfStringEncoding, 0x0100);
+		assert.strictEqual(first.confidence, 1);
+	});
+
+	it("should recognize UTF-8 and single-byte encodings", () => {
+		assert.strictEqual(detectEncoding(Buffer.from(text, "utf8"))[0].encoding.cfStringEncoding, 0x08000100);
+
+		const found = detectEncoding(StringEncoding.byIANACharSetName("windows-1251").encode(text));
+		assert.strictEqual(found[0].encoding.cfStringEncoding, 0x0502);
+		assert.isFalse(found.some(({encoding}) => encoding.cfStringEncoding === 0x08000100), "the text isn't valid UTF-8");
+
+		for (let index = 1; index < found.length; index++)
+			assert.isAtMost(found[index].confidence, found[index - 1].confidence);
+	});
+
+	it("should only consider the given candidates", () => {
+		const found = detectEncoding(Buffer.from("café", "latin1"), { candidates: ["us-ascii", "iso-8859-1"] });
+		assert.deepStrictEqual(found.map(({encoding}) => encoding.cfStringEncoding), [0x0201]);
+	});
+
+	it("should not hold a character cut off by sampleBytes against an encoding", () => {
+		const input = Buffer.from(text, "utf8");
+		const [first] = detectEncoding(input, { sampleBytes: 5 });
+		assert.strictEqual(first.encoding.cfStringEncoding, 0x08000100);
+	});
+});
+
 describe("transcodeSmallest", () => {
 	const inputString = "4 ÷ 2 = 2¶";
 	const input = Buffer.from(inputString, "latin1");
@@ -102,6 +287,11 @@ describe("transcodeSmallest", () => {
 		assert.strictEqual(encoded.encoding.decode(encoded.text), inputString);
 	}
 
+	it("should replace invalid input if not fatal", () => {
+		const result = transcodeSmallest(Buffer.from([0x61, 0xff]), "UTF-8", { fatal: false, replacement: "é" });
+		assert.strictEqual(result.encoding.decode(result.text), "aé");
+	});
+
 	it("should round-trip and respect isEncodingOk", () => {
 		for (const shouldAccept of [true, false]) {
 			const options: SelectAndEncodeOptions = {
@@ -118,3 +308,77 @@ describe("transcodeSmallest", () => {
 		}
 	});
 });
+
+describe("encodeInto and transcodeInto", () => {
+	it("should stop at the last whole character that fits", () => {
+		const target = Buffer.alloc(5, 0);
+
+		assert.deepStrictEqual(encodeInto("a👍b", "UTF-8", target, 2), { read: 1, written: 1 });
+		assert.deepStrictEqual(encodeInto("👍b", "UTF-8", target, 3), { read: 0, written: 0 });
+		assert.deepStrictEqual(encodeInto("a👍b", "UTF-8", target), { read: 3, written: 5 });
+		assert.equalBytes(target.subarray(0, 5), Buffer.from("a👍", "utf8"));
+	});
+
+	it("should throw on unrepresentable characters, unless there is a loss byte", () => {
+		const target = Buffer.alloc(4);
+		assert.throws(() => encodeInto("é", "US-ASCII", target), NotRepresentableError);
+		assert.deepStrictEqual(encodeInto("é", "US-ASCII", target, 0, { lossByte: 63 }), { read: 1, written: 1 });
+		assert.throws(() => encodeInto("x", "US-ASCII", target, 5), RangeError);
+	});
+
+	it("should report how many input bytes were transcoded", () => {
+		const macRoman = Buffer.from([0x61, 0x8e, 0x8e, 0x62]);
+		const target = Buffer.alloc(4);
+
+		assert.deepStrictEqual(transcodeInto(macRoman, "macintosh", "UTF-8", target), { read: 2, written: 3 });
+		assert.deepStrictEqual(transcodeInto(macRoman.subarray(2), "macintosh", "UTF-8", target), { read: 2, written: 3 });
+		assert.equalBytes(target.subarray(0, 3), Buffer.from("éb", "utf8"));
+
+		const withBOM = Buffer.from([0xef, 0xbb, 0xbf, 0x61, 0xc3, 0xa9]);
+		assert.deepStrictEqual(transcodeInto(withBOM, "UTF-8", "macintosh", Buffer.alloc(1)), { read: 4, written: 1 });
+		assert.deepStrictEqual(transcodeInto(Buffer.from("plain"), "UTF-8", "macintosh", Buffer.alloc(3)), { read: 3, written: 3 });
+	});
+
+	it("should stop reading at a character boundary", () => {
+		// Big5 has two codes for some characters, such as U+FF0F, so where the input stops can't be found by encoding the output again.
+		const input = Buffer.from([0xa2, 0x41, 0x61, 0xa1, 0xfe, 0xa4, 0xa4, 0xa2, 0x41, 0x62]);
+		const expected = transcode(input, "Big5", "UTF-8");
+
+		for (const size of [1, 2, 3, 4, 7]) {
+			const target = Buffer.alloc(size);
+			const pieces: Buffer[] = [];
+
+			for (let offset = 0; offset < input.length;) {
+				const { read, written } = transcodeInto(input.subarray(offset), "Big5", "UTF-8", target);
+				if (read === 0)
+					break;
+
+				assert.equalBytes(transcode(input.subarray(offset, offset + read), "Big5", "UTF-8"), target.subarray(0, written));
+				pieces.push(Buffer.from(target.subarray(0, written)));
+				offset += read;
+			}
+
+			assert.equalBytes(Buffer.concat(pieces), size < 3 ? Buffer.alloc(0) : expected);
+		}
+	});
+
+	it("should convert a long input a piece at a time, when called in a loop", () => {
+		const text = "Grüße, 世界! 👍 ".repeat(20000);
+		const input = Buffer.from(text, "utf16le");
+		const target = Buffer.alloc(4096);
+		const pieces: Buffer[] = [];
+
+		for (let offset = 0; offset < input.length;) {
+			const { read, written } = transcodeInto(input.subarray(offset), "UTF-16LE", "UTF-8", target);
+			assert.isAbove(read, 0);
+			pieces.push(Buffer.from(target.subarray(0, written)));
+			offset += read;
+		}
+
+		assert.strictEqual(Buffer.concat(pieces).toString("utf8"), text);
+
+		const encoded = Buffer.alloc(6);
+		assert.deepStrictEqual(encodeInto(text, "UTF-8", encoded), { read: 4, written: 6 });
+		assert.strictEqual(encoded.toString("utf8"), "Grüß");
+	});
+});
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""
+Generates the table file for the portable backend's multi-byte (CJK) encodings, from the codecs that ship with Python.
+
+Usage: tools/generate-cjk-tables.py [--update-checksum] lib/cjk-tables.bin
+
+The tables are only as good as the installed Python's codecs, which could change from one version to another, so the SHA-256 of the file is kept in tools/cjk-tables.sha256, and the file isn't written if it doesn't match. After changing this script on purpose, run it with --update-checksum to record the new one.
+
+The file is memory-mapped by src/MultiByteTables.cc when one of these encodings is first used. Its layout (all integers little-endian, all offsets from the start of the file and 4-byte aligned) is:
+
+	header:     char magic[8] = "ICCFMB01"; u32 count
+	directory:  count x { u32 encoding; u32 flags; u32 nodes; u32 nodeCount; u32 index; u32 pages; u32 pageCount; u32 ranges; u32 rangeCount }
+	nodes:      nodeCount x u16[256]. Decoding starts at node 0 with the first byte. Each entry is a character, a child node (0xd800 + n) to continue with the next byte, 0xfffe for a GB18030 four-byte sequence, or 0xffff for an invalid byte.
+	index:      u16[256], mapping the high byte of a UTF-16 code unit to a page (0 is empty).
+	pages:      pageCount x u32[256], mapping the low byte to its encoded form: the length in the top byte, then the bytes, first byte highest. 0 means unmappable.
+	ranges:     rangeCount x { u32 linear; u32 codePoint }, for GB18030 four-byte sequences in the BMP. Each range ends where the next begins; the last is only an end marker.
+"""
+
+import hashlib
+import os
+import struct
+import sys
+
+# (CFStringEncoding, Python codec name)
+MULTI_BYTE_ENCODINGS = [
+	(0x0A01, "shift_jis"),
+	(0x0920, "euc_jp"),
+	(0x0631, "gbk"),
+	(0x0632, "gb18030"),
+	(0x0A03, "big5"),
+	(0x0940, "euc_kr"),
+]
+
+FLAG_GB18030 = 1
+
+CHECKSUM_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "cjk-tables.sha256")
+
+# Sequences that Python's codecs treat specially, and that the tables map the plain way instead. Python decodes EUC-KR's Hangul filler only as the start of an 8-byte composed syllable (KS X 1001 annex 3), which the tables don't support.
+OVERRIDES = {
+	("euc_kr", b"\xa4\xd4"): 0x3164,
+}
+
+INVALID = 0xFFFF
+FOUR_BYTE = 0xFFFE
+CHILD = 0xD800
+
+
+def gb18030_linear(b):
+	return (((b[0] - 0x81) * 10 + (b[1] - 0x30)) * 126 + (b[2] - 0x81)) * 10 + (b[3] - 0x30)
+
+
+def decode_one(codec, seq):
+	"""Returns the single BMP character that `seq` decodes to, "incomplete" if it's the start of a longer sequence, or None if it's invalid."""
+	if (codec, seq) in OVERRIDES:
+		return OVERRIDES[(codec, seq)]
+
+	try:
+		s = seq.decode(codec)
+	except UnicodeDecodeError as e:
+		return "incomplete" if e.end == len(seq) and "incomplete" in e.reason else None
+
+	if len(s) != 1:
+		return None
+
+	c = ord(s)
+	if c > 0xFFFF or 0xD800 <= c <= 0xDFFF or c >= 0xFFFE:
+		raise ValueError(f"{codec} {seq.hex()} decodes to U+{c:04X}, which the table can't hold")
+	return c
+
+
+def build_nodes(codec, gb18030):
+	nodes = []
+
+	def build(prefix):
+		node = [INVALID] * 256
+		nodes.append(node)
+
+		for b in range(256):
+			seq = prefix + bytes([b])
+			result = decode_one(codec, seq)
+
+			if result == "incomplete":
+				if gb18030 and len(seq) == 2:
+					node[b] = FOUR_BYTE
+				else:
+					child = len(nodes)
+					if any(c != INVALID for c in build(seq)):
+						node[b] = CHILD + child
+					else:
+						# Nothing valid starts this way, so don't keep the empty node.
+						del nodes[child:]
+			elif result is not None:
+				node[b] = result
+
+		return node
+
+	build(b"")
+	return nodes
+
+
+def build_encoder(codec, gb18030):
+	pages = [[0] * 256]
+	index = [0] * 256
+
+	for c in range(0x10000):
+		if 0xD800 <= c <= 0xDFFF:
+			continue
+
+		try:
+			encoded = chr(c).encode(codec)
+		except UnicodeEncodeError:
+			continue
+
+		# GB18030 four-byte sequences are computed, not looked up.
+		if gb18030 and len(encoded) == 4:
+			continue
+
+		# The rest of the Hangul syllables, which Python encodes as EUC-KR composed sequences. Since those aren't decoded either, leave them unmappable.
+		if codec == "euc_kr" and encoded.startswith(b"\xa4\xd4") and len(encoded) > 2:
+			continue
+
+		if len(encoded) > 3:
+			raise ValueError(f"{codec} encodes U+{c:04X} as {encoded.hex()}, which is too long for the table")
+
+		if index[c >> 8] == 0:
+			index[c >> 8] = len(pages)
+			pages.append([0] * 256)
+
+		pages[index[c >> 8]][c & 0xFF] = (len(encoded) << 24) | int.from_bytes(encoded, "big")
+
+	return index, pages
+
+
+def build_ranges(codec):
+	"""Finds the runs of GB18030 four-byte sequences in the BMP that map to consecutive code points."""
+	ranges = []
+	previous = None
+
+	for c in range(0x80, 0x10000):
+		if 0xD800 <= c <= 0xDFFF:
+			continue
+
+		encoded = chr(c).encode(codec)
+		if len(encoded) != 4:
+			continue
+
+		linear = gb18030_linear(encoded)
+		if previous is None or linear - previous[0] != c - previous[1]:
+			ranges.append((linear, c))
+		previous = (linear, c)
+
+	# End marker, so that every range has a known length.
+	ranges.append((previous[0] + 1, previous[1] + 1))
+	return ranges
+
+
+def main(path, update_checksum=False):
+	sections = []
+
+	for encoding, codec in MULTI_BYTE_ENCODINGS:
+		gb18030 = codec == "gb18030"
+		nodes = build_nodes(codec, gb18030)
+		index, pages = build_encoder(codec, gb18030)
+		ranges = build_ranges(codec) if gb18030 else []
+
+		for b in range(0x80):
+			if nodes[0][b] != b:
+				raise ValueError(f"{codec} is not ASCII-compatible")
+
+		sections.append((encoding, FLAG_GB18030 if gb18030 else 0, nodes, index, pages, ranges))
+
+	header_size = 12 + len(sections) * 36
+	body = bytearray()
+	directory = bytearray()
+
+	for encoding, flags, nodes, index, pages, ranges in sections:
+		nodes_offset = header_size + len(body)
+		for node in nodes:
+			body += struct.pack("<256H", *node)
+
+		index_offset = header_size + len(body)
+		body += struct.pack("<256H", *index)
+
+		pages_offset = header_size + len(body)
+		for page in pages:
+			body += struct.pack("<256I", *page)
+
+		ranges_offset = header_size + len(body)
+		for linear, code_point in ranges:
+			body += struct.pack("<II", linear, code_point)
+
+		directory += struct.pack("<9I", encoding, flags, nodes_offset, len(nodes), index_offset, pages_offset, len(pages), ranges_offset, len(ranges))
+
+	contents = b"ICCFMB01" + struct.pack("<I", len(sections)) + directory + body
+	checksum = hashlib.sha256(contents).hexdigest()
+
+	if update_checksum:
+		with open(CHECKSUM_PATH, "w") as out:
+			out.write(checksum + "\n")
+	else:
+		with open(CHECKSUM_PATH) as f:
+			expected = f.read().strip()
+
+		if checksum != expected:
+			sys.exit(f"{path}: the tables made with Python {sys.version.split()[0]} have SHA-256 {checksum}, not {expected} as recorded in {CHECKSUM_PATH}. This Python's codecs map some characters differently.")
+
+	with open(path, "wb") as out:
+		out.write(contents)
+
+
+if __name__ == "__main__":
+	args = sys.argv[1:]
+	update = "--update-checksum" in args
+	if update:
+		args.remove("--update-checksum")
+	main(args[0], update)
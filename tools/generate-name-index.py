@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+Generates the perfect hash tables that the portable backend uses to look up encodings by IANA character set name, Windows codepage, NSStringEncoding constant, and CFStringEncoding, from the registry in src/PortableBackend.cc.
+
+Usage: tools/generate-name-index.py > src/name-index.hh
+
+The output is checked in, so this only needs to be run after changing the registry. src/PortableBackend.cc checks at compile time that every name, codepage, and constant in the registry still leads to its own entry through the tables.
+
+Each table maps keys to positions in the registry, and is looked up by hashing the key twice: first with seed 0 to choose a bucket, then with that bucket's seed (its "displacement") to choose a slot. The displacements are chosen so that no two keys end up in the same slot, so a lookup never has to look at more than one slot. The hash functions here must match the ones in src/PortableBackend.cc:
+
+	mix(h):               h ^= h >> 16; h *= 0x85ebca6b; h ^= h >> 13; h *= 0xc2b2ae35; h ^= h >> 16
+	hashName(name, seed): FNV-1a of the name in ASCII lower case, starting from 0x811c9dc5 ^ seed, then mix
+	hashNumber(n, seed):  mix(n ^ (seed * 0x9e3779b9))
+
+All arithmetic is on unsigned 32-bit integers.
+"""
+
+import os
+import re
+import sys
+
+MASK32 = 0xFFFFFFFF
+NO_WINDOWS_CODEPAGE = "kNoWindowsCodepage"
+NS_STRING_ENCODING_HIGH_BIT = 0x80000000
+
+
+def mix(h):
+	h ^= h >> 16
+	h = (h * 0x85EBCA6B) & MASK32
+	h ^= h >> 13
+	h = (h * 0xC2B2AE35) & MASK32
+	h ^= h >> 16
+	return h
+
+
+def hash_name(name, seed):
+	h = 0x811C9DC5 ^ seed
+	for c in name.lower().encode("ascii"):
+		h = ((h ^ c) * 0x01000193) & MASK32
+	return mix(h)
+
+
+def hash_number(n, seed):
+	return mix(n ^ ((seed * 0x9E3779B9) & MASK32))
+
+
+def read_registry(path):
+	with open(path, encoding="utf-8") as f:
+		source = f.read()
+
+	names = {
+		m.group(1): re.findall(r'"([^"]*)"', m.group(2))
+		for m in re.finditer(r"const char \* const (\w+)\[\] = \{(.*?)\};", source)
+	}
+
+	registry_source = re.search(r"constexpr EncodingInfo registry\[\] = \{(.*?)\n\t\};", source, re.S).group(1)
+	registry = [
+		{ "id": int(m.group(1), 16), "names": names[m.group(2)], "codepage": None if m.group(3) == NO_WINDOWS_CODEPAGE else int(m.group(3)) }
+		for m in re.finditer(r'\{ (0x[0-9A-Fa-f]+), "[^"]*", (\w+), (\w+), \w+ \}', registry_source)
+	]
+
+	ns_source = re.search(r"\} nsStringEncodings\[\] = \{(.*?)\n\t\};", source, re.S).group(1)
+	ns_string_encodings = [(int(m.group(1), 16), int(m.group(2))) for m in re.finditer(r"\{ (0x[0-9A-Fa-f]+), (\d+) \}", ns_source)]
+
+	return registry, ns_string_encodings
+
+
+def build(keys, hash_function):
+	"""Finds displacements that put each of the keys (a dict of key to registry position) in a slot of its own. Returns the displacements and the slots."""
+
+	slot_count = 1
+	while slot_count * 4 < len(keys) * 5:
+		slot_count *= 2
+	bucket_count = max(1, slot_count // 4)
+
+	buckets = [[] for _ in range(bucket_count)]
+	for key in keys:
+		buckets[hash_function(key, 0) & (bucket_count - 1)].append(key)
+
+	displacements = [0] * bucket_count
+	slots = [None] * slot_count
+
+	# Fill the fullest buckets first, while there are still plenty of empty slots.
+	for bucket in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+		if not buckets[bucket]:
+			break
+
+		for displacement in range(1, 0x10000):
+			chosen = [hash_function(key, displacement) & (slot_count - 1) for key in buckets[bucket]]
+			if len(set(chosen)) == len(chosen) and all(slots[s] is None for s in chosen):
+				break
+		else:
+			raise ValueError(f"no displacement works for bucket {bucket}")
+
+		displacements[bucket] = displacement
+		for key, slot in zip(buckets[bucket], chosen):
+			slots[slot] = (key, keys[key])
+
+	return displacements, slots
+
+
+def emit_displacements(out, name, displacements):
+	out.write(f"static constexpr uint16_t k{name}Displacements[{len(displacements)}] = {{\n")
+	for row in range(0, len(displacements), 16):
+		out.write("\t" + ", ".join(str(d) for d in displacements[row:row + 16]) + ",\n")
+	out.write("};\n")
+
+
+def emit_number_index(out, name, comment, keys):
+	displacements, slots = build(keys, hash_number)
+	out.write(f"\n// {comment}\n")
+	emit_displacements(out, name, displacements)
+	out.write(f"static constexpr IndexedNumber k{name}Slots[{len(slots)}] = {{\n")
+	for slot in slots:
+		out.write("\t{ 0, kNoIndexEntry },\n" if slot is None else f"\t{{ 0x{slot[0]:08x}, {slot[1]} }},\n")
+	out.write("};\n")
+
+
+def main(out):
+	root = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+	registry, ns_string_encodings = read_registry(os.path.join(root, "src", "PortableBackend.cc"))
+
+	if len(registry) >= 0xFF:
+		raise ValueError("registry positions must fit in a byte")
+
+	# As with a search of the registry from the beginning, the first entry with a given key wins.
+	names, codepages, nss, ids = {}, {}, {}, {}
+	positions = {entry["id"]: position for position, entry in enumerate(registry)}
+
+	for position, entry in enumerate(registry):
+		ids.setdefault(entry["id"], position)
+
+		for name in entry["names"]:
+			if not name.isascii():
+				raise ValueError(f"{name} is not ASCII")
+			if name.lower() in names and names[name.lower()] != position:
+				raise ValueError(f"{name} names more than one encoding")
+			names.setdefault(name.lower(), position)
+
+		if entry["codepage"] is not None:
+			codepages.setdefault(entry["codepage"], position)
+
+		# Every encoding's NSStringEncoding is its CFStringEncoding with the high bit set, and some also have a second, older constant.
+		nss.setdefault(entry["id"] | NS_STRING_ENCODING_HIGH_BIT, position)
+
+	for encoding, ns in ns_string_encodings:
+		if encoding in positions:
+			nss.setdefault(ns, positions[encoding])
+
+	out.write("// Generated by tools/generate-name-index.py from src/PortableBackend.cc. Do not edit.\n\n")
+	out.write("#pragma once\n\n")
+	out.write("#include <cstddef>\n")
+	out.write("#include <cstdint>\n\n")
+	out.write("/** A slot in one of the tables below. `entry` is a position in the registry, or `kNoIndexEntry` if the slot is empty. */\n")
+	out.write("struct IndexedName {\n\tconst char *name;\n\tuint8_t length;\n\tuint8_t entry;\n};\n\n")
+	out.write("struct IndexedNumber {\n\tuint32_t key;\n\tuint8_t entry;\n};\n\n")
+	out.write("static constexpr uint8_t kNoIndexEntry = 0xff;\n")
+	out.write(f"static constexpr size_t kIndexedRegistrySize = {len(registry)};\n")
+	out.write(f"static constexpr size_t kMaxIndexedNameLength = {max(len(name) for name in names)};\n")
+
+	displacements, slots = build(names, hash_name)
+	out.write("\n// IANA character set names, in lower case\n")
+	emit_displacements(out, "Name", displacements)
+	out.write(f"static constexpr IndexedName kNameSlots[{len(slots)}] = {{\n")
+	for slot in slots:
+		out.write("\t{ \"\", 0, kNoIndexEntry },\n" if slot is None else f"\t{{ \"{slot[0]}\", {len(slot[0])}, {slot[1]} }},\n")
+	out.write("};\n")
+
+	emit_number_index(out, "WindowsCodepage", "Windows codepages", codepages)
+	emit_number_index(out, "NSStringEncoding", "NSStringEncoding constants", nss)
+	emit_number_index(out, "Encoding", "CFStringEncodings", ids)
+
+
+if __name__ == "__main__":
+	main(sys.stdout)
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+Generates the conversion tables used by the portable backend, from the codecs that ship with Python.
+
+Usage: tools/generate-tables.py > src/sbcs-tables.hh
+
+The output is checked in, so this only needs to be run when adding or changing a table.
+"""
+
+import codecs
+import sys
+
+# (C++ identifier, Python codec name)
+SINGLE_BYTE_TABLES = [
+	("ASCII", "ascii"),
+	("MacRoman", "mac_roman"),
+	("ISOLatin1", "latin_1"),
+	("WindowsLatin1", "cp1252"),
+	("WindowsLatin2", "cp1250"),
+	("WindowsCyrillic", "cp1251"),
+	("WindowsGreek", "cp1253"),
+	("WindowsLatin5", "cp1254"),
+	("WindowsHebrew", "cp1255"),
+	("WindowsArabic", "cp1256"),
+	("WindowsBalticRim", "cp1257"),
+	("WindowsVietnamese", "cp1258"),
+	("ISOLatin2", "iso8859_2"),
+	("ISOLatin3", "iso8859_3"),
+	("ISOLatin4", "iso8859_4"),
+	("ISOLatinCyrillic", "iso8859_5"),
+	("ISOLatinArabic", "iso8859_6"),
+	("ISOLatinGreek", "iso8859_7"),
+	("ISOLatinHebrew", "iso8859_8"),
+	("ISOLatin5", "iso8859_9"),
+	("ISOLatin6", "iso8859_10"),
+	("ISOLatinThai", "iso8859_11"),
+	("ISOLatin7", "iso8859_13"),
+	("ISOLatin8", "iso8859_14"),
+	("ISOLatin9", "iso8859_15"),
+	("ISOLatin10", "iso8859_16"),
+	("KOI8R", "koi8_r"),
+	("KOI8U", "koi8_u"),
+	("DOSLatinUS", "cp437"),
+	("DOSGreek", "cp737"),
+	("DOSBalticRim", "cp775"),
+	("DOSLatin1", "cp850"),
+	("DOSLatin2", "cp852"),
+	("DOSCyrillic", "cp855"),
+	("DOSTurkish", "cp857"),
+	("DOSPortuguese", "cp860"),
+	("DOSIcelandic", "cp861"),
+	("DOSHebrew", "cp862"),
+	("DOSCanadianFrench", "cp863"),
+	("DOSArabic", "cp864"),
+	("DOSNordic", "cp865"),
+	("DOSRussian", "cp866"),
+	("DOSGreek2", "cp869"),
+	("DOSThai", "cp874"),
+	("MacCyrillic", "mac_cyrillic"),
+	("MacGreek", "mac_greek"),
+	("MacCentralEurRoman", "mac_latin2"),
+	("MacIcelandic", "mac_iceland"),
+	("MacTurkish", "mac_turkish"),
+	("MacCroatian", "mac_croatian"),
+	("MacRomanian", "mac_romanian"),
+]
+
+UNMAPPED = 0xFFFF
+
+
+def decode_table(codec):
+	table = []
+	for b in range(256):
+		try:
+			s = bytes([b]).decode(codec)
+		except UnicodeDecodeError:
+			table.append(UNMAPPED)
+			continue
+		if len(s) != 1 or ord(s) > 0xFFFF:
+			raise ValueError(f"{codec} byte {b:#04x} does not map to a single BMP character")
+		table.append(ord(s))
+	return table
+
+
+def emit_table(out, name, table):
+	out.write(f"static constexpr char16_t k{name}Table[256] = {{\n")
+	for row in range(0, 256, 8):
+		out.write("\t" + ", ".join(f"0x{c:04x}" for c in table[row:row + 8]) + ",\n")
+	out.write("};\n")
+
+
+def main(out):
+	out.write("// Generated by tools/generate-tables.py. Do not edit.\n\n")
+	out.write("#pragma once\n")
+
+	for name, codec in SINGLE_BYTE_TABLES:
+		codecs.lookup(codec)
+		out.write(f"\n// {codec}\n")
+		emit_table(out, name, decode_table(codec))
+
+
+if __name__ == "__main__":
+	main(sys.stdout)